@@ -0,0 +1,101 @@
+#ifndef _EASM_ARENA_H_
+#define _EASM_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <vector>
+
+namespace EAsm
+{
+    // Bump allocator. Memory is carved from big blocks one piece after
+    // the other and only goes back, all of it at once, when the arena is
+    // destroyed. Nothing allocated here gets its destructor called, so it
+    // only holds trivially destructible data.
+    class Arena
+    {
+    public:
+        static constexpr size_t BlockSize = 64 * 1024;
+
+        Arena()
+        : cur(nullptr), end(nullptr)
+        {}
+
+        ~Arena()
+        {
+            for (char *block : blocks)
+                std::free(block);
+        }
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        void *allocate(size_t size, size_t align = alignof(std::max_align_t))
+        {
+            uintptr_t p = (reinterpret_cast<uintptr_t>(cur) + (align - 1)) & ~uintptr_t(align - 1);
+
+            if (cur == nullptr || p + size > reinterpret_cast<uintptr_t>(end))
+                return allocateSlow(size, align);
+
+            cur = reinterpret_cast<char *>(p + size);
+
+            return reinterpret_cast<void *>(p);
+        }
+
+        template <typename T>
+        T *allocArray(size_t count)
+        { return static_cast<T *>(allocate(sizeof(T) * count, alignof(T))); }
+
+        std::string_view copyString(std::string_view str)
+        {
+            if (str.empty())
+                return std::string_view();
+
+            char *p = static_cast<char *>(allocate(str.size(), 1));
+
+            std::memcpy(p, str.data(), str.size());
+
+            return std::string_view(p, str.size());
+        }
+
+    private:
+        // Pieces bigger than a quarter of a block get a block of their own,
+        // the current block keeps serving the small ones
+        void *allocateSlow(size_t size, size_t align)
+        {
+            size_t block_size = size + align;
+            bool own_block = (block_size > BlockSize / 4);
+
+            if (!own_block)
+                block_size = BlockSize;
+
+            char *block = static_cast<char *>(std::malloc(block_size));
+
+            if (block == nullptr)
+                throw std::bad_alloc();
+
+            blocks.push_back(block);
+
+            uintptr_t p = (reinterpret_cast<uintptr_t>(block) + (align - 1)) & ~uintptr_t(align - 1);
+
+            if (!own_block)
+            {
+                cur = reinterpret_cast<char *>(p + size);
+                end = block + block_size;
+            }
+
+            return reinterpret_cast<void *>(p);
+        }
+
+    private:
+        char *cur;
+        char *end;
+        std::vector<char *> blocks;
+    };
+
+} // namespace EAsm
+
+#endif
@@ -15,11 +15,22 @@ namespace EAsm
           show_exec_time(false),
           interactive(false),
           show_help(false),
+          disasm(false),
           gbl_size(0),
           stk_size(0),
+          heap_size(0),
+          history_size(0),
+          threads(0),
           entry_label(),
+          exec_engine("decoded"),
+          flush_policy(),
+          emit_c_file(),
+          resume_file(),
+          cache_dir(),
+          batch_file(),
           vga_plugin_lib(),
-          input_files()
+          input_files(),
+          lane_inputs()
         {
         }
 
@@ -28,12 +39,23 @@ namespace EAsm
         bool show_exec_time;
         bool interactive;
         bool show_help;
+        bool disasm;
         size_t gbl_size;
         size_t stk_size;
+        size_t heap_size;
+        size_t history_size;
+        size_t threads;
         std::string entry_label;
+        std::string exec_engine;
+        std::string flush_policy;
+        std::string emit_c_file;
+        std::string resume_file;
+        std::string cache_dir;
+        std::string batch_file;
         std::string vga_plugin_lib;
         std::string sc_plugin_lib;
         std::vector<std::string> input_files;
+        std::vector<std::string> lane_inputs;
     };
 
     void usage(const char *prog_name);
@@ -19,9 +19,11 @@ namespace EAsm
         VirtualAddrNotAligned,
         InstAddrOutOfRange,
         SyscallNotImplemented,
+        OutOfMemory,
         UnsupportedInst,
         Break,
         Stop,
+        Checkpoint,
         Bug,
     };
 
@@ -154,6 +156,9 @@ namespace EAsm
         void removeSrcInfo()
         { osrc_info = std::nullopt; }
 
+        void setSrcInfo(const SrcInfo& src_info)
+        { osrc_info = src_info; }
+
         bool hasSrcInfo() const
         { return (osrc_info != std::nullopt); }
 
@@ -171,10 +176,12 @@ namespace EAsm
 
         void print(std::ostream& out) const
         {
+            // Line 0 is code without a source, like a loaded executable
             if (osrc_info)
             {
-                out << colorText(fcolor::green, fileName()) << ":"
-                    << colorText(fcolor::yellow, lineNum()) << ":";
+                out << colorText(fcolor::green, fileName()) << ":";
+                if (lineNum() != 0)
+                    out << colorText(fcolor::yellow, lineNum()) << ":";
             }
             if (error_info)
                 error_info->print(out);
@@ -218,7 +225,7 @@ namespace EAsm
     }
 
     Error errorCodeDesc(const SrcInfo& src_info, ErrorCode ecode);
-    Error arithOvfError(const SrcInfo& src_info, const std::string& inst, int32_t arg1, int32_t arg2);
+    Error arithOvfError(const std::string& inst, int32_t arg1, int32_t arg2);
 
 } // namespace EAsm
 
@@ -0,0 +1,185 @@
+#ifndef _EASM_NAME_TABLE_H_
+#define _EASM_NAME_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace EAsm
+{
+    template <typename T>
+    struct NameEntry
+    {
+        std::string_view name;
+        T value{};
+    };
+
+    namespace NameHash
+    {
+        constexpr size_t roundPow2(size_t n)
+        {
+            size_t p = 1;
+
+            while (p < n)
+                p <<= 1;
+
+            return p;
+        }
+
+        constexpr unsigned log2(size_t n)
+        {
+            unsigned bits = 0;
+
+            while ((size_t(1) << bits) < n)
+                bits++;
+
+            return bits;
+        }
+
+        // FNV-1a
+        constexpr uint64_t hash(std::string_view name)
+        {
+            uint64_t h = 0xcbf29ce484222325ull;
+
+            for (char ch : name)
+            {
+                h ^= static_cast<unsigned char>(ch);
+                h *= 0x100000001b3ull;
+            }
+            return h;
+        }
+    }
+
+    // Fixed set of names, the perfect hash is built by the compiler so the
+    // table is plain constant data with nothing to run at startup. Names
+    // are spread over buckets, and every bucket has a displacement chosen
+    // so its names land in slots no other name has. A lookup hashes the
+    // key once and compares it with one name at most. The names must all
+    // be different, the compiler gives up on the table otherwise.
+    template <typename T, size_t N>
+    class NameTable
+    {
+    public:
+        static_assert(N > 0 && N < 0xffff, "Bad name count");
+
+        static constexpr size_t SlotCount = NameHash::roundPow2(2 * N);
+        static constexpr size_t BucketCount = NameHash::roundPow2((N + 1) / 2);
+
+        constexpr NameTable(const NameEntry<T> (&list)[N])
+        : entries(), slots(), disp()
+        {
+            uint64_t hashes[N] = {};
+            size_t bucket_size[BucketCount] = {};
+
+            for (size_t i = 0; i < N; i++)
+            {
+                entries[i] = list[i];
+                hashes[i] = NameHash::hash(list[i].name);
+                bucket_size[bucketOf(hashes[i])]++;
+            }
+
+            // Biggest buckets first, while most of the slots are free
+            for (size_t size = N; size > 0; size--)
+            {
+                for (size_t b = 0; b < BucketCount; b++)
+                {
+                    if (bucket_size[b] == size)
+                        placeBucket(b, hashes);
+                }
+            }
+        }
+
+        constexpr const T *find(std::string_view name) const
+        {
+            uint64_t h = NameHash::hash(name);
+            uint16_t slot = slots[slotOf(h, disp[bucketOf(h)])];
+
+            if (slot != 0 && entries[slot - 1].name == name)
+                return &entries[slot - 1].value;
+
+            return nullptr;
+        }
+
+        constexpr const NameEntry<T> *begin() const
+        { return entries; }
+
+        constexpr const NameEntry<T> *end() const
+        { return entries + N; }
+
+        constexpr size_t size() const
+        { return N; }
+
+    private:
+        static constexpr size_t bucketOf(uint64_t h)
+        {
+            return (BucketCount == 1)? 0 : ((h * 0x9e3779b97f4a7c15ull) >> (64 - NameHash::log2(BucketCount)));
+        }
+
+        static constexpr size_t slotOf(uint64_t h, uint16_t d)
+        {
+            return ((h ^ (d * 0xc2b2ae3d27d4eb4full)) * 0xff51afd7ed558ccdull) >> (64 - NameHash::log2(SlotCount));
+        }
+
+        // Tries displacements until every name of bucket b gets a free slot
+        constexpr void placeBucket(size_t b, const uint64_t (&hashes)[N])
+        {
+            for (uint16_t d = 0; ; d++)
+            {
+                size_t placed = 0;
+                bool ok = true;
+
+                for (size_t i = 0; i < N && ok; i++)
+                {
+                    if (bucketOf(hashes[i]) != b)
+                        continue;
+
+                    size_t s = slotOf(hashes[i], d);
+
+                    if (slots[s] != 0)
+                        ok = false;
+                    else
+                    {
+                        slots[s] = static_cast<uint16_t>(i + 1);
+                        placed++;
+                    }
+                }
+
+                if (ok)
+                {
+                    disp[b] = d;
+                    return;
+                }
+
+                // Takes back the slots of this try
+                for (size_t i = 0; i < N && placed > 0; i++)
+                {
+                    if (bucketOf(hashes[i]) != b)
+                        continue;
+
+                    size_t s = slotOf(hashes[i], d);
+
+                    if (slots[s] == i + 1)
+                    {
+                        slots[s] = 0;
+                        placed--;
+                    }
+                }
+            }
+        }
+
+    private:
+        NameEntry<T> entries[N];
+        uint16_t slots[SlotCount];      // Index of the entry plus one, 0 if free
+        uint16_t disp[BucketCount];
+    };
+
+    // The value type is given and the size comes from the list
+    template <typename T, size_t N>
+    constexpr NameTable<T, N> makeNameTable(const NameEntry<T> (&list)[N])
+    {
+        return NameTable<T, N>(list);
+    }
+
+} // namespace EAsm
+
+#endif
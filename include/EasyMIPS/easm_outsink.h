@@ -0,0 +1,76 @@
+#ifndef _EASM_OUTSINK_H_
+#define _EASM_OUTSINK_H_
+
+#include <cstddef>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+namespace EAsm
+{
+    enum class FlushPolicy
+    {
+        Line,   // Writes the buffer every time a newline goes in
+        Size,   // Writes the buffer when it's full or the stream is flushed
+        Exit    // Grows the buffer and writes it once, when the sink goes away
+    };
+
+    // Stream buffer that collects the output in one contiguous block and
+    // writes it to a file descriptor with write(2), without stdio in the
+    // way. Attached to std::cout it replaces the buffer of the stream, so
+    // the color codes of rang are still left out when the descriptor isn't
+    // a terminal.
+    class OutputSink: public std::streambuf
+    {
+    public:
+        static constexpr size_t DefaultSize = 1 << 20;
+
+        OutputSink(int fd, FlushPolicy policy, size_t size = DefaultSize);
+        ~OutputSink() override;
+
+        OutputSink(const OutputSink&) = delete;
+        OutputSink& operator=(const OutputSink&) = delete;
+
+        // The stream writes through this sink until the sink is destroyed
+        void attach(std::ostream& os);
+
+        // Writes what's in the buffer, whatever the policy
+        bool flush();
+
+        bool isTerminal() const
+        { return is_tty; }
+
+        FlushPolicy flushPolicy() const
+        { return policy; }
+
+        void setFlushPolicy(FlushPolicy new_policy);
+
+    protected:
+        int_type overflow(int_type ch) override;
+        std::streamsize xsputn(const char *s, std::streamsize n) override;
+        int sync() override;
+
+    private:
+        // Moves the characters of the put area into fill
+        void commitPut()
+        {
+            fill += (pptr() - pbase());
+            setp(pptr(), epptr());
+        }
+
+        void resetPut();
+        bool writeOut(const char *s, size_t n);
+
+    private:
+        int fd;
+        FlushPolicy policy;
+        bool is_tty;
+        std::vector<char> buf;
+        size_t fill;                // Bytes in buf before the put area
+        std::ostream *attached;
+        std::streambuf *prev_buf;
+    };
+
+} // namespace EAsm
+
+#endif
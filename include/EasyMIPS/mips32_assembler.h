@@ -2,6 +2,7 @@
 #define __MIPS32_ASSEMBLER_H__
 
 #include <string>
+#include <string_view>
 #include <cstring>
 #include <memory>
 #include <vector>
@@ -11,12 +12,16 @@
 
 namespace Mips32
 {
-    enum class Opcode
+    enum class Opcode : uint8_t
     {
         Add, Sll, Nop, Addu, Srl, And, Sra, Break, Sllv, Div, Srlv, Divu, Srav, Jalr, Jr,
         Syscall, Mfhi, Mflo, Mthi, Mtlo, Mult, Multu, Nor, Or, Slt, Sltu, Sub, Subu, Xor,
         Bltz, Bgez, Beq, Beqz, Bne, Bnez, Blez, Bgtz, Slti, Lb, Sltiu, Lbu, Lh, Ori, Lhu,
         Addi, Addiu, Andi, Xori, Lui, Lw, Lwc1, Sb, Sh, Sw, Swc1, J, Jal, Move, Li, La,
+        Task, // Not an instruction, runs the VmOperation task
+
+        // Superinstructions, only produced by the interpreter block builder
+        LuiOri, AddiuBne, SltBeq, SltBne
     };
 
     enum class ArgType
@@ -336,10 +341,15 @@ namespace Mips32
             std::vector<uint8_t>::iterator it;
         };
 
-        TaskFunction compileInst(Opcode opc, const std::vector<uint32_t> &argv, const EAsm::SrcInfo& src_info);
-        int getRegIndex(const std::string &name);
+        TaskFunction compileInst(Opcode opc, const std::vector<uint32_t> &argv);
+        std::optional<DecodedInst> decodeInst(Opcode opc, const std::vector<uint32_t> &argv);
+
+        // Arguments that decodeInst() turns into di, so an instruction that
+        // only exists in decoded form can be compiled
+        std::vector<uint32_t> instArgs(const DecodedInst& di);
+        int getRegIndex(std::string_view name);
         std::string getRegName(size_t idx);
-        const InstInfo *getInstInfo(const std::string &name);
+        const InstInfo *getInstInfo(std::string_view name);
     }; // namespace Assembler
 
 } // namespace Mips32
@@ -0,0 +1,59 @@
+#ifndef __MIPS32_BATCH_H__
+#define __MIPS32_BATCH_H__
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "mips32_vm.h"
+
+namespace Mips32
+{
+    // One run of a batch. File names are already resolved against the
+    // directory of the manifest.
+    struct BatchJob
+    {
+        long line;                            // Line of the job in the manifest
+        std::vector<std::string> input_files;
+        std::string entry_label;
+        std::string stdin_file;               // Empty gives the program no input
+        std::string expect_file;              // Empty doesn't check the output
+    };
+
+    using BatchJobVector = std::vector<BatchJob>;
+
+    struct BatchOptions
+    {
+        BatchOptions()
+        : engine(ExecEngine::Decoded),
+          ext_sc_handler(nullptr),
+          cache_dir(),
+          threads(0)
+        {}
+
+        ExecEngine engine;
+        SyscallHandler ext_sc_handler;
+        std::string cache_dir;
+        unsigned threads;                     // 0 uses all the cores
+    };
+
+    // A manifest has one job per line, as key=value fields separated by
+    // blanks:
+    //
+    //     run=main.asm,lib.asm entry=main stdin=t1.in expect=t1.out
+    //
+    // Only run is required, it takes the program files separated by
+    // commas. Empty lines and lines starting with # are skipped. Throws
+    // EAsm::Error if the file can't be read or a line is wrong.
+    BatchJobVector parseManifest(const std::string& file);
+
+    // Runs the jobs on a pool of threads. Each thread keeps a virtual
+    // machine of its own, which is reset between jobs. One JSON object per
+    // job is written to out, in the order of the jobs, as soon as the jobs
+    // before it are done. Returns the number of jobs that failed or whose
+    // output wasn't the expected one.
+    size_t runBatch(const BatchJobVector& jobs, const MemoryMap& mmap,
+                    const BatchOptions& opts, std::ostream& out);
+
+} // namespace Mips32
+
+#endif
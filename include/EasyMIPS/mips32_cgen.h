@@ -0,0 +1,52 @@
+#ifndef __MIPS32_CGEN_H__
+#define __MIPS32_CGEN_H__
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "mips32_interp.h"
+
+namespace Mips32
+{
+    // Translates a compiled program into a self-contained C translation
+    // unit. Every basic block becomes a label inside main(), guest registers
+    // are locals, the global memory image is a static array and syscalls go
+    // through a small runtime that mirrors RuntimeContext::syscallHandler().
+    //
+    // Indirect jumps are dispatched over the addresses that can be computed
+    // at translation time: return addresses and text labels loaded into a
+    // register or stored in the global data.
+    class CEmitter
+    {
+    public:
+        CEmitter(const VmOperationVector& action_v, const DebugTable& dbg_table,
+                 MemoryManager& mm);
+
+        CEmitter(const CEmitter&) = delete;
+        CEmitter& operator=(const CEmitter&) = delete;
+
+        // Throws EAsm::Error if the program has commands or instructions the
+        // translator doesn't support
+        void emit(std::ostream& out, VirtualAddr entry_addr);
+
+    private:
+        std::string reg(unsigned index);
+        std::string target(VirtualAddr addr);
+        void findLeaders(VirtualAddr entry_addr);
+        void emitInst(std::ostream& out, size_t idx);
+        void emitRuntime(std::ostream& out);
+
+    private:
+        const VmOperationVector& action_v;
+        const DebugTable& dbg_table;
+        MemoryManager& mm;
+        DecodedInstVector code_v;
+        std::vector<bool> is_label;
+        std::vector<bool> is_indirect;
+        std::vector<bool> reg_used;
+        bool needs_dispatch;
+    };
+
+} // namespace Mips32
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef __MIPS32_CHECKPOINT_H__
+#define __MIPS32_CHECKPOINT_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mips32_runtime.h"
+#include "mips32_lexer.h"
+
+namespace Mips32
+{
+    struct SourceFile
+    {
+        std::string name;
+        SourceTextPtr text;     // Shared with the copies, it's never changed
+    };
+
+    using SourceFileVector = std::vector<SourceFile>;
+
+    // State of a virtual machine saved by #checkpoint. The file has a
+    // versioned header with the memory map, the registers, the instruction
+    // count and the program, and then the memory image at a multiple of
+    // MemoryManager::ImageAlign so it can be mapped back into guest memory.
+    // The program is kept as source text and compiled again on resume,
+    // which puts every instruction at the same address. Numbers are in host
+    // byte order, a checkpoint can't be moved to a host with the other one.
+    struct Checkpoint
+    {
+        static constexpr uint32_t Version = 1;
+
+        Checkpoint(const MemoryMap& mmap)
+        : mem_map(mmap), heap_brk(0), regs(), inst_count(0), image_ofs(0), image_size(0)
+        {}
+
+        // Both throw EAsm::Error if the file can't be written or read. The
+        // memory is written after the header from mm, load() only reads the
+        // header and leaves image_ofs and image_size for
+        // MemoryManager::loadImage().
+        void save(const std::string& file, const MemoryManager& mm);
+        static Checkpoint load(const std::string& file);
+
+        MemoryMap mem_map;
+        VirtualAddr heap_brk;
+        uint32_t regs[RegIndex::Pc + 1];
+        uint64_t inst_count;
+        std::string entry_label;
+        SourceFileVector sources;
+        uint64_t image_ofs;
+        uint64_t image_size;
+    };
+
+} // namespace Mips32
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef __MIPS32_ELF_H__
+#define __MIPS32_ELF_H__
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "mips32_runtime.h"
+
+namespace Mips32
+{
+    // PT_LOAD segment of an executable. Bytes past the file data, up to
+    // mem_size, are zero.
+    struct ElfSegment
+    {
+        VirtualAddr vaddr;
+        uint32_t mem_size;
+        bool exec;
+        std::vector<uint8_t> bytes;
+    };
+
+    // Big-endian ELF32 MIPS executable, as linked by a cross toolchain.
+    // Executable segments make the text, which must start at 0x400000 or
+    // after it, and the others go to the global memory.
+    struct ElfImage
+    {
+        VirtualAddr entry;
+        std::vector<ElfSegment> segments;
+        std::unordered_map<std::string, VirtualAddr> symbols; // From .symtab
+
+        static bool isElf(const std::string& file);
+
+        // Throws EAsm::Error if the file can't be read or isn't an
+        // executable the virtual machine can run
+        static ElfImage load(const std::string& file);
+
+        // Words of the executable segments from 0x400000, in host order
+        std::vector<uint32_t> text() const;
+    };
+
+    // One operation per word of text at 0x400000. The virtual machine has
+    // no delay slots, so a branch or jump and the instruction after it are
+    // swapped when that doesn't change what they do, and otherwise run as
+    // a single operation that evaluates the branch first. Words that aren't
+    // an instruction fail when they run.
+    VmOperationVector compileText(const std::vector<uint32_t>& text, VirtualAddr entry_addr);
+
+} // namespace Mips32
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef __MIPS32_ENCODING_H__
+#define __MIPS32_ENCODING_H__
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include "mips32_runtime.h"
+
+namespace Mips32
+{
+    // MIPS32 machine code for the decoded instructions. Branch and jump
+    // targets are encoded relative to pc the usual way, without delay slots
+    // since the virtual machine doesn't have them. $zero forms are used for
+    // the pseudo instructions: move is addu, beqz and bnez are beq and bne,
+    // and li or la become a single addiu, ori or lui when the value fits.
+    //
+    // Operations that have no single instruction, commands and wider li or
+    // la included, are stored as a word with the reserved opcode 0x3b and
+    // the index of the operation in the low 26 bits.
+    constexpr uint32_t PseudoOpcode = 0x3b;
+
+    inline bool isPseudoWord(uint32_t word)
+    { return (word >> 26) == PseudoOpcode; }
+
+    inline uint32_t pseudoWord(uint32_t index)
+    { return (PseudoOpcode << 26) | (index & 0x3ffffff); }
+
+    inline uint32_t pseudoIndex(uint32_t word)
+    { return word & 0x3ffffff; }
+
+    // Empty if the instruction has no encoding at pc
+    std::optional<uint32_t> encodeInst(const DecodedInst& di, VirtualAddr pc);
+
+    // Empty for pseudo words and words that aren't a supported instruction
+    std::optional<DecodedInst> decodeWord(uint32_t word, VirtualAddr pc);
+
+    // Text of the word at pc, in the same syntax the assembler takes
+    std::string disassemble(uint32_t word, VirtualAddr pc);
+
+    // One word per operation, the first one at 0x400000
+    std::vector<uint32_t> encodeProgram(const VmOperationVector& action_v);
+
+} // namespace Mips32
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef __MIPS32_HISTORY_H__
+#define __MIPS32_HISTORY_H__
+
+#include <cstdint>
+#include <vector>
+#include "mips32_runtime.h"
+
+namespace Mips32
+{
+    // Undo log of the instructions run by the virtual machine, so they can
+    // be stepped backward and forward again. Every instruction logs its PC
+    // and the old value of what it changes: the registers its decoded form
+    // writes, memory words written by stores and the ReadString syscall,
+    // and the heap break moved by sbrk. Instructions without a decoded form
+    // and syscalls compare all the registers after running instead. A
+    // plain ALU instruction takes two 12 byte records.
+    //
+    // Records are kept in a ring buffer of a fixed budget. When it's full
+    // the oldest instructions are dropped. Undoing swaps the logged value
+    // with the current one, so the same record redoes the change later.
+    // Memory written by debugger commands and syscall plugins isn't logged.
+    class ExecHistory
+    {
+    public:
+        ExecHistory(size_t budget);
+
+        // Forgets everything, the current state is the oldest point
+        void clear();
+
+        // Called around every operation that runs. Undone instructions that
+        // haven't been redone are dropped by the next one.
+        void beginStep(RuntimeContext& ctx, const VmOperation& op);
+        void endStep(const RuntimeContext& ctx);
+
+        // Both return the number of instructions actually stepped
+        size_t undo(RuntimeContext& ctx, size_t count);
+        size_t redo(RuntimeContext& ctx, size_t count);
+
+        // Undoes instructions until the one at pc is the next to run.
+        // Returns false, leaving ctx alone, if it's not in the history.
+        bool rewind(RuntimeContext& ctx, VirtualAddr pc);
+
+        size_t undoCount() const
+        { return past_steps; }
+
+        size_t redoCount() const
+        { return total_steps - past_steps; }
+
+    private:
+        enum class Kind : uint32_t
+        { Step, Reg, Mem, Brk };
+
+        struct Record
+        {
+            Kind kind;
+            uint32_t addr; // PC, register index or word address
+            uint32_t value;
+        };
+
+        // The capacity is a power of two, the ring only wraps once it's full
+        Record& at(size_t index)
+        { return ring[(first + index) & (capacity - 1)]; }
+
+        static size_t ringCapacity(size_t budget);
+
+        void push(const Record& rec)
+        {
+            if (!in_step)
+                return;
+
+            if (count == capacity)
+            {
+                makeRoom();
+                if (!in_step)
+                    return;
+            }
+
+            if (count < ring.size())
+                at(count) = rec;
+            else
+                ring.push_back(rec);
+
+            count++;
+            past++;
+        }
+
+        void makeRoom();
+        void saveReg(const RuntimeContext& ctx, uint32_t index);
+        void saveRegs(const RuntimeContext& ctx);
+        void saveWord(RuntimeContext& ctx, VirtualAddr vaddr);
+        static void swap(RuntimeContext& ctx, Record& rec);
+
+    private:
+        size_t capacity;
+        std::vector<Record> ring;
+        size_t first;       // Index of the oldest record
+        size_t count;       // Records, undone ones included
+        size_t past;        // Records that haven't been undone
+        size_t step_start;  // First record of the current instruction
+        size_t total_steps;
+        size_t past_steps;
+        bool in_step;       // The current instruction is being logged
+        bool diff_regs;     // Its registers are compared with shadow
+        uint32_t shadow[RegIndex::Pc]; // Registers before it ran
+    };
+
+} // namespace Mips32
+
+#endif
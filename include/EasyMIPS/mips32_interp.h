@@ -0,0 +1,82 @@
+#ifndef __MIPS32_INTERP_H__
+#define __MIPS32_INTERP_H__
+
+#include <vector>
+#include "mips32_runtime.h"
+
+namespace Mips32
+{
+    using DecodedInstVector = std::vector<DecodedInst>;
+
+    bool isBlockEnd(Opcode opc);
+    bool hasStaticTarget(Opcode opc);
+
+    // Runs a program from a flat array of decoded instructions using a switch
+    // dispatch loop. Instructions that need error reporting, syscalls and
+    // commands are delegated to the VmOperation task, so the behavior matches
+    // the closure engine.
+    //
+    // Code is executed in basic blocks which are built the first time
+    // execution reaches their start address. A block ends after a branch,
+    // jump, syscall or command, and it's linked to its successor blocks once
+    // they are known, so the address checks and the instruction counting are
+    // done once per block.
+    //
+    // After loadText() the instructions are decoded from the machine code
+    // in guest memory instead, so a program can modify its own code. Words
+    // written by the program are decoded again and all the blocks dropped
+    // before the next block runs, a change to the running block only shows
+    // once it's left.
+    class Interpreter
+    {
+    public:
+        Interpreter(const VmOperationVector& action_v);
+
+        // Decodes the text of mm, which must have been encoded from action_v
+        void loadText(MemoryManager& mm);
+
+        ErrorCode run(RuntimeContext& ctx, size_t& inst_count);
+
+        size_t faultIndex() const
+        { return fault_idx; }
+
+        size_t blockCount() const
+        { return blocks.size(); }
+
+    private:
+        static constexpr uint32_t NoBlock = UINT32_MAX;
+
+        struct Block
+        {
+            uint32_t start;       // Index of the first instruction
+            uint32_t inst_count;  // Number of instructions, fused ones included
+            uint32_t first_op;
+            uint32_t op_count;
+            VirtualAddr next_pc;  // Fall through address
+            VirtualAddr taken_pc; // Target of the last branch or jump, if any
+            uint32_t next_blk;
+            uint32_t taken_blk;
+        };
+
+        uint32_t blockAt(size_t idx);
+        uint32_t buildBlock(size_t idx);
+        void flushBlocks();
+        void decodeSlot(size_t idx, uint32_t word, bool rewritten);
+        bool updateText(MemoryManager& mm);
+
+    private:
+        const VmOperationVector& action_v;
+        DecodedInstVector code_v;
+        std::vector<const TaskFunction *> task_v; // Slow path of every instruction
+        std::vector<TaskFunction> slot_tasks;     // Tasks of rewritten instructions
+        std::vector<uint32_t> words;              // Text as last decoded
+        DecodedInstVector ops;
+        std::vector<uint32_t> op_index; // Instruction index of every op
+        std::vector<Block> blocks;
+        std::vector<uint32_t> block_at;
+        size_t fault_idx;
+    };
+
+} // namespace Mips32
+
+#endif
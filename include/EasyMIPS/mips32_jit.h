@@ -0,0 +1,89 @@
+#ifndef __MIPS32_JIT_H__
+#define __MIPS32_JIT_H__
+
+#include <vector>
+#include "mips32_interp.h"
+
+namespace Mips32
+{
+    // Translates basic blocks of decoded instructions into native x86-64
+    // code the first time execution reaches them. Guest registers are read
+    // from and written to the RegFile array, and memory accesses are checked
+    // against the MemoryMap regions before touching the guest memory.
+    //
+    // Whatever the generated code cannot handle (syscalls, commands, faulting
+    // loads and stores, arithmetic overflow) leaves the block through a side
+    // exit, and the instruction is run by its VmOperation task, so the error
+    // codes and messages are the same as in the other engines.
+    //
+    // The JIT is only available on x86-64 hosts that let a page be made
+    // executable, isAvailable() returns false anywhere else.
+    class JitEngine
+    {
+    public:
+        JitEngine(const VmOperationVector& action_v, const MemoryMap& mmap);
+        ~JitEngine();
+
+        JitEngine(const JitEngine&) = delete;
+        JitEngine& operator=(const JitEngine&) = delete;
+
+        bool isAvailable() const
+        { return !chunks.empty(); }
+
+        ErrorCode run(RuntimeContext& ctx, size_t& inst_count);
+
+        size_t faultIndex() const
+        { return fault_idx; }
+
+        size_t blockCount() const
+        { return blocks.size(); }
+
+        // Set when run() stopped because new code couldn't be made
+        // executable, the program goes on from the PC in the context in
+        // another engine
+        bool needsFallback() const
+        { return no_exec; }
+
+    private:
+        // Returns the guest PC where the block was left in the low 32 bits,
+        // and the number of instructions it completed in the high ones. Bit 63
+        // is set on a side exit, the instruction at the PC must then be run
+        // by the interpreter.
+        using BlockFunction = uint64_t (*)(uint32_t *regs, uint8_t *mem, const size_t *heap_size);
+
+        static constexpr uint32_t NoBlock = UINT32_MAX;
+
+        struct Block
+        {
+            BlockFunction fn;
+            VirtualAddr next_pc;  // Fall through address
+            VirtualAddr taken_pc; // Target of the last branch or jump, if any
+            uint32_t next_blk;
+            uint32_t taken_blk;
+        };
+
+        struct CodeChunk
+        {
+            uint8_t *base;
+            size_t size;
+            size_t used;
+        };
+
+        uint32_t blockAt(size_t idx);
+        uint32_t buildBlock(size_t idx);
+        BlockFunction install(const std::vector<uint8_t>& code);
+
+    private:
+        const VmOperationVector& action_v;
+        MemoryMap mmap;
+        DecodedInstVector code_v;
+        std::vector<Block> blocks;
+        std::vector<uint32_t> block_at;
+        std::vector<CodeChunk> chunks;
+        size_t fault_idx;
+        bool no_exec;
+    };
+
+} // namespace Mips32
+
+#endif
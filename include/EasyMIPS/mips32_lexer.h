@@ -4,7 +4,9 @@
 #include <inttypes.h>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <fstream>
 
@@ -18,7 +20,7 @@ namespace Mips32
         {
             KwDotGlobal, KwDotData, KwDotText, KwDotByte, KwDotHWord,
             KwDotWord, KwDotFill, KwShow, KwSet, KwExec,
-            KwStop, KwDebug, KwReset, KwByte, KwHword, KwWord,
+            KwStop, KwDebug, KwReset, KwCheckpoint, KwUndo, KwRedo, KwRewind, KwByte, KwHword, KwWord,
             KwHex, KwDec, KwSigned, KwUnsigned, KwBinary, KwAscii, KwSep,
             KwHiHw, KwLoHw, RegIndex, RegName, Ident, DotIdent, DollarIdent,
             StrLiteral, Label, OpenBracket, CloseBracket, OpenPar, ClosePar,
@@ -28,48 +30,50 @@ namespace Mips32
 
         Token() : line_num(0), token_id(-1) {}
 
-        Token(long line, long tid, const std::string &txt)
+        Token(long line, long tid, std::string_view txt)
             : line_num(line), token_id(tid), text(txt)
         { }
 
-        Token(const Token& rhs)
-            : line_num(rhs.line_num),
-              token_id(rhs.token_id),
-              text(rhs.text)
-        {}
+        bool isNone() { return token_id < 0; }
 
-        Token(Token&& rhs)
-            : line_num(rhs.line_num),
-              token_id(rhs.token_id),
-              text(std::move(rhs.text))
-        { rhs.token_id = -1; }
+        long line_num;
+        long token_id;
+        std::string_view text;  // Points into the source kept by the lexer
+    };
 
-        Token& operator=(Token&& rhs)
-        {
-            line_num = rhs.line_num;
-            token_id = rhs.token_id;
-            text = std::move(rhs.text);
-            rhs.token_id = -1;
+    // Text of a program file followed by Padding zero bytes, which is what
+    // the lexer needs to run over it in place. A file is mapped into memory
+    // instead of read, the page after the file and the rest of its last
+    // page are zeros. The file shouldn't be truncated while it's mapped.
+    class SourceText
+    {
+    public:
+        static constexpr size_t Padding = 16;
 
-            return *this;
-        }
+        // Keeps a copy of text
+        explicit SourceText(std::string_view text);
+        ~SourceText();
 
-        Token& operator=(const Token& rhs)
-        {
-            line_num = rhs.line_num;
-            token_id = rhs.token_id;
-            text = rhs.text;
+        SourceText(const SourceText&) = delete;
+        SourceText& operator=(const SourceText&) = delete;
 
-            return *this;
-        }
+        // Returns nullptr if the file can't be opened
+        static std::shared_ptr<const SourceText> mapFile(const std::string& file);
 
-        bool isNone() { return token_id < 0; }
+        std::string_view text() const
+        { return std::string_view(data, size); }
 
-        long line_num;
-        long token_id;
-        std::string text;
+    private:
+        SourceText() : data(nullptr), size(0), map_size(0) {}
+
+        const char *data;
+        size_t size;
+        size_t map_size;            // 0 when the text is in buff
+        std::vector<char> buff;
     };
 
+    using SourceTextPtr = std::shared_ptr<const SourceText>;
+
     class Lexer
     {
     public:
@@ -78,6 +82,12 @@ namespace Mips32
               state(State::Default),
               ctx(in) {}
 
+        // Lexes the text where it is, src must outlive the lexer
+        Lexer(const SourceText& src)
+            : line_num(1),
+              state(State::Default),
+              ctx(src) {}
+
         ~Lexer(){};
 
         Token getNextToken();
@@ -90,25 +100,25 @@ namespace Mips32
             InShowCmd,
             InSetCmd
         };
-        enum class FillStatus { Ok, Error, Eof };
-
+        // The whole input is read up front, or given as a SourceText, and
+        // never moves, so the text of the tokens can point into it for as
+        // long as the lexer lives
         struct Context
         {
             std::vector<char> buff;
-            char *limit;
-            char *cur;
-            char *tok;
-            char *mark;
-            bool eof;
+            const char *limit;
+            const char *cur;
+            const char *tok;
+            const char *mark;
             long line_num;
-            std::istream &in;
 
             Context(std::istream &in);
-            FillStatus fill(size_t need);
+            Context(const SourceText& src);
 
-            std::string tokenText(bool discard_quotes = false)
+            std::string_view tokenText(bool discard_quotes = false)
             {
-                return discard_quotes ? std::string(tok + 1, cur - 1) : std::string(tok, cur);
+                return discard_quotes ? std::string_view(tok + 1, (cur - tok) - 2)
+                                      : std::string_view(tok, cur - tok);
             }
         };
 
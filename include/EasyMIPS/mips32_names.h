@@ -0,0 +1,152 @@
+#ifndef __MIPS32_NAMES_H__
+#define __MIPS32_NAMES_H__
+
+#include <string_view>
+#include "easm_name_table.h"
+#include "mips32_assembler.h"
+#include "mips32_lexer.h"
+
+// Names of the registers, instructions, directives and commands, for the
+// lexer, the assembler and the completion of the REPL. The tables are
+// built at compile time and looked up with a std::string_view.
+namespace Mips32::Names
+{
+    using EAsm::NameEntry;
+    using EAsm::makeNameTable;
+
+    struct RegNames
+    {
+        std::string_view name;      // $zero, $at, ...
+        std::string_view num_name;  // $r0, $r1, ...
+    };
+
+    inline constexpr RegNames reg_names[] = {
+        {"$zero", "$r0"}, {"$at", "$r1"}, {"$v0", "$r2"}, {"$v1", "$r3"},
+        {"$a0", "$r4"}, {"$a1", "$r5"}, {"$a2", "$r6"}, {"$a3", "$r7"},
+        {"$t0", "$r8"}, {"$t1", "$r9"}, {"$t2", "$r10"}, {"$t3", "$r11"},
+        {"$t4", "$r12"}, {"$t5", "$r13"}, {"$t6", "$r14"}, {"$t7", "$r15"},
+        {"$s0", "$r16"}, {"$s1", "$r17"}, {"$s2", "$r18"}, {"$s3", "$r19"},
+        {"$s4", "$r20"}, {"$s5", "$r21"}, {"$s6", "$r22"}, {"$s7", "$r23"},
+        {"$t8", "$r24"}, {"$t9", "$r25"}, {"$k0", "$r26"}, {"$k1", "$r27"},
+        {"$gp", "$r28"}, {"$sp", "$r29"}, {"$fp", "$r30"}, {"$ra", "$r31"},
+        {"$lo", "$r32"}, {"$hi", "$r33"}, {"$pc", "$r34"}
+    };
+
+    inline constexpr size_t RegCount = sizeof(reg_names) / sizeof(reg_names[0]);
+
+    struct Register
+    {
+        unsigned index;
+        bool numeric;   // Named $rN
+    };
+
+    // Both names of every register
+    constexpr EAsm::NameTable<Register, 2 * RegCount> makeRegisterTable()
+    {
+        NameEntry<Register> list[2 * RegCount] = {};
+
+        for (unsigned i = 0; i < RegCount; i++)
+        {
+            list[2 * i] = {reg_names[i].name, {i, false}};
+            list[2 * i + 1] = {reg_names[i].num_name, {i, true}};
+        }
+        return EAsm::NameTable<Register, 2 * RegCount>(list);
+    }
+
+    inline constexpr auto registers = makeRegisterTable();
+
+    inline constexpr auto mnemonics = makeNameTable<InstInfo>({
+        {"add", {"add", Opcode::Add, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
+        {"sll", {"sll", Opcode::Sll, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
+        {"nop", {"nop", Opcode::Nop, {0, ArgType::None, ArgType::None, ArgType::None}}},
+        {"addu", {"addu", Opcode::Addu, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
+        {"srl", {"srl", Opcode::Srl, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
+        {"and", {"and", Opcode::And, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
+        {"sra", {"sra", Opcode::Sra, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
+        {"break", {"break", Opcode::Break, {1, ArgType::Imm, ArgType::None, ArgType::None}}},
+        {"sllv", {"sllv", Opcode::Sllv, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
+        {"div", {"div", Opcode::Div, {2, ArgType::Reg, ArgType::Reg, ArgType::None}}},
+        {"srlv", {"srlv", Opcode::Srlv, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
+        {"divu", {"divu", Opcode::Divu, {2, ArgType::Reg, ArgType::Reg, ArgType::None}}},
+        {"srav", {"srav", Opcode::Srav, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
+        {"jalr", {"jalr", Opcode::Jalr, {1, ArgType::Reg, ArgType::None, ArgType::None}}},
+        {"jr", {"jr", Opcode::Jr, {1, ArgType::Reg, ArgType::None, ArgType::None}}},
+        {"mfhi", {"mfhi", Opcode::Mfhi, {1, ArgType::Reg, ArgType::None, ArgType::None}}},
+        {"syscall", {"syscall", Opcode::Syscall, {0, ArgType::None, ArgType::None, ArgType::None}}},
+        {"mflo", {"mflo", Opcode::Mflo, {1, ArgType::Reg, ArgType::None, ArgType::None}}},
+        {"mthi", {"mthi", Opcode::Mthi, {1, ArgType::Reg, ArgType::None, ArgType::None}}},
+        {"mtlo", {"mtlo", Opcode::Mtlo, {1, ArgType::Reg, ArgType::None, ArgType::None}}},
+        {"mult", {"mult", Opcode::Mult, {2, ArgType::Reg, ArgType::Reg, ArgType::None}}},
+        {"multu", {"multu", Opcode::Multu, {2, ArgType::Reg, ArgType::Reg, ArgType::None}}},
+        {"nor", {"nor", Opcode::Nor, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
+        {"or", {"or", Opcode::Or, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
+        {"slt", {"slt", Opcode::Slt, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
+        {"sltu", {"sltu", Opcode::Sltu, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
+        {"sub", {"sub", Opcode::Sub, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
+        {"subu", {"subu", Opcode::Subu, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
+        {"xor", {"xor", Opcode::Xor, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
+        {"addi", {"addi", Opcode::Addi, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
+        {"beq", {"beq", Opcode::Beq, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
+        {"bne", {"bne", Opcode::Bne, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
+        {"beqz", {"beqz", Opcode::Beqz, {2, ArgType::Reg, ArgType::Imm, ArgType::None}}},
+        {"bnez", {"bnez", Opcode::Bnez, {2, ArgType::Reg, ArgType::Imm, ArgType::None}}},
+        {"bgtz", {"bgtz", Opcode::Bgtz, {2, ArgType::Reg, ArgType::Imm, ArgType::None}}},
+        {"bltz", {"bltz", Opcode::Bltz, {2, ArgType::Reg, ArgType::Imm, ArgType::None}}},
+        {"bgez", {"bgez", Opcode::Bgez, {2, ArgType::Reg, ArgType::Imm, ArgType::None}}},
+        {"blez", {"blez", Opcode::Blez, {2, ArgType::Reg, ArgType::Imm, ArgType::None}}},
+        {"addiu", {"addiu", Opcode::Addiu, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
+        {"andi", {"andi", Opcode::Andi, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
+        {"slti", {"slti", Opcode::Slti, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
+        {"sltiu", {"sltiu", Opcode::Sltiu, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
+        {"ori", {"ori", Opcode::Ori, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
+        {"xori", {"xori", Opcode::Xori, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
+        {"lui", {"lui", Opcode::Lui, {2, ArgType::Reg, ArgType::Imm, ArgType::None}}},
+        {"lwc1", {"lwc1", Opcode::Lwc1, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
+        {"lw", {"lw", Opcode::Lw, {2, ArgType::Reg, ArgType::BaseOfs, ArgType::None}}},
+        {"lb", {"lb", Opcode::Lb, {2, ArgType::Reg, ArgType::BaseOfs, ArgType::None}}},
+        {"lbu", {"lbu", Opcode::Lbu, {2, ArgType::Reg, ArgType::BaseOfs, ArgType::None}}},
+        {"lh", {"lh", Opcode::Lh, {2, ArgType::Reg, ArgType::BaseOfs, ArgType::None}}},
+        {"lhu", {"lhu", Opcode::Lhu, {2, ArgType::Reg, ArgType::BaseOfs, ArgType::None}}},
+        {"sb", {"sb", Opcode::Sb, {2, ArgType::Reg, ArgType::BaseOfs, ArgType::None}}},
+        {"sh", {"sh", Opcode::Sh, {2, ArgType::Reg, ArgType::BaseOfs, ArgType::None}}},
+        {"sw", {"sw", Opcode::Sw, {2, ArgType::Reg, ArgType::BaseOfs, ArgType::None}}},
+        {"swc1", {"swc1", Opcode::Swc1, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
+        {"j", {"j", Opcode::J, {1, ArgType::Imm, ArgType::None, ArgType::None}}},
+        {"jal", {"jal", Opcode::Jal, {1, ArgType::Imm, ArgType::None, ArgType::None}}},
+        {"move", {"move", Opcode::Move, {2, ArgType::Reg, ArgType::Reg, ArgType::None}}},
+        {"la", {"la", Opcode::La, {2, ArgType::Reg, ArgType::Imm, ArgType::None}}},
+        {"li", {"li", Opcode::Li, {2, ArgType::Reg, ArgType::Imm, ArgType::None}}},
+    });
+
+    // The values are Token ids
+    inline constexpr auto directives = makeNameTable<unsigned>({
+        {".global", Token::KwDotGlobal}, {".data", Token::KwDotData},
+        {".text", Token::KwDotText}, {".byte", Token::KwDotByte},
+        {".hword", Token::KwDotHWord}, {".word", Token::KwDotWord}
+    });
+
+    inline constexpr auto commands = makeNameTable<unsigned>({
+        {"#show", Token::KwShow}, {"#set", Token::KwSet}, {"#exec", Token::KwExec},
+        {"#reset", Token::KwReset}, {"#checkpoint", Token::KwCheckpoint},
+        {"#undo", Token::KwUndo}, {"#redo", Token::KwRedo}, {"#rewind", Token::KwRewind},
+        {"#stop", Token::KwStop}, {"#hihw", Token::KwHiHw}, {"#lohw", Token::KwLoHw},
+        {"#debug", Token::KwDebug}
+    });
+
+    // Keywords after #show and after #set
+    inline constexpr auto show_keywords = makeNameTable<unsigned>({
+        {"hexadecimal", Token::KwHex}, {"hex", Token::KwHex},
+        {"decimal", Token::KwDec}, {"signed", Token::KwSigned},
+        {"unsigned", Token::KwUnsigned}, {"binary", Token::KwBinary},
+        {"byte", Token::KwByte}, {"ascii", Token::KwAscii},
+        {"hword", Token::KwHword}, {"word", Token::KwWord},
+        {"sep", Token::KwSep}
+    });
+
+    inline constexpr auto set_keywords = makeNameTable<unsigned>({
+        {"byte", Token::KwByte}, {"hword", Token::KwHword}, {"word", Token::KwWord}
+    });
+
+} // namespace Mips32::Names
+
+#endif // __MIPS32_NAMES_H__
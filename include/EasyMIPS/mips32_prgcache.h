@@ -0,0 +1,67 @@
+#ifndef __MIPS32_PRGCACHE_H__
+#define __MIPS32_PRGCACHE_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mips32_runtime.h"
+#include "mips32_checkpoint.h"
+
+namespace Mips32
+{
+    // Global data of one assembled file
+    struct DataBlock
+    {
+        VirtualAddr vaddr;
+        std::vector<uint8_t> bytes;
+    };
+
+    using DataBlockVector = std::vector<DataBlock>;
+
+    // Assembled programs kept on disk, one file per program in a directory,
+    // so running the same sources again skips the lexer, the parser and the
+    // assembler. A file has the decoded instructions, the source line of
+    // every one, the global data and the entry address. It's named after
+    // a hash of the sources, the entry label and the memory map, and mapped
+    // in with a single mmap where the host has it. Numbers are in host byte
+    // order.
+    //
+    // Only programs made of decoded instructions can be kept, the tasks of
+    // debugger commands can't be rebuilt without the AST. A file that can't
+    // be read or written is a miss, never an error.
+    class ProgramCache
+    {
+    public:
+        static constexpr uint32_t Version = 1;
+
+        ProgramCache(const std::string& dir)
+        : dir(dir)
+        {}
+
+        static uint64_t programKey(const SourceFileVector& sources,
+                                   const std::string& entry_label,
+                                   const MemoryMap& mmap);
+
+        static bool canStore(const VmOperationVector& action_v);
+
+        // On a hit the operations are compiled again from the decoded
+        // instructions and the global data is written into mm
+        bool load(uint64_t key, MemoryManager& mm, VmOperationVector& action_v,
+                  DebugTable& dbg_table, VirtualAddr& entry_addr);
+
+        // The file is written aside and renamed, so other processes never
+        // see half of it
+        bool store(uint64_t key, const VmOperationVector& action_v,
+                   const DebugTable& dbg_table, const DataBlockVector& data,
+                   VirtualAddr entry_addr);
+
+    private:
+        std::string filePath(uint64_t key) const;
+
+    private:
+        std::string dir;
+    };
+
+} // namespace Mips32
+
+#endif
@@ -8,6 +8,7 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "mem_iterator.h"
@@ -40,15 +41,27 @@ namespace Mips32
         ReadInt = 5,
         ReadString = 8,
         ReadChar = 12,
-        ExitProgram = 10
+        Sbrk = 9,
+        ExitProgram = 10,
+        ReadInts = 60       // Reads $a1 integers into the word array at $a0
     };
 
+    // The heap starts at the first page after the global memory and grows
+    // with sbrk up to heap_limit bytes. Only the part below the current
+    // heap size is mapped. In memory it goes after the global memory and
+    // the stack.
     struct MemoryMap
     {
+        static constexpr size_t PageSize = 4096;
+        static constexpr VirtualAddr DataStart = 0x10000000;
+        static constexpr VirtualAddr StackTop = 0x7fffeffc;
+
         MemoryMap(VirtualAddr g_start, VirtualAddr s_start,
-                  size_t g_size, size_t s_size)
+                  size_t g_size, size_t s_size, size_t h_limit = 0)
         : gbl_start(g_start), stk_start(s_start),
-          gbl_size(g_size), stk_size(s_size)
+          heap_start((g_start + g_size + (PageSize - 1)) & ~(PageSize - 1)),
+          gbl_size(g_size), stk_size(s_size),
+          heap_size(0), heap_limit(h_limit)
         {}
 
         long offsetOf(VirtualAddr vaddr) const
@@ -57,6 +70,8 @@ namespace Mips32
                 return (vaddr - gbl_start);
             else if (vaddr >= stk_start && vaddr < (stk_start + stk_size))
                 return ((vaddr - stk_start) + gbl_size);
+            else if (vaddr >= heap_start && vaddr < (heap_start + heap_size))
+                return ((vaddr - heap_start) + gbl_size + stk_size);
             else
                 return -1;
         }
@@ -73,8 +88,14 @@ namespace Mips32
         VirtualAddr stkEndAddr() const
         { return (stk_start + stk_size); }
 
+        VirtualAddr heapStartAddr() const
+        { return heap_start; }
+
+        VirtualAddr heapEndAddr() const
+        { return (heap_start + heap_size); }
+
         long maxOffset() const
-        { return (gbl_size + stk_size - 1); }
+        { return (gbl_size + stk_size + heap_size - 1); }
 
         size_t gblSize() const
         { return gbl_size; }
@@ -82,6 +103,31 @@ namespace Mips32
         size_t stkSize() const
         { return stk_size; }
 
+        size_t heapSize() const
+        { return heap_size; }
+
+        size_t heapLimit() const
+        { return heap_limit; }
+
+        void setHeapSize(size_t size)
+        { heap_size = size; }
+
+        // The global memory starts from DataStart, the heap follows it and
+        // can grow up to its limit without reaching the stack, which ends
+        // at StackTop. Sums are done in 64 bits so they can't wrap.
+        bool isValid() const
+        {
+            return gbl_start >= DataStart && ((gbl_start | stk_start | gbl_size | stk_size) % 4) == 0
+                   && uint64_t(gbl_start) + gbl_size <= heap_start
+                   && uint64_t(heap_start) + heap_limit <= stk_start
+                   && uint64_t(stk_start) + stk_size <= StackTop
+                   && heap_size <= heap_limit;
+        }
+
+        // Generated code reads the heap size from here
+        const size_t *heapSizePtr() const
+        { return &heap_size; }
+
         size_t gblWordSize() const
         { return (gbl_size / 4); }
 
@@ -94,24 +140,70 @@ namespace Mips32
     private:
         VirtualAddr gbl_start;
         VirtualAddr stk_start;
+        VirtualAddr heap_start;
         size_t gbl_size;
         size_t stk_size;
+        size_t heap_size;
+        size_t heap_limit;
+    };
+
+    enum class MemAccess : unsigned
+    { Read, Write };
+
+    // Guest memory, text and heap break saved by MemoryManager::snapshot(). On
+    // Linux the image is kept in a memory file and guest memory is mapped
+    // from it copy on write, so a restore only drops the pages written
+    // since. Elsewhere the blocks that aren't zero are kept aside and copied
+    // back. MemoryManager::loadImage() maps a checkpoint file the same way.
+    class MemorySnapshot
+    {
+    public:
+        MemorySnapshot() = default;
+        ~MemorySnapshot();
+
+        MemorySnapshot(const MemorySnapshot&) = delete;
+        MemorySnapshot& operator=(const MemorySnapshot&) = delete;
+
+    private:
+        friend class MemoryManager;
+
+        struct Block
+        {
+            size_t ofs;
+            size_t size;
+        };
+
+        size_t heap_size = 0;
+        VirtualAddr heap_brk = 0;
+        std::vector<uint32_t> text;
+        int fd = -1;
+        size_t fd_ofs = 0;
+        std::vector<Block> blocks;
+        std::vector<uint8_t> data;
     };
 
     class MemoryManager
     {
     public:
+        // Memory images start at a multiple of this in a file, so they can be
+        // mapped on hosts with pages of up to 64 KiB
+        static constexpr size_t ImageAlign = 65536;
+
         MemoryManager(const MemoryMap& mmap)
-        : mmap(mmap)
+        : mmap(mmap), heap_brk(mmap.heapStartAddr())
         {
-            mem = new uint8_t[mmap.wordSize() * 4];
+            mem = allocMem(memSize());
+            flushTlb();
         }
 
         ~MemoryManager()
         {
-            delete[] mem;
+            freeMem(mem, memSize());
         }
 
+        MemoryManager(const MemoryManager&) = delete;
+        MemoryManager& operator=(const MemoryManager&) = delete;
+
         const MemoryMap& memMap() { return mmap; }
 
         template <typename T>
@@ -132,26 +224,191 @@ namespace Mips32
         bool isValidAddr(VirtualAddr vaddr)
         { return (mmap.offsetOf(vaddr) != -1); }
 
+        // Both ends must be in the same region, so every address in between
+        // is mapped as well
         bool isValidAddrRange(VirtualAddr vaddr1, VirtualAddr vaddr2)
         {
-            return ((mmap.offsetOf(vaddr1) != -1)
-                    && (mmap.offsetOf(vaddr2) != -1));
+            long ofs1 = mmap.offsetOf(vaddr1);
+            long ofs2 = mmap.offsetOf(vaddr2);
+
+            return (ofs1 != -1 && ofs2 != -1 && vaddr1 <= vaddr2
+                    && (ofs2 - ofs1) == static_cast<long>(vaddr2 - vaddr1));
         }
 
-    #ifdef _MIPS32_TESTING
         uint8_t* getMem()
         {
             return mem;
         }
-    #endif
+
+        // Host address of the sizeof(T) bytes at vaddr, or nullptr if they
+        // are not mapped or the access is not allowed. Naturally aligned
+        // accesses are served by a direct mapped software TLB, so a hit is a
+        // single compare and an add; anything else goes through the memory
+        // map the same way memIter() does.
+        template <typename T, MemAccess Acc = MemAccess::Read>
+        T* hostPtr(VirtualAddr vaddr)
+        {
+            if ((vaddr % sizeof(T)) == 0)
+            {
+                TlbEntry& e = tlb[static_cast<unsigned>(Acc)][(vaddr >> PageShift) & (TlbSize - 1)];
+                VirtualAddr ofs = vaddr - e.vaddr;
+
+                if (ofs < e.size || refillTlb(e, vaddr, Acc))
+                {
+                    ofs = vaddr - e.vaddr;
+                    return reinterpret_cast<T *>(e.host + (ofs ^ swizzle<T>()));
+                }
+            }
+            if (!isValidAddrRange(vaddr, vaddr + (sizeof(T) - 1)))
+                return textPtr<T, Acc>(vaddr);
+
+            return &(*memIter<T>(vaddr));
+        }
+
+        void flushTlb();
+
+        // Machine code of the program, one word per instruction from
+        // 0x400000. It can be read by naturally aligned accesses, and only
+        // written after setTextWritable(true). The index of every word
+        // written is kept until takeTextDirty(), so the engine can decode it
+        // again. Text isn't part of the data regions, isValidAddr() and the
+        // bulk copies don't see it.
+        void setText(std::vector<uint32_t> words);
+        void setTextWritable(bool writable)
+        { text_writable = writable; }
+
+        const std::vector<uint32_t>& textWords() const
+        { return text; }
+
+        bool textDirty() const
+        { return !text_dirty.empty(); }
+
+        std::vector<uint32_t> takeTextDirty()
+        {
+            std::vector<uint32_t> dirty;
+
+            dirty.swap(text_dirty);
+            return dirty;
+        }
+
+        // Moves the end of the heap incr bytes up, rounded to words, and
+        // leaves the old end in brk. The mapped part grows a page at a time.
+        // Returns false if the heap would go over its limit.
+        bool sbrk(uint32_t incr, VirtualAddr& brk);
+
+        // Puts the end of the heap back at brk, a value sbrk() left before.
+        // Used to undo it, the memory past the new end must be zero again.
+        void setHeapBreak(VirtualAddr brk);
+
+        // Copies the memory and the text of other, which must have the same
+        // memory map. Blocks that are zero in other are skipped, so they stay
+        // unmapped.
+        void copyFrom(const MemoryManager& other);
+
+        // Saves the memory, the text and the heap break. Taking it costs a
+        // pass over the mapped memory, restoring it costs the pages written
+        // since. A snapshot can be restored into any memory manager with the
+        // same memory map, as many times as needed.
+        std::unique_ptr<MemorySnapshot> snapshot();
+        void restore(const MemorySnapshot& snap);
+
+        // Writes the memory at the current position of out, which must be
+        // a multiple of ImageAlign, as imageSize() bytes. Zero blocks are
+        // skipped with a seek, so the file is sparse where the host allows.
+        void saveImage(std::ostream& out) const;
+
+        // Restores an image saved by saveImage() at offset ofs of file. On
+        // POSIX hosts it's mapped copy on write, so pages are only read when
+        // the program touches them. Returns false if it can't be read.
+        bool loadImage(const std::string& file, size_t ofs,
+                       size_t heap_size, VirtualAddr brk);
+
+        size_t imageSize() const
+        { return memSize(); }
+
+        VirtualAddr heapBreak() const
+        { return heap_brk; }
+
+        // Bulk copies between guest memory and a buffer in guest (big endian)
+        // byte order. Words are kept in host order, so on little endian hosts
+        // the bytes are swapped here, a whole block at a time, instead of on
+        // every access. The range must be valid, see isValidAddrRange().
+        void readBytes(VirtualAddr vaddr, void *dst, size_t n);
+        void writeBytes(VirtualAddr vaddr, const void *src, size_t n);
+
+    private:
+        static constexpr unsigned PageShift = 12;
+        static constexpr unsigned TlbSize = 64;
+
+        // Covers the word aligned part of one guest page that is inside a
+        // single region of the memory map. An entry with size 0 never hits.
+        struct TlbEntry
+        {
+            VirtualAddr vaddr;
+            uint32_t size;
+            uint8_t *host;
+        };
+
+        // Offset of a sub word inside a big endian word stored in host order
+        template <typename T>
+        static constexpr VirtualAddr swizzle()
+        {
+        #if __BYTE_ORDER == __BIG_ENDIAN
+            return 0;
+        #else
+            return (4 - sizeof(T)) & 3;
+        #endif
+        }
+
+        bool refillTlb(TlbEntry& e, VirtualAddr vaddr, MemAccess acc);
+
+        // Host address of a text word or sub word. Writes never go through
+        // the TLB, every one of them is recorded.
+        template <typename T, MemAccess Acc>
+        T* textPtr(VirtualAddr vaddr)
+        {
+            VirtualAddr ofs = vaddr - 0x400000;
+
+            if ((vaddr % sizeof(T)) != 0 || ofs / 4 >= text.size())
+                return nullptr;
+
+            if (Acc == MemAccess::Write)
+            {
+                if (!text_writable)
+                    return nullptr;
+                text_dirty.push_back(ofs / 4);
+            }
+
+            uint8_t *host = reinterpret_cast<uint8_t *>(text.data());
+
+            return reinterpret_cast<T *>(host + (ofs ^ swizzle<T>()));
+        }
+
+        size_t memSize() const
+        { return std::max<size_t>(mmap.wordSize() * 4 + mmap.heapLimit(), 1); }
+
+        // Bytes that can hold something other than zero, the heap past its
+        // current size is never touched
+        size_t usedSize() const
+        { return std::min<size_t>(mmap.maxOffset() + 1, memSize()); }
+
+        static uint8_t *allocMem(size_t size);
+        static void freeMem(uint8_t *mem, size_t size);
+        static void clearMem(uint8_t *mem, size_t size);
 
     private:
         uint8_t* mem = nullptr;
         MemoryMap mmap;
+        VirtualAddr heap_brk;
+        std::vector<uint32_t> text;
+        std::vector<uint32_t> text_dirty;
+        bool text_writable = false;
+        TlbEntry tlb[2][TlbSize];
     };
 
     struct RuntimeContext;
     class RegFile;
+    enum class Opcode : uint8_t;
 
     using TaskFunction = std::function<ErrorCode(RuntimeContext&)>;
     using SyscallHandler = ErrorCode (*)(uint32_t*, void*, const MemoryMap*);
@@ -197,14 +454,50 @@ namespace Mips32
         uint32_t regs[32 + 3]; // 32=LO, 33=HI, 34=PC
     };
 
+    // Syscall input read a block at a time from a stream. Only what the
+    // stream has already buffered is taken, so an interactive input isn't
+    // read past the line that was typed. Numbers are parsed in place with
+    // std::from_chars.
+    class InputReader
+    {
+    public:
+        static constexpr size_t BufferSize = 64 * 1024;
+
+        explicit InputReader(std::istream& in);
+
+        // The next line without its newline, valid until the next read
+        std::string_view readLine();
+
+        // Reads a line and returns the number at its start after the
+        // blanks, 0 if there's none or it doesn't fit in a long
+        long readInt();
+
+        // Reads up to count numbers separated by blanks or newlines into
+        // dst, then skips the blanks up to the end of the line. Stops at
+        // the end of the input or at something that isn't a number.
+        // Returns how many numbers were read.
+        size_t readInts(uint32_t *dst, size_t count);
+
+    private:
+        bool refill();
+        bool skipBlanks(bool newlines);
+
+    private:
+        std::istream& in;
+        std::vector<char> buf;
+        size_t pos;
+        size_t end;
+    };
+
     struct RuntimeContext
     {
         RuntimeContext();
         RuntimeContext(MemoryManager* mm);
         RuntimeContext(std::ostream& out);
         RuntimeContext(MemoryManager* mm, std::ostream& out);
+        RuntimeContext(MemoryManager* mm, std::istream& in, std::ostream& out);
 
-        ErrorCode syscallHandler(const EAsm::SrcInfo& src_info);
+        ErrorCode syscallHandler();
 
         EAsm::ErrorPair validateAddr(VirtualAddr vaddr, size_t wcount, WordSize ws);
 
@@ -217,24 +510,60 @@ namespace Mips32
         RegFile reg_file;
         MemoryManager* mm;
         SyscallHandler ext_syscall_handler;
+        InputReader in;
         std::ostream& out;
         EAsm::Error last_error;
+        std::string checkpoint_file; // Set by #checkpoint
+    };
+
+    // Fixed size instruction record used by the decoded execution engine.
+    // Immediates are already sign or zero extended at compile time.
+    struct DecodedInst
+    {
+        Opcode opc;
+        uint8_t rd;
+        uint8_t rs;
+        uint8_t rt;
+        uint32_t imm;
     };
 
     struct VmOperation
     {
         VmOperation() = default;
 
-        VmOperation(const std::string& fname, long line)
-        : task(nullptr), src_info(fname, line)
+        VmOperation(TaskFunction&& task)
+        : task(std::move(task))
         {}
 
         TaskFunction task;
-        EAsm::SrcInfo src_info;  // For error reporting
+        std::optional<DecodedInst> dinst; // Empty for commands
     };
 
     using VmOperationVector = std::vector<VmOperation>;
     using OptVmOperation = std::optional<VmOperation>;
+
+    // Source location of every compiled operation, indexed the same way as
+    // the VmOperationVector. It's only used when building error messages.
+    class DebugTable
+    {
+    public:
+        void add(const char *fname, long line);
+
+        EAsm::SrcInfo srcInfo(size_t index) const;
+
+        size_t size() const
+        { return entries.size(); }
+
+    private:
+        struct Entry
+        {
+            uint32_t file_id;
+            uint32_t line;
+        };
+
+        std::vector<std::string> files;
+        std::vector<Entry> entries;
+    };
 }  // namespace Mips32
 
 #endif
@@ -0,0 +1,69 @@
+#ifndef __MIPS32_SIMT_H__
+#define __MIPS32_SIMT_H__
+
+#include <vector>
+#include "mips32_interp.h"
+
+namespace Mips32
+{
+    // Runs one program over up to MaxLanes independent runtime contexts in
+    // lockstep. Every context has its own memory, input and output, so the
+    // lanes only share the code.
+    //
+    // Registers are kept in struct of arrays form, one row of lanes per
+    // register, so ALU instructions and branch conditions are a plain loop
+    // over the row that the compiler turns into SSE/AVX vector code. Loads
+    // and stores go to the memory of every lane one by one.
+    //
+    // Lanes that are at the same PC run together under a lane mask. The
+    // group with the lowest PC is always the one that runs next, and a group
+    // stops at the end of its basic block or before the target of a branch,
+    // so lanes that took different paths join again at the first common
+    // block. Syscalls, commands and faulting instructions run the
+    // VmOperation task of every lane on its own context.
+    class SimtEngine
+    {
+    public:
+        static constexpr unsigned MaxLanes = 16;
+
+        SimtEngine(const VmOperationVector& action_v);
+
+        // Every context must have the PC at the program entry point. Their
+        // registers hold the final state when it returns.
+        void run(const std::vector<RuntimeContext *>& ctx_v);
+
+        ErrorCode laneResult(unsigned lane) const
+        { return lane_ecode[lane]; }
+
+        size_t faultIndex(unsigned lane) const
+        { return fault_idx[lane]; }
+
+        size_t instCount(unsigned lane) const
+        { return inst_count[lane]; }
+
+    private:
+        struct alignas(64) LaneVector
+        {
+            uint32_t v[MaxLanes];
+        };
+
+        void runGroup(VirtualAddr pc);
+        bool runTask(unsigned lane, size_t idx);
+        void stopLane(unsigned lane, ErrorCode ecode, size_t idx);
+
+    private:
+        const VmOperationVector& action_v;
+        DecodedInstVector code_v;
+        std::vector<bool> is_leader;
+        std::vector<RuntimeContext *> lane_ctx;
+        LaneVector regs[RegIndex::Pc + 1];
+        LaneVector mask;
+        LaneVector running;
+        ErrorCode lane_ecode[MaxLanes];
+        size_t fault_idx[MaxLanes];
+        size_t inst_count[MaxLanes];
+    };
+
+} // namespace Mips32
+
+#endif
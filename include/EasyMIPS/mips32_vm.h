@@ -6,10 +6,30 @@
 #include <memory>
 #include <iosfwd>
 #include "mips32_runtime.h"
+#include "mips32_checkpoint.h"
+#include "mips32_history.h"
 
 namespace Mips32
 {
 
+namespace Ast
+{
+    class AsmProgram;
+    class HistoryCmd;
+}
+
+enum class ExecEngine
+{ Closure, Decoded, Jit };
+
+// Outcome of one of the inputs given to VirtualMachine::execLanes()
+struct LaneResult
+{
+    int status;          // Same value exec() would return
+    size_t inst_count;
+    std::string output;
+    EAsm::Error error;
+};
+
 class VirtualMachine
 {
 public:
@@ -26,33 +46,121 @@ public:
     {}
 
     VirtualMachine(const MemoryMap& mmap, SyscallHandler esch, std::ostream& out)
-    : mem_map(mmap), out(out), ext_sc_handler(esch)
+    : VirtualMachine(mmap, esch, std::cin, out)
+    {}
+
+    // Syscalls read from in and write to out, nothing else is shared, so
+    // every thread can run a machine of its own
+    VirtualMachine(const MemoryMap& mmap, SyscallHandler esch, std::istream& in, std::ostream& out)
+    : mem_map(mmap), ext_sc_handler(esch), in(in), out(out), engine(ExecEngine::Decoded),
+      parse_threads(0)
     { init(); }
 
     const MemoryMap& memoryMap() { return mem_map; }
 
     void init();
-    
+
+    void setExecEngine(ExecEngine eng)
+    { engine = eng; }
+
+    ExecEngine execEngine() const
+    { return engine; }
+
+    // Logs every instruction run, in up to size bytes, so they can be
+    // undone by #undo and #rewind. A size of 0 turns it off. Programs run
+    // by the closure engine while it's on.
+    void setHistorySize(size_t size);
+
+    // Keeps assembled programs in dir and loads them from there when the
+    // same sources are run again, see ProgramCache. An empty dir turns it
+    // off, which is the default.
+    void setCacheDir(const std::string& dir)
+    { cache_dir = dir; }
+
+    // The files of a program are parsed on up to count threads, one file
+    // per thread at a time. 0 uses all the cores, which is the default.
+    void setParseThreads(unsigned count)
+    { parse_threads = count; }
+
     size_t getInstCount() { return inst_count; }
     size_t getExecTime() { return exec_time_us; }
 
     int processCliInput(const std::string& input);
 
+    // A single input file that's an ELF executable is loaded instead of
+    // assembled, see ElfImage. The entry label is then one of its symbols.
     int exec(const std::vector<std::string>& input_files,
              const std::string& entry_label = "");
 
+    int emitC(const std::vector<std::string>& input_files,
+              const std::string& entry_label, std::ostream& c_out);
+
+    // Lists the address, the machine code and the instruction of every
+    // word of the program text
+    int disassemble(const std::vector<std::string>& input_files,
+                    const std::string& entry_label, std::ostream& d_out);
+
+    // Runs the program once for every input text. The runs are independent,
+    // each one has its own memory, and they are done in lockstep by groups
+    // of up to SimtEngine::MaxLanes.
+    int execLanes(const std::vector<std::string>& input_files,
+                  const std::string& entry_label,
+                  const std::vector<std::string>& lane_inputs,
+                  std::vector<LaneResult>& results);
+
+    // Saves the registers, the memory and, while a program runs, the
+    // program and the instruction count. A #checkpoint command in a program
+    // calls this and the run goes on.
+    int checkpoint(const std::string& file);
+
+    // Loads a checkpoint, memory map included, and goes on with the program
+    // saved in it. A checkpoint taken in interactive mode has no program, it
+    // only brings back the registers and the memory.
+    int resume(const std::string& file);
+
     const EAsm::Error& lastError()
     { return last_error; }
 
 private:
-    int exec(const VmOperationVector& action_v, VirtualAddr entry_point, VirtualAddr initial_ra);
+    using ProgramHandler = std::function<int (const VmOperationVector& action_v,
+                                              const DebugTable& dbg_table,
+                                              VirtualAddr entry_addr)>;
+
+    int loadProgram(const std::vector<std::string>& input_files,
+                    const std::string& entry_label, const ProgramHandler& handler);
+    int loadProgram(SourceFileVector&& sources,
+                    const std::string& entry_label, const ProgramHandler& handler);
+    int compileProgram(const ProgramHandler& handler);
+    int execElf(const std::string& file, const std::string& entry_label);
+    int exec(const VmOperationVector& action_v, const DebugTable& dbg_table,
+             VirtualAddr entry_point, VirtualAddr initial_ra);
+    int run(const VmOperationVector& action_v, const DebugTable& dbg_table);
+    bool takeCheckpoint(ErrorCode ecode);
+    int historyCmd(Ast::HistoryCmd *n_cmd, Ast::AsmProgram *n_prg);
+    int execClosures(const VmOperationVector& action_v, const DebugTable& dbg_table);
+    int execDecoded(const VmOperationVector& action_v, const DebugTable& dbg_table);
+    int execJit(const VmOperationVector& action_v, const DebugTable& dbg_table);
+    int engineResult(RuntimeContext& ctx, ErrorCode ecode, size_t fault_idx,
+                     const VmOperationVector& action_v, const DebugTable& dbg_table,
+                     EAsm::Error& error);
+    void runtimeError(RuntimeContext& ctx, const EAsm::SrcInfo& src_info,
+                      ErrorCode ecode, EAsm::Error& error);
 
 private:
     MemoryMap mem_map;
     std::unique_ptr<MemoryManager> mem_mgr;
+    std::unique_ptr<MemorySnapshot> reset_snap;
+    SourceFileVector prg_sources; // Program being run, for checkpoints
+    std::string prg_entry;
+    std::string cache_dir;
+    std::vector<uint32_t> prg_text; // Machine code of a loaded executable
     std::unique_ptr<RuntimeContext> rt_ctx;
+    std::unique_ptr<ExecHistory> history;
     SyscallHandler ext_sc_handler;
+    std::istream& in;
     std::ostream& out;
+    ExecEngine engine;
+    unsigned parse_threads;
     EAsm::Error last_error;
     size_t inst_count;
     size_t exec_time_us;
@@ -18,6 +18,42 @@ namespace EAsm
                   << "  " << colorText(fcolor::magenta, "--entry") << " "
                   << colorText(fcolor::yellow, "<function>\n")
                   << "    Start the program at the specified function\n"
+                  << "  " << colorText(fcolor::magenta, "--engine") << " "
+                  << colorText(fcolor::yellow, "<decoded|closure|jit>\n")
+                  << "    Selects the execution engine (default is decoded)\n"
+                  << "  " << colorText(fcolor::magenta, "--flush") << " "
+                  << colorText(fcolor::yellow, "<line|size|exit>\n")
+                  << "    When the program output is written, on every newline, when the\n"
+                  << "    buffer is full or once at the end. The default is line on a\n"
+                  << "    terminal and size otherwise\n"
+                  << "  " << colorText(fcolor::magenta, "--emit-c") << " "
+                  << colorText(fcolor::yellow, "<file.c>\n")
+                  << "    Translates the program given with --run to C instead of running it\n"
+                  << "  " << colorText(fcolor::magenta, "--disasm\n")
+                  << "    Lists the machine code of the program given with --run instead\n"
+                  << "    of running it\n"
+                  << "  " << colorText(fcolor::magenta, "--lanes")
+                  << " " << colorText(fcolor::yellow, "<input_1>")
+                  << " ... "
+                  << colorText(fcolor::yellow, "<input_N>\n")
+                  << "    Runs the program once per input file in lockstep, the output of\n"
+                  << "    every run is written to <input_i>.out\n"
+                  << "  " << colorText(fcolor::magenta, "--batch") << " "
+                  << colorText(fcolor::yellow, "<manifest>\n")
+                  << "    Runs every job of the manifest on a pool of threads and writes\n"
+                  << "    the result of each one as a line of JSON\n"
+                  << "  " << colorText(fcolor::magenta, "--threads") << " "
+                  << colorText(fcolor::yellow, "<count>\n")
+                  << "    Number of threads used by --batch, or to parse the files given\n"
+                  << "    with --run, all the cores by default\n"
+                  << "  " << colorText(fcolor::magenta, "--resume") << " "
+                  << colorText(fcolor::yellow, "<file>\n")
+                  << "    Goes on with the program saved by #checkpoint in file, with the\n"
+                  << "    memory sizes it had. Use -i for checkpoints taken in interactive mode\n"
+                  << "  " << colorText(fcolor::magenta, "--cache-dir") << " "
+                  << colorText(fcolor::yellow, "<dir>\n")
+                  << "    Keeps the assembled programs in dir, running the same sources\n"
+                  << "    again loads them from there instead of assembling them\n"
                   << "  " << colorText(fcolor::magenta, "--interactive")
                   << " or "
                   << colorText(fcolor::magenta, "-i")
@@ -27,10 +63,20 @@ namespace EAsm
                   << "    Specifies a library to handle syscalls\n"
                   << "  " << colorText(fcolor::magenta, "--gbl-size ")
                   << colorText(fcolor::yellow, "<size>\n")
-                  << "    Defines the size in bytes of the global memory\n"
+                  << "    Defines the size in bytes of the global memory, pages are\n"
+                  << "    allocated when the program first uses them\n"
                   << "  " << colorText(fcolor::magenta, "--stk-size ")
                   << colorText(fcolor::yellow, "<size>\n")
                   << "    Defines the size in bytes of the stack\n"
+                  << "  " << colorText(fcolor::magenta, "--heap-size ")
+                  << colorText(fcolor::yellow, "<size>\n")
+                  << "    Defines the maximum size in bytes that the heap can grow\n"
+                  << "    to with sbrk (syscall 9), 16 MiB by default\n"
+                  << "  " << colorText(fcolor::magenta, "--history-size ")
+                  << colorText(fcolor::yellow, "<size>\n")
+                  << "    Logs the last instructions run in up to size bytes, so they can\n"
+                  << "    be undone with #undo and #rewind. Programs run with the closure\n"
+                  << "    engine while it's on\n"
                   << "  " << colorText(fcolor::magenta, "--inst-count\n")
                   << "    Shows the number of instruction used when running a program\n"
                   << "  " << colorText(fcolor::magenta, "--exec-time\n")
@@ -72,10 +118,33 @@ namespace EAsm
                 }
                 continue;
             }
+            if (strcmp(argv[i], "--lanes") == 0)
+            {
+                i++;
+                while (i < argc)
+                {
+                    if (argv[i][0] == '-') break;
+
+                    args.lane_inputs.emplace_back(argv[i]);
+                    i++;
+                }
+                if (args.lane_inputs.empty())
+                {
+                    std::cerr << "Missing input file name for "
+                              << cboldText(fcolor::red, "--lanes")
+                              << " option\n";
+
+                    usage(prg);
+                    return 2;
+                }
+                continue;
+            }
             if (strcmp(argv[i], "--inst-count") == 0)
                 args.show_inst_count = true;
             else if (strcmp(argv[i], "--exec-time") == 0)
                 args.show_exec_time = true;
+            else if (strcmp(argv[i], "--disasm") == 0)
+                args.disasm = true;
             else if (strcmp(argv[i], "--interactive") == 0
                      || strcmp(argv[i], "-i") == 0)
                 args.interactive = true;
@@ -129,6 +198,54 @@ namespace EAsm
                     return 2;
                 }
             }
+            else if (strcmp(argv[i], "--heap-size") == 0)
+            {
+                i++;
+                if (i >= argc)
+                {
+                    std::cerr << "Missing size argument in option "
+                              << cboldText(fcolor::red, "--heap-size")
+                              << '\n';
+                    usage(prg);
+                    return 2;
+                }
+
+                char *endptr;
+                args.heap_size = std::strtoul(argv[i], &endptr, 10);
+
+                if (*endptr != '\0')
+                {
+                    std::cerr << "Invalid size argument in option "
+                              << cboldText(fcolor::red, "--heap-size")
+                              << '\n';
+                    usage(prg);
+                    return 2;
+                }
+            }
+            else if (strcmp(argv[i], "--history-size") == 0)
+            {
+                i++;
+                if (i >= argc)
+                {
+                    std::cerr << "Missing size argument in option "
+                              << cboldText(fcolor::red, "--history-size")
+                              << '\n';
+                    usage(prg);
+                    return 2;
+                }
+
+                char *endptr;
+                args.history_size = std::strtoul(argv[i], &endptr, 10);
+
+                if (*endptr != '\0')
+                {
+                    std::cerr << "Invalid size argument in option "
+                              << cboldText(fcolor::red, "--history-size")
+                              << '\n';
+                    usage(prg);
+                    return 2;
+                }
+            }
             else if (strcmp(argv[i], "--vga-plugin") == 0)
             {
                 i++;
@@ -142,6 +259,56 @@ namespace EAsm
                 }
                 args.vga_plugin_lib = argv[i];
             }
+            else if (strcmp(argv[i], "--threads") == 0)
+            {
+                i++;
+                if (i >= argc)
+                {
+                    std::cerr << "Missing count argument in option "
+                              << cboldText(fcolor::red, "--threads")
+                              << '\n';
+                    usage(prg);
+                    return 2;
+                }
+
+                char *endptr;
+                args.threads = std::strtoul(argv[i], &endptr, 10);
+
+                if (*endptr != '\0')
+                {
+                    std::cerr << "Invalid count argument in option "
+                              << cboldText(fcolor::red, "--threads")
+                              << '\n';
+                    usage(prg);
+                    return 2;
+                }
+            }
+            else if (strcmp(argv[i], "--batch") == 0)
+            {
+                i++;
+                if (i >= argc)
+                {
+                    std::cerr << "Missing manifest file for "
+                            << cboldText(fcolor::red, "--batch")
+                            << " option\n";
+                    usage(prg);
+                    return 2;
+                }
+                args.batch_file = argv[i];
+            }
+            else if (strcmp(argv[i], "--cache-dir") == 0)
+            {
+                i++;
+                if (i >= argc)
+                {
+                    std::cerr << "Missing directory for "
+                            << cboldText(fcolor::red, "--cache-dir")
+                            << " option\n";
+                    usage(prg);
+                    return 2;
+                }
+                args.cache_dir = argv[i];
+            }
             else if (strcmp(argv[i], "--sc-handler") == 0)
             {
                 i++;
@@ -155,6 +322,83 @@ namespace EAsm
                 }
                 args.sc_plugin_lib = argv[i];
             }
+            else if (strcmp(argv[i], "--engine") == 0
+                     || strncmp(argv[i], "--engine=", 9) == 0)
+            {
+                const char *name = nullptr;
+
+                if (argv[i][8] == '=')
+                    name = argv[i] + 9;
+                else if (++i < argc)
+                    name = argv[i];
+
+                if (name == nullptr || *name == '\0')
+                {
+                    std::cerr << "Missing engine name for "
+                            << cboldText(fcolor::red, "--engine")
+                            << " option\n";
+                    usage(prg);
+                    return 2;
+                }
+                if (strcmp(name, "decoded") != 0 && strcmp(name, "closure") != 0
+                    && strcmp(name, "jit") != 0)
+                {
+                    std::cerr << "Invalid engine " << cboldText(fcolor::red, name)
+                              << " in option " << cboldText(fcolor::red, "--engine")
+                              << '\n';
+                    usage(prg);
+                    return 2;
+                }
+                args.exec_engine = name;
+            }
+            else if (strcmp(argv[i], "--flush") == 0)
+            {
+                i++;
+                if (i >= argc)
+                {
+                    std::cerr << "Missing policy for "
+                            << cboldText(fcolor::red, "--flush")
+                            << " option\n";
+                    usage(prg);
+                    return 2;
+                }
+                if (strcmp(argv[i], "line") != 0 && strcmp(argv[i], "size") != 0
+                    && strcmp(argv[i], "exit") != 0)
+                {
+                    std::cerr << "Invalid policy " << cboldText(fcolor::red, argv[i])
+                              << " in option " << cboldText(fcolor::red, "--flush")
+                              << '\n';
+                    usage(prg);
+                    return 2;
+                }
+                args.flush_policy = argv[i];
+            }
+            else if (strcmp(argv[i], "--emit-c") == 0)
+            {
+                i++;
+                if (i >= argc)
+                {
+                    std::cerr << "Missing output file for "
+                            << cboldText(fcolor::red, "--emit-c")
+                            << " option\n";
+                    usage(prg);
+                    return 2;
+                }
+                args.emit_c_file = argv[i];
+            }
+            else if (strcmp(argv[i], "--resume") == 0)
+            {
+                i++;
+                if (i >= argc)
+                {
+                    std::cerr << "Missing checkpoint file for "
+                            << cboldText(fcolor::red, "--resume")
+                            << " option\n";
+                    usage(prg);
+                    return 2;
+                }
+                args.resume_file = argv[i];
+            }
             else if (strcmp(argv[i], "--entry") == 0)
             {
                 i++;
@@ -21,6 +21,12 @@ namespace EAsm
             case ErrorCode::SyscallNotImplemented:
                 return Error(src_info, "Syscall not implemented\n");
 
+            case ErrorCode::OutOfMemory:
+                return Error(src_info, "Out of memory\n");
+
+            case ErrorCode::Checkpoint:
+                return Error(src_info, "Checkpoints can only be taken in a single run\n");
+
             case ErrorCode::Break:
                 return Error(src_info, "Breakpoint exception\n");
 
@@ -32,9 +38,9 @@ namespace EAsm
         }
     }
 
-    Error arithOvfError(const SrcInfo& src_info, const std::string& inst, int32_t arg1, int32_t arg2)
+    Error arithOvfError(const std::string& inst, int32_t arg1, int32_t arg2)
     {
-        return EAsm::Error(src_info, "Arithmetic overflow in ",
+        return EAsm::Error("Arithmetic overflow in ",
                            cboldText(fcolor::blue, inst), " instruction. ",
                            "The values that caused the overflow are: ",
                            colorText(fcolor::yellow, arg1),
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include "easm_outsink.h"
+
+#if defined(_WIN32)
+    #include <io.h>
+#else
+    #include <unistd.h>
+#endif
+
+namespace EAsm
+{
+    OutputSink::OutputSink(int fd, FlushPolicy policy, size_t size)
+    : fd(fd), policy(policy), is_tty(false), buf(std::max<size_t>(size, 1)),
+      fill(0), attached(nullptr), prev_buf(nullptr)
+    {
+    #if defined(_WIN32)
+        is_tty = (_isatty(fd) != 0);
+    #else
+        is_tty = (::isatty(fd) != 0);
+    #endif
+        resetPut();
+    }
+
+    OutputSink::~OutputSink()
+    {
+        flush();
+
+        if (attached != nullptr)
+            attached->rdbuf(prev_buf);
+    }
+
+    void OutputSink::attach(std::ostream& os)
+    {
+        // Output already in the stream goes out before anything of the sink
+        os.flush();
+        prev_buf = os.rdbuf(this);
+        attached = &os;
+    }
+
+    void OutputSink::setFlushPolicy(FlushPolicy new_policy)
+    {
+        commitPut();
+        policy = new_policy;
+        resetPut();
+    }
+
+    // A line buffered sink keeps the put area empty, every character goes
+    // through overflow() where the newlines are seen
+    void OutputSink::resetPut()
+    {
+        char *p = buf.data() + fill;
+
+        setp(p, (policy == FlushPolicy::Line)? p : buf.data() + buf.size());
+    }
+
+    bool OutputSink::writeOut(const char *s, size_t n)
+    {
+        while (n > 0)
+        {
+        #if defined(_WIN32)
+            int res = _write(fd, s, static_cast<unsigned>(std::min<size_t>(n, 1 << 30)));
+        #else
+            ssize_t res = ::write(fd, s, n);
+        #endif
+            if (res < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+
+                return false;
+            }
+            s += res;
+            n -= res;
+        }
+
+        return true;
+    }
+
+    bool OutputSink::flush()
+    {
+        commitPut();
+
+        // What couldn't be written is dropped, the stream reports the error
+        bool ok = writeOut(buf.data(), fill);
+
+        fill = 0;
+        resetPut();
+
+        return ok;
+    }
+
+    OutputSink::int_type OutputSink::overflow(int_type ch)
+    {
+        if (traits_type::eq_int_type(ch, traits_type::eof()))
+            return (sync() == 0)? traits_type::not_eof(ch) : traits_type::eof();
+
+        char c = traits_type::to_char_type(ch);
+
+        return (xsputn(&c, 1) == 1)? ch : traits_type::eof();
+    }
+
+    std::streamsize OutputSink::xsputn(const char *s, std::streamsize n)
+    {
+        size_t len = static_cast<size_t>(n);
+
+        commitPut();
+        if (fill + len > buf.size())
+        {
+            if (policy == FlushPolicy::Exit)
+                buf.resize(std::max(buf.size() * 2, fill + len));
+            else if (!flush())
+                return 0;
+            else if (len >= buf.size())
+                return writeOut(s, len)? n : 0;
+        }
+
+        std::memcpy(buf.data() + fill, s, len);
+        fill += len;
+
+        if (policy == FlushPolicy::Line && std::memchr(s, '\n', len) != nullptr)
+            return flush()? n : 0;
+
+        resetPut();
+
+        return n;
+    }
+
+    int OutputSink::sync()
+    {
+        if (policy == FlushPolicy::Exit)
+            return 0;
+
+        return flush()? 0 : -1;
+    }
+
+} // namespace EAsm
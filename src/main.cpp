@@ -1,10 +1,14 @@
+#include <fstream>
+#include <sstream>
 #include <replxx.hxx>
 #include "easm_error.h"
 #include "easm_clargs.h"
+#include "easm_outsink.h"
 #include "colorizer.h"
 #include "num_convert.h"
 #include "native_lib.h"
 #include "mips32_vm.h"
+#include "mips32_batch.h"
 #include "mips32_completion.h"
 
 static inline size_t WAlign(size_t size)
@@ -33,6 +37,22 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    // std::cin gets a buffer of its own, so the syscalls read the input a
+    // block at a time. The REPL reads the standard input through stdio.
+    if (!args.interactive)
+        std::ios::sync_with_stdio(false);
+
+    // Everything written to std::cout, the program output included, goes to
+    // the standard output through one large buffer
+    EAsm::OutputSink out_sink(1, EAsm::FlushPolicy::Size);
+
+    if (args.flush_policy == "line" || (args.flush_policy.empty() && out_sink.isTerminal()))
+        out_sink.setFlushPolicy(EAsm::FlushPolicy::Line);
+    else if (args.flush_policy == "exit")
+        out_sink.setFlushPolicy(EAsm::FlushPolicy::Exit);
+
+    out_sink.attach(std::cout);
+
     Mips32::SyscallHandler ext_syscall_handler = nullptr;
     NativeLib nlib;
     if (!args.sc_plugin_lib.empty())
@@ -61,13 +81,194 @@ int main(int argc, char *argv[])
 
     size_t gbl_size = (args.gbl_size>0)? WAlign(args.gbl_size) : 4096;
     size_t stk_size = (args.stk_size>0)? WAlign(args.stk_size) : 4096;
+    size_t heap_size = (args.heap_size>0)? WAlign(args.heap_size) : 16 * 1024 * 1024;
+
+    using Mips32::MemoryMap;
+
+    // Memory is allocated as it's touched, so the sizes are only limits, but
+    // the regions can't overlap. The heap goes after the global memory.
+    MemoryMap mmap(MemoryMap::DataStart, (MemoryMap::StackTop - stk_size), gbl_size, stk_size, heap_size);
+
+    if (stk_size > MemoryMap::StackTop || !mmap.isValid())
+    {
+        std::cerr << "The global memory, the heap and the stack overlap, "
+                  << colorText(fcolor::magenta, "--gbl-size") << " + "
+                  << colorText(fcolor::magenta, "--heap-size") << " + "
+                  << colorText(fcolor::magenta, "--stk-size") << " can be "
+                  << colorText(fcolor::yellow, MemoryMap::StackTop - MemoryMap::DataStart) << " bytes at most\n";
+        return 1;
+    }
+
+    if (!args.batch_file.empty())
+    {
+        if (!args.input_files.empty() || !args.resume_file.empty())
+        {
+            std::cerr << "Option " << cboldText(fcolor::red, "--batch")
+                      << " can't be used with " << cboldText(fcolor::red, "--run")
+                      << " or " << cboldText(fcolor::red, "--resume")
+                      << ", the programs are in the manifest\n";
+            return 2;
+        }
+
+        Mips32::BatchJobVector jobs;
+
+        try
+        {
+            jobs = Mips32::parseManifest(args.batch_file);
+        }
+        catch (EAsm::Error& err)
+        {
+            std::cerr << err;
+            return 1;
+        }
+
+        Mips32::BatchOptions opts;
+
+        if (args.exec_engine == "closure")
+            opts.engine = Mips32::ExecEngine::Closure;
+        else if (args.exec_engine == "jit")
+            opts.engine = Mips32::ExecEngine::Jit;
+
+        opts.ext_sc_handler = ext_syscall_handler;
+        opts.cache_dir = args.cache_dir;
+        opts.threads = args.threads;
+
+        return (Mips32::runBatch(jobs, mmap, opts, std::cout) == 0)? 0 : 1;
+    }
 
-    Mips32::MemoryMap mmap(0x10000000, (0x7fffeffc - stk_size), gbl_size, stk_size);
     Mips32::VirtualMachine vm(mmap, ext_syscall_handler);
 
-    if (!args.input_files.empty())
+    if (args.exec_engine == "closure")
+        vm.setExecEngine(Mips32::ExecEngine::Closure);
+    else if (args.exec_engine == "jit")
+        vm.setExecEngine(Mips32::ExecEngine::Jit);
+
+    if (args.history_size != 0)
+        vm.setHistorySize(args.history_size);
+
+    if (!args.cache_dir.empty())
+        vm.setCacheDir(args.cache_dir);
+
+    vm.setParseThreads(args.threads);
+
+    if (!args.emit_c_file.empty())
+    {
+        if (args.input_files.empty())
+        {
+            std::cerr << "Option " << cboldText(fcolor::red, "--emit-c")
+                      << " needs the program files given with "
+                      << cboldText(fcolor::red, "--run") << '\n';
+            return 2;
+        }
+
+        std::ofstream c_out(args.emit_c_file);
+        if (!c_out.is_open())
+        {
+            std::cerr << "Cannot open file "
+                      << colorText(fcolor::red, args.emit_c_file)
+                      << '\n';
+            return 1;
+        }
+
+        int res = vm.emitC(args.input_files, args.entry_label, c_out);
+        if (res != 0)
+            std::cerr << vm.lastError();
+
+        return res;
+    }
+
+    if (args.disasm)
     {
-        int res = vm.exec(args.input_files, args.entry_label);
+        if (args.input_files.empty())
+        {
+            std::cerr << "Option " << cboldText(fcolor::red, "--disasm")
+                      << " needs the program files given with "
+                      << cboldText(fcolor::red, "--run") << '\n';
+            return 2;
+        }
+
+        int res = vm.disassemble(args.input_files, args.entry_label, std::cout);
+        if (res != 0)
+            std::cerr << vm.lastError();
+
+        return res;
+    }
+
+    if (!args.lane_inputs.empty())
+    {
+        if (args.input_files.empty())
+        {
+            std::cerr << "Option " << cboldText(fcolor::red, "--lanes")
+                      << " needs the program files given with "
+                      << cboldText(fcolor::red, "--run") << '\n';
+            return 2;
+        }
+
+        std::vector<std::string> lane_inputs;
+        for (const auto& file : args.lane_inputs)
+        {
+            std::ifstream in(file);
+            if (!in.is_open())
+            {
+                std::cerr << "Cannot open file " << colorText(fcolor::red, file) << '\n';
+                return 1;
+            }
+
+            std::ostringstream text;
+            text << in.rdbuf();
+            lane_inputs.push_back(text.str());
+        }
+
+        std::vector<Mips32::LaneResult> results;
+        int res = vm.execLanes(args.input_files, args.entry_label, lane_inputs, results);
+        if (res != 0)
+        {
+            std::cerr << vm.lastError();
+            return res;
+        }
+
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const std::string& file = args.lane_inputs[i];
+            std::ofstream out(file + ".out");
+
+            out << results[i].output;
+
+            if (results[i].status != 0)
+            {
+                std::cerr << colorText(fcolor::green, file) << ": " << results[i].error;
+                res = std::max(res, results[i].status);
+            }
+            else if (args.show_inst_count)
+            {
+                std::cout << colorText(fcolor::green, file) << ": "
+                          << "Number of instructions: "
+                          << colorText(fcolor::yellow, results[i].inst_count)
+                          << '\n';
+            }
+        }
+        if (args.show_exec_time)
+        {
+            std::cout << "Execution time: "
+                      << colorText(fcolor::yellow, vm.getExecTime())
+                      << "us\n";
+        }
+
+        return res;
+    }
+
+    if (!args.resume_file.empty() && !args.input_files.empty())
+    {
+        std::cerr << "Option " << cboldText(fcolor::red, "--resume")
+                  << " can't be used with " << cboldText(fcolor::red, "--run")
+                  << ", the program is in the checkpoint\n";
+        return 2;
+    }
+
+    if (!args.input_files.empty() || !args.resume_file.empty())
+    {
+        int res = args.resume_file.empty()? vm.exec(args.input_files, args.entry_label)
+                                          : vm.resume(args.resume_file);
         if (res == 0)
         {
             if (args.show_inst_count)
@@ -97,14 +298,17 @@ int main(int argc, char *argv[])
               << " (" << colorText(fcolor::cyan, "big endian")
               << ")\n\n";
 
+    // A resumed checkpoint brings its own memory map
+    const Mips32::MemoryMap& vm_mmap = vm.memoryMap();
+
     std::cout << "Global base address = "
-              << colorText(rang::fg::yellow, Cvt::hexVal(mmap.gblStartAddr())) << '\n'
+              << colorText(rang::fg::yellow, Cvt::hexVal(vm_mmap.gblStartAddr())) << '\n'
               << "Stack pointer address = "
-              << colorText(rang::fg::yellow, Cvt::hexVal(mmap.stkEndAddr())) << '\n'
+              << colorText(rang::fg::yellow, Cvt::hexVal(vm_mmap.stkEndAddr())) << '\n'
               << "Global memory size = "
-              << colorText(rang::fg::yellow, mmap.gblWordSize()) << " words\n"
+              << colorText(rang::fg::yellow, vm_mmap.gblWordSize()) << " words\n"
               << "Stack size         = "
-              << colorText(rang::fg::yellow, mmap.stkWordSize()) << " words\n\n";
+              << colorText(rang::fg::yellow, vm_mmap.stkWordSize()) << " words\n\n";
 
     // Register autocompletion callback with replxx
     replxx::Replxx rx;
@@ -1,207 +1,294 @@
+#include <type_traits>
 #include "mips32_assembler.h"
+#include "mips32_names.h"
 #include "easm_error.h"
 #include "num_convert.h"
 #include "colorizer.h"
 
 namespace Mips32::Assembler
 {
-    struct RegName
+    Arg::Array::Array(unsigned sz): sz(sz)
+    { args = new Arg[sz]; }
+
+    // Closures returned by compileInst() are specialized on the operand shape,
+    // which is known at assembly time: writes to $zero are dropped, a source
+    // register used twice is read once and immediates are extended once.
+
+    struct AddOp
+    { static uint32_t eval(uint32_t a, uint32_t b) { return a + b; } };
+
+    struct SubOp
+    { static uint32_t eval(uint32_t a, uint32_t b) { return a - b; } };
+
+    struct AndOp
+    { static uint32_t eval(uint32_t a, uint32_t b) { return a & b; } };
+
+    struct OrOp
+    { static uint32_t eval(uint32_t a, uint32_t b) { return a | b; } };
+
+    struct XorOp
+    { static uint32_t eval(uint32_t a, uint32_t b) { return a ^ b; } };
+
+    struct NorOp
+    { static uint32_t eval(uint32_t a, uint32_t b) { return ~(a | b); } };
+
+    struct SltOp
+    { static uint32_t eval(uint32_t a, uint32_t b) { return static_cast<int32_t>(a) < static_cast<int32_t>(b); } };
+
+    struct SltuOp
+    { static uint32_t eval(uint32_t a, uint32_t b) { return a < b; } };
+
+    struct SllOp
+    { static uint32_t eval(uint32_t a, uint32_t b) { return a << (b & 0x1f); } };
+
+    struct SrlOp
+    { static uint32_t eval(uint32_t a, uint32_t b) { return a >> (b & 0x1f); } };
+
+    struct SraOp
+    { static uint32_t eval(uint32_t a, uint32_t b) { return static_cast<int32_t>(a) >> (b & 0x1f); } };
+
+    static ErrorCode nopTask(RuntimeContext&)
+    { return ErrorCode::Ok; }
+
+    template <typename Op, bool SameSrc>
+    struct RegRegTask
     {
-        const char *name1;
-        const char *name2;
+        ErrorCode operator()(RuntimeContext& ctx) const
+        {
+            uint32_t *regs = ctx.reg_file.getRegArray();
+            uint32_t rd1 = regs[rs];
+            uint32_t rd2 = SameSrc? rd1 : regs[rt];
+
+            regs[rd] = Op::eval(rd1, rd2);
+            return ErrorCode::Ok;
+        }
+
+        uint32_t rd, rs, rt;
     };
 
-    static const RegName reg_names[] = {
-        {"$r0", "$zero"},
-        {"$r1", "$at"},
-        {"$r2", "$v0"},
-        {"$r3", "$v1"},
-        {"$r4", "$a0"},
-        {"$r5", "$a1"},
-        {"$r6", "$a2"},
-        {"$r7", "$a3"},
-        {"$r8", "$t0"},
-        {"$r9", "$t1"},
-        {"$r10", "$t2"},
-        {"$r11", "$t3"},
-        {"$r12", "$t4"},
-        {"$r13", "$t5"},
-        {"$r14", "$t6"},
-        {"$r15", "$t7"},
-        {"$r16", "$s0"},
-        {"$r17", "$s1"},
-        {"$r18", "$s2"},
-        {"$r19", "$s3"},
-        {"$r20", "$s4"},
-        {"$r21", "$s5"},
-        {"$r22", "$s6"},
-        {"$r23", "$s7"},
-        {"$r24", "$t8"},
-        {"$r25", "$t9"},
-        {"$r26", "$k0"},
-        {"$r27", "$k1"},
-        {"$r28", "$gp"},
-        {"$r29", "$sp"},
-        {"$r30", "$fp"},
-        {"$r31", "$ra"},
-        {"$r32", "$lo"},
-        {"$r33", "$hi"},
-        {"$r34", "$pc"},
+    template <typename Op, bool ZeroImm>
+    struct RegImmTask
+    {
+        ErrorCode operator()(RuntimeContext& ctx) const
+        {
+            uint32_t *regs = ctx.reg_file.getRegArray();
+
+            regs[rt] = Op::eval(regs[rs], ZeroImm? 0 : imm);
+            return ErrorCode::Ok;
+        }
+
+        uint32_t rt, rs, imm;
     };
-    static const int Reg_Count = sizeof(reg_names) / sizeof(reg_names[0]);
-
-    static const std::unordered_map<std::string, InstInfo> inst_info = {
-        {"add", {"add", Opcode::Add, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
-        {"sll", {"sll", Opcode::Sll, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
-        {"nop", {"nop", Opcode::Nop, {0, ArgType::None, ArgType::None, ArgType::None}}},
-        {"addu", {"addu", Opcode::Addu, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
-        {"srl", {"srl", Opcode::Srl, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
-        {"and", {"and", Opcode::And, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
-        {"sra", {"sra", Opcode::Sra, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
-        {"break", {"break", Opcode::Break, {1, ArgType::Imm, ArgType::None, ArgType::None}}},
-        {"sllv", {"sllv", Opcode::Sllv, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
-        {"div", {"div", Opcode::Div, {2, ArgType::Reg, ArgType::Reg, ArgType::None}}},
-        {"srlv", {"srlv", Opcode::Srlv, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
-        {"divu", {"divu", Opcode::Divu, {2, ArgType::Reg, ArgType::Reg, ArgType::None}}},
-        {"srav", {"srav", Opcode::Srav, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
-        {"jalr", {"jalr", Opcode::Jalr, {1, ArgType::Reg, ArgType::None, ArgType::None}}},
-        {"jr", {"jr", Opcode::Jr, {1, ArgType::Reg, ArgType::None, ArgType::None}}},
-        {"mfhi", {"mfhi", Opcode::Mfhi, {1, ArgType::Reg, ArgType::None, ArgType::None}}},
-        {"syscall", {"syscall", Opcode::Syscall, {0, ArgType::None, ArgType::None, ArgType::None}}},
-        {"mflo", {"mflo", Opcode::Mflo, {1, ArgType::Reg, ArgType::None, ArgType::None}}},
-        {"mthi", {"mthi", Opcode::Mthi, {1, ArgType::Reg, ArgType::None, ArgType::None}}},
-        {"mtlo", {"mtlo", Opcode::Mtlo, {1, ArgType::Reg, ArgType::None, ArgType::None}}},
-        {"mult", {"mult", Opcode::Mult, {2, ArgType::Reg, ArgType::Reg, ArgType::None}}},
-        {"multu", {"multu", Opcode::Multu, {2, ArgType::Reg, ArgType::Reg, ArgType::None}}},
-        {"nor", {"nor", Opcode::Nor, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
-        {"or", {"or", Opcode::Or, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
-        {"slt", {"slt", Opcode::Slt, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
-        {"sltu", {"sltu", Opcode::Sltu, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
-        {"sub", {"sub", Opcode::Sub, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
-        {"subu", {"subu", Opcode::Subu, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
-        {"xor", {"xor", Opcode::Xor, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
-        {"addi", {"addi", Opcode::Addi, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
-        {"beq", {"beq", Opcode::Beq, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
-        {"bne", {"bne", Opcode::Bne, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
-        {"beqz", {"beqz", Opcode::Beqz, {2, ArgType::Reg, ArgType::Imm}}},
-        {"bnez", {"bnez", Opcode::Bnez, {2, ArgType::Reg, ArgType::Imm}}},
-        {"bgtz", {"bgtz", Opcode::Bgtz, {2, ArgType::Reg, ArgType::Imm, ArgType::None}}},
-        {"bltz", {"bltz", Opcode::Bltz, {2, ArgType::Reg, ArgType::Imm, ArgType::None}}},
-        {"bgez", {"bgez", Opcode::Bgez, {2, ArgType::Reg, ArgType::Imm, ArgType::None}}},
-        {"blez", {"blez", Opcode::Blez, {2, ArgType::Reg, ArgType::Imm, ArgType::None}}},
-        {"addiu", {"addiu", Opcode::Addiu, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
-        {"andi", {"andi", Opcode::Andi, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
-        {"slti", {"slti", Opcode::Slti, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
-        {"sltiu", {"sltiu", Opcode::Sltiu, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
-        {"ori", {"ori", Opcode::Ori, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
-        {"xori", {"xori", Opcode::Xori, {3, ArgType::Reg, ArgType::Reg, ArgType::Imm}}},
-        {"lui", {"lui", Opcode::Lui, {2, ArgType::Reg, ArgType::Imm, ArgType::None}}},
-        {"lwc1", {"lwc1", Opcode::Lwc1, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
-        {"lw", {"lw", Opcode::Lw, {2, ArgType::Reg, ArgType::BaseOfs, ArgType::None}}},
-        {"lb", {"lb", Opcode::Lb, {2, ArgType::Reg, ArgType::BaseOfs, ArgType::None}}},
-        {"lbu", {"lbu", Opcode::Lbu, {2, ArgType::Reg, ArgType::BaseOfs, ArgType::None}}},
-        {"lh", {"lh", Opcode::Lh, {2, ArgType::Reg, ArgType::BaseOfs, ArgType::None}}},
-        {"lhu", {"lhu", Opcode::Lhu, {2, ArgType::Reg, ArgType::BaseOfs, ArgType::None}}},
-        {"sb", {"sb", Opcode::Sb, {2, ArgType::Reg, ArgType::BaseOfs, ArgType::None}}},
-        {"sh", {"sh", Opcode::Sh, {2, ArgType::Reg, ArgType::BaseOfs, ArgType::None}}},
-        {"sw", {"sw", Opcode::Sw, {2, ArgType::Reg, ArgType::BaseOfs, ArgType::None}}},
-        {"swc1", {"swc1", Opcode::Swc1, {3, ArgType::Reg, ArgType::Reg, ArgType::Reg}}},
-        {"j", {"j", Opcode::J, {1, ArgType::Imm, ArgType::None, ArgType::None}}},
-        {"jal", {"jal", Opcode::Jal, {1, ArgType::Imm, ArgType::None, ArgType::None}}},
-        {"move", {"move", Opcode::Move, {2, ArgType::Reg, ArgType::Reg, ArgType::None}}},
-        {"la", {"la", Opcode::La, {2, ArgType::Reg, ArgType::Imm, ArgType::None}}},
-        {"li", {"li", Opcode::Li, {2, ArgType::Reg, ArgType::Imm, ArgType::None}}},
+
+    template <typename Op>
+    static TaskFunction regRegTask(uint32_t rd, uint32_t rs, uint32_t rt)
+    {
+        if (rd == RegIndex::Zero)
+            return nopTask;
+        if (rs == rt)
+            return RegRegTask<Op, true>{rd, rs, rt};
+
+        return RegRegTask<Op, false>{rd, rs, rt};
+    }
+
+    // The immediate must be already extended
+    template <typename Op>
+    static TaskFunction regImmTask(uint32_t rt, uint32_t rs, uint32_t imm)
+    {
+        if (rt == RegIndex::Zero)
+            return nopTask;
+        if (imm == 0)
+            return RegImmTask<Op, true>{rt, rs, imm};
+
+        return RegImmTask<Op, false>{rt, rs, imm};
+    }
+
+    // add, addi and sub trap on overflow even when the destination is $zero,
+    // only the write is dropped in that case
+    template <typename Op, bool ImmSrc, bool WriteDst>
+    struct OvfArithTask
+    {
+        ErrorCode operator()(RuntimeContext& ctx) const
+        {
+            uint32_t *regs = ctx.reg_file.getRegArray();
+            uint32_t rd1 = regs[rs];
+            uint32_t rd2 = ImmSrc? imm : regs[rt];
+            uint32_t res = Op::eval(rd1, rd2);
+            constexpr bool is_sub = std::is_same_v<Op, SubOp>;
+
+            // For add the operands have the same sign and the result a
+            // different one, for sub the operands have different signs and
+            // the result has a different sign than rd1
+            uint32_t ovf = is_sub? ((rd1 ^ rd2) & (rd1 ^ res))
+                                 : (~(rd1 ^ rd2) & (rd1 ^ res));
+
+            if (ovf & 0x80000000)
+            {
+                ctx.last_error = EAsm::arithOvfError(name,
+                                                     static_cast<int32_t>(rd1),
+                                                     static_cast<int32_t>(is_sub? 0u - rd2 : rd2));
+
+                return ErrorCode::Overflow;
+            }
+
+            if (WriteDst)
+                regs[rd] = res;
+
+            return ErrorCode::Ok;
+        }
+
+        const char *name;
+        uint32_t rd, rs, rt, imm;
     };
 
-    Arg::Array::Array(unsigned sz): sz(sz)
-    { args = new Arg[sz]; }
+    template <typename Op, bool ImmSrc>
+    static TaskFunction ovfArithTask(const char *name, uint32_t rd, uint32_t rs,
+                                     uint32_t rt, uint32_t imm)
+    {
+        if (rd == RegIndex::Zero)
+            return OvfArithTask<Op, ImmSrc, false>{name, rd, rs, rt, imm};
+
+        return OvfArithTask<Op, ImmSrc, true>{name, rd, rs, rt, imm};
+    }
 
-    TaskFunction compileInst(Opcode opc, const std::vector<uint32_t>& argv, const EAsm::SrcInfo& src_info)
+    static ErrorCode addrRangeError(RuntimeContext& ctx, VirtualAddr vaddr, const char *name)
     {
-        uint32_t arg1 = (argv.size()>0)? argv[0] : 0;
-        uint32_t arg2 = (argv.size()>1)? argv[1] : 0;
-        uint32_t arg3 = (argv.size()>2)? argv[2] : 0;
+        ctx.last_error = EAsm::Error("Invalid virtual address ",
+                                     colorText(fcolor::yellow, Cvt::hexVal(vaddr)),
+                                     " in instruction ",
+                                     cboldText(fcolor::blue, name),
+                                     '\n');
 
-        switch (opc)
+        return ErrorCode::VirtualAddrOutOfRange;
+    }
+
+    static ErrorCode addrAlignError(RuntimeContext& ctx, VirtualAddr vaddr, size_t size)
+    {
+        ctx.last_error = EAsm::Error("Virtual address ",
+                                     colorText(fcolor::yellow, Cvt::hexVal(vaddr)),
+                                     (size == 2)? " is not aligned to half word boundaries\n"
+                                                : " is not aligned to word boundaries\n");
+
+        return ErrorCode::VirtualAddrNotAligned;
+    }
+
+    // Checks an access of sizeof(T) bytes at vaddr and sets p to its host
+    // address. A misaligned access that is also out of range is reported as
+    // out of range.
+    template <typename T, MemAccess Acc>
+    static ErrorCode memAccess(RuntimeContext& ctx, VirtualAddr vaddr, const char *name, T*& p)
+    {
+        if ((vaddr % sizeof(T)) != 0)
         {
-            case Opcode::Add:
-                return [arg1, arg2, arg3, si{src_info}](RuntimeContext& ctx)
-                {
-                    uint32_t rd1 = ctx.reg_file[arg2];
-                    uint32_t rd2 = ctx.reg_file[arg3];
-                    uint32_t sum = rd1 + rd2;
+            if (!ctx.mm->isValidAddrRange(vaddr, vaddr + (sizeof(T) - 1)))
+                return addrRangeError(ctx, vaddr, name);
 
-                    if (!((rd1 ^ rd2) & 0x80000000)  // same sign
-                        && ((rd1 ^ sum) & 0x80000000)) // different result sign
-                    {
-                        ctx.last_error = EAsm::arithOvfError(si, "add",
-                                                             static_cast<int32_t>(rd1),
-                                                             static_cast<int32_t>(rd2));
+            return addrAlignError(ctx, vaddr, sizeof(T));
+        }
 
-                        return ErrorCode::Overflow;
-                    }
+        p = ctx.mm->hostPtr<T, Acc>(vaddr);
 
-                    ctx.reg_file.setReg(arg1, sum);
-                    return ErrorCode::Ok;
-                };
-            case Opcode::Addu:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    ctx.reg_file.setReg(arg1, ctx.reg_file[arg2] + ctx.reg_file[arg3]);
-                    return ErrorCode::Ok;
-                };
-            case Opcode::Addi:
-                return [arg1, arg2, arg3, si{src_info}] (RuntimeContext& ctx)
-                {
-                    uint32_t rd1 = ctx.reg_file[arg2];
-                    uint32_t rd2 = extend_cast<int16_t, uint32_t>(arg3);
-                    uint32_t sum = rd1 + rd2;
+        if (p == nullptr)
+            return addrRangeError(ctx, vaddr, name);
 
-                    if (!((rd1 ^ rd2) & 0x80000000) // same sign
-                        && ((rd1 ^ sum) & 0x80000000)) // different result sign
-                    {
-                        ctx.last_error = EAsm::arithOvfError(si, "addi",
-                                                             static_cast<int32_t>(rd1),
-                                                             static_cast<int32_t>(rd2));
+        return ErrorCode::Ok;
+    }
 
-                        return ErrorCode::Overflow;
-                    }
+    template <typename T, bool ZeroOfs, bool WriteDst>
+    struct LoadTask
+    {
+        ErrorCode operator()(RuntimeContext& ctx) const
+        {
+            uint32_t *regs = ctx.reg_file.getRegArray();
+            VirtualAddr vaddr = ZeroOfs? regs[base] : regs[base] + ofs;
+            T *p;
+            ErrorCode ecode = memAccess<T, MemAccess::Read>(ctx, vaddr, name, p);
 
-                    ctx.reg_file.setReg(arg1, sum);
-                    return ErrorCode::Ok;
-                };
-            case Opcode::Addiu:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    ctx.reg_file.setReg(arg1, ctx.reg_file[arg2] + extend_cast<int16_t, uint32_t>(arg3));
-                    return ErrorCode::Ok;
-                };
-            case Opcode::Sub:
-                return [arg1, arg2, arg3, si{src_info}] (RuntimeContext& ctx)
-                {
-                    uint32_t rd1 = ctx.reg_file[arg2];
-                    uint32_t rd2 = ctx.reg_file[arg3];
-                    uint32_t sum = rd1 - rd2;
+            if (ecode != ErrorCode::Ok)
+                return ecode;
 
-                    // Overflow if operands have different signs AND result has different sign than rd1
-                    if (((rd1 ^ rd2) & (rd1 ^ sum) & 0x80000000))
-                    {
-                        ctx.last_error = EAsm::arithOvfError(si, "sub",
-                                                             static_cast<int32_t>(rd1),
-                                                             -static_cast<int32_t>(rd2));
+            // Signed types are sign extended, unsigned ones zero extended
+            if (WriteDst)
+                regs[rt] = static_cast<uint32_t>(static_cast<int32_t>(*p));
 
-                        return ErrorCode::Overflow;
-                    }
+            return ErrorCode::Ok;
+        }
 
-                    ctx.reg_file.setReg(arg1, sum);
-                    return ErrorCode::Ok;
-                };
+        const char *name;
+        uint32_t rt, base, ofs;
+    };
+
+    template <typename T, bool ZeroOfs>
+    using LoadRegTask = LoadTask<T, ZeroOfs, true>;
+
+    template <typename T, bool ZeroOfs>
+    using LoadZeroTask = LoadTask<T, ZeroOfs, false>;
+
+    template <typename T, bool ZeroOfs>
+    struct StoreTask
+    {
+        ErrorCode operator()(RuntimeContext& ctx) const
+        {
+            uint32_t *regs = ctx.reg_file.getRegArray();
+            VirtualAddr vaddr = ZeroOfs? regs[base] : regs[base] + ofs;
+            T *p;
+            ErrorCode ecode = memAccess<T, MemAccess::Write>(ctx, vaddr, name, p);
+
+            if (ecode != ErrorCode::Ok)
+                return ecode;
+
+            *p = static_cast<T>(regs[rt]);
+
+            return ErrorCode::Ok;
+        }
+
+        const char *name;
+        uint32_t rt, base, ofs;
+    };
+
+    template <template <typename, bool> class Task, typename T>
+    static TaskFunction memTask(const char *name, uint32_t rt, uint32_t ofs, uint32_t base)
+    {
+        if (ofs == 0)
+            return Task<T, true>{name, rt, base, ofs};
+
+        return Task<T, false>{name, rt, base, ofs};
+    }
+
+    template <typename T>
+    static TaskFunction loadTask(const char *name, uint32_t rt, uint32_t ofs, uint32_t base)
+    {
+        if (rt == RegIndex::Zero)
+            return memTask<LoadZeroTask, T>(name, rt, ofs, base);
+
+        return memTask<LoadRegTask, T>(name, rt, ofs, base);
+    }
+
+    template <typename T>
+    static TaskFunction storeTask(const char *name, uint32_t rt, uint32_t ofs, uint32_t base)
+    { return memTask<StoreTask, T>(name, rt, ofs, base); }
+
+    TaskFunction compileInst(Opcode opc, const std::vector<uint32_t>& argv)
+    {
+        uint32_t arg1 = (argv.size()>0)? argv[0] : 0;
+        uint32_t arg2 = (argv.size()>1)? argv[1] : 0;
+        uint32_t arg3 = (argv.size()>2)? argv[2] : 0;
+
+        switch (opc)
+        {
+            case Opcode::Add:
+                return ovfArithTask<AddOp, false>("add", arg1, arg2, arg3, 0);
+            case Opcode::Addu:
+                return regRegTask<AddOp>(arg1, arg2, arg3);
+            case Opcode::Addi:
+                return ovfArithTask<AddOp, true>("addi", arg1, arg2, 0,
+                                                 extend_cast<int16_t, uint32_t>(arg3));
+            case Opcode::Addiu:
+                return regImmTask<AddOp>(arg1, arg2, extend_cast<int16_t, uint32_t>(arg3));
+            case Opcode::Sub:
+                return ovfArithTask<SubOp, false>("sub", arg1, arg2, arg3, 0);
             case Opcode::Subu:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    ctx.reg_file.setReg(arg1, ctx.reg_file[arg2] - ctx.reg_file[arg3]);
-                    return ErrorCode::Ok;
-                };
+                return regRegTask<SubOp>(arg1, arg2, arg3);
             case Opcode::Mult:
                 return [arg1, arg2](RuntimeContext& ctx)
                 {
@@ -225,71 +312,31 @@ namespace Mips32::Assembler
                     return ErrorCode::Ok;
                 };
             case Opcode::Nop:
-                return [](RuntimeContext& ctx) { return ErrorCode::Ok; };
+                return nopTask;
             case Opcode::Sll:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    ctx.reg_file.setReg(arg1, ctx.reg_file[arg2] << (arg3 & 0x1f));
-                    return ErrorCode::Ok;
-                };
+                return regImmTask<SllOp>(arg1, arg2, arg3 & 0x1f);
             case Opcode::Srl:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    ctx.reg_file.setReg(arg1, ctx.reg_file[arg2] >> (arg3 & 0x1f));
-                    return ErrorCode::Ok;
-                };
+                return regImmTask<SrlOp>(arg1, arg2, arg3 & 0x1f);
             case Opcode::Sra:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    int32_t rd2 = static_cast<int32_t>(ctx.reg_file[arg2]);
-                    int32_t shift = arg3 & 0x1f;
-
-                    ctx.reg_file.setReg(arg1, rd2 >> shift);
-                    return ErrorCode::Ok;
-                };
+                return regImmTask<SraOp>(arg1, arg2, arg3 & 0x1f);
             case Opcode::Sllv:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    uint32_t rd2 = ctx.reg_file[arg2];
-                    uint32_t rd3 = ctx.reg_file[arg3];
-                    
-                    ctx.reg_file.setReg(arg1, rd2 << (rd3 & 0x1f));
-                    return ErrorCode::Ok;
-                };
+                return regRegTask<SllOp>(arg1, arg2, arg3);
             case Opcode::Srlv:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    uint32_t rd2 = ctx.reg_file[arg2];
-                    uint32_t rd3 = ctx.reg_file[arg3];
-
-                    ctx.reg_file.setReg(arg1, rd2 >> (rd3 & 0x1f));
-                    return ErrorCode::Ok;
-                };
+                return regRegTask<SrlOp>(arg1, arg2, arg3);
             case Opcode::Srav:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    int32_t rd2 = static_cast<int32_t>(ctx.reg_file[arg2]);
-                    int32_t shift = static_cast<int32_t>(ctx.reg_file[arg3]) & 0x1f;
-
-                    ctx.reg_file.setReg(arg1, rd2 >> shift);
-                    return ErrorCode::Ok;
-                };
+                return regRegTask<SraOp>(arg1, arg2, arg3);
             case Opcode::And:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    ctx.reg_file.setReg(arg1, ctx.reg_file[arg2] & ctx.reg_file[arg3]);
-                    return ErrorCode::Ok;
-                };
+                return regRegTask<AndOp>(arg1, arg2, arg3);
             case Opcode::Break:
-                return [arg1, si{src_info}](RuntimeContext& ctx)
+                return [arg1](RuntimeContext& ctx)
                 {
-                    ctx.last_error = EAsm::Error(si, "Breakpoint exception #",
-                                                   colorText(fcolor::yellow, arg1),
-                                                   '\n');
+                    ctx.last_error = EAsm::Error("Breakpoint exception #",
+                                                 colorText(fcolor::yellow, arg1),
+                                                 '\n');
                     return ErrorCode::Break;
                 };
             case Opcode::Div:
-                return [arg1, arg2, si{src_info}] (RuntimeContext& ctx)
+                return [arg1, arg2] (RuntimeContext& ctx)
                 {
                     if (ctx.reg_file[arg2] != 0)
                     {
@@ -315,7 +362,7 @@ namespace Mips32::Assembler
                     return ErrorCode::Ok;
                 };
             case Opcode::Divu:
-                return [arg1, arg2, si{src_info}](RuntimeContext& ctx)
+                return [arg1, arg2](RuntimeContext& ctx)
                 {
                     if (ctx.reg_file[arg2] != 0)
                     {
@@ -356,22 +403,14 @@ namespace Mips32::Assembler
                     return ErrorCode::Ok;
                 };
             case Opcode::Mfhi:
-                return [arg1](RuntimeContext& ctx)
-                {
-                    ctx.reg_file.setReg(arg1, ctx.reg_file.getHiReg());
-                    return ErrorCode::Ok;
-                };
+                return regImmTask<OrOp>(arg1, RegIndex::Hi, 0);
             case Opcode::Syscall:
-                return [si{src_info}](RuntimeContext& ctx)
+                return [](RuntimeContext& ctx)
                 {
-                    return ctx.syscallHandler(si);
+                    return ctx.syscallHandler();
                 };
             case Opcode::Mflo:
-                return [arg1](RuntimeContext& ctx)
-                {
-                    ctx.reg_file.setReg(arg1, ctx.reg_file.getLoReg());
-                    return ErrorCode::Ok;
-                };
+                return regImmTask<OrOp>(arg1, RegIndex::Lo, 0);
             case Opcode::Mthi:
                 return [arg1](RuntimeContext& ctx)
                 {
@@ -385,44 +424,15 @@ namespace Mips32::Assembler
                     return ErrorCode::Ok;
                 };
             case Opcode::Nor:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    ctx.reg_file.setReg(arg1, ~(ctx.reg_file[arg2] | ctx.reg_file[arg3]));
-                    return ErrorCode::Ok;
-                };
+                return regRegTask<NorOp>(arg1, arg2, arg3);
             case Opcode::Or:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    ctx.reg_file.setReg(arg1, ctx.reg_file[arg2] | ctx.reg_file[arg3]);
-                    return ErrorCode::Ok;
-                };
+                return regRegTask<OrOp>(arg1, arg2, arg3);
             case Opcode::Slt:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    int32_t rd2 = static_cast<int32_t>(ctx.reg_file[arg2]);
-                    int32_t rd3 = static_cast<int32_t>(ctx.reg_file[arg3]);
-
-                    ctx.reg_file.setReg(arg1, rd2 < rd3);
-                    return ErrorCode::Ok;
-                };
+                return regRegTask<SltOp>(arg1, arg2, arg3);
             case Opcode::Sltu:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    uint32_t rd2 = ctx.reg_file[arg2];
-                    uint32_t rd3 = ctx.reg_file[arg3];
-
-                    ctx.reg_file.setReg(arg1, rd2 < rd3);
-                    return ErrorCode::Ok;
-                };
+                return regRegTask<SltuOp>(arg1, arg2, arg3);
             case Opcode::Xor:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    uint32_t rd2 = ctx.reg_file[arg2];
-                    uint32_t rd3 = ctx.reg_file[arg3];
-                    
-                    ctx.reg_file.setReg(arg1, rd2 ^ rd3);
-                    return ErrorCode::Ok;
-                };
+                return regRegTask<XorOp>(arg1, arg2, arg3);
             case Opcode::Bltz:
                 return [arg1, arg2](RuntimeContext& ctx)
                 {
@@ -464,33 +474,20 @@ namespace Mips32::Assembler
                     return ErrorCode::Ok;
                 };
             case Opcode::Andi:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    uint32_t rd2 = ctx.reg_file[arg2];
-                    uint32_t rd3 = arg3 & 0xffff;
-
-                    ctx.reg_file.setReg(arg1, rd2 & rd3);
-                    return ErrorCode::Ok;
-                };
+                return regImmTask<AndOp>(arg1, arg2, arg3 & 0xffff);
             case Opcode::Ori:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    uint32_t rd2 = ctx.reg_file[arg2];
-                    uint32_t rd3 = arg3 & 0xffff;
-
-                    ctx.reg_file.setReg(arg1, rd2 | rd3);
-                    return ErrorCode::Ok;
-                };
+                return regImmTask<OrOp>(arg1, arg2, arg3 & 0xffff);
             case Opcode::Xori:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    uint32_t rd2 = ctx.reg_file[arg2];
-                    uint32_t rd3 = arg3 & 0xffff;
-
-                    ctx.reg_file.setReg(arg1, rd2 ^ rd3);
-                    return ErrorCode::Ok;
-                };
+                return regImmTask<XorOp>(arg1, arg2, arg3 & 0xffff);
             case Opcode::Beq:
+                if (arg1 == arg2)
+                {
+                    return [arg3](RuntimeContext& ctx)
+                    {
+                        ctx.setPC(arg3);
+                        return ErrorCode::Ok;
+                    };
+                }
                 return [arg1, arg2, arg3](RuntimeContext& ctx)
                 {
                     if (ctx.reg_file[arg1] == ctx.reg_file[arg2])
@@ -507,6 +504,9 @@ namespace Mips32::Assembler
                     return ErrorCode::Ok;
                 };
             case Opcode::Bne:
+                if (arg1 == arg2)
+                    return nopTask;
+
                 return [arg1, arg2, arg3](RuntimeContext& ctx)
                 {
                     if (ctx.reg_file[arg1] != ctx.reg_file[arg2])
@@ -523,215 +523,27 @@ namespace Mips32::Assembler
                     return ErrorCode::Ok;
                 };
             case Opcode::Slti:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    int32_t rs = static_cast<int32_t>(ctx.reg_file[arg2]);
-                    int32_t imm = extend_cast<int16_t, int32_t>(arg3);
-
-                    ctx.reg_file.setReg(arg1, rs < imm);
-                    return ErrorCode::Ok;
-                };
+                return regImmTask<SltOp>(arg1, arg2, extend_cast<int16_t, uint32_t>(arg3));
             case Opcode::Sltiu:
-                return [arg1, arg2, arg3](RuntimeContext& ctx)
-                {
-                    uint32_t rs = ctx.reg_file[arg2];
-                    uint32_t imm = extend_cast<int16_t, uint32_t>(arg3);
-
-                    ctx.reg_file.setReg(arg1, rs < imm);
-                    return ErrorCode::Ok;
-                };
+                return regImmTask<SltuOp>(arg1, arg2, extend_cast<int16_t, uint32_t>(arg3));
             case Opcode::Sb:
-                return [arg1, arg2, arg3, si{src_info}] (RuntimeContext& ctx)
-                {
-                    VirtualAddr vaddr = extend_cast<int16_t, uint32_t>(arg2) + ctx.reg_file[arg3];
-                    if (!ctx.mm->isValidAddr(vaddr))
-                    {
-                        ctx.last_error = EAsm::Error(si, "Invalid virtual address ",
-                                                       colorText(fcolor::yellow, Cvt::hexVal(vaddr)),
-                                                       " in instruction ",
-                                                       cboldText(fcolor::blue, "sb"),
-                                                       '\n');
-
-                        return ErrorCode::VirtualAddrOutOfRange;
-                    }
-                    MemIterator<uint8_t> it = ctx.mm->memIter<uint8_t>(vaddr);
-                    *it = static_cast<uint8_t>(ctx.reg_file[arg1]);
-
-                    return ErrorCode::Ok;
-                };
+                return storeTask<uint8_t>("sb", arg1, extend_cast<int16_t, uint32_t>(arg2), arg3);
             case Opcode::Sh:
-                return [arg1, arg2, arg3, si{src_info}] (RuntimeContext& ctx)
-                {
-                    VirtualAddr vaddr = extend_cast<int16_t, uint32_t>(arg2) + ctx.reg_file[arg3];
-                    if (!ctx.mm->isValidAddrRange(vaddr, vaddr + 1))
-                    {
-                        ctx.last_error = EAsm::Error(si, "Invalid virtual address ",
-                                                       colorText(fcolor::yellow, Cvt::hexVal(vaddr)),
-                                                       " in instruction ",
-                                                       cboldText(fcolor::blue, "sh"),
-                                                       '\n');
-                        return ErrorCode::VirtualAddrOutOfRange;
-                    }
-                    if ((vaddr % 2) != 0)
-                    {
-                        ctx.last_error = EAsm::Error(si, "Virtual address ",
-                                                       colorText(fcolor::yellow, Cvt::hexVal(vaddr)),
-                                                       " is not aligned to half word boundaries\n");
-
-                        return ErrorCode::VirtualAddrNotAligned;
-                    }
-                    MemIterator<uint16_t> it = ctx.mm->memIter<uint16_t>(vaddr);
-                    *it = static_cast<uint16_t>(ctx.reg_file[arg1]);
-
-                    return ErrorCode::Ok;
-                };
+                return storeTask<uint16_t>("sh", arg1, extend_cast<int16_t, uint32_t>(arg2), arg3);
             case Opcode::Sw:
-                return [arg1, arg2, arg3, si{src_info}] (RuntimeContext& ctx)
-                {
-                    VirtualAddr vaddr = extend_cast<int16_t, uint32_t>(arg2) + ctx.reg_file[arg3];
-                    if (!ctx.mm->isValidAddrRange(vaddr, vaddr + 3))
-                    {
-                        ctx.last_error = EAsm::Error(si, "Invalid virtual address ",
-                                                       colorText(fcolor::yellow, Cvt::hexVal(vaddr)),
-                                                       " in instruction ",
-                                                       cboldText(fcolor::blue, "sw"),
-                                                       '\n');
-                        return ErrorCode::VirtualAddrOutOfRange;
-                    }
-                    if ((vaddr % 4) != 0)
-                    {
-                        ctx.last_error = EAsm::Error(si, "Virtual address ",
-                                                       colorText(fcolor::yellow, Cvt::hexVal(vaddr)),
-                                                       " is not aligned to word boundaries\n");
-
-                        return ErrorCode::VirtualAddrNotAligned;
-                    }
-                    MemIterator<uint32_t> it = ctx.mm->memIter<uint32_t>(vaddr);
-                    *it = ctx.reg_file[arg1];
-
-                    return ErrorCode::Ok;
-                };
+                return storeTask<uint32_t>("sw", arg1, extend_cast<int16_t, uint32_t>(arg2), arg3);
             case Opcode::Lw:
-                return [arg1, arg2, arg3, si{src_info}](RuntimeContext& ctx)
-                {
-                    VirtualAddr vaddr = extend_cast<int16_t, uint32_t>(arg2) + ctx.reg_file[arg3];
-                    if (!ctx.mm->isValidAddrRange(vaddr, vaddr + 3))
-                    {
-                        ctx.last_error = EAsm::Error(si, "Invalid virtual address ",
-                                                       colorText(fcolor::yellow, Cvt::hexVal(vaddr)),
-                                                       " in instruction ",
-                                                       cboldText(fcolor::blue, "lw"),
-                                                       '\n');
-
-                        return ErrorCode::VirtualAddrOutOfRange;
-                    }
-                    if ((vaddr % 4) != 0)
-                    {
-                        ctx.last_error = EAsm::Error(si, "Virtual address ",
-                                                       colorText(fcolor::yellow, Cvt::hexVal(vaddr)),
-                                                       " is not aligned to word boundaries\n");
-
-                        return ErrorCode::VirtualAddrNotAligned;
-                    }
-                    MemIterator<uint32_t> it = ctx.mm->memIter<uint32_t>(vaddr);
-                    ctx.reg_file.setReg(arg1, *it);
-
-                    return ErrorCode::Ok;
-                };
+                return loadTask<uint32_t>("lw", arg1, extend_cast<int16_t, uint32_t>(arg2), arg3);
             case Opcode::Lb:
-                return [arg1, arg2, arg3, si{src_info}](RuntimeContext& ctx)
-                {
-                    VirtualAddr vaddr = extend_cast<int16_t, uint32_t>(arg2) + ctx.reg_file[arg3];
-                    if (!ctx.mm->isValidAddr(vaddr))
-                    {
-                        ctx.last_error = EAsm::Error(si, "Invalid virtual address ",
-                                                       colorText(fcolor::yellow, Cvt::hexVal(vaddr)),
-                                                       " in instruction ",
-                                                       cboldText(fcolor::blue, "lb"),
-                                                       '\n');
-                        return ErrorCode::VirtualAddrOutOfRange;
-                    }
-                    MemIterator<int8_t> it = ctx.mm->memIter<int8_t>(vaddr);
-                    ctx.reg_file.setReg(arg1, static_cast<int32_t>(*it));
-
-                    return ErrorCode::Ok;
-                };
+                return loadTask<int8_t>("lb", arg1, extend_cast<int16_t, uint32_t>(arg2), arg3);
             case Opcode::Lbu:
-                return [arg1, arg2, arg3, si{src_info}](RuntimeContext& ctx)
-                {
-                    VirtualAddr vaddr = extend_cast<int16_t, uint32_t>(arg2) + ctx.reg_file[arg3];
-                    if (!ctx.mm->isValidAddr(vaddr))
-                    {
-                        ctx.last_error = EAsm::Error(si, "Invalid virtual address ",
-                                                       colorText(fcolor::yellow, Cvt::hexVal(vaddr)),
-                                                       " in instruction ",
-                                                       cboldText(fcolor::blue, "lbu"),
-                                                       '\n');
-                        return ErrorCode::VirtualAddrOutOfRange;
-                    }
-                    MemIterator<uint8_t> it = ctx.mm->memIter<uint8_t>(vaddr);
-                    ctx.reg_file.setReg(arg1, static_cast<uint32_t>(*it));
-
-                    return ErrorCode::Ok;
-                };
+                return loadTask<uint8_t>("lbu", arg1, extend_cast<int16_t, uint32_t>(arg2), arg3);
             case Opcode::Lh:
-                return [arg1, arg2, arg3, si{src_info}](RuntimeContext& ctx)
-                {
-                    VirtualAddr vaddr = extend_cast<int16_t, uint32_t>(arg2) + ctx.reg_file[arg3];
-                    if (!ctx.mm->isValidAddrRange(vaddr, vaddr + 1))
-                    {
-                        ctx.last_error = EAsm::Error(si, "Invalid virtual address ",
-                                                       colorText(fcolor::yellow, Cvt::hexVal(vaddr)),
-                                                       " in instruction ",
-                                                       cboldText(fcolor::blue, "lh"),
-                                                       '\n');
-                        return ErrorCode::VirtualAddrOutOfRange;
-                    }
-                    if ((vaddr % 2) != 0)
-                    {
-                        ctx.last_error = EAsm::Error(si, "Virtual address ",
-                                                       colorText(fcolor::yellow, Cvt::hexVal(vaddr)),
-                                                       " is not aligned to half word boundaries\n");
-
-                        return ErrorCode::VirtualAddrNotAligned;
-                    }
-                    MemIterator<int16_t> it = ctx.mm->memIter<int16_t>(vaddr);
-                    ctx.reg_file.setReg(arg1, static_cast<int32_t>(*it));
-
-                    return ErrorCode::Ok;
-                };
+                return loadTask<int16_t>("lh", arg1, extend_cast<int16_t, uint32_t>(arg2), arg3);
             case Opcode::Lhu:
-                return [arg1, arg2, arg3, si{src_info}](RuntimeContext& ctx)
-                {
-                    VirtualAddr vaddr = extend_cast<int16_t, uint32_t>(arg2) + ctx.reg_file[arg3];
-                    if (!ctx.mm->isValidAddrRange(vaddr, vaddr + 1))
-                    {
-                        ctx.last_error = EAsm::Error(si, "Invalid virtual address ",
-                                                       colorText(fcolor::yellow, Cvt::hexVal(vaddr)),
-                                                       " in instruction ",
-                                                       cboldText(fcolor::blue, "lhu"),
-                                                       '\n');
-                        return ErrorCode::VirtualAddrOutOfRange;
-                    }
-                    if ((vaddr % 2) != 0)
-                    {
-                        ctx.last_error = EAsm::Error(si, "Virtual address ",
-                                                       colorText(fcolor::yellow, Cvt::hexVal(vaddr)),
-                                                       " is not aligned to half word boundaries\n");
-
-                        return ErrorCode::VirtualAddrNotAligned;
-                    }
-                    MemIterator<uint16_t> it = ctx.mm->memIter<uint16_t>(vaddr);
-                    ctx.reg_file.setReg(arg1, static_cast<uint32_t>(*it));
-
-                    return ErrorCode::Ok;
-                };
+                return loadTask<uint16_t>("lhu", arg1, extend_cast<int16_t, uint32_t>(arg2), arg3);
             case Opcode::Lui:
-                return [arg1, arg2](RuntimeContext& ctx)
-                {
-                    ctx.reg_file.setReg(arg1, (arg2 & 0xffff) << 16);
-                    return ErrorCode::Ok;
-                };
+                return regImmTask<OrOp>(arg1, RegIndex::Zero, (arg2 & 0xffff) << 16);
             case Opcode::Lwc1:
             case Opcode::Swc1:
                 return [] (RuntimeContext& ctx)
@@ -740,46 +552,163 @@ namespace Mips32::Assembler
                     return ErrorCode::UnsupportedInst;
                 };
             case Opcode::Move:
-                return [arg1, arg2](RuntimeContext& ctx)
-                {
-                    ctx.reg_file.setReg(arg1, ctx.reg_file[arg2]);
-                    return ErrorCode::Ok;
-                };
+                return regImmTask<OrOp>(arg1, arg2, 0);
             case Opcode::La:
             case Opcode::Li:
-                return [arg1, arg2](RuntimeContext& ctx)
-                {
-                    ctx.reg_file.setReg(arg1, arg2);
-                    return ErrorCode::Ok;
-                };
+                return regImmTask<OrOp>(arg1, RegIndex::Zero, arg2);
             default:
                 throw std::runtime_error("Not implemented");
         }
     }
 
-    int getRegIndex(const std::string& name)
+    std::optional<DecodedInst> decodeInst(Opcode opc, const std::vector<uint32_t>& argv)
     {
-        for (int i = 0; i < Reg_Count; i++)
+        uint32_t arg1 = (argv.size()>0)? argv[0] : 0;
+        uint32_t arg2 = (argv.size()>1)? argv[1] : 0;
+        uint32_t arg3 = (argv.size()>2)? argv[2] : 0;
+
+        DecodedInst di {opc, 0, 0, 0, 0};
+
+        switch (opc)
         {
-            if ((name == reg_names[i].name1) || (name == reg_names[i].name2))
-                return i;
+            case Opcode::Add: case Opcode::Addu: case Opcode::Sub: case Opcode::Subu:
+            case Opcode::And: case Opcode::Or: case Opcode::Nor: case Opcode::Xor:
+            case Opcode::Slt: case Opcode::Sltu:
+                di.rd = arg1;
+                di.rs = arg2;
+                di.rt = arg3;
+                break;
+            case Opcode::Sllv: case Opcode::Srlv: case Opcode::Srav:
+                di.rd = arg1;
+                di.rt = arg2;
+                di.rs = arg3;
+                break;
+            case Opcode::Sll: case Opcode::Srl: case Opcode::Sra:
+                di.rd = arg1;
+                di.rt = arg2;
+                di.imm = arg3 & 0x1f;
+                break;
+            case Opcode::Addi: case Opcode::Addiu: case Opcode::Slti: case Opcode::Sltiu:
+                di.rt = arg1;
+                di.rs = arg2;
+                di.imm = extend_cast<int16_t, uint32_t>(arg3);
+                break;
+            case Opcode::Andi: case Opcode::Ori: case Opcode::Xori:
+                di.rt = arg1;
+                di.rs = arg2;
+                di.imm = arg3 & 0xffff;
+                break;
+            case Opcode::Lui:
+                di.rt = arg1;
+                di.imm = (arg2 & 0xffff) << 16;
+                break;
+            case Opcode::La: case Opcode::Li:
+                di.rt = arg1;
+                di.imm = arg2;
+                break;
+            case Opcode::Move:
+                di.rd = arg1;
+                di.rs = arg2;
+                break;
+            case Opcode::Mult: case Opcode::Multu: case Opcode::Div: case Opcode::Divu:
+                di.rs = arg1;
+                di.rt = arg2;
+                break;
+            case Opcode::Mfhi: case Opcode::Mflo:
+                di.rd = arg1;
+                break;
+            case Opcode::Mthi: case Opcode::Mtlo: case Opcode::Jr: case Opcode::Jalr:
+                di.rs = arg1;
+                break;
+            case Opcode::Beq: case Opcode::Bne:
+                di.rs = arg1;
+                di.rt = arg2;
+                di.imm = arg3;
+                break;
+            case Opcode::Beqz: case Opcode::Bnez: case Opcode::Bltz:
+            case Opcode::Bgez: case Opcode::Blez: case Opcode::Bgtz:
+                di.rs = arg1;
+                di.imm = arg2;
+                break;
+            case Opcode::J: case Opcode::Jal: case Opcode::Break:
+                di.imm = arg1;
+                break;
+            case Opcode::Lw: case Opcode::Lb: case Opcode::Lbu: case Opcode::Lh: case Opcode::Lhu:
+            case Opcode::Sw: case Opcode::Sb: case Opcode::Sh:
+                di.rt = arg1;
+                di.imm = extend_cast<int16_t, uint32_t>(arg2);
+                di.rs = arg3;
+                break;
+            case Opcode::Nop: case Opcode::Syscall:
+                break;
+            default:
+                return std::nullopt;
         }
-        return -1;
+
+        // $lo, $hi and $pc as operands are left to the closure engine
+        if (di.rd > RegIndex::Ra || di.rs > RegIndex::Ra || di.rt > RegIndex::Ra)
+            return std::nullopt;
+
+        return di;
     }
 
-    std::string getRegName(size_t idx)
+    std::vector<uint32_t> instArgs(const DecodedInst& di)
     {
-        return (idx < Reg_Count)? reg_names[idx].name2 : "";
+        switch (di.opc)
+        {
+            case Opcode::Add: case Opcode::Addu: case Opcode::Sub: case Opcode::Subu:
+            case Opcode::And: case Opcode::Or: case Opcode::Nor: case Opcode::Xor:
+            case Opcode::Slt: case Opcode::Sltu:
+                return {di.rd, di.rs, di.rt};
+            case Opcode::Sllv: case Opcode::Srlv: case Opcode::Srav:
+                return {di.rd, di.rt, di.rs};
+            case Opcode::Sll: case Opcode::Srl: case Opcode::Sra:
+                return {di.rd, di.rt, di.imm};
+            case Opcode::Addi: case Opcode::Addiu: case Opcode::Slti: case Opcode::Sltiu:
+            case Opcode::Andi: case Opcode::Ori: case Opcode::Xori:
+                return {di.rt, di.rs, di.imm};
+            case Opcode::Lui:
+                return {di.rt, di.imm >> 16};
+            case Opcode::La: case Opcode::Li:
+                return {di.rt, di.imm};
+            case Opcode::Move:
+                return {di.rd, di.rs};
+            case Opcode::Mult: case Opcode::Multu: case Opcode::Div: case Opcode::Divu:
+                return {di.rs, di.rt};
+            case Opcode::Mfhi: case Opcode::Mflo:
+                return {di.rd};
+            case Opcode::Mthi: case Opcode::Mtlo: case Opcode::Jr: case Opcode::Jalr:
+                return {di.rs};
+            case Opcode::Beq: case Opcode::Bne:
+                return {di.rs, di.rt, di.imm};
+            case Opcode::Beqz: case Opcode::Bnez: case Opcode::Bltz:
+            case Opcode::Bgez: case Opcode::Blez: case Opcode::Bgtz:
+                return {di.rs, di.imm};
+            case Opcode::J: case Opcode::Jal: case Opcode::Break:
+                return {di.imm};
+            case Opcode::Lw: case Opcode::Lb: case Opcode::Lbu: case Opcode::Lh: case Opcode::Lhu:
+            case Opcode::Sw: case Opcode::Sb: case Opcode::Sh:
+                return {di.rt, di.imm, di.rs};
+            default:
+                return {};
+        }
     }
 
-    const InstInfo *getInstInfo(const std::string& name)
+    int getRegIndex(std::string_view name)
     {
-        auto it = inst_info.find(name);
+        const Names::Register *reg = Names::registers.find(name);
 
-        if (it != inst_info.end())
-            return &(it->second);
+        return (reg != nullptr)? reg->index : -1;
+    }
 
-        return nullptr;
+    std::string getRegName(size_t idx)
+    {
+        return (idx < Names::RegCount)? std::string(Names::reg_names[idx].name) : "";
+    }
+
+    const InstInfo *getInstInfo(std::string_view name)
+    {
+        return Names::mnemonics.find(name);
     }
 
 } // namespace Mips32::Assembler
\ No newline at end of file
@@ -0,0 +1,305 @@
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "mips32_batch.h"
+#include "colorizer.h"
+
+namespace fs = std::filesystem;
+
+using sys_clk = std::chrono::steady_clock;
+
+namespace Mips32
+{
+    static bool readFile(const std::string& file, std::string& text)
+    {
+        std::ifstream in(file, std::ios::in | std::ios::binary);
+
+        if (!in.is_open())
+            return false;
+
+        std::ostringstream buf;
+
+        buf << in.rdbuf();
+        text = buf.str();
+
+        return true;
+    }
+
+    BatchJobVector parseManifest(const std::string& file)
+    {
+        std::ifstream in(file, std::ios::in);
+
+        if (!in.is_open())
+            throw EAsm::Error("Cannot open manifest file ", cboldText(fcolor::red, file), '\n');
+
+        fs::path base_dir = fs::path(file).parent_path();
+        auto resolve = [&base_dir](const std::string& name)
+        {
+            fs::path path(name);
+
+            return path.is_absolute()? name : (base_dir / path).string();
+        };
+
+        BatchJobVector jobs;
+        std::string line;
+
+        for (long line_num = 1; std::getline(in, line); line_num++)
+        {
+            std::istringstream fields(line);
+            std::string field;
+            BatchJob job;
+
+            job.line = line_num;
+            while (fields >> field)
+            {
+                if (field[0] == '#')
+                    break;
+
+                size_t eq = field.find('=');
+                std::string key = field.substr(0, eq);
+                std::string value = (eq == std::string::npos)? "" : field.substr(eq + 1);
+
+                if (value.empty())
+                    throw EAsm::Error(EAsm::SrcInfo(file, line_num), "Field ",
+                                      cboldText(fcolor::red, field), " has no value\n");
+
+                if (key == "run")
+                {
+                    std::istringstream names(value);
+                    std::string name;
+
+                    while (std::getline(names, name, ','))
+                    {
+                        if (!name.empty())
+                            job.input_files.push_back(resolve(name));
+                    }
+                }
+                else if (key == "entry")
+                    job.entry_label = value;
+                else if (key == "stdin")
+                    job.stdin_file = resolve(value);
+                else if (key == "expect")
+                    job.expect_file = resolve(value);
+                else
+                    throw EAsm::Error(EAsm::SrcInfo(file, line_num), "Unknown field ",
+                                      cboldText(fcolor::red, key), '\n');
+            }
+
+            if (job.input_files.empty())
+            {
+                if (!job.entry_label.empty() || !job.stdin_file.empty() || !job.expect_file.empty())
+                    throw EAsm::Error(EAsm::SrcInfo(file, line_num), "Job without ",
+                                      cboldText(fcolor::red, "run"), " files\n");
+                continue;
+            }
+
+            jobs.push_back(std::move(job));
+        }
+
+        return jobs;
+    }
+
+    static void putJsonString(std::ostream& out, const std::string& str)
+    {
+        static const char *digits = "0123456789abcdef";
+
+        out << '"';
+        for (char ch : str)
+        {
+            switch (ch)
+            {
+                case '"':  out << "\\\""; break;
+                case '\\': out << "\\\\"; break;
+                case '\n': out << "\\n"; break;
+                case '\r': out << "\\r"; break;
+                case '\t': out << "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(ch) < 0x20)
+                        out << "\\u00" << digits[ch >> 4] << digits[ch & 0x0f];
+                    else
+                        out << ch;
+            }
+        }
+        out << '"';
+    }
+
+    // Virtual machine and streams of one thread, reused by all its jobs
+    class BatchWorker
+    {
+    public:
+        BatchWorker(const MemoryMap& mmap, const BatchOptions& opts)
+        : mmap(mmap), opts(opts)
+        {}
+
+        // Returns the JSON line of the job and whether it passed
+        bool run(size_t index, const BatchJob& job, std::string& json);
+
+    private:
+        void resetVm();
+
+    private:
+        const MemoryMap& mmap;
+        const BatchOptions& opts;
+        std::istringstream in;
+        std::ostringstream out;
+        std::unique_ptr<VirtualMachine> vm;
+    };
+
+    void BatchWorker::resetVm()
+    {
+        if (vm)
+        {
+            vm->init();
+            return;
+        }
+
+        vm = std::make_unique<VirtualMachine>(mmap, opts.ext_sc_handler, in, out);
+        vm->setExecEngine(opts.engine);
+        vm->setCacheDir(opts.cache_dir);
+        // The jobs already keep the cores busy
+        vm->setParseThreads(1);
+    }
+
+    bool BatchWorker::run(size_t index, const BatchJob& job, std::string& json)
+    {
+        std::string input, expected;
+        std::ostringstream error;
+        int status = 0;
+
+        if (!job.stdin_file.empty() && !readFile(job.stdin_file, input))
+        {
+            error << "Cannot open file " << job.stdin_file << '\n';
+            status = 1;
+        }
+        else if (!job.expect_file.empty() && !readFile(job.expect_file, expected))
+        {
+            error << "Cannot open file " << job.expect_file << '\n';
+            status = 1;
+        }
+
+        in.clear();
+        in.str(input);
+        out.clear();
+        out.str("");
+
+        auto time1 = sys_clk::now();
+
+        if (status == 0)
+        {
+            try
+            {
+                resetVm();
+                status = vm->exec(job.input_files, job.entry_label);
+                if (status != 0)
+                    error << vm->lastError();
+            }
+            catch (std::exception& ex)
+            {
+                error << ex.what() << '\n';
+                status = 3;
+            }
+        }
+
+        auto time2 = sys_clk::now();
+        auto total_us = std::chrono::duration_cast<std::chrono::microseconds>(time2 - time1);
+
+        std::string output = out.str();
+        bool checked = (status == 0 && !job.expect_file.empty());
+        bool passed = (status == 0 && (!checked || output == expected));
+        std::ostringstream line;
+
+        line << "{\"job\":" << index + 1 << ",\"line\":" << job.line
+             << ",\"status\":" << status << ",\"passed\":";
+
+        if (checked || status != 0)
+            line << (passed? "true" : "false");
+        else
+            line << "null";
+
+        if (status == 0)
+        {
+            line << ",\"inst_count\":" << vm->getInstCount()
+                 << ",\"exec_us\":" << vm->getExecTime();
+        }
+        line << ",\"total_us\":" << total_us.count();
+
+        if (status != 0)
+        {
+            line << ",\"error\":";
+            putJsonString(line, error.str());
+        }
+        if (!passed || !checked)
+        {
+            line << ",\"output\":";
+            putJsonString(line, output);
+        }
+        line << '}';
+
+        json = line.str();
+
+        return passed;
+    }
+
+    size_t runBatch(const BatchJobVector& jobs, const MemoryMap& mmap,
+                    const BatchOptions& opts, std::ostream& out)
+    {
+        unsigned thread_count = opts.threads;
+
+        if (thread_count == 0)
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+        thread_count = std::min<size_t>(thread_count, std::max<size_t>(jobs.size(), 1));
+
+        std::atomic<size_t> next_job(0);
+        std::atomic<size_t> failed(0);
+        std::vector<std::string> lines(jobs.size());
+        std::vector<bool> done(jobs.size(), false);
+        size_t written = 0;
+        std::mutex out_mutex;
+
+        auto work = [&]()
+        {
+            BatchWorker worker(mmap, opts);
+            std::string json;
+
+            for (size_t idx = next_job++; idx < jobs.size(); idx = next_job++)
+            {
+                if (!worker.run(idx, jobs[idx], json))
+                    failed++;
+
+                std::lock_guard<std::mutex> lock(out_mutex);
+
+                lines[idx] = std::move(json);
+                done[idx] = true;
+
+                if (written != idx)
+                    continue;
+
+                for (; written < jobs.size() && done[written]; written++)
+                {
+                    out << lines[written] << '\n';
+                    lines[written].clear();
+                }
+                out.flush();
+            }
+        };
+
+        std::vector<std::thread> threads;
+
+        for (unsigned i = 1; i < thread_count; i++)
+            threads.emplace_back(work);
+
+        work();
+
+        for (auto& th : threads)
+            th.join();
+
+        return failed;
+    }
+
+} // namespace Mips32
@@ -0,0 +1,786 @@
+#include <iostream>
+#include <map>
+#include <sstream>
+#include "mips32_cgen.h"
+#include "mips32_assembler.h"
+#include "easm_error.h"
+#include "num_convert.h"
+#include "colorizer.h"
+
+namespace Mips32
+{
+    static const char *c_runtime = R"(
+static inline void fail(int loc, int code, const char *fmt, ...)
+{
+    va_list ap;
+
+    fflush(stdout);
+    fprintf(stderr, "%s:%d:", src_file[src_loc[loc].file], src_loc[loc].line);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    exit(code);
+}
+
+static inline void ovf_error(int loc, const char *inst, uint32_t a, uint32_t b)
+{
+    fail(loc, 2, "Arithmetic overflow in %s instruction. The values that caused "
+                 "the overflow are: %d and %d\n", inst, (int32_t)a, (int32_t)b);
+}
+
+/* Same as MemoryManager::sbrk, only the heap below heap_size can be used */
+static uint32_t heap_size = 0;
+static uint32_t heap_brk = HEAP_START;
+
+static inline long offset_of(uint32_t vaddr)
+{
+    if (vaddr >= GBL_START && vaddr - GBL_START < GBL_SIZE)
+        return (long)(vaddr - GBL_START);
+    if (vaddr >= STK_START && vaddr - STK_START < STK_SIZE)
+        return (long)(vaddr - STK_START + GBL_SIZE);
+    if (vaddr >= HEAP_START && vaddr - HEAP_START < heap_size)
+        return (long)(vaddr - HEAP_START + GBL_SIZE + STK_SIZE);
+    return -1;
+}
+
+/* Words are kept as values, bytes and half words are big endian inside them */
+static inline uint32_t get8(long ofs)
+{ return (mem[ofs >> 2] >> ((3 - (ofs & 3)) * 8)) & 0xffu; }
+
+static inline void set8(long ofs, uint32_t val)
+{
+    int shift = (3 - (ofs & 3)) * 8;
+    mem[ofs >> 2] = (mem[ofs >> 2] & ~(0xffu << shift)) | ((val & 0xffu) << shift);
+}
+
+static inline uint32_t get16(long ofs)
+{ return (mem[ofs >> 2] >> ((2 - (ofs & 2)) * 8)) & 0xffffu; }
+
+static inline void set16(long ofs, uint32_t val)
+{
+    int shift = (2 - (ofs & 2)) * 8;
+    mem[ofs >> 2] = (mem[ofs >> 2] & ~(0xffffu << shift)) | ((val & 0xffffu) << shift);
+}
+
+/* Both ends in the same region, the end is computed in 64 bits so it can't wrap */
+static inline int valid_range(uint32_t vaddr, uint64_t size)
+{
+    long ofs = offset_of(vaddr);
+    uint64_t end = (uint64_t)vaddr + size - 1;
+
+    return ofs >= 0 && end <= 0xffffffffu && offset_of((uint32_t)end) - ofs == (long)(size - 1);
+}
+
+static inline long check_addr(uint32_t vaddr, uint32_t size, int loc, const char *inst)
+{
+    long ofs = offset_of(vaddr);
+
+    if (ofs < 0 || offset_of(vaddr + size - 1) < 0)
+        fail(loc, 2, "Invalid virtual address 0x%08x in instruction %s\n", vaddr, inst);
+    if (size == 4 && (vaddr % 4) != 0)
+        fail(loc, 2, "Virtual address 0x%08x is not aligned to word boundaries\n", vaddr);
+    if (size == 2 && (vaddr % 2) != 0)
+        fail(loc, 2, "Virtual address 0x%08x is not aligned to half word boundaries\n", vaddr);
+
+    return ofs;
+}
+
+static inline uint32_t lw(uint32_t vaddr, int loc)
+{ return mem[check_addr(vaddr, 4, loc, "lw") >> 2]; }
+
+static inline uint32_t lh(uint32_t vaddr, int loc)
+{ return (uint32_t)(int32_t)(int16_t)get16(check_addr(vaddr, 2, loc, "lh")); }
+
+static inline uint32_t lhu(uint32_t vaddr, int loc)
+{ return get16(check_addr(vaddr, 2, loc, "lhu")); }
+
+static inline uint32_t lb(uint32_t vaddr, int loc)
+{ return (uint32_t)(int32_t)(int8_t)get8(check_addr(vaddr, 1, loc, "lb")); }
+
+static inline uint32_t lbu(uint32_t vaddr, int loc)
+{ return get8(check_addr(vaddr, 1, loc, "lbu")); }
+
+static inline void sw(uint32_t vaddr, uint32_t val, int loc)
+{ mem[check_addr(vaddr, 4, loc, "sw") >> 2] = val; }
+
+static inline void sh(uint32_t vaddr, uint32_t val, int loc)
+{ set16(check_addr(vaddr, 2, loc, "sh"), val); }
+
+static inline void sb(uint32_t vaddr, uint32_t val, int loc)
+{ set8(check_addr(vaddr, 1, loc, "sb"), val); }
+
+/* Same as std::getline, the new line isn't stored */
+static inline char *read_line(void)
+{
+    static char empty[1];
+    static char *buf = NULL;
+    static size_t cap = 0;
+    size_t len = 0;
+    int c;
+
+    fflush(stdout);
+    while ((c = getchar()) != EOF && c != '\n')
+    {
+        if (len + 1 >= cap)
+        {
+            cap = cap? cap * 2 : 128;
+            buf = (char *)realloc(buf, cap);
+            if (buf == NULL)
+                exit(3);
+        }
+        buf[len++] = (char)c;
+    }
+    if (buf == NULL)
+        return empty;
+
+    buf[len] = '\0';
+    return buf;
+}
+
+static inline char *trim(char *s)
+{
+    size_t len;
+
+    while (*s != '\0' && strchr(" \t\n\r\f\v", *s) != NULL)
+        s++;
+
+    len = strlen(s);
+    while (len > 0 && strchr(" \t\n\r\f\v", s[len - 1]) != NULL)
+        s[--len] = '\0';
+
+    return s;
+}
+
+/* Same as InputReader::readInts, the numbers go to the words at vaddr */
+static inline uint32_t read_ints(uint32_t vaddr, uint32_t count, int loc)
+{
+    char tok[32];
+    uint32_t n;
+    int c = EOF;
+
+    if (count > 0 && ((vaddr % 4) != 0 || !valid_range(vaddr, (uint64_t)count * 4)))
+        fail(loc, 2, "Invalid virtual address range 0x%08x:0x%08llx\n", vaddr,
+             (unsigned long long)vaddr + (uint64_t)count * 4 - 1);
+
+    fflush(stdout);
+    for (n = 0; n < count; n++)
+    {
+        size_t len = 0;
+        char *end;
+        long val;
+
+        while ((c = getchar()) != EOF && isspace(c))
+            ;
+        if (c == EOF)
+            break;
+        if (!isdigit(c) && c != '+' && c != '-')
+        {
+            ungetc(c, stdin);
+            break;
+        }
+        for (; c != EOF && !isspace(c); c = getchar())
+        {
+            if (len + 1 < sizeof(tok))
+                tok[len++] = (char)c;
+        }
+        tok[len] = '\0';
+        if (c != EOF)
+            ungetc(c, stdin);
+
+        errno = 0;
+        val = strtol(tok, &end, 10);
+        if (end == tok || *end != '\0' || errno == ERANGE)
+            break;
+
+        mem[offset_of(vaddr + n * 4) >> 2] = (uint32_t)val;
+    }
+
+    /* The rest of the line goes too */
+    while ((c = getchar()) != EOF && c != '\n' && isspace(c))
+        ;
+    if (c != EOF && c != '\n')
+        ungetc(c, stdin);
+
+    return n;
+}
+
+static inline uint32_t sys_call(uint32_t v0, uint32_t a0, uint32_t a1, int loc)
+{
+    switch (v0)
+    {
+        case 1: /* PrintInt */
+            printf("%d", (int32_t)a0);
+            break;
+
+        case 4: /* PrintString */
+        {
+            long ofs = offset_of(a0);
+
+            if (ofs < 0)
+                fail(loc, 2, "Virtual address 0x%08x is out of range\n", a0);
+
+            for (; ofs < GBL_SIZE + STK_SIZE + (long)heap_size; ofs++)
+            {
+                uint32_t c = get8(ofs);
+
+                if (c == 0)
+                    break;
+                putchar((int)c);
+            }
+            if (ofs == GBL_SIZE + STK_SIZE + (long)heap_size)
+                fail(loc, 2, "Virtual address 0x%08x is out of range\n", (uint32_t)(a0 + ofs));
+
+            break;
+        }
+        case 11: /* PrintChar */
+            putchar((char)a0);
+            break;
+
+        case 5: /* ReadInt */
+        {
+            char *input = trim(read_line());
+            char *end;
+            long val;
+
+            errno = 0;
+            val = strtol(input, &end, 10);
+
+            return (end == input || errno == ERANGE)? 0 : (uint32_t)val;
+        }
+        case 12: /* ReadChar */
+        {
+            char *input = trim(read_line());
+
+            return (uint32_t)input[0];
+        }
+        case 8: /* ReadString */
+        {
+            long ofs = offset_of(a0);
+            size_t len, i;
+            char *input;
+
+            if (a1 > 1 && !valid_range(a0, a1))
+                fail(loc, 2, "Invalid virtual address range 0x%08x:0x%08llx\n", a0,
+                     (unsigned long long)a0 + a1 - 1);
+            if (a1 <= 1 && ofs < 0)
+                fail(loc, 2, "Invalid virtual address 0x%08x\n", a0);
+            if (a1 == 0)
+                break;
+
+            input = read_line();
+            len = strlen(input);
+            if (len > a1 - 1)
+                len = a1 - 1;
+
+            for (i = 0; i < len; i++)
+                set8(ofs++, (unsigned char)input[i]);
+            set8(ofs, 0);
+
+            break;
+        }
+        case 60: /* ReadInts */
+            return read_ints(a0, a1, loc);
+
+        case 9: /* Sbrk */
+        {
+            uint32_t brk = heap_brk;
+            uint64_t used;
+
+            if ((int32_t)a0 < 0)
+                fail(loc, 2, "The heap can't shrink, invalid sbrk amount %d\n", (int32_t)a0);
+
+            used = (heap_brk - HEAP_START) + (((uint64_t)a0 + 3) & ~(uint64_t)3);
+            if (used > (uint64_t)HEAP_LIMIT)
+                fail(loc, 2, "Cannot grow the heap by %d bytes, the heap limit is %ld bytes\n",
+                     (int32_t)a0, HEAP_LIMIT);
+
+            /* Whole pages, like the VM */
+            heap_size = (uint32_t)((used + 4095) & ~(uint64_t)4095);
+            if (heap_size > (uint64_t)HEAP_LIMIT)
+                heap_size = (uint32_t)HEAP_LIMIT;
+            heap_brk = HEAP_START + (uint32_t)used;
+
+            return brk;
+        }
+
+        case 10: /* ExitProgram */
+            fflush(stdout);
+            exit(0);
+
+        default:
+            fail(loc, 2, "Syscall number %u is not implemented\n", v0);
+    }
+
+    return v0;
+}
+)";
+
+    static std::string hexStr(VirtualAddr val)
+    {
+        std::ostringstream oss;
+
+        oss << Cvt::hexVal(val);
+        return oss.str();
+    }
+
+    static std::string cString(const std::string& s)
+    {
+        std::string res = "\"";
+
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+                res += '\\';
+            res += c;
+        }
+        return res + '"';
+    }
+
+    CEmitter::CEmitter(const VmOperationVector& action_v, const DebugTable& dbg_table,
+                       MemoryManager& mm)
+    : action_v(action_v), dbg_table(dbg_table), mm(mm),
+      is_label(action_v.size(), false), is_indirect(action_v.size(), false),
+      reg_used(RegIndex::Pc, false), needs_dispatch(false)
+    {
+        code_v.reserve(action_v.size());
+
+        for (const auto& act : action_v)
+        {
+            if (act.dinst)
+                code_v.push_back(*act.dinst);
+            else
+                code_v.push_back({Opcode::Task, 0, 0, 0, 0});
+        }
+    }
+
+    std::string CEmitter::reg(unsigned index)
+    {
+        if (index == RegIndex::Zero)
+            return "0u";
+
+        reg_used[index] = true;
+
+        if (index == RegIndex::Lo)
+            return "lo";
+        if (index == RegIndex::Hi)
+            return "hi";
+
+        return "r" + std::to_string(index);
+    }
+
+    // Jump to a static address
+    std::string CEmitter::target(VirtualAddr addr)
+    {
+        const VirtualAddr last_pc = 0x400000 + code_v.size() * 4;
+        size_t idx = static_cast<VirtualAddr>(addr - 0x400000) / 4;
+
+        if (addr >= last_pc)
+            return "goto done;";
+
+        if (idx < code_v.size() && (addr % 4) == 0)
+            return "goto L" + std::to_string(idx) + ";";
+
+        needs_dispatch = true;
+        return "{ pc = " + hexStr(addr) + "u; goto dispatch; }";
+    }
+
+    void CEmitter::findLeaders(VirtualAddr entry_addr)
+    {
+        const VirtualAddr last_pc = 0x400000 + code_v.size() * 4;
+
+        auto addIndirect = [this, last_pc](VirtualAddr addr)
+        {
+            if (addr >= 0x400000 && addr < last_pc && (addr % 4) == 0)
+            {
+                is_label[(addr - 0x400000) / 4] = true;
+                is_indirect[(addr - 0x400000) / 4] = true;
+            }
+        };
+
+        addIndirect(entry_addr);
+
+        for (size_t i = 0; i < code_v.size(); i++)
+        {
+            const DecodedInst& di = code_v[i];
+
+            if (hasStaticTarget(di.opc))
+            {
+                VirtualAddr addr = di.imm;
+
+                if (addr >= 0x400000 && addr < last_pc && (addr % 4) == 0)
+                    is_label[(addr - 0x400000) / 4] = true;
+            }
+
+            switch (di.opc)
+            {
+                case Opcode::Jal:
+                case Opcode::Jalr:
+                    addIndirect(0x400000 + (i + 1) * 4);
+                    break;
+                case Opcode::Jr:
+                    needs_dispatch = true;
+                    break;
+                case Opcode::La:
+                case Opcode::Li:
+                case Opcode::Lui:
+                case Opcode::Ori:
+                case Opcode::Addiu:
+                    addIndirect(di.imm);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        // Jump tables
+        const MemoryMap& mmap = mm.memMap();
+        for (size_t i = 0; i < mmap.gblWordSize(); i++)
+            addIndirect(*mm.memIter<uint32_t>(mmap.gblStartAddr() + i * 4));
+
+        // lui + ori pairs building a text address
+        for (size_t i = 1; i < code_v.size(); i++)
+        {
+            if (code_v[i - 1].opc == Opcode::Lui && code_v[i].opc == Opcode::Ori)
+                addIndirect(code_v[i - 1].imm | code_v[i].imm);
+        }
+    }
+
+    void CEmitter::emitInst(std::ostream& out, size_t idx)
+    {
+        const DecodedInst& di = code_v[idx];
+        const std::string loc = std::to_string(idx);
+        const std::string next_pc = hexStr(0x400000 + (idx + 1) * 4) + "u";
+        const std::string imm = hexStr(di.imm) + "u";
+        const char *op = nullptr;
+
+        auto assign = [&](unsigned dst, const std::string& expr)
+        {
+            if (dst != RegIndex::Zero)
+                out << "    " << reg(dst) << " = " << expr << ";\n";
+        };
+
+        switch (di.opc)
+        {
+            case Opcode::Add:
+            case Opcode::Addi:
+            case Opcode::Sub:
+            {
+                bool is_sub = (di.opc == Opcode::Sub);
+                std::string b = (di.opc == Opcode::Addi)? imm : reg(di.rt);
+                unsigned dst = (di.opc == Opcode::Addi)? di.rt : di.rd;
+                const char *name = (di.opc == Opcode::Add)? "add" : is_sub? "sub" : "addi";
+
+                out << "    a = " << reg(di.rs) << "; b = " << b << "; t = a "
+                    << (is_sub? '-' : '+') << " b;\n";
+
+                if (is_sub)
+                    out << "    if ((a ^ b) & (a ^ t) & 0x80000000u)";
+                else
+                    out << "    if (!((a ^ b) & 0x80000000u) && ((a ^ t) & 0x80000000u))";
+
+                out << " ovf_error(" << loc << ", \"" << name << "\", a, "
+                    << (is_sub? "0u - b" : "b") << ");\n";
+                assign(dst, "t");
+                break;
+            }
+            case Opcode::Addu: op = "+"; break;
+            case Opcode::Subu: op = "-"; break;
+            case Opcode::And: op = "&"; break;
+            case Opcode::Or: op = "|"; break;
+            case Opcode::Xor: op = "^"; break;
+            case Opcode::Nor:
+                assign(di.rd, "~(" + reg(di.rs) + " | " + reg(di.rt) + ")");
+                break;
+            case Opcode::Addiu:
+                assign(di.rt, reg(di.rs) + " + " + imm);
+                break;
+            case Opcode::Andi:
+                assign(di.rt, reg(di.rs) + " & " + imm);
+                break;
+            case Opcode::Ori:
+                assign(di.rt, reg(di.rs) + " | " + imm);
+                break;
+            case Opcode::Xori:
+                assign(di.rt, reg(di.rs) + " ^ " + imm);
+                break;
+            case Opcode::Slt:
+                assign(di.rd, "(int32_t)" + reg(di.rs) + " < (int32_t)" + reg(di.rt));
+                break;
+            case Opcode::Sltu:
+                assign(di.rd, reg(di.rs) + " < " + reg(di.rt));
+                break;
+            case Opcode::Slti:
+                assign(di.rt, "(int32_t)" + reg(di.rs) + " < (int32_t)" + imm);
+                break;
+            case Opcode::Sltiu:
+                assign(di.rt, reg(di.rs) + " < " + imm);
+                break;
+            case Opcode::Sll:
+                assign(di.rd, reg(di.rt) + " << " + std::to_string(di.imm));
+                break;
+            case Opcode::Srl:
+                assign(di.rd, reg(di.rt) + " >> " + std::to_string(di.imm));
+                break;
+            case Opcode::Sra:
+                assign(di.rd, "(uint32_t)((int32_t)" + reg(di.rt) + " >> " + std::to_string(di.imm) + ")");
+                break;
+            case Opcode::Sllv:
+                assign(di.rd, reg(di.rt) + " << (" + reg(di.rs) + " & 0x1f)");
+                break;
+            case Opcode::Srlv:
+                assign(di.rd, reg(di.rt) + " >> (" + reg(di.rs) + " & 0x1f)");
+                break;
+            case Opcode::Srav:
+                assign(di.rd, "(uint32_t)((int32_t)" + reg(di.rt) + " >> (" + reg(di.rs) + " & 0x1f))");
+                break;
+            case Opcode::Lui:
+            case Opcode::Li:
+            case Opcode::La:
+                assign(di.rt, imm);
+                break;
+            case Opcode::Move:
+                assign(di.rd, reg(di.rs));
+                break;
+            case Opcode::Mult:
+                out << "    m = (int64_t)(int32_t)" << reg(di.rs) << " * (int32_t)" << reg(di.rt) << ";\n"
+                    << "    " << reg(RegIndex::Lo) << " = (uint32_t)m; "
+                    << reg(RegIndex::Hi) << " = (uint32_t)((uint64_t)m >> 32);\n";
+                break;
+            case Opcode::Multu:
+                out << "    m = (int64_t)((uint64_t)" << reg(di.rs) << " * " << reg(di.rt) << ");\n"
+                    << "    " << reg(RegIndex::Lo) << " = (uint32_t)m; "
+                    << reg(RegIndex::Hi) << " = (uint32_t)((uint64_t)m >> 32);\n";
+                break;
+            case Opcode::Div:
+                out << "    a = " << reg(di.rs) << "; b = " << reg(di.rt) << ";\n"
+                    << "    if (b != 0 && a == 0x80000000u && b == 0xffffffffu) { "
+                    << reg(RegIndex::Lo) << " = a; " << reg(RegIndex::Hi) << " = 0; }\n"
+                    << "    else if (b != 0) { "
+                    << reg(RegIndex::Lo) << " = (uint32_t)((int32_t)a / (int32_t)b); "
+                    << reg(RegIndex::Hi) << " = (uint32_t)((int32_t)a % (int32_t)b); }\n";
+                break;
+            case Opcode::Divu:
+                out << "    a = " << reg(di.rs) << "; b = " << reg(di.rt) << ";\n"
+                    << "    if (b != 0) { " << reg(RegIndex::Lo) << " = a / b; "
+                    << reg(RegIndex::Hi) << " = a % b; }\n";
+                break;
+            case Opcode::Mfhi:
+                assign(di.rd, reg(RegIndex::Hi));
+                break;
+            case Opcode::Mflo:
+                assign(di.rd, reg(RegIndex::Lo));
+                break;
+            case Opcode::Mthi:
+                assign(RegIndex::Hi, reg(di.rs));
+                break;
+            case Opcode::Mtlo:
+                assign(RegIndex::Lo, reg(di.rs));
+                break;
+            case Opcode::Lw:
+            case Opcode::Lh:
+            case Opcode::Lhu:
+            case Opcode::Lb:
+            case Opcode::Lbu:
+            {
+                const char *fn = (di.opc == Opcode::Lw)? "lw" : (di.opc == Opcode::Lh)? "lh"
+                                 : (di.opc == Opcode::Lhu)? "lhu" : (di.opc == Opcode::Lb)? "lb" : "lbu";
+                std::string call = std::string(fn) + "(" + reg(di.rs) + " + " + imm + ", " + loc + ")";
+
+                if (di.rt == RegIndex::Zero)
+                    out << "    (void)" << call << ";\n";
+                else
+                    assign(di.rt, call);
+                break;
+            }
+            case Opcode::Sw:
+            case Opcode::Sh:
+            case Opcode::Sb:
+            {
+                const char *fn = (di.opc == Opcode::Sw)? "sw" : (di.opc == Opcode::Sh)? "sh" : "sb";
+
+                out << "    " << fn << "(" << reg(di.rs) << " + " << imm << ", "
+                    << reg(di.rt) << ", " << loc << ");\n";
+                break;
+            }
+            case Opcode::Nop:
+                break;
+            case Opcode::Beq:
+                out << "    if (" << reg(di.rs) << " == " << reg(di.rt) << ") " << target(di.imm) << '\n';
+                break;
+            case Opcode::Bne:
+                out << "    if (" << reg(di.rs) << " != " << reg(di.rt) << ") " << target(di.imm) << '\n';
+                break;
+            case Opcode::Beqz:
+                out << "    if (" << reg(di.rs) << " == 0) " << target(di.imm) << '\n';
+                break;
+            case Opcode::Bnez:
+                out << "    if (" << reg(di.rs) << " != 0) " << target(di.imm) << '\n';
+                break;
+            case Opcode::Bltz:
+                out << "    if ((int32_t)" << reg(di.rs) << " < 0) " << target(di.imm) << '\n';
+                break;
+            case Opcode::Bgez:
+                out << "    if ((int32_t)" << reg(di.rs) << " >= 0) " << target(di.imm) << '\n';
+                break;
+            case Opcode::Blez:
+                out << "    if ((int32_t)" << reg(di.rs) << " <= 0) " << target(di.imm) << '\n';
+                break;
+            case Opcode::Bgtz:
+                out << "    if ((int32_t)" << reg(di.rs) << " > 0) " << target(di.imm) << '\n';
+                break;
+            case Opcode::J:
+                out << "    " << target(di.imm) << '\n';
+                break;
+            case Opcode::Jal:
+                assign(RegIndex::Ra, next_pc);
+                out << "    " << target(di.imm) << '\n';
+                break;
+            case Opcode::Jr:
+                out << "    pc = " << reg(di.rs) << "; goto dispatch;\n";
+                break;
+            case Opcode::Jalr:
+                assign(RegIndex::Ra, next_pc);
+                out << "    pc = " << reg(di.rs) << "; goto dispatch;\n";
+                break;
+            case Opcode::Syscall:
+                out << "    " << reg(RegIndex::v0) << " = sys_call(" << reg(RegIndex::v0) << ", "
+                    << reg(RegIndex::a0) << ", " << reg(RegIndex::a1) << ", " << loc << ");\n";
+                break;
+            case Opcode::Break:
+                out << "    fail(" << loc << ", 2, \"Breakpoint exception #" << di.imm << "\\n\");\n";
+                break;
+            default:
+                throw EAsm::Error(dbg_table.srcInfo(idx),
+                                  "Debugger commands and floating point instructions can't be translated to C\n");
+        }
+
+        if (op != nullptr)
+            assign(di.rd, reg(di.rs) + " " + op + " " + reg(di.rt));
+    }
+
+    void CEmitter::emitRuntime(std::ostream& out)
+    {
+        const MemoryMap& mmap = mm.memMap();
+        std::map<std::string, int> file_ids;
+        std::vector<std::string> files;
+
+        out << "#include <ctype.h>\n"
+            << "#include <errno.h>\n"
+            << "#include <stdarg.h>\n"
+            << "#include <stdint.h>\n"
+            << "#include <stdio.h>\n"
+            << "#include <stdlib.h>\n"
+            << "#include <string.h>\n\n"
+            << "#define GBL_START " << Cvt::hexVal(mmap.gblStartAddr()) << "u\n"
+            << "#define GBL_SIZE " << mmap.gblSize() << "L\n"
+            << "#define STK_START " << Cvt::hexVal(mmap.stkStartAddr()) << "u\n"
+            << "#define STK_SIZE " << mmap.stkSize() << "L\n"
+            << "#define HEAP_START " << Cvt::hexVal(mmap.heapStartAddr()) << "u\n"
+            << "#define HEAP_LIMIT " << mmap.heapLimit() << "L\n"
+            << "#define TEXT_START 0x00400000u\n"
+            << "#define TEXT_END " << hexStr(0x400000 + code_v.size() * 4) << "u\n\n";
+
+        // Global data image, the stack and the heap start zeroed
+        size_t gbl_words = mmap.gblWordSize();
+        while (gbl_words > 0 && *mm.memIter<uint32_t>(mmap.gblStartAddr() + (gbl_words - 1) * 4) == 0)
+            gbl_words--;
+
+        out << "static uint32_t mem[" << mmap.wordSize() + (mmap.heapLimit() + 3) / 4 << "] = {";
+        for (size_t i = 0; i < gbl_words; i++)
+        {
+            out << ((i % 6 == 0)? "\n    " : " ")
+                << Cvt::hexVal(*mm.memIter<uint32_t>(mmap.gblStartAddr() + i * 4)) << "u,";
+        }
+        out << (gbl_words? "\n" : "0") << "};\n\n";
+
+        std::string locs;
+        for (size_t i = 0; i < code_v.size(); i++)
+        {
+            EAsm::SrcInfo si = dbg_table.srcInfo(i);
+            auto it = file_ids.find(si.fileName());
+
+            if (it == file_ids.end())
+            {
+                it = file_ids.emplace(si.fileName(), files.size()).first;
+                files.push_back(si.fileName());
+            }
+            locs += "    {" + std::to_string(it->second) + ", " + std::to_string(si.lineNum()) + "},\n";
+        }
+
+        out << "static const char *const src_file[] = {\n";
+        for (const auto& f : files)
+            out << "    " << cString(f) << ",\n";
+        out << "};\n\n"
+            << "static const struct { int file; int line; } src_loc[] = {\n"
+            << locs << "};\n"
+            << c_runtime;
+    }
+
+    void CEmitter::emit(std::ostream& out, VirtualAddr entry_addr)
+    {
+        std::ostringstream body;
+        size_t entry_idx = static_cast<VirtualAddr>(entry_addr - 0x400000) / 4;
+
+        findLeaders(entry_addr);
+
+        for (size_t i = 0; i < code_v.size(); i++)
+        {
+            if (is_label[i])
+                body << "L" << i << ":\n";
+
+            emitInst(body, i);
+        }
+        body << "    goto done;\n";
+
+        if (needs_dispatch)
+        {
+            body << "dispatch:\n"
+                 << "    if (pc >= TEXT_END) goto done;\n"
+                 << "    switch ((pc - TEXT_START) >> 2)\n"
+                 << "    {\n";
+            for (size_t i = 0; i < code_v.size(); i++)
+            {
+                if (is_indirect[i])
+                    body << "        case " << i << ": goto L" << i << ";\n";
+            }
+            body << "        default: break;\n"
+                 << "    }\n"
+                 << "    fflush(stdout);\n"
+                 << "    fprintf(stderr, \"Runtime error: Invalid instruction address 0x%08x\\n\", pc);\n"
+                 << "    return 1;\n";
+        }
+        body << "done:\n"
+             << "    fflush(stdout);\n"
+             << "    return 0;\n"
+             << "}\n";
+
+        const MemoryMap& mmap = mm.memMap();
+
+        out << "/* Generated by EasyMIPS --emit-c */\n";
+        emitRuntime(out);
+
+        std::string unused;
+
+        out << "\nint main(void)\n{\n";
+        for (unsigned i = 1; i < RegIndex::Pc; i++)
+        {
+            if (!reg_used[i])
+                continue;
+
+            VirtualAddr init = 0;
+            if (i == RegIndex::Sp)
+                init = mmap.stkEndAddr();
+            else if (i == RegIndex::Gp)
+                init = mmap.gblStartAddr();
+
+            out << "    uint32_t " << reg(i) << " = " << Cvt::hexVal(init) << "u;\n";
+            unused += "(void)" + reg(i) + "; ";
+        }
+        out << "    uint32_t a, b, t, pc;\n"
+            << "    int64_t m;\n\n"
+            << "    " << unused << "(void)a; (void)b; (void)t; (void)pc; (void)m;\n"
+            << "    goto L" << entry_idx << ";\n"
+            << body.str();
+    }
+
+} // namespace Mips32
@@ -0,0 +1,186 @@
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include "mips32_checkpoint.h"
+#include "colorizer.h"
+
+namespace Mips32
+{
+    static const char Magic[8] = {'E', 'M', 'I', 'P', 'S', 'C', 'K', 'P'};
+
+    // Written as a number, it reads back different on a host with the other
+    // byte order
+    static const uint32_t ByteOrderMark = 0x01020304;
+
+    template <typename T>
+    static void put(std::string& buf, T val)
+    {
+        buf.append(reinterpret_cast<const char *>(&val), sizeof(T));
+    }
+
+    static void putString(std::string& buf, std::string_view str)
+    {
+        put<uint64_t>(buf, str.size());
+        buf.append(str);
+    }
+
+    template <typename T>
+    static bool get(std::istream& in, T& val)
+    {
+        return static_cast<bool>(in.read(reinterpret_cast<char *>(&val), sizeof(T)));
+    }
+
+    static bool getString(std::istream& in, std::string& str)
+    {
+        uint64_t size;
+
+        if (!get(in, size))
+            return false;
+
+        // Don't trust the size before reading, a bad file could ask for anything
+        str.clear();
+        while (size > 0)
+        {
+            char chunk[4096];
+            size_t n = std::min<uint64_t>(size, sizeof(chunk));
+
+            if (!in.read(chunk, n))
+                return false;
+
+            str.append(chunk, n);
+            size -= n;
+        }
+
+        return true;
+    }
+
+    void Checkpoint::save(const std::string& file, const MemoryManager& mm)
+    {
+        std::string hdr;
+
+        hdr.append(Magic, sizeof(Magic));
+        put<uint32_t>(hdr, Version);
+        put<uint32_t>(hdr, ByteOrderMark);
+        put<uint64_t>(hdr, mem_map.gblStartAddr());
+        put<uint64_t>(hdr, mem_map.stkStartAddr());
+        put<uint64_t>(hdr, mem_map.gblSize());
+        put<uint64_t>(hdr, mem_map.stkSize());
+        put<uint64_t>(hdr, mem_map.heapLimit());
+        put<uint64_t>(hdr, mem_map.heapSize());
+        put<uint64_t>(hdr, heap_brk);
+        for (uint32_t reg : regs)
+            put<uint32_t>(hdr, reg);
+        put<uint64_t>(hdr, inst_count);
+        putString(hdr, entry_label);
+        put<uint64_t>(hdr, sources.size());
+        for (const auto& src : sources)
+        {
+            putString(hdr, src.name);
+            putString(hdr, src.text->text());
+        }
+
+        // The image offset and size go last, the header size is known by now
+        const size_t align = MemoryManager::ImageAlign;
+
+        image_ofs = ((hdr.size() + 2 * sizeof(uint64_t) + align - 1) / align) * align;
+        image_size = mm.imageSize();
+        put<uint64_t>(hdr, image_ofs);
+        put<uint64_t>(hdr, image_size);
+
+        std::ofstream out(file, std::ios::out | std::ios::binary | std::ios::trunc);
+
+        if (!out.is_open())
+            throw EAsm::Error("Cannot create checkpoint file ", cboldText(fcolor::red, file), '\n');
+
+        out.write(hdr.data(), hdr.size());
+        out.seekp(image_ofs);
+        mm.saveImage(out);
+
+        if (!out.flush())
+            throw EAsm::Error("Cannot write checkpoint file ", cboldText(fcolor::red, file), '\n');
+    }
+
+    Checkpoint Checkpoint::load(const std::string& file)
+    {
+        std::ifstream in(file, std::ios::in | std::ios::binary);
+
+        if (!in.is_open())
+            throw EAsm::Error("Cannot open checkpoint file ", cboldText(fcolor::red, file), '\n');
+
+        auto bad_file = [&file]()
+        {
+            return EAsm::Error(cboldText(fcolor::red, file),
+                               " is not a valid checkpoint file\n");
+        };
+
+        char magic[sizeof(Magic)];
+        uint32_t version, bom;
+
+        if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, Magic, sizeof(Magic)) != 0
+            || !get(in, version) || !get(in, bom))
+            throw bad_file();
+
+        if (version != Version)
+            throw EAsm::Error("Checkpoint file ", cboldText(fcolor::red, file),
+                              " has version ", colorText(fcolor::yellow, version),
+                              ", only version ", colorText(fcolor::yellow, Version),
+                              " is supported\n");
+
+        if (bom != ByteOrderMark)
+            throw EAsm::Error("Checkpoint file ", cboldText(fcolor::red, file),
+                              " was saved on a host with another byte order\n");
+
+        uint64_t gbl_start, stk_start, gbl_size, stk_size, heap_limit, heap_size, heap_brk;
+
+        if (!get(in, gbl_start) || !get(in, stk_start) || !get(in, gbl_size)
+            || !get(in, stk_size) || !get(in, heap_limit) || !get(in, heap_size)
+            || !get(in, heap_brk))
+            throw bad_file();
+
+        Checkpoint ckpt(MemoryMap(gbl_start, stk_start, gbl_size, stk_size, heap_limit));
+        uint64_t src_count;
+
+        ckpt.mem_map.setHeapSize(heap_size);
+        ckpt.heap_brk = heap_brk;
+
+        // The map is used as is to lay out guest memory, it gets the checks
+        // of the command line map and the break must be inside the heap
+        if (gbl_start > UINT32_MAX || stk_start > UINT32_MAX || !ckpt.mem_map.isValid()
+            || heap_brk < ckpt.mem_map.heapStartAddr() || heap_brk > ckpt.mem_map.heapEndAddr())
+            throw bad_file();
+
+        for (uint32_t& reg : ckpt.regs)
+        {
+            if (!get(in, reg))
+                throw bad_file();
+        }
+
+        if (!get(in, ckpt.inst_count) || !getString(in, ckpt.entry_label)
+            || !get(in, src_count))
+            throw bad_file();
+
+        for (uint64_t i = 0; i < src_count; i++)
+        {
+            SourceFile src;
+            std::string text;
+
+            if (!getString(in, src.name) || !getString(in, text))
+                throw bad_file();
+
+            src.text = std::make_shared<const SourceText>(text);
+            ckpt.sources.push_back(std::move(src));
+        }
+
+        if (!get(in, ckpt.image_ofs) || !get(in, ckpt.image_size)
+            || (ckpt.image_ofs % MemoryManager::ImageAlign) != 0)
+            throw bad_file();
+
+        // The image must be all there, it's mapped and read lazily
+        in.seekg(0, std::ios::end);
+        if (static_cast<uint64_t>(in.tellg()) < ckpt.image_ofs + ckpt.image_size)
+            throw bad_file();
+
+        return ckpt;
+    }
+
+} // namespace Mips32
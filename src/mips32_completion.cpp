@@ -1,4 +1,5 @@
 #include "mips32_completion.h"
+#include "mips32_names.h"
 #include <replxx.hxx>
 #include <algorithm>
 #include <cctype>
@@ -12,84 +13,9 @@ namespace Mips32
 // ============================================================================
 
 /**
- * Instruction metadata for autocompletion
- * Organized alphabetically for efficient searching
+ * Instructions, registers, directives, commands and keywords come from the
+ * tables shared with the lexer and the assembler, see mips32_names.h
  */
-static const char* instruction_list[] = {
-    "add", "addi", "addiu", "addu", "and", "andi",
-    "beq", "beqz", "bgez", "bgtz", "blez", "bltz", "bne", "bnez", "break",
-    "div", "divu",
-    "j", "jal", "jalr", "jr",
-    "la", "lb", "lbu", "lh", "lhu", "li", "lui", "lw", "lwc1",
-    "mfhi", "mflo", "move", "mthi", "mtlo", "mult", "multu",
-    "nop", "nor",
-    "or", "ori",
-    "sb", "sh", "sll", "sllv", "slt", "slti", "sltiu", "sltu", "sra", "srav",
-    "srl", "srlv", "sub", "subu", "sw", "swc1", "syscall",
-    "xor", "xori"
-};
-
-static const int instruction_count = sizeof(instruction_list) / sizeof(instruction_list[0]);
-
-/**
- * Register metadata for autocompletion
- * Each entry: {name1, name2} where name1 is $rN and name2 is the symbolic name
- */
-struct RegInfo
-{
-    const char *name;       // Primary name (symbolic like $t0, $zero)
-    const char *alt_name;   // Alternative name ($r0, $r1, etc.)
-};
-
-static const RegInfo register_list[] = {
-    {"$zero", "$r0"},
-    {"$at", "$r1"},
-    {"$v0", "$r2"}, {"$v1", "$r3"},
-    {"$a0", "$r4"}, {"$a1", "$r5"}, {"$a2", "$r6"}, {"$a3", "$r7"},
-    {"$t0", "$r8"}, {"$t1", "$r9"}, {"$t2", "$r10"}, {"$t3", "$r11"},
-    {"$t4", "$r12"}, {"$t5", "$r13"}, {"$t6", "$r14"}, {"$t7", "$r15"},
-    {"$s0", "$r16"}, {"$s1", "$r17"}, {"$s2", "$r18"}, {"$s3", "$r19"},
-    {"$s4", "$r20"}, {"$s5", "$r21"}, {"$s6", "$r22"}, {"$s7", "$r23"},
-    {"$t8", "$r24"}, {"$t9", "$r25"},
-    {"$k0", "$r26"}, {"$k1", "$r27"},
-    {"$gp", "$r28"},
-    {"$sp", "$r29"},
-    {"$fp", "$r30"},
-    {"$ra", "$r31"},
-    {"$lo", "$r32"},
-    {"$hi", "$r33"},
-    {"$pc", "$r34"}
-};
-
-static const int register_count = sizeof(register_list) / sizeof(register_list[0]);
-
-/**
- * Assembler directives for autocompletion
- */
-static const char* directive_list[] = {
-    ".data", ".text", ".globl", ".word", ".half", ".byte", ".space", ".ascii", ".asciiz", ".align"
-};
-
-static const int directive_count = sizeof(directive_list) / sizeof(directive_list[0]);
-
-/**
- * Debugger commands for autocompletion
- */
-static const char* command_list[] = {
-    "#show", "#set", "#exec", "#reset", "#stop", "#hihw", "#lohw", "#debug"
-};
-
-static const int command_count = sizeof(command_list) / sizeof(command_list[0]);
-
-/**
- * Debugger command keywords for autocompletion
- */
-static const char* keyword_list[] = {
-    "hexadecimal", "hex", "decimal", "signed", "unsigned", "binary",
-    "byte", "ascii", "hword", "word", "sep"
-};
-
-static const int keyword_count = sizeof(keyword_list) / sizeof(keyword_list[0]);
 
 // ============================================================================
 // Helper Functions
@@ -111,7 +37,7 @@ static std::string toLower(const std::string &s)
 /**
  * Check if a string starts with a prefix (case-insensitive)
  */
-static bool startsWithCaseInsensitive(const std::string &str, const std::string &prefix)
+static bool startsWithCaseInsensitive(std::string_view str, const std::string &prefix)
 {
     if (prefix.length() > str.length())
         return false;
@@ -291,11 +217,11 @@ std::vector<std::string> completeInstruction(const std::string &prefix)
     std::vector<std::string> matches;
     std::string lower_prefix = toLower(prefix);
     
-    for (int i = 0; i < instruction_count; ++i)
+    for (const auto &entry : Names::mnemonics)
     {
-        if (startsWithCaseInsensitive(instruction_list[i], lower_prefix))
+        if (startsWithCaseInsensitive(entry.name, lower_prefix))
         {
-            matches.push_back(instruction_list[i]);
+            matches.emplace_back(entry.name);
         }
     }
     
@@ -313,17 +239,17 @@ std::vector<std::string> completeRegister(const std::string &prefix)
     std::vector<std::string> matches;
     std::string lower_prefix = toLower(prefix);
     
-    for (int i = 0; i < register_count; ++i)
+    for (const auto &reg : Names::reg_names)
     {
         // Check primary name (symbolic like $t0)
-        if (startsWithCaseInsensitive(register_list[i].name, lower_prefix))
+        if (startsWithCaseInsensitive(reg.name, lower_prefix))
         {
-            matches.push_back(register_list[i].name);
+            matches.emplace_back(reg.name);
         }
         // Check alternative name ($r0, $r1, etc.)
-        else if (startsWithCaseInsensitive(register_list[i].alt_name, lower_prefix))
+        else if (startsWithCaseInsensitive(reg.num_name, lower_prefix))
         {
-            matches.push_back(register_list[i].alt_name);
+            matches.emplace_back(reg.num_name);
         }
     }
     
@@ -341,11 +267,11 @@ std::vector<std::string> completeDirective(const std::string &prefix)
     std::vector<std::string> matches;
     std::string lower_prefix = toLower(prefix);
     
-    for (int i = 0; i < directive_count; ++i)
+    for (const auto &entry : Names::directives)
     {
-        if (startsWithCaseInsensitive(directive_list[i], lower_prefix))
+        if (startsWithCaseInsensitive(entry.name, lower_prefix))
         {
-            matches.push_back(directive_list[i]);
+            matches.emplace_back(entry.name);
         }
     }
     
@@ -363,11 +289,11 @@ std::vector<std::string> completeCommand(const std::string &prefix)
     std::vector<std::string> matches;
     std::string lower_prefix = toLower(prefix);
     
-    for (int i = 0; i < command_count; ++i)
+    for (const auto &entry : Names::commands)
     {
-        if (startsWithCaseInsensitive(command_list[i], lower_prefix))
+        if (startsWithCaseInsensitive(entry.name, lower_prefix))
         {
-            matches.push_back(command_list[i]);
+            matches.emplace_back(entry.name);
         }
     }
     
@@ -385,11 +311,11 @@ std::vector<std::string> completeKeyword(const std::string &prefix)
     std::vector<std::string> matches;
     std::string lower_prefix = toLower(prefix);
     
-    for (int i = 0; i < keyword_count; ++i)
+    for (const auto &entry : Names::show_keywords)
     {
-        if (startsWithCaseInsensitive(keyword_list[i], lower_prefix))
+        if (startsWithCaseInsensitive(entry.name, lower_prefix))
         {
-            matches.push_back(keyword_list[i]);
+            matches.emplace_back(entry.name);
         }
     }
     
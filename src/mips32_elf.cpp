@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <unordered_set>
+#include "mips32_elf.h"
+#include "mips32_assembler.h"
+#include "mips32_encoding.h"
+#include "mips32_interp.h"
+#include "num_convert.h"
+#include "colorizer.h"
+
+namespace Mips32
+{
+    static const char Magic[4] = {0x7f, 'E', 'L', 'F'};
+
+    // Values of the ELF specification that are used here
+    enum : uint32_t
+    {
+        ElfClass32 = 1, ElfDataMsb = 2, EtExec = 2, EmMips = 8,
+        PtLoad = 1, PtDynamic = 2, PtInterp = 3, PfExec = 1,
+        ShtSymtab = 2, ShnUndef = 0, StbGlobal = 1,
+        EhdrSize = 52, PhdrSize = 32, ShdrSize = 40, SymSize = 16
+    };
+
+    // The text ends before the global memory, where the stack and the heap
+    // can't be either
+    static const VirtualAddr TextStart = 0x400000;
+    static const VirtualAddr TextLimit = 0x10000000;
+
+    static uint16_t be16(const uint8_t *p)
+    { return (p[0] << 8) | p[1]; }
+
+    static uint32_t be32(const uint8_t *p)
+    { return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3]; }
+
+    bool ElfImage::isElf(const std::string& file)
+    {
+        std::ifstream in(file, std::ios::in | std::ios::binary);
+        char magic[sizeof(Magic)];
+
+        return in.read(magic, sizeof(magic)) && std::equal(magic, magic + sizeof(magic), Magic);
+    }
+
+    ElfImage ElfImage::load(const std::string& file)
+    {
+        std::ifstream in(file, std::ios::in | std::ios::binary);
+
+        if (!in.is_open())
+            throw EAsm::Error("Cannot open file ", cboldText(fcolor::red, file), '\n');
+
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)),
+                                  std::istreambuf_iterator<char>());
+
+        auto bad_file = [&file](const char *what)
+        {
+            return EAsm::Error(cboldText(fcolor::red, file), ' ', what, '\n');
+        };
+
+        // Offset and size of a part of the file, checked against its end
+        auto at = [&data](uint64_t ofs, uint64_t size) -> const uint8_t *
+        {
+            if (ofs > data.size() || size > data.size() - ofs)
+                return nullptr;
+
+            return data.data() + ofs;
+        };
+
+        const uint8_t *ehdr = at(0, EhdrSize);
+
+        if (ehdr == nullptr || !std::equal(Magic, Magic + sizeof(Magic), ehdr))
+            throw bad_file("is not an ELF file");
+
+        if (ehdr[4] != ElfClass32 || ehdr[5] != ElfDataMsb || be16(ehdr + 18) != EmMips)
+            throw bad_file("is not a big-endian MIPS32 ELF file");
+
+        if (be16(ehdr + 16) != EtExec)
+            throw bad_file("is not an executable, only statically linked executables can run");
+
+        uint32_t phoff = be32(ehdr + 28), shoff = be32(ehdr + 32);
+        uint16_t phentsize = be16(ehdr + 42), phnum = be16(ehdr + 44);
+        uint16_t shentsize = be16(ehdr + 46), shnum = be16(ehdr + 48);
+
+        if (phnum == 0 || phentsize < PhdrSize || at(phoff, uint64_t(phentsize) * phnum) == nullptr)
+            throw bad_file("has an invalid program header table");
+
+        ElfImage image;
+
+        image.entry = be32(ehdr + 24);
+
+        for (uint16_t i = 0; i < phnum; i++)
+        {
+            const uint8_t *phdr = data.data() + phoff + i * phentsize;
+            uint32_t type = be32(phdr);
+
+            if (type == PtDynamic || type == PtInterp)
+                throw bad_file("is dynamically linked, only statically linked executables can run");
+
+            if (type != PtLoad)
+                continue;
+
+            ElfSegment seg;
+            uint32_t offset = be32(phdr + 4), file_size = be32(phdr + 16);
+            const uint8_t *bytes = at(offset, file_size);
+
+            seg.vaddr = be32(phdr + 8);
+            seg.mem_size = be32(phdr + 20);
+            seg.exec = (be32(phdr + 24) & PfExec) != 0;
+
+            if (bytes == nullptr || file_size > seg.mem_size
+                || uint64_t(seg.vaddr) + seg.mem_size > 0x100000000ull)
+                throw bad_file("has an invalid loadable segment");
+
+            if (seg.exec && (seg.vaddr < TextStart || (seg.vaddr % 4) != 0
+                             || uint64_t(seg.vaddr) + seg.mem_size > TextLimit))
+                throw EAsm::Error("Code segment at ", cboldText(fcolor::red, Cvt::hexVal(seg.vaddr)),
+                                  " of ", colorText(fcolor::green, file),
+                                  " must be between 0x00400000 and 0x10000000\n");
+
+            if (seg.mem_size == 0)
+                continue;
+
+            seg.bytes.assign(bytes, bytes + file_size);
+            image.segments.push_back(std::move(seg));
+        }
+
+        if (image.text().empty())
+            throw bad_file("has no code segment");
+
+        // Symbols are optional, a stripped executable just has none
+        const uint8_t *shdrs = at(shoff, uint64_t(shentsize) * shnum);
+
+        if (shoff == 0 || shentsize < ShdrSize || shdrs == nullptr)
+            return image;
+
+        for (uint16_t i = 0; i < shnum; i++)
+        {
+            const uint8_t *shdr = shdrs + i * shentsize;
+            uint32_t link = be32(shdr + 24);
+
+            if (be32(shdr + 4) != ShtSymtab || link >= shnum)
+                continue;
+
+            const uint8_t *strtab_hdr = shdrs + link * shentsize;
+            const uint8_t *syms = at(be32(shdr + 16), be32(shdr + 20));
+            const uint8_t *strtab = at(be32(strtab_hdr + 16), be32(strtab_hdr + 20));
+            uint32_t strtab_size = be32(strtab_hdr + 20);
+
+            if (syms == nullptr || strtab == nullptr)
+                throw bad_file("has an invalid symbol table");
+
+            for (uint32_t ofs = 0; ofs + SymSize <= be32(shdr + 20); ofs += SymSize)
+            {
+                const uint8_t *sym = syms + ofs;
+                uint32_t name = be32(sym);
+
+                if (name == 0 || name >= strtab_size || be16(sym + 14) == ShnUndef)
+                    continue;
+
+                const char *str = reinterpret_cast<const char *>(strtab + name);
+                std::string sym_name(str, strnlen(str, strtab_size - name));
+
+                // Global symbols win over local ones with the same name
+                if ((sym[12] >> 4) == StbGlobal)
+                    image.symbols[sym_name] = be32(sym + 4);
+                else
+                    image.symbols.emplace(sym_name, be32(sym + 4));
+            }
+        }
+
+        return image;
+    }
+
+    std::vector<uint32_t> ElfImage::text() const
+    {
+        VirtualAddr text_end = TextStart;
+
+        for (const auto& seg : segments)
+        {
+            if (seg.exec)
+                text_end = std::max<VirtualAddr>(text_end, (seg.vaddr + seg.mem_size + 3) & ~3u);
+        }
+
+        std::vector<uint32_t> words((text_end - TextStart) / 4, 0);
+
+        for (const auto& seg : segments)
+        {
+            if (!seg.exec)
+                continue;
+
+            for (size_t i = 0; i < seg.bytes.size(); i++)
+            {
+                uint32_t& word = words[(seg.vaddr - TextStart + i) / 4];
+                unsigned shift = 24 - ((seg.vaddr + i) % 4) * 8;
+
+                word |= uint32_t(seg.bytes[i]) << shift;
+            }
+        }
+
+        return words;
+    }
+
+    static bool isDelayedBranch(Opcode opc)
+    {
+        return hasStaticTarget(opc) || opc == Opcode::Jr || opc == Opcode::Jalr;
+    }
+
+    // General register written by an instruction, -1 if none. Empty if it
+    // can't be moved ahead of a branch at all.
+    static std::optional<int> writtenReg(const DecodedInst& di)
+    {
+        switch (di.opc)
+        {
+            case Opcode::Add: case Opcode::Addu: case Opcode::Sub: case Opcode::Subu:
+            case Opcode::And: case Opcode::Or: case Opcode::Nor: case Opcode::Xor:
+            case Opcode::Slt: case Opcode::Sltu: case Opcode::Sllv: case Opcode::Srlv:
+            case Opcode::Srav: case Opcode::Sll: case Opcode::Srl: case Opcode::Sra:
+            case Opcode::Move: case Opcode::Mfhi: case Opcode::Mflo:
+                return di.rd;
+
+            case Opcode::Addi: case Opcode::Addiu: case Opcode::Slti: case Opcode::Sltiu:
+            case Opcode::Andi: case Opcode::Ori: case Opcode::Xori: case Opcode::Lui:
+            case Opcode::La: case Opcode::Li: case Opcode::Lw: case Opcode::Lb:
+            case Opcode::Lbu: case Opcode::Lh: case Opcode::Lhu:
+                return di.rt;
+
+            case Opcode::Mult: case Opcode::Multu: case Opcode::Div: case Opcode::Divu:
+            case Opcode::Mthi: case Opcode::Mtlo: case Opcode::Sb: case Opcode::Sh:
+            case Opcode::Sw: case Opcode::Nop:
+                return -1;
+
+            default:
+                return std::nullopt;
+        }
+    }
+
+    // The delay slot instruction can run first if it doesn't write what the
+    // branch reads, and it doesn't use $ra when the branch links
+    static bool canSwap(const DecodedInst& branch, const DecodedInst& slot)
+    {
+        std::optional<int> reg = writtenReg(slot);
+
+        if (!reg)
+            return false;
+
+        if ((branch.opc == Opcode::Jal || branch.opc == Opcode::Jalr)
+            && (slot.rd == RegIndex::Ra || slot.rs == RegIndex::Ra || slot.rt == RegIndex::Ra))
+            return false;
+
+        if (*reg <= 0)
+            return true;
+
+        switch (branch.opc)
+        {
+            case Opcode::Beq: case Opcode::Bne:
+                return *reg != branch.rs && *reg != branch.rt;
+            case Opcode::J: case Opcode::Jal:
+                return true;
+            default:
+                return *reg != branch.rs;
+        }
+    }
+
+    // Runs the delay slot after the branch condition is known. Links go past
+    // the delay slot, which is also where a branch not taken goes on.
+    static TaskFunction delayedBranch(TaskFunction branch, TaskFunction slot)
+    {
+        return [branch = std::move(branch), slot = std::move(slot)](RuntimeContext& ctx)
+        {
+            VirtualAddr slot_pc = ctx.getPC();
+
+            ctx.setPC(slot_pc + 4);
+
+            ErrorCode ecode = branch(ctx);
+            VirtualAddr next_pc = ctx.getPC();
+
+            if (ecode != ErrorCode::Ok)
+                return ecode;
+
+            ctx.setPC(slot_pc + 4);
+            ecode = slot(ctx);
+
+            if (ecode == ErrorCode::Ok)
+                ctx.setPC(next_pc);
+
+            return ecode;
+        };
+    }
+
+    VmOperationVector compileText(const std::vector<uint32_t>& text, VirtualAddr entry_addr)
+    {
+        VmOperationVector action_v;
+        std::unordered_set<VirtualAddr> targets{entry_addr};
+
+        action_v.reserve(text.size());
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            uint32_t word = text[i];
+            std::optional<DecodedInst> di = decodeWord(word, TextStart + i * 4);
+
+            if (!di)
+            {
+                action_v.emplace_back([word](RuntimeContext& ctx)
+                {
+                    ctx.last_error = EAsm::Error("Invalid instruction word ",
+                                                 cboldText(fcolor::red, Cvt::hexVal(word)), '\n');
+                    return ErrorCode::UnsupportedInst;
+                });
+                continue;
+            }
+
+            if (hasStaticTarget(di->opc))
+                targets.insert(di->imm);
+
+            VmOperation op(Assembler::compileInst(di->opc, Assembler::instArgs(*di)));
+
+            op.dinst = di;
+            action_v.push_back(std::move(op));
+        }
+
+        for (size_t i = 0; i + 1 < action_v.size(); i++)
+        {
+            const std::optional<DecodedInst>& branch = action_v[i].dinst;
+
+            if (!branch || !isDelayedBranch(branch->opc))
+                continue;
+
+            const std::optional<DecodedInst>& slot = action_v[i + 1].dinst;
+
+            // A branch in a delay slot is undefined, both are left alone.
+            // Code that jumps to the delay slot needs it where it is.
+            if (!slot || !isDelayedBranch(slot->opc))
+            {
+                if (slot && canSwap(*branch, *slot) && targets.count(TextStart + (i + 1) * 4) == 0)
+                    std::swap(action_v[i], action_v[i + 1]);
+                else
+                    action_v[i] = VmOperation(delayedBranch(action_v[i].task, action_v[i + 1].task));
+            }
+            i++;
+        }
+
+        return action_v;
+    }
+
+} // namespace Mips32
@@ -0,0 +1,378 @@
+#include <sstream>
+#include "mips32_encoding.h"
+#include "mips32_assembler.h"
+#include "num_convert.h"
+
+namespace Mips32
+{
+    struct OpcodeCode
+    {
+        Opcode opc;
+        uint32_t code;
+    };
+
+    // Function field of the SPECIAL (opcode 0) instructions
+    static const OpcodeCode special_codes[] = {
+        {Opcode::Sll, 0x00}, {Opcode::Srl, 0x02}, {Opcode::Sra, 0x03},
+        {Opcode::Sllv, 0x04}, {Opcode::Srlv, 0x06}, {Opcode::Srav, 0x07},
+        {Opcode::Jr, 0x08}, {Opcode::Jalr, 0x09}, {Opcode::Syscall, 0x0c},
+        {Opcode::Break, 0x0d}, {Opcode::Mfhi, 0x10}, {Opcode::Mthi, 0x11},
+        {Opcode::Mflo, 0x12}, {Opcode::Mtlo, 0x13}, {Opcode::Mult, 0x18},
+        {Opcode::Multu, 0x19}, {Opcode::Div, 0x1a}, {Opcode::Divu, 0x1b},
+        {Opcode::Add, 0x20}, {Opcode::Addu, 0x21}, {Opcode::Sub, 0x22},
+        {Opcode::Subu, 0x23}, {Opcode::And, 0x24}, {Opcode::Or, 0x25},
+        {Opcode::Xor, 0x26}, {Opcode::Nor, 0x27}, {Opcode::Slt, 0x2a},
+        {Opcode::Sltu, 0x2b}
+    };
+
+    // Opcode field of the other instructions. Bltz and Bgez share opcode 1
+    // (REGIMM) and are told apart by the rt field.
+    static const OpcodeCode primary_codes[] = {
+        {Opcode::J, 0x02}, {Opcode::Jal, 0x03}, {Opcode::Beq, 0x04},
+        {Opcode::Bne, 0x05}, {Opcode::Blez, 0x06}, {Opcode::Bgtz, 0x07},
+        {Opcode::Addi, 0x08}, {Opcode::Addiu, 0x09}, {Opcode::Slti, 0x0a},
+        {Opcode::Sltiu, 0x0b}, {Opcode::Andi, 0x0c}, {Opcode::Ori, 0x0d},
+        {Opcode::Xori, 0x0e}, {Opcode::Lui, 0x0f}, {Opcode::Lb, 0x20},
+        {Opcode::Lh, 0x21}, {Opcode::Lw, 0x23}, {Opcode::Lbu, 0x24},
+        {Opcode::Lhu, 0x25}, {Opcode::Sb, 0x28}, {Opcode::Sh, 0x29},
+        {Opcode::Sw, 0x2b}
+    };
+
+    // Same order as Opcode, up to La
+    static const char *mnemonics[] = {
+        "add", "sll", "nop", "addu", "srl", "and", "sra", "break", "sllv", "div", "srlv",
+        "divu", "srav", "jalr", "jr", "syscall", "mfhi", "mflo", "mthi", "mtlo", "mult",
+        "multu", "nor", "or", "slt", "sltu", "sub", "subu", "xor", "bltz", "bgez", "beq",
+        "beqz", "bne", "bnez", "blez", "bgtz", "slti", "lb", "sltiu", "lbu", "lh", "ori",
+        "lhu", "addi", "addiu", "andi", "xori", "lui", "lw", "lwc1", "sb", "sh", "sw",
+        "swc1", "j", "jal", "move", "li", "la"
+    };
+
+    template <size_t N>
+    static std::optional<uint32_t> codeOf(const OpcodeCode (&codes)[N], Opcode opc)
+    {
+        for (const auto& c : codes)
+        {
+            if (c.opc == opc)
+                return c.code;
+        }
+        return std::nullopt;
+    }
+
+    template <size_t N>
+    static std::optional<Opcode> opcodeOf(const OpcodeCode (&codes)[N], uint32_t code)
+    {
+        for (const auto& c : codes)
+        {
+            if (c.code == code)
+                return c.opc;
+        }
+        return std::nullopt;
+    }
+
+    static uint32_t rType(uint32_t rs, uint32_t rt, uint32_t rd, uint32_t shamt, uint32_t funct)
+    { return (rs << 21) | (rt << 16) | (rd << 11) | ((shamt & 0x1f) << 6) | funct; }
+
+    static uint32_t iType(uint32_t op, uint32_t rs, uint32_t rt, uint32_t imm)
+    { return (op << 26) | (rs << 21) | (rt << 16) | (imm & 0xffff); }
+
+    static bool isSimm16(uint32_t val)
+    { return extend_cast<int16_t, uint32_t>(val & 0xffff) == val; }
+
+    // Branch offsets count words from the instruction after the branch
+    static std::optional<uint32_t> branch(uint32_t op, uint32_t rs, uint32_t rt,
+                                          VirtualAddr target, VirtualAddr pc)
+    {
+        uint32_t ofs = target - (pc + 4);
+
+        if ((ofs % 4) != 0 || !isSimm16(static_cast<uint32_t>(static_cast<int32_t>(ofs) >> 2)))
+            return std::nullopt;
+
+        return iType(op, rs, rt, ofs >> 2);
+    }
+
+    std::optional<uint32_t> encodeInst(const DecodedInst& di, VirtualAddr pc)
+    {
+        std::optional<uint32_t> funct = codeOf(special_codes, di.opc);
+        std::optional<uint32_t> op = codeOf(primary_codes, di.opc);
+
+        switch (di.opc)
+        {
+            case Opcode::Nop:
+                return 0;
+            case Opcode::Add: case Opcode::Addu: case Opcode::Sub: case Opcode::Subu:
+            case Opcode::And: case Opcode::Or: case Opcode::Nor: case Opcode::Xor:
+            case Opcode::Slt: case Opcode::Sltu: case Opcode::Sllv: case Opcode::Srlv:
+            case Opcode::Srav:
+                return rType(di.rs, di.rt, di.rd, 0, *funct);
+            case Opcode::Sll: case Opcode::Srl: case Opcode::Sra:
+                return rType(0, di.rt, di.rd, di.imm, *funct);
+            case Opcode::Mult: case Opcode::Multu: case Opcode::Div: case Opcode::Divu:
+                return rType(di.rs, di.rt, 0, 0, *funct);
+            case Opcode::Mfhi: case Opcode::Mflo:
+                return rType(0, 0, di.rd, 0, *funct);
+            case Opcode::Mthi: case Opcode::Mtlo: case Opcode::Jr:
+                return rType(di.rs, 0, 0, 0, *funct);
+            case Opcode::Jalr:
+                return rType(di.rs, 0, RegIndex::Ra, 0, *funct);
+            case Opcode::Syscall:
+                return *funct;
+            case Opcode::Break:
+                if (di.imm > 0xfffff)
+                    return std::nullopt;
+                return (di.imm << 6) | *funct;
+            case Opcode::Move:
+                return rType(di.rs, RegIndex::Zero, di.rd, 0, *codeOf(special_codes, Opcode::Addu));
+
+            case Opcode::Addi: case Opcode::Addiu: case Opcode::Slti: case Opcode::Sltiu:
+            case Opcode::Lw: case Opcode::Lb: case Opcode::Lbu: case Opcode::Lh: case Opcode::Lhu:
+            case Opcode::Sw: case Opcode::Sb: case Opcode::Sh:
+                if (!isSimm16(di.imm))
+                    return std::nullopt;
+                return iType(*op, di.rs, di.rt, di.imm);
+            case Opcode::Andi: case Opcode::Ori: case Opcode::Xori:
+                if (di.imm > 0xffff)
+                    return std::nullopt;
+                return iType(*op, di.rs, di.rt, di.imm);
+            case Opcode::Lui:
+                if ((di.imm & 0xffff) != 0)
+                    return std::nullopt;
+                return iType(*op, 0, di.rt, di.imm >> 16);
+            case Opcode::Li: case Opcode::La:
+                if (isSimm16(di.imm))
+                    return iType(*codeOf(primary_codes, Opcode::Addiu), 0, di.rt, di.imm);
+                if (di.imm <= 0xffff)
+                    return iType(*codeOf(primary_codes, Opcode::Ori), 0, di.rt, di.imm);
+                if ((di.imm & 0xffff) == 0)
+                    return iType(*codeOf(primary_codes, Opcode::Lui), 0, di.rt, di.imm >> 16);
+                return std::nullopt;
+
+            case Opcode::Beq: case Opcode::Bne:
+                return branch(*op, di.rs, di.rt, di.imm, pc);
+            case Opcode::Beqz:
+                return branch(*codeOf(primary_codes, Opcode::Beq), di.rs, 0, di.imm, pc);
+            case Opcode::Bnez:
+                return branch(*codeOf(primary_codes, Opcode::Bne), di.rs, 0, di.imm, pc);
+            case Opcode::Blez: case Opcode::Bgtz:
+                return branch(*op, di.rs, 0, di.imm, pc);
+            case Opcode::Bltz:
+                return branch(0x01, di.rs, 0, di.imm, pc);
+            case Opcode::Bgez:
+                return branch(0x01, di.rs, 1, di.imm, pc);
+
+            case Opcode::J: case Opcode::Jal:
+                // Only inside the 256 MB region of the next instruction
+                if ((di.imm % 4) != 0 || ((di.imm ^ (pc + 4)) & 0xf0000000) != 0)
+                    return std::nullopt;
+                return (*op << 26) | ((di.imm >> 2) & 0x3ffffff);
+
+            default:
+                return std::nullopt;
+        }
+    }
+
+    std::optional<DecodedInst> decodeWord(uint32_t word, VirtualAddr pc)
+    {
+        const uint32_t op = word >> 26;
+        const uint8_t rs = (word >> 21) & 0x1f;
+        const uint8_t rt = (word >> 16) & 0x1f;
+        const uint8_t rd = (word >> 11) & 0x1f;
+        const uint32_t simm = extend_cast<int16_t, uint32_t>(word & 0xffff);
+        std::optional<Opcode> opc;
+        DecodedInst di {Opcode::Nop, 0, 0, 0, 0};
+
+        if (word == 0)
+            return di;
+
+        if (op == 0)
+            opc = opcodeOf(special_codes, word & 0x3f);
+        else if (op == 0x01 && rt <= 1)
+            opc = (rt == 0)? Opcode::Bltz : Opcode::Bgez;
+        else
+            opc = opcodeOf(primary_codes, op);
+
+        if (!opc)
+            return std::nullopt;
+
+        di.opc = *opc;
+
+        switch (di.opc)
+        {
+            case Opcode::Addu:
+                if (rt == RegIndex::Zero)
+                {
+                    di.opc = Opcode::Move;
+                    di.rd = rd;
+                    di.rs = rs;
+                    break;
+                }
+                [[fallthrough]];
+            case Opcode::Add: case Opcode::Sub: case Opcode::Subu:
+            case Opcode::And: case Opcode::Or: case Opcode::Nor: case Opcode::Xor:
+            case Opcode::Slt: case Opcode::Sltu: case Opcode::Sllv: case Opcode::Srlv:
+            case Opcode::Srav:
+                di.rd = rd;
+                di.rs = rs;
+                di.rt = rt;
+                break;
+            case Opcode::Sll: case Opcode::Srl: case Opcode::Sra:
+                di.rd = rd;
+                di.rt = rt;
+                di.imm = (word >> 6) & 0x1f;
+                break;
+            case Opcode::Mult: case Opcode::Multu: case Opcode::Div: case Opcode::Divu:
+                di.rs = rs;
+                di.rt = rt;
+                break;
+            case Opcode::Mfhi: case Opcode::Mflo:
+                di.rd = rd;
+                break;
+            case Opcode::Mthi: case Opcode::Mtlo: case Opcode::Jr: case Opcode::Jalr:
+                di.rs = rs;
+                break;
+            case Opcode::Break:
+                di.imm = (word >> 6) & 0xfffff;
+                break;
+            case Opcode::Addi: case Opcode::Addiu: case Opcode::Slti: case Opcode::Sltiu:
+            case Opcode::Lw: case Opcode::Lb: case Opcode::Lbu: case Opcode::Lh: case Opcode::Lhu:
+            case Opcode::Sw: case Opcode::Sb: case Opcode::Sh:
+                di.rt = rt;
+                di.rs = rs;
+                di.imm = simm;
+                break;
+            case Opcode::Andi: case Opcode::Ori: case Opcode::Xori:
+                di.rt = rt;
+                di.rs = rs;
+                di.imm = word & 0xffff;
+                break;
+            case Opcode::Lui:
+                di.rt = rt;
+                di.imm = (word & 0xffff) << 16;
+                break;
+            case Opcode::Beq: case Opcode::Bne:
+                if (rt == RegIndex::Zero)
+                    di.opc = (di.opc == Opcode::Beq)? Opcode::Beqz : Opcode::Bnez;
+                else
+                    di.rt = rt;
+                [[fallthrough]];
+            case Opcode::Bltz: case Opcode::Bgez: case Opcode::Blez: case Opcode::Bgtz:
+                di.rs = rs;
+                di.imm = pc + 4 + (simm << 2);
+                break;
+            case Opcode::J: case Opcode::Jal:
+                di.imm = ((pc + 4) & 0xf0000000) | ((word & 0x3ffffff) << 2);
+                break;
+            default:
+                break;
+        }
+
+        // Fields the instruction doesn't use must be zero
+        if (encodeInst(di, pc) != word)
+            return std::nullopt;
+
+        return di;
+    }
+
+    static std::string regName(uint32_t idx)
+    { return Assembler::getRegName(idx); }
+
+    std::string disassemble(uint32_t word, VirtualAddr pc)
+    {
+        std::ostringstream out;
+        std::optional<DecodedInst> odi = decodeWord(word, pc);
+
+        if (!odi)
+        {
+            if (isPseudoWord(word))
+                out << "<operation " << pseudoIndex(word) << ">";
+            else
+                out << ".word " << Cvt::hexVal(word);
+
+            return out.str();
+        }
+
+        const DecodedInst& di = *odi;
+        const std::string rd = regName(di.rd);
+        const std::string rs = regName(di.rs);
+        const std::string rt = regName(di.rt);
+
+        out << mnemonics[static_cast<size_t>(di.opc)];
+
+        switch (di.opc)
+        {
+            case Opcode::Add: case Opcode::Addu: case Opcode::Sub: case Opcode::Subu:
+            case Opcode::And: case Opcode::Or: case Opcode::Nor: case Opcode::Xor:
+            case Opcode::Slt: case Opcode::Sltu:
+                out << ' ' << rd << ", " << rs << ", " << rt;
+                break;
+            case Opcode::Sllv: case Opcode::Srlv: case Opcode::Srav:
+                out << ' ' << rd << ", " << rt << ", " << rs;
+                break;
+            case Opcode::Sll: case Opcode::Srl: case Opcode::Sra:
+                out << ' ' << rd << ", " << rt << ", " << di.imm;
+                break;
+            case Opcode::Mult: case Opcode::Multu: case Opcode::Div: case Opcode::Divu:
+                out << ' ' << rs << ", " << rt;
+                break;
+            case Opcode::Move:
+                out << ' ' << rd << ", " << rs;
+                break;
+            case Opcode::Mfhi: case Opcode::Mflo:
+                out << ' ' << rd;
+                break;
+            case Opcode::Mthi: case Opcode::Mtlo: case Opcode::Jr: case Opcode::Jalr:
+                out << ' ' << rs;
+                break;
+            case Opcode::Break:
+                if (di.imm != 0)
+                    out << ' ' << di.imm;
+                break;
+            case Opcode::Addi: case Opcode::Addiu: case Opcode::Slti: case Opcode::Sltiu:
+                out << ' ' << rt << ", " << rs << ", " << static_cast<int32_t>(di.imm);
+                break;
+            case Opcode::Andi: case Opcode::Ori: case Opcode::Xori:
+                out << ' ' << rt << ", " << rs << ", " << Cvt::hexVal(static_cast<uint16_t>(di.imm));
+                break;
+            case Opcode::Lui:
+                out << ' ' << rt << ", " << Cvt::hexVal(static_cast<uint16_t>(di.imm >> 16));
+                break;
+            case Opcode::Lw: case Opcode::Lb: case Opcode::Lbu: case Opcode::Lh: case Opcode::Lhu:
+            case Opcode::Sw: case Opcode::Sb: case Opcode::Sh:
+                out << ' ' << rt << ", " << static_cast<int32_t>(di.imm) << '(' << rs << ')';
+                break;
+            case Opcode::Beq: case Opcode::Bne:
+                out << ' ' << rs << ", " << rt << ", " << Cvt::hexVal(di.imm);
+                break;
+            case Opcode::Beqz: case Opcode::Bnez: case Opcode::Bltz: case Opcode::Bgez:
+            case Opcode::Blez: case Opcode::Bgtz:
+                out << ' ' << rs << ", " << Cvt::hexVal(di.imm);
+                break;
+            case Opcode::J: case Opcode::Jal:
+                out << ' ' << Cvt::hexVal(di.imm);
+                break;
+            default:
+                break;
+        }
+
+        return out.str();
+    }
+
+    std::vector<uint32_t> encodeProgram(const VmOperationVector& action_v)
+    {
+        std::vector<uint32_t> text(action_v.size());
+
+        for (size_t i = 0; i < action_v.size(); i++)
+        {
+            const VmOperation& act = action_v[i];
+            std::optional<uint32_t> word;
+
+            if (act.dinst)
+                word = encodeInst(*act.dinst, 0x400000 + i * 4);
+
+            text[i] = word.value_or(pseudoWord(i));
+        }
+
+        return text;
+    }
+
+} // namespace Mips32
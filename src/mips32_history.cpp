@@ -0,0 +1,320 @@
+#include <algorithm>
+#include "mips32_history.h"
+#include "mips32_assembler.h"
+
+namespace Mips32
+{
+    // Largest power of two records that fit in budget bytes
+    size_t ExecHistory::ringCapacity(size_t budget)
+    {
+        size_t cap = 64;
+
+        while (cap * 2 * sizeof(Record) <= budget)
+            cap *= 2;
+
+        return cap;
+    }
+
+    ExecHistory::ExecHistory(size_t budget)
+    : capacity(ringCapacity(budget)),
+      first(0), count(0), past(0), step_start(0),
+      total_steps(0), past_steps(0), in_step(false), diff_regs(false), shadow()
+    {}
+
+    void ExecHistory::clear()
+    {
+        first = 0;
+        count = past = step_start = 0;
+        total_steps = past_steps = 0;
+        in_step = diff_regs = false;
+    }
+
+    void ExecHistory::beginStep(RuntimeContext& ctx, const VmOperation& op)
+    {
+        // Whatever was undone can't be redone anymore
+        count = past;
+        total_steps = past_steps;
+
+        in_step = true;
+        diff_regs = false;
+        step_start = count;
+        push({Kind::Step, ctx.getPC(), 0});
+
+        if (!in_step)
+            return;
+
+        total_steps++;
+        past_steps++;
+
+        // Instructions only run by their closure write who knows what
+        if (!op.dinst)
+        {
+            saveRegs(ctx);
+            return;
+        }
+
+        const DecodedInst& di = *op.dinst;
+        const RegFile& regs = ctx.reg_file;
+
+        switch (di.opc)
+        {
+            case Opcode::Add: case Opcode::Addu: case Opcode::Sub: case Opcode::Subu:
+            case Opcode::And: case Opcode::Or: case Opcode::Nor: case Opcode::Xor:
+            case Opcode::Slt: case Opcode::Sltu: case Opcode::Sllv: case Opcode::Srlv:
+            case Opcode::Srav: case Opcode::Sll: case Opcode::Srl: case Opcode::Sra:
+            case Opcode::Move: case Opcode::Mfhi: case Opcode::Mflo:
+                saveReg(ctx, di.rd);
+                break;
+
+            case Opcode::Addi: case Opcode::Addiu: case Opcode::Slti: case Opcode::Sltiu:
+            case Opcode::Andi: case Opcode::Ori: case Opcode::Xori: case Opcode::Lui:
+            case Opcode::La: case Opcode::Li: case Opcode::Lw: case Opcode::Lb:
+            case Opcode::Lbu: case Opcode::Lh: case Opcode::Lhu:
+                saveReg(ctx, di.rt);
+                break;
+
+            case Opcode::Mult: case Opcode::Multu: case Opcode::Div: case Opcode::Divu:
+                saveReg(ctx, RegIndex::Hi);
+                saveReg(ctx, RegIndex::Lo);
+                break;
+
+            case Opcode::Mthi:
+                saveReg(ctx, RegIndex::Hi);
+                break;
+
+            case Opcode::Mtlo:
+                saveReg(ctx, RegIndex::Lo);
+                break;
+
+            case Opcode::Jal: case Opcode::Jalr:
+                saveReg(ctx, RegIndex::Ra);
+                break;
+
+            case Opcode::Sb: case Opcode::Sh: case Opcode::Sw:
+                saveWord(ctx, regs[di.rs] + di.imm);
+                break;
+
+            case Opcode::Beq: case Opcode::Bne: case Opcode::Beqz: case Opcode::Bnez:
+            case Opcode::Bltz: case Opcode::Bgez: case Opcode::Blez: case Opcode::Bgtz:
+            case Opcode::J: case Opcode::Jr: case Opcode::Nop:
+                break;
+
+            case Opcode::Syscall:
+                switch (static_cast<Syscall>(regs[RegIndex::v0]))
+                {
+                    case Syscall::ReadString:
+                    {
+                        VirtualAddr vaddr = regs[RegIndex::a0];
+                        uint64_t end = uint64_t(vaddr) + regs[RegIndex::a1];
+
+                        // An invalid range fails without writing anything
+                        if (end == vaddr || end - 1 > UINT32_MAX
+                            || !ctx.mm->isValidAddrRange(vaddr, static_cast<VirtualAddr>(end - 1)))
+                            break;
+
+                        for (uint64_t wa = vaddr & ~3u; wa < end && in_step; wa += 4)
+                            saveWord(ctx, static_cast<VirtualAddr>(wa));
+
+                        break;
+                    }
+                    case Syscall::ReadInts:
+                    {
+                        VirtualAddr vaddr = regs[RegIndex::a0];
+                        uint64_t end = uint64_t(vaddr) + uint64_t(regs[RegIndex::a1]) * 4;
+
+                        if (end == vaddr || (vaddr % 4) != 0 || end - 1 > UINT32_MAX
+                            || !ctx.mm->isValidAddrRange(vaddr, static_cast<VirtualAddr>(end - 1)))
+                            break;
+
+                        for (uint64_t wa = vaddr; wa < end && in_step; wa += 4)
+                            saveWord(ctx, static_cast<VirtualAddr>(wa));
+
+                        break;
+                    }
+                    case Syscall::Sbrk:
+                        push({Kind::Brk, 0, ctx.mm->heapBreak()});
+                        break;
+
+                    default:
+                        break;
+                }
+
+                // Plugins may write any register
+                saveRegs(ctx);
+                break;
+
+            default:
+                saveRegs(ctx);
+                break;
+        }
+    }
+
+    void ExecHistory::endStep(const RuntimeContext& ctx)
+    {
+        if (diff_regs && in_step)
+        {
+            // Lo and Hi included, the PC is kept by the step record
+            for (uint32_t i = 1; i < std::size(shadow); i++)
+            {
+                if (ctx.reg_file[i] != shadow[i])
+                    push({Kind::Reg, i, shadow[i]});
+            }
+        }
+        in_step = false;
+    }
+
+    size_t ExecHistory::undo(RuntimeContext& ctx, size_t n)
+    {
+        size_t done = 0;
+
+        while (done < n && past_steps > 0)
+        {
+            for (;;)
+            {
+                Record& rec = at(--past);
+
+                if (rec.kind == Kind::Step)
+                {
+                    // Remembers where the instruction left the PC, for redo
+                    rec.value = ctx.getPC();
+                    ctx.setPC(rec.addr);
+                    break;
+                }
+                swap(ctx, rec);
+            }
+            past_steps--;
+            done++;
+        }
+
+        return done;
+    }
+
+    size_t ExecHistory::redo(RuntimeContext& ctx, size_t n)
+    {
+        size_t done = 0;
+
+        while (done < n && past_steps < total_steps)
+        {
+            ctx.setPC(at(past++).value);
+
+            while (past < count && at(past).kind != Kind::Step)
+                swap(ctx, at(past++));
+
+            past_steps++;
+            done++;
+        }
+
+        return done;
+    }
+
+    bool ExecHistory::rewind(RuntimeContext& ctx, VirtualAddr pc)
+    {
+        size_t steps = 0;
+
+        for (size_t i = past; i > 0; i--)
+        {
+            const Record& rec = at(i - 1);
+
+            if (rec.kind != Kind::Step)
+                continue;
+
+            steps++;
+            if (rec.addr == pc)
+            {
+                undo(ctx, steps);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Drops an eighth of the ring at once, so a full ring doesn't pay for
+    // it on every instruction
+    void ExecHistory::makeRoom()
+    {
+        size_t n = 0;
+        size_t steps = 0;
+
+        // Whole instructions only, the current one is kept
+        while (n < step_start && (n < capacity / 8 || at(n).kind != Kind::Step))
+        {
+            steps += (at(n).kind == Kind::Step);
+            n++;
+        }
+
+        if (n == 0)
+        {
+            // The current instruction alone doesn't fit
+            first = 0;
+            count = past = 0;
+            total_steps = past_steps = 0;
+            in_step = false;
+            return;
+        }
+
+        first = (first + n) & (capacity - 1);
+        count -= n;
+        past -= n;
+        step_start -= n;
+        total_steps -= steps;
+        past_steps -= steps;
+    }
+
+    void ExecHistory::saveReg(const RuntimeContext& ctx, uint32_t index)
+    {
+        push({Kind::Reg, index, ctx.reg_file[index]});
+    }
+
+    // The registers that changed are only known once the step has run
+    void ExecHistory::saveRegs(const RuntimeContext& ctx)
+    {
+        for (size_t i = 0; i < std::size(shadow); i++)
+            shadow[i] = ctx.reg_file[i];
+
+        diff_regs = true;
+    }
+
+    void ExecHistory::saveWord(RuntimeContext& ctx, VirtualAddr vaddr)
+    {
+        uint32_t *word = ctx.mm->hostPtr<uint32_t>(vaddr & ~3u);
+
+        // A store to an invalid address fails without writing anything
+        if (word != nullptr)
+            push({Kind::Mem, vaddr & ~3u, *word});
+    }
+
+    void ExecHistory::swap(RuntimeContext& ctx, Record& rec)
+    {
+        switch (rec.kind)
+        {
+            case Kind::Reg:
+            {
+                uint32_t val = ctx.reg_file[rec.addr];
+
+                ctx.reg_file.setReg(rec.addr, rec.value);
+                rec.value = val;
+                break;
+            }
+            case Kind::Mem:
+            {
+                uint32_t *word = ctx.mm->hostPtr<uint32_t, MemAccess::Write>(rec.addr);
+
+                if (word != nullptr)
+                    std::swap(*word, rec.value);
+                break;
+            }
+            case Kind::Brk:
+            {
+                VirtualAddr brk = ctx.mm->heapBreak();
+
+                ctx.mm->setHeapBreak(rec.value);
+                rec.value = brk;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+} // namespace Mips32
@@ -0,0 +1,670 @@
+#include "mips32_interp.h"
+#include "mips32_assembler.h"
+#include "mips32_encoding.h"
+#include "num_convert.h"
+#include "colorizer.h"
+
+namespace Mips32
+{
+    bool isBlockEnd(Opcode opc)
+    {
+        switch (opc)
+        {
+            case Opcode::Beq: case Opcode::Bne: case Opcode::Beqz: case Opcode::Bnez:
+            case Opcode::Bltz: case Opcode::Bgez: case Opcode::Blez: case Opcode::Bgtz:
+            case Opcode::J: case Opcode::Jal: case Opcode::Jr: case Opcode::Jalr:
+            case Opcode::Syscall: case Opcode::Break: case Opcode::Lwc1: case Opcode::Swc1:
+            case Opcode::Task:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    bool hasStaticTarget(Opcode opc)
+    {
+        switch (opc)
+        {
+            case Opcode::Beq: case Opcode::Bne: case Opcode::Beqz: case Opcode::Bnez:
+            case Opcode::Bltz: case Opcode::Bgez: case Opcode::Blez: case Opcode::Bgtz:
+            case Opcode::J: case Opcode::Jal:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    static Opcode fusedOpcode(const DecodedInst& di1, const DecodedInst& di2)
+    {
+        if (di1.opc == Opcode::Lui && di2.opc == Opcode::Ori
+            && di2.rs == di1.rt && di2.rt == di1.rt)
+            return Opcode::LuiOri;
+
+        if (di1.opc == Opcode::Addiu && di2.opc == Opcode::Bne)
+            return Opcode::AddiuBne;
+
+        if (di1.opc == Opcode::Slt && di2.opc == Opcode::Beq)
+            return Opcode::SltBeq;
+
+        if (di1.opc == Opcode::Slt && di2.opc == Opcode::Bne)
+            return Opcode::SltBne;
+
+        return Opcode::Task;
+    }
+
+    Interpreter::Interpreter(const VmOperationVector& action_v)
+    : action_v(action_v), block_at(action_v.size(), NoBlock), fault_idx(0)
+    {
+        code_v.reserve(action_v.size());
+        task_v.reserve(action_v.size());
+
+        for (const auto& act : action_v)
+        {
+            if (act.dinst)
+                code_v.push_back(*act.dinst);
+            else
+                code_v.push_back({Opcode::Task, 0, 0, 0, 0});
+
+            task_v.push_back(&act.task);
+        }
+    }
+
+    void Interpreter::loadText(MemoryManager& mm)
+    {
+        const std::vector<uint32_t>& text = mm.textWords();
+
+        if (text.size() != code_v.size())
+            return;
+
+        mm.takeTextDirty();
+        words = text;
+        for (size_t i = 0; i < words.size(); i++)
+            decodeSlot(i, words[i], false);
+
+        flushBlocks();
+    }
+
+    // Operations without an encoding are in the text as pseudo words, they
+    // run the same as before. Instructions the program wrote get a task of
+    // their own for the slow path.
+    void Interpreter::decodeSlot(size_t idx, uint32_t word, bool rewritten)
+    {
+        if (isPseudoWord(word) && pseudoIndex(word) < action_v.size())
+        {
+            const VmOperation& act = action_v[pseudoIndex(word)];
+
+            code_v[idx] = act.dinst.value_or(DecodedInst{Opcode::Task, 0, 0, 0, 0});
+            task_v[idx] = &act.task;
+            return;
+        }
+
+        std::optional<DecodedInst> di = decodeWord(word, 0x400000 + idx * 4);
+
+        if (di && !rewritten)
+        {
+            code_v[idx] = *di;
+            task_v[idx] = &action_v[idx].task;
+            return;
+        }
+
+        if (slot_tasks.empty())
+            slot_tasks.resize(code_v.size());
+
+        if (di)
+        {
+            code_v[idx] = *di;
+            slot_tasks[idx] = Assembler::compileInst(di->opc, Assembler::instArgs(*di));
+        }
+        else
+        {
+            code_v[idx] = {Opcode::Task, 0, 0, 0, 0};
+            slot_tasks[idx] = [word](RuntimeContext& ctx)
+            {
+                ctx.last_error = EAsm::Error("Invalid instruction word ",
+                                             cboldText(fcolor::red, Cvt::hexVal(word)), '\n');
+                return ErrorCode::UnsupportedInst;
+            };
+        }
+        task_v[idx] = &slot_tasks[idx];
+    }
+
+    // Returns true if a word written since the last call is different
+    bool Interpreter::updateText(MemoryManager& mm)
+    {
+        const std::vector<uint32_t>& text = mm.textWords();
+        bool changed = false;
+
+        for (uint32_t idx : mm.takeTextDirty())
+        {
+            if (idx < words.size() && text[idx] != words[idx])
+            {
+                words[idx] = text[idx];
+                decodeSlot(idx, words[idx], true);
+                changed = true;
+            }
+        }
+
+        if (changed)
+            flushBlocks();
+
+        return changed;
+    }
+
+    void Interpreter::flushBlocks()
+    {
+        blocks.clear();
+        ops.clear();
+        op_index.clear();
+        std::fill(block_at.begin(), block_at.end(), NoBlock);
+    }
+
+    uint32_t Interpreter::blockAt(size_t idx)
+    {
+        if (block_at[idx] == NoBlock)
+            block_at[idx] = buildBlock(idx);
+
+        return block_at[idx];
+    }
+
+    uint32_t Interpreter::buildBlock(size_t idx)
+    {
+        Block blk;
+
+        blk.start = idx;
+        blk.first_op = ops.size();
+        blk.taken_pc = 0;
+        blk.next_blk = NoBlock;
+        blk.taken_blk = NoBlock;
+
+        size_t i = idx;
+        while (i < code_v.size())
+        {
+            const DecodedInst& di = code_v[i];
+            Opcode fused = (i + 1 < code_v.size())? fusedOpcode(di, code_v[i + 1]) : Opcode::Task;
+
+            if (fused == Opcode::LuiOri)
+            {
+                ops.push_back({Opcode::LuiOri, 0, 0, di.rt, di.imm | code_v[i + 1].imm});
+                op_index.push_back(i + 1);
+                i += 2;
+                continue;
+            }
+            if (fused != Opcode::Task)
+            {
+                // The branch keeps its own slot right after the fused op
+                DecodedInst fdi = di;
+                fdi.opc = fused;
+
+                ops.push_back(fdi);
+                ops.push_back(code_v[i + 1]);
+                op_index.push_back(i);
+                op_index.push_back(i + 1);
+                blk.taken_pc = code_v[i + 1].imm;
+                i += 2;
+                break;
+            }
+
+            ops.push_back(di);
+            op_index.push_back(i);
+            i++;
+
+            if (isBlockEnd(di.opc))
+            {
+                if (hasStaticTarget(di.opc))
+                    blk.taken_pc = di.imm;
+                break;
+            }
+        }
+
+        blk.inst_count = i - idx;
+        blk.op_count = ops.size() - blk.first_op;
+        blk.next_pc = 0x400000 + i * 4;
+        blocks.push_back(blk);
+
+        return blocks.size() - 1;
+    }
+
+    ErrorCode Interpreter::run(RuntimeContext& ctx, size_t& inst_count)
+    {
+        uint32_t *regs = ctx.reg_file.getRegArray();
+        MemoryManager *mm = ctx.mm;
+        const size_t count = code_v.size();
+        const VirtualAddr last_pc = 0x400000 + count * 4;
+        VirtualAddr pc = ctx.getPC();
+        size_t idx = static_cast<VirtualAddr>(pc - 0x400000) / 4;
+        ErrorCode ecode;
+
+        if (idx >= count)
+        {
+            fault_idx = idx;
+            return ErrorCode::InstAddrOutOfRange;
+        }
+
+        if (mm->textDirty())
+            updateText(*mm);
+
+        uint32_t bid = blockAt(idx);
+
+        while (true)
+        {
+            const Block& blk = blocks[bid];
+            const DecodedInst *op = ops.data() + blk.first_op;
+            const DecodedInst *op_end = op + blk.op_count;
+
+            inst_count += blk.inst_count;
+            pc = blk.next_pc;
+
+            for (; op != op_end; op++)
+            {
+                switch (op->opc)
+                {
+                    case Opcode::Add:
+                    {
+                        uint32_t rd1 = regs[op->rs];
+                        uint32_t rd2 = regs[op->rt];
+                        uint32_t sum = rd1 + rd2;
+
+                        if (!((rd1 ^ rd2) & 0x80000000) && ((rd1 ^ sum) & 0x80000000))
+                            goto slow_path;
+
+                        regs[op->rd] = sum;
+                        break;
+                    }
+                    case Opcode::Addi:
+                    {
+                        uint32_t rd1 = regs[op->rs];
+                        uint32_t sum = rd1 + op->imm;
+
+                        if (!((rd1 ^ op->imm) & 0x80000000) && ((rd1 ^ sum) & 0x80000000))
+                            goto slow_path;
+
+                        regs[op->rt] = sum;
+                        break;
+                    }
+                    case Opcode::Sub:
+                    {
+                        uint32_t rd1 = regs[op->rs];
+                        uint32_t rd2 = regs[op->rt];
+                        uint32_t diff = rd1 - rd2;
+
+                        if ((rd1 ^ rd2) & (rd1 ^ diff) & 0x80000000)
+                            goto slow_path;
+
+                        regs[op->rd] = diff;
+                        break;
+                    }
+                    case Opcode::Addu:
+                        regs[op->rd] = regs[op->rs] + regs[op->rt];
+                        break;
+                    case Opcode::Subu:
+                        regs[op->rd] = regs[op->rs] - regs[op->rt];
+                        break;
+                    case Opcode::Addiu:
+                        regs[op->rt] = regs[op->rs] + op->imm;
+                        break;
+                    case Opcode::And:
+                        regs[op->rd] = regs[op->rs] & regs[op->rt];
+                        break;
+                    case Opcode::Or:
+                        regs[op->rd] = regs[op->rs] | regs[op->rt];
+                        break;
+                    case Opcode::Nor:
+                        regs[op->rd] = ~(regs[op->rs] | regs[op->rt]);
+                        break;
+                    case Opcode::Xor:
+                        regs[op->rd] = regs[op->rs] ^ regs[op->rt];
+                        break;
+                    case Opcode::Andi:
+                        regs[op->rt] = regs[op->rs] & op->imm;
+                        break;
+                    case Opcode::Ori:
+                        regs[op->rt] = regs[op->rs] | op->imm;
+                        break;
+                    case Opcode::Xori:
+                        regs[op->rt] = regs[op->rs] ^ op->imm;
+                        break;
+                    case Opcode::Slt:
+                        regs[op->rd] = static_cast<int32_t>(regs[op->rs]) < static_cast<int32_t>(regs[op->rt]);
+                        break;
+                    case Opcode::Sltu:
+                        regs[op->rd] = regs[op->rs] < regs[op->rt];
+                        break;
+                    case Opcode::Slti:
+                        regs[op->rt] = static_cast<int32_t>(regs[op->rs]) < static_cast<int32_t>(op->imm);
+                        break;
+                    case Opcode::Sltiu:
+                        regs[op->rt] = regs[op->rs] < op->imm;
+                        break;
+                    case Opcode::Sll:
+                        regs[op->rd] = regs[op->rt] << op->imm;
+                        break;
+                    case Opcode::Srl:
+                        regs[op->rd] = regs[op->rt] >> op->imm;
+                        break;
+                    case Opcode::Sra:
+                        regs[op->rd] = static_cast<int32_t>(regs[op->rt]) >> op->imm;
+                        break;
+                    case Opcode::Sllv:
+                        regs[op->rd] = regs[op->rt] << (regs[op->rs] & 0x1f);
+                        break;
+                    case Opcode::Srlv:
+                        regs[op->rd] = regs[op->rt] >> (regs[op->rs] & 0x1f);
+                        break;
+                    case Opcode::Srav:
+                        regs[op->rd] = static_cast<int32_t>(regs[op->rt]) >> (regs[op->rs] & 0x1f);
+                        break;
+                    case Opcode::Lui:
+                    case Opcode::Li:
+                    case Opcode::La:
+                        regs[op->rt] = op->imm;
+                        break;
+                    case Opcode::Move:
+                        regs[op->rd] = regs[op->rs];
+                        break;
+                    case Opcode::Mult:
+                    {
+                        int64_t m = extend_cast<int32_t, int64_t>(regs[op->rs])
+                                    * extend_cast<int32_t, int64_t>(regs[op->rt]);
+
+                        regs[RegIndex::Lo] = m & 0xffffffff;
+                        regs[RegIndex::Hi] = (m >> 32) & 0xffffffff;
+                        break;
+                    }
+                    case Opcode::Multu:
+                    {
+                        uint64_t m = static_cast<uint64_t>(regs[op->rs])
+                                     * static_cast<uint64_t>(regs[op->rt]);
+
+                        regs[RegIndex::Lo] = m & 0xffffffff;
+                        regs[RegIndex::Hi] = m >> 32;
+                        break;
+                    }
+                    case Opcode::Div:
+                    {
+                        int32_t divisor = static_cast<int32_t>(regs[op->rt]);
+
+                        if (divisor != 0)
+                        {
+                            int32_t dividend = static_cast<int32_t>(regs[op->rs]);
+
+                            if (dividend == INT32_MIN && divisor == -1)
+                            {
+                                regs[RegIndex::Lo] = static_cast<uint32_t>(INT32_MIN);
+                                regs[RegIndex::Hi] = 0;
+                            }
+                            else
+                            {
+                                regs[RegIndex::Lo] = dividend / divisor;
+                                regs[RegIndex::Hi] = dividend % divisor;
+                            }
+                        }
+                        break;
+                    }
+                    case Opcode::Divu:
+                    {
+                        uint32_t divisor = regs[op->rt];
+
+                        if (divisor != 0)
+                        {
+                            regs[RegIndex::Lo] = regs[op->rs] / divisor;
+                            regs[RegIndex::Hi] = regs[op->rs] % divisor;
+                        }
+                        break;
+                    }
+                    case Opcode::Mfhi:
+                        regs[op->rd] = regs[RegIndex::Hi];
+                        break;
+                    case Opcode::Mflo:
+                        regs[op->rd] = regs[RegIndex::Lo];
+                        break;
+                    case Opcode::Mthi:
+                        regs[RegIndex::Hi] = regs[op->rs];
+                        break;
+                    case Opcode::Mtlo:
+                        regs[RegIndex::Lo] = regs[op->rs];
+                        break;
+                    case Opcode::Beq:
+                        if (regs[op->rs] == regs[op->rt])
+                            pc = op->imm;
+                        break;
+                    case Opcode::Bne:
+                        if (regs[op->rs] != regs[op->rt])
+                            pc = op->imm;
+                        break;
+                    case Opcode::Beqz:
+                        if (regs[op->rs] == 0)
+                            pc = op->imm;
+                        break;
+                    case Opcode::Bnez:
+                        if (regs[op->rs] != 0)
+                            pc = op->imm;
+                        break;
+                    case Opcode::Bltz:
+                        if (static_cast<int32_t>(regs[op->rs]) < 0)
+                            pc = op->imm;
+                        break;
+                    case Opcode::Bgez:
+                        if (static_cast<int32_t>(regs[op->rs]) >= 0)
+                            pc = op->imm;
+                        break;
+                    case Opcode::Blez:
+                        if (static_cast<int32_t>(regs[op->rs]) <= 0)
+                            pc = op->imm;
+                        break;
+                    case Opcode::Bgtz:
+                        if (static_cast<int32_t>(regs[op->rs]) > 0)
+                            pc = op->imm;
+                        break;
+                    case Opcode::J:
+                        pc = op->imm;
+                        break;
+                    case Opcode::Jal:
+                        regs[RegIndex::Ra] = pc;
+                        pc = op->imm;
+                        break;
+                    case Opcode::Jr:
+                        pc = regs[op->rs];
+                        break;
+                    case Opcode::Jalr:
+                        regs[RegIndex::Ra] = pc;
+                        pc = regs[op->rs];
+                        break;
+                    case Opcode::Lw:
+                    {
+                        VirtualAddr vaddr = regs[op->rs] + op->imm;
+                        uint32_t *p = ((vaddr % 4) == 0)? mm->hostPtr<uint32_t, MemAccess::Read>(vaddr) : nullptr;
+
+                        if (p == nullptr)
+                            goto slow_path;
+
+                        regs[op->rt] = *p;
+                        break;
+                    }
+                    case Opcode::Lh:
+                    {
+                        VirtualAddr vaddr = regs[op->rs] + op->imm;
+                        int16_t *p = ((vaddr % 2) == 0)? mm->hostPtr<int16_t, MemAccess::Read>(vaddr) : nullptr;
+
+                        if (p == nullptr)
+                            goto slow_path;
+
+                        regs[op->rt] = static_cast<int32_t>(*p);
+                        break;
+                    }
+                    case Opcode::Lhu:
+                    {
+                        VirtualAddr vaddr = regs[op->rs] + op->imm;
+                        uint16_t *p = ((vaddr % 2) == 0)? mm->hostPtr<uint16_t, MemAccess::Read>(vaddr) : nullptr;
+
+                        if (p == nullptr)
+                            goto slow_path;
+
+                        regs[op->rt] = *p;
+                        break;
+                    }
+                    case Opcode::Lb:
+                    {
+                        VirtualAddr vaddr = regs[op->rs] + op->imm;
+                        int8_t *p = mm->hostPtr<int8_t, MemAccess::Read>(vaddr);
+
+                        if (p == nullptr)
+                            goto slow_path;
+
+                        regs[op->rt] = static_cast<int32_t>(*p);
+                        break;
+                    }
+                    case Opcode::Lbu:
+                    {
+                        VirtualAddr vaddr = regs[op->rs] + op->imm;
+                        uint8_t *p = mm->hostPtr<uint8_t, MemAccess::Read>(vaddr);
+
+                        if (p == nullptr)
+                            goto slow_path;
+
+                        regs[op->rt] = *p;
+                        break;
+                    }
+                    case Opcode::Sw:
+                    {
+                        VirtualAddr vaddr = regs[op->rs] + op->imm;
+                        uint32_t *p = ((vaddr % 4) == 0)? mm->hostPtr<uint32_t, MemAccess::Write>(vaddr) : nullptr;
+
+                        if (p == nullptr)
+                            goto slow_path;
+
+                        *p = regs[op->rt];
+                        break;
+                    }
+                    case Opcode::Sh:
+                    {
+                        VirtualAddr vaddr = regs[op->rs] + op->imm;
+                        uint16_t *p = ((vaddr % 2) == 0)? mm->hostPtr<uint16_t, MemAccess::Write>(vaddr) : nullptr;
+
+                        if (p == nullptr)
+                            goto slow_path;
+
+                        *p = static_cast<uint16_t>(regs[op->rt]);
+                        break;
+                    }
+                    case Opcode::Sb:
+                    {
+                        VirtualAddr vaddr = regs[op->rs] + op->imm;
+                        uint8_t *p = mm->hostPtr<uint8_t, MemAccess::Write>(vaddr);
+
+                        if (p == nullptr)
+                            goto slow_path;
+
+                        *p = static_cast<uint8_t>(regs[op->rt]);
+                        break;
+                    }
+                    case Opcode::Nop:
+                        break;
+                    case Opcode::LuiOri:
+                        regs[op->rt] = op->imm;
+                        break;
+                    case Opcode::AddiuBne:
+                        regs[op->rt] = regs[op->rs] + op->imm;
+                        regs[RegIndex::Zero] = 0;
+                        op++;
+                        if (regs[op->rs] != regs[op->rt])
+                            pc = op->imm;
+                        break;
+                    case Opcode::SltBeq:
+                        regs[op->rd] = static_cast<int32_t>(regs[op->rs]) < static_cast<int32_t>(regs[op->rt]);
+                        regs[RegIndex::Zero] = 0;
+                        op++;
+                        if (regs[op->rs] == regs[op->rt])
+                            pc = op->imm;
+                        break;
+                    case Opcode::SltBne:
+                        regs[op->rd] = static_cast<int32_t>(regs[op->rs]) < static_cast<int32_t>(regs[op->rt]);
+                        regs[RegIndex::Zero] = 0;
+                        op++;
+                        if (regs[op->rs] != regs[op->rt])
+                            pc = op->imm;
+                        break;
+                    default:
+                        goto slow_path;
+                }
+
+                regs[RegIndex::Zero] = 0;
+                continue;
+
+            slow_path:
+                {
+                    // Syscalls, commands and faulting instructions run the original
+                    // task, which also takes care of building the error message
+                    size_t inst_idx = op_index[op - ops.data()];
+                    size_t skipped = blk.start + blk.inst_count - (inst_idx + 1);
+                    VirtualAddr next_pc = 0x400000 + (inst_idx + 1) * 4;
+                    const TaskFunction& task = *task_v[inst_idx];
+
+                    ctx.setPC(next_pc);
+
+                    if (task == nullptr)
+                    {
+                        inst_count -= skipped;
+                        fault_idx = inst_idx;
+                        return ErrorCode::Bug;
+                    }
+
+                    ecode = task(ctx);
+
+                    if (ecode != ErrorCode::Ok)
+                    {
+                        inst_count -= skipped;
+                        fault_idx = inst_idx;
+                        return ecode;
+                    }
+                    if (ctx.getPC() != next_pc)
+                    {
+                        inst_count -= skipped;
+                        pc = ctx.getPC();
+                        break;
+                    }
+                }
+            }
+
+            if (pc >= last_pc)
+                break;
+
+            uint32_t next_bid;
+
+            // A store to the text drops every block, blk included
+            bool text_changed = mm->textDirty() && updateText(*mm);
+
+            if (!text_changed && pc == blk.next_pc && blk.next_blk != NoBlock)
+                next_bid = blk.next_blk;
+            else if (!text_changed && pc == blk.taken_pc && blk.taken_blk != NoBlock)
+                next_bid = blk.taken_blk;
+            else
+            {
+                idx = static_cast<VirtualAddr>(pc - 0x400000) / 4;
+
+                if (idx >= count)
+                {
+                    ctx.setPC(pc);
+                    fault_idx = idx;
+                    return ErrorCode::InstAddrOutOfRange;
+                }
+
+                next_bid = blockAt(idx);
+
+                // blockAt() can grow the block vector, so blk is no longer valid
+                if (!text_changed)
+                {
+                    Block& prev = blocks[bid];
+                    if (pc == prev.next_pc)
+                        prev.next_blk = next_bid;
+                    else if (pc == prev.taken_pc)
+                        prev.taken_blk = next_bid;
+                }
+            }
+            bid = next_bid;
+        }
+
+        ctx.setPC(pc);
+        return ErrorCode::Ok;
+    }
+
+} // namespace Mips32
@@ -0,0 +1,851 @@
+#include <cstring>
+#include <new>
+#include "mips32_jit.h"
+#include "mips32_assembler.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+    #define JIT_X86_64
+    #ifdef _WIN32
+        #include <windows.h>
+    #else
+        #include <sys/mman.h>
+        #include <unistd.h>
+    #endif
+#endif
+
+namespace Mips32
+{
+    static const size_t ChunkSize = 256 * 1024;
+
+    // Code pages are read/write while the code is written into them and
+    // read/execute while it runs, never writable and executable at once
+    static uint8_t *allocCode(size_t size)
+    {
+    #if defined(JIT_X86_64) && defined(_WIN32)
+        void *p = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+        return static_cast<uint8_t *>(p);
+    #elif defined(JIT_X86_64)
+        void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        return (p == MAP_FAILED)? nullptr : static_cast<uint8_t *>(p);
+    #else
+        (void)size;
+        return nullptr;
+    #endif
+    }
+
+    // Switches the pages holding [p, p + size) between writable and
+    // executable. Fails where the system doesn't allow code to be generated.
+    static bool protectCode(uint8_t *p, size_t size, bool exec)
+    {
+    #if defined(JIT_X86_64) && defined(_WIN32)
+        DWORD old_prot;
+
+        if (!VirtualProtect(p, size, exec? PAGE_EXECUTE_READ : PAGE_READWRITE, &old_prot))
+            return false;
+
+        if (exec)
+            FlushInstructionCache(GetCurrentProcess(), p, size);
+
+        return true;
+    #elif defined(JIT_X86_64)
+        uintptr_t page_size = sysconf(_SC_PAGESIZE);
+        uintptr_t start = reinterpret_cast<uintptr_t>(p) & ~(page_size - 1);
+        uintptr_t end = reinterpret_cast<uintptr_t>(p) + size;
+
+        return mprotect(reinterpret_cast<void *>(start), end - start,
+                        exec? (PROT_READ | PROT_EXEC) : (PROT_READ | PROT_WRITE)) == 0;
+    #else
+        (void)p;
+        (void)size;
+        (void)exec;
+        return false;
+    #endif
+    }
+
+    static void freeCode(uint8_t *p, size_t size)
+    {
+    #if defined(JIT_X86_64) && defined(_WIN32)
+        (void)size;
+        VirtualFree(p, 0, MEM_RELEASE);
+    #elif defined(JIT_X86_64)
+        munmap(p, size);
+    #else
+        (void)p;
+        (void)size;
+    #endif
+    }
+
+    // Minimal x86-64 encoder. The generated code keeps the guest register
+    // array in rbx and the guest memory in r12, eax/ecx/edx are scratch.
+    class X64Emitter
+    {
+    public:
+        enum Reg { Eax = 0, Ecx = 1, Edx = 2 };
+
+        // Condition codes, as used by jcc/setcc/cmovcc
+        enum Cond
+        {
+            O = 0x0, B = 0x2, AE = 0x3, E = 0x4, NE = 0x5, BE = 0x6, A = 0x7,
+            L = 0xc, GE = 0xd, LE = 0xe, G = 0xf
+        };
+
+        // Opcodes of the 'op r32, r/m32' and 'op eax, imm32' forms
+        enum AluOp
+        {
+            Add = 0x03, Or = 0x0b, And = 0x23, Sub = 0x2b, Xor = 0x33, Cmp = 0x3b
+        };
+
+        const std::vector<uint8_t>& code() const
+        { return buf; }
+
+        size_t pos() const
+        { return buf.size(); }
+
+        void prologue()
+        {
+            emit(0x53);                 // push rbx
+            emit(0x41, 0x54);           // push r12
+            emit(0x41, 0x55);           // push r13
+        #ifdef _WIN32
+            emit(0x48, 0x89, 0xcb);     // mov rbx, rcx
+            emit(0x49, 0x89, 0xd4);     // mov r12, rdx
+            emit(0x4d, 0x89, 0xc5);     // mov r13, r8
+        #else
+            emit(0x48, 0x89, 0xfb);     // mov rbx, rdi
+            emit(0x49, 0x89, 0xf4);     // mov r12, rsi
+            emit(0x49, 0x89, 0xd5);     // mov r13, rdx
+        #endif
+        }
+
+        void epilogue()
+        {
+            emit(0x41, 0x5d);           // pop r13
+            emit(0x41, 0x5c);           // pop r12
+            emit(0x5b);                 // pop rbx
+            emit(0xc3);                 // ret
+        }
+
+        // Leaves the block returning 'value'
+        void exitWith(uint64_t value)
+        {
+            movRaxImm(value);
+            epilogue();
+        }
+
+        // mov r32, [rbx + 4*greg]
+        void load(Reg r, unsigned greg)
+        { regMem(0x8b, r, greg); }
+
+        // mov [rbx + 4*greg], r32. Writes to $zero are dropped
+        void store(unsigned greg, Reg r)
+        {
+            if (greg != RegIndex::Zero)
+                regMem(0x89, r, greg);
+        }
+
+        // mov dword [rbx + 4*greg], imm32
+        void storeImm(unsigned greg, uint32_t imm)
+        {
+            if (greg != RegIndex::Zero)
+            {
+                regMem(0xc7, 0, greg);
+                emit32(imm);
+            }
+        }
+
+        // op eax, [rbx + 4*greg]
+        void alu(AluOp op, unsigned greg)
+        { regMem(op, Eax, greg); }
+
+        // op eax, imm32
+        void aluImm(AluOp op, uint32_t imm)
+        {
+            emit(op + 2);
+            emit32(imm);
+        }
+
+        void notEax()
+        { emit(0xf7, 0xd0); }
+
+        void testEax()
+        { emit(0x85, 0xc0); }
+
+        void setcc(Cond cc)
+        {
+            emit(0x0f, 0x90 | cc, 0xc0);    // setcc al
+            emit(0x0f, 0xb6, 0xc0);         // movzx eax, al
+        }
+
+        // ext is the /digit of the shift group: 4 = shl, 5 = shr, 7 = sar
+        void shiftImm(unsigned ext, uint8_t amount)
+        { emit(0xc1, 0xc0 | (ext << 3), amount); }
+
+        void shiftCl(unsigned ext)
+        { emit(0xd3, 0xc0 | (ext << 3)); }
+
+        // ext is the /digit of the F7 group: 4 = mul, 5 = imul, 6 = div, 7 = idiv
+        void mulDivMem(unsigned ext, unsigned greg)
+        { regMem(0xf7, ext, greg); }
+
+        void mulDivEcx(unsigned ext)
+        { emit(0xf7, 0xc0 | (ext << 3) | Ecx); }
+
+        void cdq()
+        { emit(0x99); }
+
+        void zeroEdx()
+        { emit(0x31, 0xd2); }
+
+        void testEcx()
+        { emit(0x85, 0xc9); }
+
+        void cmpEcxImm(uint32_t imm)
+        {
+            emit(0x81, 0xf9);
+            emit32(imm);
+        }
+
+        void subEcxImm(uint32_t imm)
+        {
+            emit(0x81, 0xe9);
+            emit32(imm);
+        }
+
+        void addEcxImm(uint32_t imm)
+        {
+            emit(0x81, 0xc1);
+            emit32(imm);
+        }
+
+        // cmp ecx, [r13]
+        void cmpEcxHeapSize()
+        { emit(0x41, 0x3b, 0x4d, 0x00); }
+
+        void xorEcxImm8(uint8_t imm)
+        { emit(0x83, 0xf1, imm); }
+
+        void movEcxEax()
+        { emit(0x89, 0xc1); }
+
+        void testAlImm(uint8_t imm)
+        { emit(0xa8, imm); }
+
+        void movRaxImm(uint64_t imm)
+        {
+            emit(0x48, 0xb8);
+            emit64(imm);
+        }
+
+        void movRdxImm(uint64_t imm)
+        {
+            emit(0x48, 0xba);
+            emit64(imm);
+        }
+
+        void orRaxRdx()
+        { emit(0x48, 0x09, 0xd0); }
+
+        void cmovRaxRdx(Cond cc)
+        { emit(0x48, 0x0f, 0x40 | cc, 0xc2); }
+
+        // Guest memory accesses, [r12 + rcx]
+        void loadMem(size_t size, bool sign_ext)
+        {
+            switch (size)
+            {
+                case 1: emit(0x41, 0x0f, sign_ext? 0xbe : 0xb6); break;
+                case 2: emit(0x41, 0x0f, sign_ext? 0xbf : 0xb7); break;
+                default: emit(0x41, 0x8b); break;
+            }
+            emit(0x04, 0x0c);
+        }
+
+        void storeMem(size_t size)
+        {
+            switch (size)
+            {
+                case 1: emit(0x41, 0x88); break;
+                case 2: emit(0x66, 0x41, 0x89); break;
+                default: emit(0x41, 0x89); break;
+            }
+            emit(0x04, 0x0c);
+        }
+
+        // Emits a jcc/jmp with a 32-bit displacement to be patched by bind()
+        size_t jcc(Cond cc)
+        {
+            emit(0x0f, 0x80 | cc);
+            emit32(0);
+            return pos();
+        }
+
+        size_t jmp()
+        {
+            emit(0xe9);
+            emit32(0);
+            return pos();
+        }
+
+        void bind(size_t label)
+        {
+            int32_t rel = static_cast<int32_t>(pos() - label);
+            std::memcpy(buf.data() + label - 4, &rel, 4);
+        }
+
+    private:
+        void regMem(uint8_t opc, unsigned reg, unsigned greg)
+        {
+            // mod = 10 (disp32), rm = rbx
+            emit(opc, 0x80 | (reg << 3) | 3);
+            emit32(greg * 4);
+        }
+
+        template <typename... T>
+        void emit(T... bytes)
+        { (buf.push_back(static_cast<uint8_t>(bytes)), ...); }
+
+        void emit32(uint32_t v)
+        {
+            for (int i = 0; i < 4; i++)
+                buf.push_back((v >> (i * 8)) & 0xff);
+        }
+
+        void emit64(uint64_t v)
+        {
+            emit32(v & 0xffffffff);
+            emit32(v >> 32);
+        }
+
+    private:
+        std::vector<uint8_t> buf;
+    };
+
+    static uint64_t normalExit(uint32_t count, VirtualAddr pc)
+    { return (static_cast<uint64_t>(count) << 32) | pc; }
+
+    static uint64_t sideExit(uint32_t count, VirtualAddr pc)
+    { return (1ull << 63) | normalExit(count, pc); }
+
+    static X64Emitter::Cond branchCond(Opcode opc)
+    {
+        switch (opc)
+        {
+            case Opcode::Beq: case Opcode::Beqz: return X64Emitter::E;
+            case Opcode::Bne: case Opcode::Bnez: return X64Emitter::NE;
+            case Opcode::Bltz: return X64Emitter::L;
+            case Opcode::Bgez: return X64Emitter::GE;
+            case Opcode::Blez: return X64Emitter::LE;
+            default: return X64Emitter::G;
+        }
+    }
+
+    JitEngine::JitEngine(const VmOperationVector& action_v, const MemoryMap& mmap)
+    : action_v(action_v), mmap(mmap), block_at(action_v.size(), NoBlock), fault_idx(0),
+      no_exec(false)
+    {
+        code_v.reserve(action_v.size());
+
+        for (const auto& act : action_v)
+        {
+            if (act.dinst)
+                code_v.push_back(*act.dinst);
+            else
+                code_v.push_back({Opcode::Task, 0, 0, 0, 0});
+        }
+
+        uint8_t *base = allocCode(ChunkSize);
+
+        // Generated code can't run if the pages can't be made executable
+        if (base != nullptr && protectCode(base, ChunkSize, true))
+            chunks.push_back({base, ChunkSize, 0});
+        else if (base != nullptr)
+            freeCode(base, ChunkSize);
+    }
+
+    JitEngine::~JitEngine()
+    {
+        for (auto& chunk : chunks)
+            freeCode(chunk.base, chunk.size);
+    }
+
+    uint32_t JitEngine::blockAt(size_t idx)
+    {
+        if (block_at[idx] == NoBlock)
+            block_at[idx] = buildBlock(idx);
+
+        return block_at[idx];
+    }
+
+    JitEngine::BlockFunction JitEngine::install(const std::vector<uint8_t>& code)
+    {
+        CodeChunk *chunk = &chunks.back();
+
+        if (chunk->size - chunk->used < code.size())
+        {
+            size_t size = std::max(ChunkSize, code.size());
+            uint8_t *base = allocCode(size);
+
+            if (base == nullptr)
+                throw std::bad_alloc();
+
+            chunks.push_back({base, size, 0});
+            chunk = &chunks.back();
+        }
+
+        uint8_t *p = chunk->base + chunk->used;
+
+        if (!protectCode(p, code.size(), false))
+            return nullptr;
+
+        std::memcpy(p, code.data(), code.size());
+
+        if (!protectCode(p, code.size(), true))
+            return nullptr;
+
+        chunk->used += (code.size() + 15) & ~size_t(15);
+
+        return reinterpret_cast<BlockFunction>(p);
+    }
+
+    uint32_t JitEngine::buildBlock(size_t idx)
+    {
+        using X = X64Emitter;
+
+        X64Emitter e;
+        std::vector<std::pair<size_t, uint64_t>> side_exits;
+        Block blk;
+        size_t i = idx;
+        bool ended = false;
+
+        blk.taken_pc = 0;
+        blk.next_blk = NoBlock;
+        blk.taken_blk = NoBlock;
+
+        // Leaves 'vaddr = regs[rs] + imm' translated to a host offset in rcx,
+        // or jumps to the side exit if it's misaligned or out of range
+        auto memAddr = [&](const DecodedInst& di, size_t size, uint64_t exit_value)
+        {
+            e.load(X::Eax, di.rs);
+            e.aluImm(X::Add, di.imm);
+
+            if (size > 1)
+            {
+                e.testAlImm(size - 1);
+                side_exits.push_back({e.jcc(X::NE), exit_value});
+            }
+
+            size_t found = 0;
+            size_t found_stk = 0;
+            if (mmap.gblSize() >= size)
+            {
+                e.movEcxEax();
+                e.subEcxImm(mmap.gblStartAddr());
+                e.cmpEcxImm(mmap.gblSize() - size);
+                found = e.jcc(X::BE);
+            }
+            if (mmap.stkSize() >= size)
+            {
+                e.movEcxEax();
+                e.subEcxImm(mmap.stkStartAddr());
+                e.cmpEcxImm(mmap.stkSize() - size);
+
+                if (mmap.heapLimit() > 0)
+                {
+                    size_t not_stk = e.jcc(X::A);
+
+                    e.addEcxImm(mmap.gblSize());
+                    found_stk = e.jmp();
+                    e.bind(not_stk);
+                }
+                else
+                {
+                    side_exits.push_back({e.jcc(X::A), exit_value});
+                    e.addEcxImm(mmap.gblSize());
+                }
+            }
+            if (mmap.heapLimit() > 0)
+            {
+                // The heap size changes with sbrk, it's read from memory.
+                // It is a whole number of pages, so an aligned access below
+                // it fits in the heap.
+                e.movEcxEax();
+                e.subEcxImm(mmap.heapStartAddr());
+                e.cmpEcxHeapSize();
+                side_exits.push_back({e.jcc(X::AE), exit_value});
+                e.addEcxImm(mmap.gblSize() + mmap.stkSize());
+            }
+            else if (mmap.stkSize() < size)
+                side_exits.push_back({e.jmp(), exit_value});
+
+            if (found != 0)
+                e.bind(found);
+            if (found_stk != 0)
+                e.bind(found_stk);
+
+            // Words are stored in host order, see MemIterator
+            if (size == 1)
+                e.xorEcxImm8(3);
+            else if (size == 2)
+                e.xorEcxImm8(2);
+        };
+
+        e.prologue();
+
+        while (i < code_v.size() && !ended)
+        {
+            const DecodedInst& di = code_v[i];
+            uint32_t done = i - idx;
+            VirtualAddr pc = 0x400000 + i * 4;
+            VirtualAddr next_pc = pc + 4;
+            uint64_t exit_here = sideExit(done, pc);
+
+            i++;
+            ended = isBlockEnd(di.opc);
+
+            switch (di.opc)
+            {
+                case Opcode::Add:
+                case Opcode::Sub:
+                    e.load(X::Eax, di.rs);
+                    e.alu((di.opc == Opcode::Add)? X::Add : X::Sub, di.rt);
+                    side_exits.push_back({e.jcc(X::O), exit_here});
+                    e.store(di.rd, X::Eax);
+                    break;
+                case Opcode::Addi:
+                    e.load(X::Eax, di.rs);
+                    e.aluImm(X::Add, di.imm);
+                    side_exits.push_back({e.jcc(X::O), exit_here});
+                    e.store(di.rt, X::Eax);
+                    break;
+                case Opcode::Addu:
+                case Opcode::Subu:
+                case Opcode::And:
+                case Opcode::Or:
+                case Opcode::Xor:
+                case Opcode::Nor:
+                {
+                    X::AluOp op = X::Add;
+
+                    if (di.opc == Opcode::Subu) op = X::Sub;
+                    else if (di.opc == Opcode::And) op = X::And;
+                    else if (di.opc == Opcode::Or || di.opc == Opcode::Nor) op = X::Or;
+                    else if (di.opc == Opcode::Xor) op = X::Xor;
+
+                    e.load(X::Eax, di.rs);
+                    e.alu(op, di.rt);
+                    if (di.opc == Opcode::Nor)
+                        e.notEax();
+                    e.store(di.rd, X::Eax);
+                    break;
+                }
+                case Opcode::Addiu:
+                case Opcode::Andi:
+                case Opcode::Ori:
+                case Opcode::Xori:
+                {
+                    X::AluOp op = X::Add;
+
+                    if (di.opc == Opcode::Andi) op = X::And;
+                    else if (di.opc == Opcode::Ori) op = X::Or;
+                    else if (di.opc == Opcode::Xori) op = X::Xor;
+
+                    e.load(X::Eax, di.rs);
+                    e.aluImm(op, di.imm);
+                    e.store(di.rt, X::Eax);
+                    break;
+                }
+                case Opcode::Slt:
+                case Opcode::Sltu:
+                    e.load(X::Eax, di.rs);
+                    e.alu(X::Cmp, di.rt);
+                    e.setcc((di.opc == Opcode::Slt)? X::L : X::B);
+                    e.store(di.rd, X::Eax);
+                    break;
+                case Opcode::Slti:
+                case Opcode::Sltiu:
+                    e.load(X::Eax, di.rs);
+                    e.aluImm(X::Cmp, di.imm);
+                    e.setcc((di.opc == Opcode::Slti)? X::L : X::B);
+                    e.store(di.rt, X::Eax);
+                    break;
+                case Opcode::Sll:
+                case Opcode::Srl:
+                case Opcode::Sra:
+                    e.load(X::Eax, di.rt);
+                    e.shiftImm((di.opc == Opcode::Sll)? 4 : (di.opc == Opcode::Srl)? 5 : 7, di.imm);
+                    e.store(di.rd, X::Eax);
+                    break;
+                case Opcode::Sllv:
+                case Opcode::Srlv:
+                case Opcode::Srav:
+                    e.load(X::Ecx, di.rs);
+                    e.load(X::Eax, di.rt);
+                    e.shiftCl((di.opc == Opcode::Sllv)? 4 : (di.opc == Opcode::Srlv)? 5 : 7);
+                    e.store(di.rd, X::Eax);
+                    break;
+                case Opcode::Lui:
+                case Opcode::Li:
+                case Opcode::La:
+                    e.storeImm(di.rt, di.imm);
+                    break;
+                case Opcode::Move:
+                    e.load(X::Eax, di.rs);
+                    e.store(di.rd, X::Eax);
+                    break;
+                case Opcode::Mult:
+                case Opcode::Multu:
+                    e.load(X::Eax, di.rs);
+                    e.mulDivMem((di.opc == Opcode::Mult)? 5 : 4, di.rt);
+                    e.store(RegIndex::Lo, X::Eax);
+                    e.store(RegIndex::Hi, X::Edx);
+                    break;
+                case Opcode::Div:
+                {
+                    e.load(X::Ecx, di.rt);
+                    e.testEcx();
+                    size_t by_zero = e.jcc(X::E);
+
+                    e.load(X::Eax, di.rs);
+                    e.cmpEcxImm(0xffffffff);
+                    size_t no_ovf1 = e.jcc(X::NE);
+                    e.aluImm(X::Cmp, 0x80000000);
+                    size_t no_ovf2 = e.jcc(X::NE);
+
+                    // INT32_MIN / -1 traps on x86
+                    e.store(RegIndex::Lo, X::Eax);
+                    e.storeImm(RegIndex::Hi, 0);
+                    size_t done_ovf = e.jmp();
+
+                    e.bind(no_ovf1);
+                    e.bind(no_ovf2);
+                    e.cdq();
+                    e.mulDivEcx(7);
+                    e.store(RegIndex::Lo, X::Eax);
+                    e.store(RegIndex::Hi, X::Edx);
+
+                    e.bind(by_zero);
+                    e.bind(done_ovf);
+                    break;
+                }
+                case Opcode::Divu:
+                {
+                    e.load(X::Ecx, di.rt);
+                    e.testEcx();
+                    size_t by_zero = e.jcc(X::E);
+
+                    e.load(X::Eax, di.rs);
+                    e.zeroEdx();
+                    e.mulDivEcx(6);
+                    e.store(RegIndex::Lo, X::Eax);
+                    e.store(RegIndex::Hi, X::Edx);
+
+                    e.bind(by_zero);
+                    break;
+                }
+                case Opcode::Mfhi:
+                case Opcode::Mflo:
+                    e.load(X::Eax, (di.opc == Opcode::Mfhi)? RegIndex::Hi : RegIndex::Lo);
+                    e.store(di.rd, X::Eax);
+                    break;
+                case Opcode::Mthi:
+                case Opcode::Mtlo:
+                    e.load(X::Eax, di.rs);
+                    e.store((di.opc == Opcode::Mthi)? RegIndex::Hi : RegIndex::Lo, X::Eax);
+                    break;
+                case Opcode::Lw:
+                case Opcode::Lh:
+                case Opcode::Lhu:
+                case Opcode::Lb:
+                case Opcode::Lbu:
+                {
+                    size_t size = (di.opc == Opcode::Lw)? 4 : (di.opc == Opcode::Lh || di.opc == Opcode::Lhu)? 2 : 1;
+
+                    memAddr(di, size, exit_here);
+                    e.loadMem(size, di.opc == Opcode::Lh || di.opc == Opcode::Lb);
+                    e.store(di.rt, X::Eax);
+                    break;
+                }
+                case Opcode::Sw:
+                case Opcode::Sh:
+                case Opcode::Sb:
+                {
+                    size_t size = (di.opc == Opcode::Sw)? 4 : (di.opc == Opcode::Sh)? 2 : 1;
+
+                    memAddr(di, size, exit_here);
+                    e.load(X::Eax, di.rt);
+                    e.storeMem(size);
+                    break;
+                }
+                case Opcode::Nop:
+                    break;
+                case Opcode::Beq:
+                case Opcode::Bne:
+                case Opcode::Beqz:
+                case Opcode::Bnez:
+                case Opcode::Bltz:
+                case Opcode::Bgez:
+                case Opcode::Blez:
+                case Opcode::Bgtz:
+                    e.load(X::Eax, di.rs);
+                    if (di.opc == Opcode::Beq || di.opc == Opcode::Bne)
+                        e.alu(X::Cmp, di.rt);
+                    else
+                        e.testEax();
+
+                    e.movRaxImm(normalExit(done + 1, next_pc));
+                    e.movRdxImm(normalExit(done + 1, di.imm));
+                    e.cmovRaxRdx(branchCond(di.opc));
+                    e.epilogue();
+                    blk.taken_pc = di.imm;
+                    break;
+                case Opcode::J:
+                case Opcode::Jal:
+                    if (di.opc == Opcode::Jal)
+                        e.storeImm(RegIndex::Ra, next_pc);
+
+                    e.exitWith(normalExit(done + 1, di.imm));
+                    blk.taken_pc = di.imm;
+                    break;
+                case Opcode::Jr:
+                case Opcode::Jalr:
+                    if (di.opc == Opcode::Jalr)
+                        e.storeImm(RegIndex::Ra, next_pc);
+
+                    e.load(X::Eax, di.rs);
+                    e.movRdxImm(normalExit(done + 1, 0));
+                    e.orRaxRdx();
+                    e.epilogue();
+                    break;
+                default:
+                    // Syscalls, commands and everything else run in the interpreter
+                    e.exitWith(exit_here);
+                    ended = true;
+                    break;
+            }
+        }
+
+        if (!ended)
+            e.exitWith(normalExit(i - idx, 0x400000 + i * 4));
+
+        for (const auto& se : side_exits)
+        {
+            e.bind(se.first);
+            e.exitWith(se.second);
+        }
+
+        blk.fn = install(e.code());
+        if (blk.fn == nullptr)
+        {
+            no_exec = true;
+            return NoBlock;
+        }
+        blk.next_pc = 0x400000 + i * 4;
+        blocks.push_back(blk);
+
+        return blocks.size() - 1;
+    }
+
+    ErrorCode JitEngine::run(RuntimeContext& ctx, size_t& inst_count)
+    {
+        uint32_t *regs = ctx.reg_file.getRegArray();
+        uint8_t *mem = ctx.mm->getMem();
+        const size_t *heap_size = ctx.mm->memMap().heapSizePtr();
+        const size_t count = code_v.size();
+        const VirtualAddr last_pc = 0x400000 + count * 4;
+        VirtualAddr pc = ctx.getPC();
+        size_t idx = static_cast<VirtualAddr>(pc - 0x400000) / 4;
+
+        if (idx >= count)
+        {
+            fault_idx = idx;
+            return ErrorCode::InstAddrOutOfRange;
+        }
+
+        uint32_t bid = blockAt(idx);
+
+        if (bid == NoBlock)
+        {
+            ctx.setPC(pc);
+            return ErrorCode::Ok;
+        }
+
+        while (true)
+        {
+            uint64_t ret = blocks[bid].fn(regs, mem, heap_size);
+
+            pc = static_cast<VirtualAddr>(ret);
+            inst_count += (ret >> 32) & 0x7fffffff;
+
+            if (ret >> 63)
+            {
+                size_t inst_idx = static_cast<VirtualAddr>(pc - 0x400000) / 4;
+                const TaskFunction& task = action_v[inst_idx].task;
+
+                ctx.setPC(pc + 4);
+
+                if (task == nullptr)
+                {
+                    inst_count++;
+                    fault_idx = inst_idx;
+                    return ErrorCode::Bug;
+                }
+
+                ErrorCode ecode = task(ctx);
+                inst_count++;
+
+                if (ecode != ErrorCode::Ok)
+                {
+                    fault_idx = inst_idx;
+                    return ecode;
+                }
+                regs[RegIndex::Zero] = 0;
+                pc = ctx.getPC();
+            }
+
+            if (pc >= last_pc)
+                break;
+
+            const Block& blk = blocks[bid];
+            uint32_t next_bid;
+
+            if (pc == blk.next_pc && blk.next_blk != NoBlock)
+                next_bid = blk.next_blk;
+            else if (pc == blk.taken_pc && blk.taken_blk != NoBlock)
+                next_bid = blk.taken_blk;
+            else
+            {
+                idx = static_cast<VirtualAddr>(pc - 0x400000) / 4;
+
+                if (idx >= count)
+                {
+                    ctx.setPC(pc);
+                    fault_idx = idx;
+                    return ErrorCode::InstAddrOutOfRange;
+                }
+
+                next_bid = blockAt(idx);
+
+                if (next_bid == NoBlock)
+                {
+                    ctx.setPC(pc);
+                    return ErrorCode::Ok;
+                }
+
+                // blockAt() can grow the block vector, so blk is no longer valid
+                Block& prev = blocks[bid];
+                if (pc == prev.next_pc)
+                    prev.next_blk = next_bid;
+                else if (pc == prev.taken_pc)
+                    prev.taken_blk = next_bid;
+            }
+            bid = next_bid;
+        }
+
+        ctx.setPC(pc);
+        return ErrorCode::Ok;
+    }
+
+} // namespace Mips32
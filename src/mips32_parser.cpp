@@ -35,6 +35,10 @@ command -> KWSHOW show_argument data_format?
 command -> KWSET cmd_arg OPEQUAL set_rvalue
 command -> KWEXEC STR_LITERAL
 command -> KWRESET
+command -> KWCHECKPOINT STR_LITERAL
+command -> KWUNDO constant?
+command -> KWREDO constant?
+command -> KWREWIND constant
 command -> KWSTOP
 
 show_argument -> cmd_arg
@@ -96,6 +100,10 @@ static TokenList firstOfStmt = {
     Token::KwSet,
     Token::KwExec,
     Token::KwReset,
+    Token::KwCheckpoint,
+    Token::KwUndo,
+    Token::KwRedo,
+    Token::KwRewind,
     Token::KwStop};
 
 static TokenList firstOfCmd = {
@@ -103,6 +111,10 @@ static TokenList firstOfCmd = {
     Token::KwSet,
     Token::KwExec,
     Token::KwReset,
+    Token::KwCheckpoint,
+    Token::KwUndo,
+    Token::KwRedo,
+    Token::KwRewind,
     Token::KwStop};
 
 static TokenList firstOfAsmDir = {
@@ -158,13 +170,21 @@ private:
     void getNextToken()
     { curr_tk = lexer.getNextToken(); }
 
+    // The text of a token only lives as long as the lexer. The AST keeps it
+    // in the string area of the node pool and the errors get a copy
+    std::string tokenText() const
+    { return std::string(curr_tk.text); }
+
+    std::string_view internText()
+    { return ctx.intern(curr_tk.text); }
+
     void match(unsigned tk_id, const char *text = "")
     {
         if (curr_tk.token_id != tk_id)
         {
             throw EAsm::Error(EAsm::SrcInfo{ ctx.currFilename(), curr_tk.line_num },
                               "Expected: ", cboldText(fcolor::cyan, text),
-                              ", found ", cboldText(fcolor::red, curr_tk.text),
+                              ", found ", cboldText(fcolor::red, tokenText()),
                               '\n');
         }
         getNextToken();
@@ -209,7 +229,7 @@ private:
         if (!tokenIs(Token::Eof))
         {
             throw EAsm::Error(EAsm::SrcInfo{ ctx.currFilename(), curr_tk.line_num },
-                       cboldText(fcolor::red, curr_tk.text),
+                       cboldText(fcolor::red, tokenText()),
                        " is not a valid start of statement\n");
         }
 
@@ -220,7 +240,7 @@ private:
     {
         while (tokenIs(Token::Label))
         {
-            Ast::AsmEntry *n_lbl = ctx.LabelEntryCreate(curr_tk.text);
+            Ast::AsmEntry *n_lbl = ctx.LabelEntryCreate(internText());
             n_lbl->setLinenum(curr_tk.line_num);
 
             asm_entries.push_back(n_lbl);
@@ -242,7 +262,7 @@ private:
         else
         {
             throw EAsm::Error(EAsm::SrcInfo{ ctx.currFilename(), curr_tk.line_num },
-                       cboldText(fcolor::red, curr_tk.text),
+                       cboldText(fcolor::red, tokenText()),
                        " is not a valid start of statement\n");
         }
 
@@ -250,7 +270,7 @@ private:
         {
             throw EAsm::Error(EAsm::SrcInfo{ ctx.currFilename(), curr_tk.line_num },
                        "Expected end of line but found ",
-                       cboldText(fcolor::red, curr_tk.text),
+                       cboldText(fcolor::red, tokenText()),
                        '\n');
         }
 
@@ -278,7 +298,7 @@ private:
         else if (tokenIs(Token::KwDotGlobal))
         {   
             getNextToken();
-            std::string text = curr_tk.text;
+            std::string_view text = internText();
             match(Token::Ident, "identifier");
 
             return ctx.GlobalDirCreate(text);
@@ -291,7 +311,7 @@ private:
             if (!tokenIs(Token::Eol, Token::Eof))
             {
                 throw EAsm::Error(EAsm::SrcInfo{ ctx.currFilename(), curr_tk.line_num },
-                           "Unexpected ", cboldText(fcolor::red, curr_tk.text),
+                           "Unexpected ", cboldText(fcolor::red, tokenText()),
                            " expecting end of line\n");
             }
             ctx.setCurrLinenum(line_num);
@@ -306,7 +326,7 @@ private:
             if (!tokenIs(Token::Eol, Token::Eof))
             {
                 throw EAsm::Error(EAsm::SrcInfo{ ctx.currFilename(), curr_tk.line_num },
-                           "Unexpected ", cboldText(fcolor::red, curr_tk.text),
+                           "Unexpected ", cboldText(fcolor::red, tokenText()),
                            " expecting end of line\n");
             }
             ctx.setCurrLinenum(line_num);
@@ -321,7 +341,7 @@ private:
             if (!tokenIs(Token::Eol, Token::Eof))
             {
                 throw EAsm::Error(EAsm::SrcInfo{ ctx.currFilename(), curr_tk.line_num },
-                           "Unexpected ", cboldText(fcolor::red, curr_tk.text),
+                           "Unexpected ", cboldText(fcolor::red, tokenText()),
                            " expecting end of line\n");
             }
             ctx.setCurrLinenum(line_num);
@@ -331,7 +351,7 @@ private:
         else
         {
             throw EAsm::Error(EAsm::SrcInfo{ ctx.currFilename(), curr_tk.line_num },
-                              "Unexpected ", cboldText(fcolor::red, curr_tk.text),
+                              "Unexpected ", cboldText(fcolor::red, tokenText()),
                               " expecting an assembler directive\n");
         }
         
@@ -339,9 +359,11 @@ private:
 
     Ast::DataArgList *dataArgList()
     {
-        Ast::DataArgVector args;
+        Ast::DataArgVector& args = data_arg_buf;
         long line_num = curr_tk.line_num;
 
+        args.clear();
+
         Ast::DataArg *arg = dataArg();
         args.push_back(arg);
         while (tokenIs(Token::Comma))
@@ -364,7 +386,7 @@ private:
         {
             case Token::StrLiteral:
             {
-                std::string text = curr_tk.text;
+                std::string_view text = internText();
                 getNextToken();
 
                 return ctx.StrLiteralDataArgCreate(text);
@@ -394,20 +416,20 @@ private:
             switch (curr_tk.token_id)
             {
                 case Token::DecConst:
-                    return ctx.DecConstDataArgCreate(curr_tk.text);
+                    return ctx.DecConstDataArgCreate(internText());
 
                 case Token::HexConst:
-                    return ctx.HexConstDataArgCreate(curr_tk.text);
+                    return ctx.HexConstDataArgCreate(internText());
 
                 case Token::BinConst:
-                    return ctx.BinConstDataArgCreate(curr_tk.text);
+                    return ctx.BinConstDataArgCreate(internText());
 
                 case Token::CharLiteral:
-                    return ctx.CharLiteralDataArgCreate(curr_tk.text);
+                    return ctx.CharLiteralDataArgCreate(internText());
 
                 default:
                     throw EAsm::Error(EAsm::SrcInfo{ ctx.currFilename(), curr_tk.line_num },
-                                      "Unexpected text ", cboldText(fcolor::red, curr_tk.text),
+                                      "Unexpected text ", cboldText(fcolor::red, tokenText()),
                                       " in data definition\n");
             }
         }();
@@ -420,7 +442,7 @@ private:
     Ast::AsmEntry *asmInstruction()
     {
         long line_num = curr_tk.line_num;
-        std::string ident = curr_tk.text;
+        std::string_view ident = internText();
 
         getNextToken();
 
@@ -525,7 +547,7 @@ private:
             case Token::KwExec:
             {
                 getNextToken();
-                std::string str = curr_tk.text;
+                std::string_view str = internText();
                 match(Token::StrLiteral, "string literal");
 
                 ctx.setCurrLinenum(line_num);
@@ -539,6 +561,39 @@ private:
 
                 return ctx.ResetCmdCreate();
             }
+            case Token::KwCheckpoint:
+            {
+                getNextToken();
+                std::string_view str = internText();
+                match(Token::StrLiteral, "string literal");
+
+                ctx.setCurrLinenum(line_num);
+
+                return ctx.CheckpointCmdCreate(ctx.StrLiteralCreate(str));
+            }
+            case Token::KwUndo:
+            case Token::KwRedo:
+            {
+                Ast::HistoryOp op = tokenIs(Token::KwUndo)? Ast::Hist_Undo : Ast::Hist_Redo;
+
+                getNextToken();
+
+                // The count is optional, one instruction by default
+                Ast::Arg *n_arg = tokenIs(Token::Eol, Token::Eof)? ctx.DecConstCreate("1")
+                                                                 : constant();
+                ctx.setCurrLinenum(line_num);
+
+                return ctx.HistoryCmdCreate(op, n_arg);
+            }
+            case Token::KwRewind:
+            {
+                getNextToken();
+                Ast::Arg *n_arg = constant();
+
+                ctx.setCurrLinenum(line_num);
+
+                return ctx.HistoryCmdCreate(Ast::Hist_Rewind, n_arg);
+            }
             case Token::KwStop:
             {
                 getNextToken();
@@ -549,7 +604,7 @@ private:
             default:
                 throw EAsm::Error(EAsm::SrcInfo{ctx.currFilename(), line_num},
                                   "Expected start of command, but found ",
-                                  cboldText(fcolor::red, curr_tk.text),
+                                  cboldText(fcolor::red, tokenText()),
                                   '\n');
         }
     }
@@ -558,7 +613,10 @@ private:
     {
         long line_num = curr_tk.line_num;
         
-        Ast::ArgVector args;
+        Ast::ArgVector& args = arg_buf;
+
+        args.clear();
+
         Ast::Arg *arg = argument();
         args.push_back(arg);
 
@@ -572,9 +630,9 @@ private:
         if (!tokenIs(Token::Eol, Token::Eof))
         {
             throw EAsm::Error(EAsm::SrcInfo{ ctx.currFilename(), curr_tk.line_num },
-                       "Unexpected text ", cboldText(fcolor::red, curr_tk.text),
+                       "Unexpected text ", cboldText(fcolor::red, tokenText()),
                        ". Did you forget a ", cboldText(fcolor::cyan, "comma"),
-                       " before ", cboldText(fcolor::yellow, curr_tk.text), "?",
+                       " before ", cboldText(fcolor::yellow, tokenText()), "?",
                        '\n');
         }
 
@@ -596,7 +654,7 @@ private:
 
             case Token::StrLiteral:
             {
-                std::string text = curr_tk.text;
+                std::string_view text = internText();
                 getNextToken();
 
                 return ctx.StrLiteralCreate(text);
@@ -678,7 +736,10 @@ private:
 
         getNextToken();
         
-        Ast::ArgVector args;
+        Ast::ArgVector& args = arg_buf;
+
+        args.clear();
+
         Ast::Arg *arg = cmdSingleArgument();
         args.push_back(arg);
 
@@ -692,9 +753,9 @@ private:
         if (!tokenIs(Token::CloseBracket))
         {
             throw EAsm::Error(EAsm::SrcInfo{ ctx.currFilename(), curr_tk.line_num },
-                       "Unexpected text ", cboldText(fcolor::red, curr_tk.text),
+                       "Unexpected text ", cboldText(fcolor::red, tokenText()),
                        ". Did you forget a ", cboldText(fcolor::cyan, "comma"),
-                       " before ", cboldText(fcolor::yellow, curr_tk.text), "?",
+                       " before ", cboldText(fcolor::yellow, tokenText()), "?",
                        '\n');
         }
         getNextToken();
@@ -712,14 +773,14 @@ private:
         {
             case Token::RegName:
             {
-                std::string rname = curr_tk.text;
+                std::string_view rname = internText();
                 getNextToken();
 
                 return ctx.RegNameCreate(rname);
             }
             case Token::RegIndex:
             {
-                std::string s_index = curr_tk.text;
+                std::string_view s_index = internText();
                 getNextToken();
 
                 return ctx.RegIndexCreate(s_index);
@@ -754,28 +815,28 @@ private:
         {
             case Token::DecConst:
             {
-                std::string sval = curr_tk.text;
+                std::string_view sval = internText();
                 getNextToken();
 
                 return ctx.DecConstCreate(sval);
             }
             case Token::HexConst:
             {
-                std::string sval = curr_tk.text;
+                std::string_view sval = internText();
                 getNextToken();
 
                 return ctx.HexConstCreate(sval);
             }
             case Token::BinConst:
             {
-                std::string sval = curr_tk.text;
+                std::string_view sval = internText();
                 getNextToken();
 
                 return ctx.BinConstCreate(sval);
             }
             case Token::CharLiteral:
             {
-                std::string sval = curr_tk.text;
+                std::string_view sval = internText();
                 getNextToken();
 
                 return ctx.CharLiteralCreate(sval);
@@ -784,7 +845,7 @@ private:
             case Token::DollarIdent:
             case Token::Ident:
             {
-                std::string str = curr_tk.text;
+                std::string_view str = internText();
                 getNextToken();
 
                 return ctx.IdentCreate(str);
@@ -809,7 +870,7 @@ private:
             }
             default:
                 throw EAsm::Error(EAsm::SrcInfo{ ctx.currFilename(), curr_tk.line_num },
-                                  "Unexpected ", cboldText(fcolor::red, curr_tk.text),
+                                  "Unexpected ", cboldText(fcolor::red, tokenText()),
                                   ", expected ", cboldText(fcolor::cyan, "decimal"),
                                   ", ", cboldText(fcolor::cyan, "hexadecimal"),
                                   ", ", cboldText(fcolor::cyan, "binary"),
@@ -822,6 +883,11 @@ private:
     Token curr_tk;
     Lexer &lexer;
     Ast::NodePool &ctx;
+
+    // The pool copies the elements of a list to its arena, the buffers are
+    // reused by every list. Lists don't nest in the grammar.
+    Ast::ArgVector arg_buf;
+    Ast::DataArgVector data_arg_buf;
 };
 
 Ast::AsmProgram *Parser::parse()
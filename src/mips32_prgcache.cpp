@@ -0,0 +1,410 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include "mips32_prgcache.h"
+#include "mips32_assembler.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define PRG_MMAP
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace Mips32
+{
+    static const char Magic[8] = {'E', 'M', 'I', 'P', 'S', 'P', 'R', 'G'};
+
+    // Written as a number, it reads back different on a host with the other
+    // byte order
+    static const uint32_t ByteOrderMark = 0x01020304;
+
+    // Contents of a whole file, mapped read only where the host can
+    class FileView
+    {
+    public:
+        FileView(const std::string& file)
+        {
+        #if defined(PRG_MMAP)
+            int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat st;
+
+            if (fd == -1)
+                return;
+
+            if (::fstat(fd, &st) == 0 && st.st_size > 0)
+            {
+                void *p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+                if (p != MAP_FAILED)
+                {
+                    ptr = static_cast<const uint8_t *>(p);
+                    len = st.st_size;
+                }
+            }
+            ::close(fd);
+        #else
+            std::ifstream in(file, std::ios::in | std::ios::binary);
+
+            if (!in.is_open())
+                return;
+
+            buf.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            ptr = reinterpret_cast<const uint8_t *>(buf.data());
+            len = buf.size();
+        #endif
+        }
+
+        ~FileView()
+        {
+        #if defined(PRG_MMAP)
+            if (ptr != nullptr)
+                ::munmap(const_cast<uint8_t *>(ptr), len);
+        #endif
+        }
+
+        FileView(const FileView&) = delete;
+        FileView& operator=(const FileView&) = delete;
+
+        const uint8_t *data() const
+        { return ptr; }
+
+        size_t size() const
+        { return len; }
+
+    private:
+        const uint8_t *ptr = nullptr;
+        size_t len = 0;
+    #if !defined(PRG_MMAP)
+        std::string buf;
+    #endif
+    };
+
+    // Reads numbers and strings in place, every read checks the end
+    struct FileReader
+    {
+        template <typename T>
+        bool get(T& val)
+        {
+            if (static_cast<size_t>(end - p) < sizeof(T))
+                return false;
+
+            std::memcpy(&val, p, sizeof(T));
+            p += sizeof(T);
+            return true;
+        }
+
+        bool getBytes(uint64_t n, const uint8_t *& bytes)
+        {
+            if (static_cast<uint64_t>(end - p) < n)
+                return false;
+
+            bytes = p;
+            p += n;
+            return true;
+        }
+
+        bool getString(std::string& str)
+        {
+            uint64_t size;
+            const uint8_t *bytes;
+
+            if (!get(size) || !getBytes(size, bytes))
+                return false;
+
+            str.assign(reinterpret_cast<const char *>(bytes), size);
+            return true;
+        }
+
+        const uint8_t *p;
+        const uint8_t *end;
+    };
+
+    template <typename T>
+    static void put(std::string& buf, T val)
+    {
+        buf.append(reinterpret_cast<const char *>(&val), sizeof(T));
+    }
+
+    static void putString(std::string& buf, const std::string& str)
+    {
+        put<uint64_t>(buf, str.size());
+        buf.append(str);
+    }
+
+    // 64 bit FNV-1a
+    struct KeyHash
+    {
+        void add(const void *data, size_t n)
+        {
+            const uint8_t *bytes = static_cast<const uint8_t *>(data);
+
+            for (size_t i = 0; i < n; i++)
+                val = (val ^ bytes[i]) * 0x100000001b3ull;
+        }
+
+        template <typename T>
+        void add(T v)
+        { add(&v, sizeof(T)); }
+
+        void addString(std::string_view str)
+        {
+            add<uint64_t>(str.size());
+            add(str.data(), str.size());
+        }
+
+        uint64_t val = 0xcbf29ce484222325ull;
+    };
+
+    uint64_t ProgramCache::programKey(const SourceFileVector& sources,
+                                      const std::string& entry_label,
+                                      const MemoryMap& mmap)
+    {
+        KeyHash hash;
+
+        hash.add<uint32_t>(Version);
+        hash.add<uint64_t>(mmap.gblStartAddr());
+        hash.add<uint64_t>(mmap.stkStartAddr());
+        hash.add<uint64_t>(mmap.gblSize());
+        hash.add<uint64_t>(mmap.stkSize());
+        hash.add<uint64_t>(mmap.heapLimit());
+        hash.addString(entry_label);
+        hash.add<uint64_t>(sources.size());
+        for (const auto& src : sources)
+        {
+            hash.addString(src.name);
+            hash.addString(src.text->text());
+        }
+
+        return hash.val;
+    }
+
+    bool ProgramCache::canStore(const VmOperationVector& action_v)
+    {
+        for (const auto& act : action_v)
+        {
+            if (!act.dinst || act.dinst->opc == Opcode::Task)
+                return false;
+        }
+
+        return !action_v.empty();
+    }
+
+    std::string ProgramCache::filePath(uint64_t key) const
+    {
+        static const char *digits = "0123456789abcdef";
+        std::string name(16, '0');
+
+        for (int i = 15; i >= 0; i--, key >>= 4)
+            name[i] = digits[key & 0x0f];
+
+        return (fs::path(dir) / (name + ".prg")).string();
+    }
+
+    // Only instructions that decodeInst() could have made, the file may
+    // come from anywhere
+    static bool isValidInst(const DecodedInst& di)
+    {
+        if (di.opc >= Opcode::Task)
+            return false;
+
+        std::optional<DecodedInst> vdi = Assembler::decodeInst(di.opc, Assembler::instArgs(di));
+
+        return vdi && vdi->opc == di.opc && vdi->rd == di.rd && vdi->rs == di.rs
+               && vdi->rt == di.rt && vdi->imm == di.imm;
+    }
+
+    bool ProgramCache::load(uint64_t key, MemoryManager& mm, VmOperationVector& action_v,
+                            DebugTable& dbg_table, VirtualAddr& entry_addr)
+    {
+        struct OpRecord
+        {
+            DecodedInst di;
+            uint32_t file_id;
+            uint32_t line;
+        };
+
+        struct DataRecord
+        {
+            VirtualAddr vaddr;
+            uint64_t size;
+            const uint8_t *bytes;
+        };
+
+        FileView file(filePath(key));
+        FileReader in{file.data(), file.data() + file.size()};
+
+        if (file.data() == nullptr)
+            return false;
+
+        const uint8_t *magic;
+        uint32_t version, bom, entry;
+        uint64_t file_key, file_count, op_count, data_count;
+
+        if (!in.getBytes(sizeof(Magic), magic) || std::memcmp(magic, Magic, sizeof(Magic)) != 0
+            || !in.get(version) || version != Version || !in.get(bom) || bom != ByteOrderMark
+            || !in.get(file_key) || file_key != key || !in.get(entry)
+            || !in.get(file_count) || !in.get(op_count) || !in.get(data_count))
+            return false;
+
+        std::vector<std::string> files;
+        std::vector<OpRecord> ops;
+        std::vector<DataRecord> data;
+
+        // Everything is checked before anything is used
+        for (uint64_t i = 0; i < file_count; i++)
+        {
+            std::string name;
+
+            if (!in.getString(name))
+                return false;
+
+            files.push_back(std::move(name));
+        }
+
+        if (op_count == 0 || op_count > file.size())
+            return false;
+
+        ops.reserve(op_count);
+        for (uint64_t i = 0; i < op_count; i++)
+        {
+            OpRecord rec;
+            uint8_t opc;
+
+            if (!in.get(opc) || !in.get(rec.di.rd) || !in.get(rec.di.rs) || !in.get(rec.di.rt)
+                || !in.get(rec.di.imm) || !in.get(rec.file_id) || !in.get(rec.line))
+                return false;
+
+            rec.di.opc = static_cast<Opcode>(opc);
+            if (!isValidInst(rec.di) || rec.file_id >= files.size())
+                return false;
+
+            ops.push_back(rec);
+        }
+
+        for (uint64_t i = 0; i < data_count; i++)
+        {
+            DataRecord rec;
+
+            if (!in.get(rec.vaddr) || !in.get(rec.size) || rec.size == 0
+                || !in.getBytes(rec.size, rec.bytes)
+                || !mm.isValidAddrRange(rec.vaddr, rec.vaddr + (rec.size - 1)))
+                return false;
+
+            data.push_back(rec);
+        }
+
+        if (in.p != in.end)
+            return false;
+
+        action_v.clear();
+        action_v.reserve(ops.size());
+        for (const auto& rec : ops)
+        {
+            VmOperation op(Assembler::compileInst(rec.di.opc, Assembler::instArgs(rec.di)));
+
+            op.dinst = rec.di;
+            action_v.push_back(std::move(op));
+            dbg_table.add(files[rec.file_id].c_str(), rec.line);
+        }
+
+        for (const auto& rec : data)
+            mm.writeBytes(rec.vaddr, rec.bytes, rec.size);
+
+        entry_addr = entry;
+
+        return true;
+    }
+
+    bool ProgramCache::store(uint64_t key, const VmOperationVector& action_v,
+                             const DebugTable& dbg_table, const DataBlockVector& data,
+                             VirtualAddr entry_addr)
+    {
+        if (!canStore(action_v))
+            return false;
+
+        std::vector<std::string> files;
+        std::vector<uint32_t> file_ids;
+
+        // Operations come grouped by file, so the lookup starts from the last one
+        for (size_t i = 0; i < action_v.size(); i++)
+        {
+            std::string name = dbg_table.srcInfo(i).fileName();
+            uint32_t file_id = files.size();
+
+            for (size_t j = files.size(); j > 0; j--)
+            {
+                if (files[j - 1] == name)
+                {
+                    file_id = j - 1;
+                    break;
+                }
+            }
+            if (file_id == files.size())
+                files.push_back(std::move(name));
+
+            file_ids.push_back(file_id);
+        }
+
+        std::string buf;
+
+        buf.append(Magic, sizeof(Magic));
+        put<uint32_t>(buf, Version);
+        put<uint32_t>(buf, ByteOrderMark);
+        put<uint64_t>(buf, key);
+        put<uint32_t>(buf, entry_addr);
+        put<uint64_t>(buf, files.size());
+        put<uint64_t>(buf, action_v.size());
+        put<uint64_t>(buf, data.size());
+
+        for (const auto& name : files)
+            putString(buf, name);
+
+        for (size_t i = 0; i < action_v.size(); i++)
+        {
+            const DecodedInst& di = *action_v[i].dinst;
+
+            put<uint8_t>(buf, static_cast<uint8_t>(di.opc));
+            put<uint8_t>(buf, di.rd);
+            put<uint8_t>(buf, di.rs);
+            put<uint8_t>(buf, di.rt);
+            put<uint32_t>(buf, di.imm);
+            put<uint32_t>(buf, file_ids[i]);
+            put<uint32_t>(buf, dbg_table.srcInfo(i).lineNum());
+        }
+
+        for (const auto& blk : data)
+        {
+            put<uint32_t>(buf, blk.vaddr);
+            put<uint64_t>(buf, blk.bytes.size());
+            buf.append(reinterpret_cast<const char *>(blk.bytes.data()), blk.bytes.size());
+        }
+
+        std::error_code ec;
+        std::string path = filePath(key);
+        std::string tmp_path = path + "." + std::to_string(std::random_device()()) + ".tmp";
+
+        fs::create_directories(dir, ec);
+
+        std::ofstream out(tmp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+
+        if (!out.is_open())
+            return false;
+
+        out.write(buf.data(), buf.size());
+        out.close();
+
+        if (!out || (fs::rename(tmp_path, path, ec), ec))
+        {
+            fs::remove(tmp_path, ec);
+            return false;
+        }
+
+        return true;
+    }
+
+} // namespace Mips32
@@ -1,14 +1,579 @@
 #include <iostream>
+#include <fstream>
 #include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <new>
 #include "num_convert.h"
 #include "mips32_runtime.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(_WIN32)
+    #define NOMINMAX
+    #include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+    #define MEM_MMAP
+    #include <sys/mman.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+
+    #if defined(__linux__) && defined(MFD_CLOEXEC)
+        #define MEM_MEMFD
+    #endif
+#endif
+
 namespace Mips32
 {
-    inline void trim(std::string &s, const char *t = " \t\n\r\f\v")
+    // Swaps the bytes of every word in a block of n bytes, n must be a
+    // multiple of 4. Turns a big endian byte stream into host order words
+    // and back.
+    static void swapWords(uint8_t *dst, const uint8_t *src, size_t n)
+    {
+        size_t i = 0;
+
+    #if defined(__SSE2__)
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+
+            // Swap the half words of every word, then the bytes of every half word
+            v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xb1), 0xb1);
+            v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), v);
+        }
+    #endif
+        for (; i < n; i += 4)
+        {
+            uint32_t w;
+
+            std::memcpy(&w, src + i, 4);
+            w = (w >> 24) | ((w >> 8) & 0xff00) | ((w << 8) & 0xff0000) | (w << 24);
+            std::memcpy(dst + i, &w, 4);
+        }
+    }
+
+    static bool isBlank(char ch)
+    {
+        return (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\f' || ch == '\v');
+    }
+
+    // Parses a decimal number like std::stol, with an optional sign
+    static bool parseLong(const char *first, const char *last, long& val, const char *&next)
+    {
+        if (first != last && *first == '+' && (last - first) > 1 && first[1] != '-')
+            first++;
+
+        auto res = std::from_chars(first, last, val, 10);
+
+        next = res.ptr;
+        return (res.ec == std::errc());
+    }
+
+    static bool isZero(const uint8_t *p, size_t n)
+    {
+        uint64_t acc = 0;
+        size_t i = 0;
+
+        for (; i + 8 <= n; i += 8)
+        {
+            uint64_t w;
+
+            std::memcpy(&w, p + i, 8);
+            acc |= w;
+        }
+        for (; i < n; i++)
+            acc |= p[i];
+
+        return (acc == 0);
+    }
+
+    // Calls f(ofs, n) for every block of n bytes of mem that isn't zero
+    template <typename F>
+    static void forEachUsedBlock(const uint8_t *mem, size_t size, F f)
+    {
+        const size_t block_size = MemoryMap::PageSize;
+
+        for (size_t ofs = 0; ofs < size; ofs += block_size)
+        {
+            size_t n = std::min(block_size, size - ofs);
+
+            if (!isZero(mem + ofs, n))
+                f(ofs, n);
+        }
+    }
+
+    MemorySnapshot::~MemorySnapshot()
+    {
+    #if defined(MEM_MMAP)
+        if (fd != -1)
+            ::close(fd);
+    #endif
+    }
+
+    // Guest memory is only reserved in the host address space, the OS maps
+    // in a zeroed page the first time one is touched. Large regions cost
+    // just the pages that the program uses.
+    uint8_t *MemoryManager::allocMem(size_t size)
+    {
+    #if defined(_WIN32)
+        // Committed up front on purpose. Windows still maps in the zeroed
+        // pages the first time they are touched, only the commit charge
+        // counts the whole size. Committing on demand would need a fault
+        // handler on every guest access, for no gain in used memory.
+        void *p = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+        if (p == nullptr)
+            throw std::bad_alloc();
+
+        return static_cast<uint8_t *>(p);
+    #elif defined(MEM_MMAP)
+        void *p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+        if (p == MAP_FAILED)
+            throw std::bad_alloc();
+
+        return static_cast<uint8_t *>(p);
+    #else
+        return new uint8_t[size]();
+    #endif
+    }
+
+    void MemoryManager::freeMem(uint8_t *mem, size_t size)
     {
-        s.erase(0, s.find_first_not_of(t));
-        s.erase(s.find_last_not_of(t) + 1);
+    #if defined(_WIN32)
+        (void)size;
+        VirtualFree(mem, 0, MEM_RELEASE);
+    #elif defined(MEM_MMAP)
+        ::munmap(mem, size);
+    #else
+        (void)size;
+        delete[] mem;
+    #endif
+    }
+
+    bool MemoryManager::sbrk(uint32_t incr, VirtualAddr& brk)
+    {
+        size_t used = heap_brk - mmap.heapStartAddr();
+        size_t new_used = used + ((static_cast<size_t>(incr) + 3) & ~size_t(3));
+
+        if (new_used > mmap.heapLimit())
+            return false;
+
+        // Pages are zero until touched, there's nothing to clear
+        size_t page_mask = MemoryMap::PageSize - 1;
+
+        mmap.setHeapSize(std::min((new_used + page_mask) & ~page_mask, mmap.heapLimit()));
+        brk = heap_brk;
+        heap_brk = mmap.heapStartAddr() + new_used;
+
+        return true;
+    }
+
+    void MemoryManager::setHeapBreak(VirtualAddr brk)
+    {
+        size_t used = brk - mmap.heapStartAddr();
+        size_t page_mask = MemoryMap::PageSize - 1;
+
+        mmap.setHeapSize(std::min((used + page_mask) & ~page_mask, mmap.heapLimit()));
+        heap_brk = brk;
+
+        // The heap may have shrunk under some entries
+        flushTlb();
+    }
+
+    // Drops every page, they read as zero again
+    void MemoryManager::clearMem(uint8_t *mem, size_t size)
+    {
+    #if defined(_WIN32)
+        VirtualFree(mem, size, MEM_DECOMMIT);
+        if (VirtualAlloc(mem, size, MEM_COMMIT, PAGE_READWRITE) == nullptr)
+            throw std::bad_alloc();
+    #elif defined(MEM_MMAP)
+        void *p = ::mmap(mem, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+
+        if (p == MAP_FAILED)
+            throw std::bad_alloc();
+    #else
+        std::fill_n(mem, size, 0);
+    #endif
+    }
+
+    void MemoryManager::copyFrom(const MemoryManager& other)
+    {
+        forEachUsedBlock(other.mem, other.usedSize(),
+            [this, &other](size_t ofs, size_t n)
+            { std::memcpy(mem + ofs, other.mem + ofs, n); });
+
+        setText(other.text);
+    }
+
+    void MemoryManager::setText(std::vector<uint32_t> words)
+    {
+        text = std::move(words);
+        text_dirty.clear();
+
+        // Entries may point into the old words
+        flushTlb();
+    }
+
+    std::unique_ptr<MemorySnapshot> MemoryManager::snapshot()
+    {
+        auto snap = std::make_unique<MemorySnapshot>();
+
+        snap->heap_size = mmap.heapSize();
+        snap->heap_brk = heap_brk;
+        snap->text = text;
+
+    #if defined(MEM_MEMFD)
+        // The file is only created for the first block, an empty image is
+        // just a cleared memory
+        int fd = -1;
+        bool ok = true;
+
+        forEachUsedBlock(mem, usedSize(),
+            [this, &fd, &ok](size_t ofs, size_t n)
+            {
+                if (fd == -1 && ok)
+                {
+                    fd = ::memfd_create("easymips-snapshot", MFD_CLOEXEC);
+                    ok = (fd != -1 && ::ftruncate(fd, memSize()) == 0);
+                }
+                ok = ok && (::pwrite(fd, mem + ofs, n, ofs) == static_cast<ssize_t>(n));
+            });
+
+        if (ok)
+        {
+            snap->fd = fd;
+
+            // From now on this memory shares the pages of the image until
+            // they are written
+            if (fd != -1)
+                restore(*snap);
+
+            return snap;
+        }
+        if (fd != -1)
+            ::close(fd);
+    #endif
+
+        // No memory file, the blocks are copied back on every restore
+        forEachUsedBlock(mem, usedSize(),
+            [this, &snap](size_t ofs, size_t n)
+            {
+                snap->blocks.push_back({ofs, n});
+                snap->data.insert(snap->data.end(), mem + ofs, mem + ofs + n);
+            });
+
+        return snap;
+    }
+
+    void MemoryManager::restore(const MemorySnapshot& snap)
+    {
+    #if defined(MEM_MMAP)
+        if (snap.fd != -1)
+        {
+            void *p = ::mmap(mem, memSize(), PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_NORESERVE | MAP_FIXED, snap.fd, snap.fd_ofs);
+
+            if (p == MAP_FAILED)
+                throw std::bad_alloc();
+        }
+        else
+    #endif
+        {
+            size_t data_ofs = 0;
+
+            clearMem(mem, memSize());
+            for (const auto& blk : snap.blocks)
+            {
+                std::memcpy(mem + blk.ofs, snap.data.data() + data_ofs, blk.size);
+                data_ofs += blk.size;
+            }
+        }
+
+        mmap.setHeapSize(snap.heap_size);
+        heap_brk = snap.heap_brk;
+        setText(snap.text);
+    }
+
+    void MemoryManager::flushTlb()
+    {
+        for (auto& tlb_acc : tlb)
+            std::fill_n(tlb_acc, TlbSize, TlbEntry{0, 0, nullptr});
+    }
+
+    bool MemoryManager::refillTlb(TlbEntry& e, VirtualAddr vaddr, MemAccess acc)
+    {
+        VirtualAddr start, end;
+        uint8_t *base = mem;
+
+        // Data regions are readable and writable, the TLB for each kind of
+        // access is only there so a permission check costs nothing on a hit.
+        // Text is only mapped for reading.
+        if (vaddr >= mmap.gblStartAddr() && vaddr < mmap.gblEndAddr())
+        {
+            start = mmap.gblStartAddr();
+            end = mmap.gblEndAddr();
+        }
+        else if (vaddr >= mmap.stkStartAddr() && vaddr < mmap.stkEndAddr())
+        {
+            start = mmap.stkStartAddr();
+            end = mmap.stkEndAddr();
+        }
+        else if (vaddr >= mmap.heapStartAddr() && vaddr < mmap.heapEndAddr())
+        {
+            start = mmap.heapStartAddr();
+            end = mmap.heapEndAddr();
+        }
+        else if (acc == MemAccess::Read && vaddr - 0x400000 < text.size() * 4)
+        {
+            start = 0x400000;
+            end = 0x400000 + text.size() * 4;
+            base = reinterpret_cast<uint8_t *>(text.data());
+        }
+        else
+            return false;
+
+        VirtualAddr page = vaddr & ~((1u << PageShift) - 1);
+
+        start = (std::max(start, page) + 3) & ~3u;
+        end = std::min<uint64_t>(end, uint64_t(page) + (1u << PageShift)) & ~3u;
+
+        long ofs = (base == mem)? mmap.offsetOf(start) : static_cast<long>(start - 0x400000);
+
+        if (vaddr < start || vaddr >= end || (ofs % 4) != 0)
+            return false;
+
+        e.vaddr = start;
+        e.size = end - start;
+        e.host = base + ofs;
+
+        return true;
+    }
+
+    void MemoryManager::saveImage(std::ostream& out) const
+    {
+        std::streamoff start = out.tellp();
+
+        forEachUsedBlock(mem, usedSize(),
+            [this, &out, start](size_t ofs, size_t n)
+            {
+                out.seekp(start + static_cast<std::streamoff>(ofs));
+                out.write(reinterpret_cast<const char *>(mem + ofs), n);
+            });
+
+        // The last byte makes the file cover the whole image, it's mapped
+        // later and pages past the end of a file can't be read
+        out.seekp(start + static_cast<std::streamoff>(memSize() - 1));
+        out.put(static_cast<char>(mem[memSize() - 1]));
+    }
+
+    bool MemoryManager::loadImage(const std::string& file, size_t ofs,
+                                  size_t heap_size, VirtualAddr brk)
+    {
+    #if defined(MEM_MMAP)
+        MemorySnapshot snap;
+
+        snap.heap_size = heap_size;
+        snap.heap_brk = brk;
+        snap.text = text; // Not in the image
+        snap.fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        snap.fd_ofs = ofs;
+
+        if (snap.fd == -1)
+            return false;
+
+        restore(snap);
+    #else
+        std::ifstream in(file, std::ios::in | std::ios::binary);
+
+        clearMem(mem, memSize());
+        if (!in.seekg(ofs) || !in.read(reinterpret_cast<char *>(mem), memSize()))
+            return false;
+
+        mmap.setHeapSize(heap_size);
+        heap_brk = brk;
+        flushTlb();
+    #endif
+
+        return true;
+    }
+
+    void MemoryManager::readBytes(VirtualAddr vaddr, void *dst, size_t n)
+    {
+        uint8_t *d = static_cast<uint8_t *>(dst);
+
+    #if __BYTE_ORDER == __BIG_ENDIAN
+        std::memcpy(d, mem + mmap.offsetOf(vaddr), n);
+    #else
+        // Bytes before the first word boundary and after the last one are
+        // copied one by one
+        size_t head = std::min<size_t>((4 - (vaddr % 4)) % 4, n);
+        size_t body = (n - head) & ~size_t(3);
+
+        for (size_t i = 0; i < head; i++)
+            d[i] = *hostPtr<uint8_t>(vaddr + i);
+
+        if (body > 0)
+            swapWords(d + head, mem + mmap.offsetOf(vaddr + head), body);
+
+        for (size_t i = head + body; i < n; i++)
+            d[i] = *hostPtr<uint8_t>(vaddr + i);
+    #endif
+    }
+
+    void MemoryManager::writeBytes(VirtualAddr vaddr, const void *src, size_t n)
+    {
+        const uint8_t *s = static_cast<const uint8_t *>(src);
+
+    #if __BYTE_ORDER == __BIG_ENDIAN
+        std::memcpy(mem + mmap.offsetOf(vaddr), s, n);
+    #else
+        size_t head = std::min<size_t>((4 - (vaddr % 4)) % 4, n);
+        size_t body = (n - head) & ~size_t(3);
+
+        for (size_t i = 0; i < head; i++)
+            *hostPtr<uint8_t, MemAccess::Write>(vaddr + i) = s[i];
+
+        if (body > 0)
+            swapWords(mem + mmap.offsetOf(vaddr + head), s + head, body);
+
+        for (size_t i = head + body; i < n; i++)
+            *hostPtr<uint8_t, MemAccess::Write>(vaddr + i) = s[i];
+    #endif
+    }
+
+    InputReader::InputReader(std::istream& in)
+    : in(in), buf(), pos(0), end(0)
+    {}
+
+    // Keeps the unread input at the start of the buffer and adds what the
+    // stream has buffered, or one character when it can't tell
+    bool InputReader::refill()
+    {
+        if (pos > 0)
+        {
+            std::memmove(buf.data(), buf.data() + pos, end - pos);
+            end -= pos;
+            pos = 0;
+        }
+        if (end == buf.size())
+            buf.resize(std::max(BufferSize, buf.size() * 2));
+
+        // Prompts must be out before waiting for the input
+        if (in.tie() != nullptr)
+            in.tie()->flush();
+
+        std::streambuf *sb = in.rdbuf();
+
+        if (sb == nullptr || std::istream::traits_type::eq_int_type(sb->sgetc(),
+                                                                  std::istream::traits_type::eof()))
+            return false;
+
+        std::streamsize avail = std::max<std::streamsize>(sb->in_avail(), 1);
+        size_t n = std::min<size_t>(avail, buf.size() - end);
+
+        end += sb->sgetn(buf.data() + end, n);
+
+        return true;
+    }
+
+    std::string_view InputReader::readLine()
+    {
+        size_t scan = pos;
+        const char *nl;
+
+        while ((nl = static_cast<const char *>(std::memchr(buf.data() + scan, '\n', end - scan))) == nullptr)
+        {
+            size_t scanned = end - pos;
+
+            if (!refill())
+            {
+                std::string_view line(buf.data() + pos, end - pos);
+
+                pos = end;
+                return line;
+            }
+            scan = pos + scanned;
+        }
+
+        size_t nl_pos = nl - buf.data();
+        std::string_view line(buf.data() + pos, nl_pos - pos);
+
+        pos = nl_pos + 1;
+        return line;
+    }
+
+    long InputReader::readInt()
+    {
+        std::string_view line = readLine();
+        const char *first = line.data();
+        const char *last = first + line.size();
+        const char *next;
+        long val;
+
+        while (first != last && isBlank(*first))
+            first++;
+
+        return parseLong(first, last, val, next)? val : 0;
+    }
+
+    bool InputReader::skipBlanks(bool newlines)
+    {
+        for (;;)
+        {
+            while (pos < end && (isBlank(buf[pos]) || (newlines && buf[pos] == '\n')))
+                pos++;
+
+            if (pos < end || !refill())
+                return (pos < end);
+        }
+    }
+
+    size_t InputReader::readInts(uint32_t *dst, size_t count)
+    {
+        size_t n = 0;
+
+        for (; n < count && skipBlanks(true); n++)
+        {
+            // The whole number has to be in the buffer
+            size_t len = 0;
+
+            for (;;)
+            {
+                while (pos + len < end && !isBlank(buf[pos + len]) && buf[pos + len] != '\n')
+                    len++;
+
+                if (pos + len < end || !refill())
+                    break;
+            }
+
+            const char *first = buf.data() + pos;
+            const char *next;
+            long val;
+
+            if (!parseLong(first, first + len, val, next) || next != first + len)
+            {
+                // Something that starts like a number is dropped
+                if (*first == '+' || *first == '-' || (*first >= '0' && *first <= '9'))
+                    pos += len;
+                break;
+            }
+
+            dst[n] = static_cast<uint32_t>(val);
+            pos += len;
+        }
+
+        // The rest of the line goes too, like after a ReadInt
+        if (skipBlanks(false) && buf[pos] == '\n')
+            pos++;
+
+        return n;
     }
 
     RuntimeContext::RuntimeContext()
@@ -24,7 +589,11 @@ namespace Mips32
     {}
 
     RuntimeContext::RuntimeContext(MemoryManager *mm, std::ostream &out)
-    : mm(mm), out(out), ext_syscall_handler(nullptr), last_error()
+    : RuntimeContext(mm, std::cin, out)
+    {}
+
+    RuntimeContext::RuntimeContext(MemoryManager *mm, std::istream &in, std::ostream &out)
+    : mm(mm), ext_syscall_handler(nullptr), in(in), out(out), last_error()
     {
         if (mm)
         {
@@ -34,24 +603,52 @@ namespace Mips32
         reg_file.setReg(RegIndex::Zero, 0);
     }
 
-    ErrorCode RuntimeContext::syscallHandler(const EAsm::SrcInfo &src_info)
+    ErrorCode RuntimeContext::syscallHandler()
     {
         uint32_t v0 = reg_file[RegIndex::v0];
 
         switch (static_cast<Syscall>(v0))
         {
             case Syscall::PrintInt:
-                out << static_cast<int32_t>(reg_file[RegIndex::a0]);
+            {
+                char digits[16];
+                auto res = std::to_chars(digits, digits + sizeof(digits),
+                                         static_cast<int32_t>(reg_file[RegIndex::a0]));
+
+                out.write(digits, res.ptr - digits);
                 break;
+            }
             case Syscall::PrintString:
             {
+                // The string goes out in chunks, not a character at a time
+                char chunk[256];
+                size_t len = 0;
+                auto put = [this, &chunk, &len](char ch)
+                {
+                    chunk[len++] = ch;
+                    if (len == sizeof(chunk))
+                    {
+                        out.write(chunk, len);
+                        len = 0;
+                    }
+                };
+
                 VirtualAddr vaddr = reg_file[RegIndex::a0];
                 if (!mm->isValidAddr(vaddr))
                 {
-                    last_error = EAsm::Error(src_info,
-                                                "Virtual address ",
-                                                Cvt::hexVal(vaddr),
-                                                " is out of range\n");
+                    // Strings in the text, like the read only data of an executable
+                    const char *ch;
+
+                    for (; (ch = mm->hostPtr<char>(vaddr)) != nullptr && *ch != '\0'; vaddr++)
+                        put(*ch);
+
+                    out.write(chunk, len);
+                    if (ch != nullptr)
+                        break;
+
+                    last_error = EAsm::Error("Virtual address ",
+                                             Cvt::hexVal(vaddr),
+                                             " is out of range\n");
 
                     return ErrorCode::VirtualAddrOutOfRange;
                 }
@@ -63,12 +660,13 @@ namespace Mips32
                     if (*it == '\0')
                         break;
 
-                    out << *it++;
+                    put(*it++);
                 }
 
+                out.write(chunk, len);
                 if (it == mem_end)
                 {
-                    last_error = EAsm::Error(src_info, "Virtual address ",
+                    last_error = EAsm::Error("Virtual address ",
                                              Cvt::hexVal(vaddr + it.offset()),
                                              " is out of range\n");
 
@@ -78,34 +676,22 @@ namespace Mips32
                 break;
             }
             case Syscall::PrintChar:
-                out << static_cast<char>(reg_file[RegIndex::a0]);
+                out.put(static_cast<char>(reg_file[RegIndex::a0]));
                 break;
 
             case Syscall::ReadInt:
-            {
-                std::string input;
-
-                std::getline(std::cin, input);
-                trim(input);
-
-                try
-                { reg_file.setReg(RegIndex::v0, std::stol(input, nullptr, 10)); }
-                catch (...)
-                { reg_file.setReg(RegIndex::v0, 0); }
-                
+                reg_file.setReg(RegIndex::v0, in.readInt());
                 break;
-            }
+
             case Syscall::ReadChar:
             {
-                std::string input;
-
-                std::getline(std::cin, input);
-                trim(input);
+                std::string_view input = in.readLine();
+                size_t first = input.find_first_not_of(" \t\r\f\v");
 
-                if (input.empty())
+                if (first == std::string_view::npos)
                     reg_file.setReg(RegIndex::v0, 0);
                 else
-                    reg_file.setReg(RegIndex::v0, input[0]);
+                    reg_file.setReg(RegIndex::v0, input[first]);
 
                 break;
             }
@@ -117,23 +703,84 @@ namespace Mips32
                 auto res = validateAddr(vaddr, len, WordSize::_8Bit);
                 if (res.err_code != ErrorCode::Ok)
                 {
-                    last_error = EAsm::Error(src_info, std::move(res.err_info), '\n');
+                    last_error = EAsm::Error(std::move(res.err_info), '\n');
                     return ErrorCode::VirtualAddrOutOfRange;
                 }
 
                 if (len == 0) break;
 
-                std::string input;
-                std::getline(std::cin, input);
-
-                auto it = mm->memIter<char>(vaddr);
+                std::string_view input = in.readLine();
                 size_t copy_len = std::min(input.length(), len - 1);
 
-                for (size_t i = 0; i < copy_len; ++i)
-                    *it++ = input[i];
+                mm->writeBytes(vaddr, input.data(), copy_len);
+                *mm->hostPtr<char, MemAccess::Write>(vaddr + copy_len) = '\0';
 
-                *it = '\0';
+                break;
+            }
+            case Syscall::ReadInts:
+            {
+                size_t count = reg_file[RegIndex::a1];
+                VirtualAddr vaddr = reg_file[RegIndex::a0];
+
+                auto res = validateAddr(vaddr, count, WordSize::_32Bit);
+                if (res.err_code != ErrorCode::Ok)
+                {
+                    last_error = EAsm::Error(std::move(res.err_info), '\n');
+                    return res.err_code;
+                }
 
+                // The numbers go to memory a block at a time
+                uint32_t block[1024];
+                size_t total = 0;
+
+                while (total < count)
+                {
+                    size_t want = std::min(count - total, sizeof(block) / sizeof(block[0]));
+                    size_t got = in.readInts(block, want);
+
+                    for (size_t i = 0; i < got; i++)
+                    {
+                        VirtualAddr waddr = vaddr + (total + i) * 4;
+                        uint32_t *word = mm->hostPtr<uint32_t, MemAccess::Write>(waddr);
+
+                        if (word == nullptr)
+                        {
+                            last_error = EAsm::Error("Invalid virtual address ",
+                                                     colorText(fcolor::yellow, Cvt::hexVal(waddr)), '\n');
+                            return ErrorCode::VirtualAddrOutOfRange;
+                        }
+                        *word = block[i];
+                    }
+
+                    total += got;
+                    if (got < want)
+                        break;
+                }
+                reg_file.setReg(RegIndex::v0, total);
+
+                break;
+            }
+            case Syscall::Sbrk:
+            {
+                VirtualAddr brk;
+                int32_t incr = static_cast<int32_t>(reg_file[RegIndex::a0]);
+
+                if (incr < 0)
+                {
+                    last_error = EAsm::Error("The heap can't shrink, invalid sbrk amount ",
+                                             colorText(fcolor::yellow, incr), '\n');
+                    return ErrorCode::OutOfMemory;
+                }
+                if (!mm->sbrk(incr, brk))
+                {
+                    last_error = EAsm::Error("Cannot grow the heap by ",
+                                             colorText(fcolor::yellow, incr),
+                                             " bytes, the heap limit is ",
+                                             colorText(fcolor::yellow, mm->memMap().heapLimit()),
+                                             " bytes\n");
+                    return ErrorCode::OutOfMemory;
+                }
+                reg_file.setReg(RegIndex::v0, brk);
                 break;
             }
             case Syscall::ExitProgram:
@@ -142,14 +789,16 @@ namespace Mips32
             default:
                 if (ext_syscall_handler != nullptr)
                 {
+                    // Plugins print on their own, buffered output goes first
+                    out.flush();
+
                     ErrorCode ec = ext_syscall_handler(reg_file.getRegArray(),
                                                     nullptr,
                                                     std::addressof(mm->memMap()));
 
                     if (ec != ErrorCode::Ok)
                     {
-                        last_error = EAsm::Error(src_info,
-                                                 "Syscall handler failed with syscall number ",
+                        last_error = EAsm::Error("Syscall handler failed with syscall number ",
                                                  colorText(fcolor::yellow, reg_file[RegIndex::v0]),
                                                  '\n');
 
@@ -158,8 +807,7 @@ namespace Mips32
                 }
                 else
                 {
-                    last_error = EAsm::Error(src_info,
-                                             "Syscall number ",
+                    last_error = EAsm::Error("Syscall number ",
                                              colorText(fcolor::yellow, reg_file[RegIndex::v0]),
                                              " is not implemented\n");
 
@@ -170,21 +818,50 @@ namespace Mips32
         return ErrorCode::Ok;
     }
 
+    void DebugTable::add(const char *fname, long line)
+    {
+        uint32_t file_id = files.size();
+
+        // Operations come grouped by file, so the lookup starts from the last one
+        for (size_t i = files.size(); i > 0; i--)
+        {
+            if (files[i - 1] == fname)
+            {
+                file_id = i - 1;
+                break;
+            }
+        }
+        if (file_id == files.size())
+            files.emplace_back(fname);
+
+        entries.push_back({file_id, static_cast<uint32_t>(line)});
+    }
+
+    EAsm::SrcInfo DebugTable::srcInfo(size_t index) const
+    {
+        if (index >= entries.size())
+            return EAsm::SrcInfo();
+
+        const Entry& e = entries[index];
+        return EAsm::SrcInfo(files[e.file_id], e.line);
+    }
+
     EAsm::ErrorPair RuntimeContext::validateAddr(VirtualAddr vaddr, size_t wcount, WordSize ws)
     {
         size_t bsize = wcount * sizeOf(ws);
 
         if (bsize > 1)
         {
-            VirtualAddr end_addr = vaddr + bsize - 1;
+            // In 64 bits, a big count must not wrap the end back into memory
+            uint64_t end_addr = uint64_t(vaddr) + bsize - 1;
 
-            if (!mm->isValidAddrRange(vaddr, end_addr))
+            if (end_addr > UINT32_MAX || !mm->isValidAddrRange(vaddr, static_cast<VirtualAddr>(end_addr)))
             {
                 return  { 
                             ErrorCode::VirtualAddrOutOfRange,
                             EAsm::makeErrorInfo("Invalid virtual address range ",
                                                 colorText(fcolor::yellow, Cvt::hexVal(vaddr)), ":",
-                                                colorText(fcolor::yellow, Cvt::hexVal(end_addr)))
+                                                colorText(fcolor::yellow, Cvt::hexVal(end_addr, (end_addr > UINT32_MAX)? 9 : 8)))
                         };
             }
         }
@@ -0,0 +1,514 @@
+#include "mips32_simt.h"
+#include "mips32_assembler.h"
+
+namespace Mips32
+{
+    static constexpr unsigned MaxLanes = SimtEngine::MaxLanes;
+
+    // Writes f(lane) to the lanes of dst selected by the mask. The values are
+    // computed into a local array first, so the compiler doesn't need to care
+    // about dst being one of the source rows when vectorizing the loops.
+    template <typename F>
+    static inline void laneOp(uint32_t *dst, const uint32_t *mask, F f)
+    {
+        uint32_t val[MaxLanes];
+        uint32_t m[MaxLanes];
+
+        for (unsigned l = 0; l < MaxLanes; l++)
+        {
+            val[l] = f(l);
+            m[l] = mask[l];
+        }
+        for (unsigned l = 0; l < MaxLanes; l++)
+            dst[l] = (val[l] & m[l]) | (dst[l] & ~m[l]);
+    }
+
+    // Loads and stores of a single lane, they return false if the access
+    // faults and leave the lane untouched
+    template <typename T>
+    static inline bool laneLoad(MemoryManager *mm, VirtualAddr vaddr, uint32_t& dst)
+    {
+        T *p = ((vaddr % sizeof(T)) == 0)? mm->hostPtr<T, MemAccess::Read>(vaddr) : nullptr;
+
+        if (p == nullptr)
+            return false;
+
+        // Signed types are sign extended, unsigned ones zero extended
+        dst = static_cast<uint32_t>(static_cast<int32_t>(*p));
+        return true;
+    }
+
+    template <typename T>
+    static inline bool laneStore(MemoryManager *mm, VirtualAddr vaddr, uint32_t val)
+    {
+        T *p = ((vaddr % sizeof(T)) == 0)? mm->hostPtr<T, MemAccess::Write>(vaddr) : nullptr;
+
+        if (p == nullptr)
+            return false;
+
+        *p = static_cast<T>(val);
+        return true;
+    }
+
+    SimtEngine::SimtEngine(const VmOperationVector& action_v)
+    : action_v(action_v), is_leader(action_v.size() + 1, false)
+    {
+        code_v.reserve(action_v.size());
+
+        for (const auto& act : action_v)
+        {
+            if (act.dinst)
+                code_v.push_back(*act.dinst);
+            else
+                code_v.push_back({Opcode::Task, 0, 0, 0, 0});
+        }
+
+        // Groups stop before every branch target, that's where lanes that
+        // split can meet again
+        for (const auto& di : code_v)
+        {
+            if (hasStaticTarget(di.opc))
+            {
+                size_t idx = static_cast<VirtualAddr>(di.imm - 0x400000) / 4;
+
+                if (idx < code_v.size())
+                    is_leader[idx] = true;
+            }
+        }
+    }
+
+    void SimtEngine::stopLane(unsigned lane, ErrorCode ecode, size_t idx)
+    {
+        lane_ecode[lane] = ecode;
+        fault_idx[lane] = idx;
+        mask.v[lane] = 0;
+        running.v[lane] = 0;
+    }
+
+    bool SimtEngine::runTask(unsigned lane, size_t idx)
+    {
+        RuntimeContext& ctx = *lane_ctx[lane];
+        uint32_t *lregs = ctx.reg_file.getRegArray();
+        const TaskFunction& task = action_v[idx].task;
+
+        for (unsigned r = 0; r < RegIndex::Pc; r++)
+            lregs[r] = regs[r].v[lane];
+
+        ctx.setPC(0x400000 + (idx + 1) * 4);
+
+        if (task == nullptr)
+        {
+            stopLane(lane, ErrorCode::Bug, idx);
+            return false;
+        }
+
+        ErrorCode ecode = task(ctx);
+
+        for (unsigned r = 0; r <= RegIndex::Pc; r++)
+            regs[r].v[lane] = lregs[r];
+
+        if (ecode != ErrorCode::Ok)
+        {
+            stopLane(lane, ecode, idx);
+            return false;
+        }
+
+        return true;
+    }
+
+    void SimtEngine::runGroup(VirtualAddr pc)
+    {
+        uint32_t *m = mask.v;
+        uint32_t *pc_row = regs[RegIndex::Pc].v;
+        size_t idx = static_cast<VirtualAddr>(pc - 0x400000) / 4;
+
+        for (unsigned l = 0; l < MaxLanes; l++)
+            m[l] = (pc_row[l] == pc)? running.v[l] : 0;
+
+        if (idx >= code_v.size())
+        {
+            for (unsigned l = 0; l < MaxLanes; l++)
+            {
+                if (m[l])
+                    stopLane(l, ErrorCode::InstAddrOutOfRange, idx);
+            }
+            return;
+        }
+
+        while (true)
+        {
+            const DecodedInst& di = code_v[idx];
+            const uint32_t *rs = regs[di.rs].v;
+            const uint32_t *rt = regs[di.rt].v;
+            const uint32_t imm = di.imm;
+            const VirtualAddr next_pc = 0x400000 + (idx + 1) * 4;
+            uint32_t *rd_row = regs[di.rd].v;
+            uint32_t *rt_row = regs[di.rt].v;
+            bool block_end = isBlockEnd(di.opc);
+
+            for (unsigned l = 0; l < MaxLanes; l++)
+                inst_count[l] += m[l] & 1;
+
+            switch (di.opc)
+            {
+                case Opcode::Add:
+                case Opcode::Addi:
+                case Opcode::Sub:
+                {
+                    bool is_sub = (di.opc == Opcode::Sub);
+                    bool is_imm = (di.opc == Opcode::Addi);
+                    uint32_t *dst = is_imm? rt_row : rd_row;
+                    uint32_t ovf = 0;
+
+                    for (unsigned l = 0; l < MaxLanes; l++)
+                    {
+                        uint32_t b = is_imm? imm : rt[l];
+                        uint32_t res = is_sub? rs[l] - b : rs[l] + b;
+                        uint32_t sign = is_sub? (rs[l] ^ b) : ~(rs[l] ^ b);
+
+                        ovf |= sign & (rs[l] ^ res) & m[l];
+                    }
+
+                    // Lanes that overflow stop with the error of the task
+                    if (ovf & 0x80000000)
+                    {
+                        for (unsigned l = 0; l < MaxLanes; l++)
+                        {
+                            uint32_t b = is_imm? imm : rt[l];
+                            uint32_t res = is_sub? rs[l] - b : rs[l] + b;
+                            uint32_t sign = is_sub? (rs[l] ^ b) : ~(rs[l] ^ b);
+
+                            if (m[l] && (sign & (rs[l] ^ res) & 0x80000000))
+                                runTask(l, idx);
+                        }
+                    }
+                    if (is_imm)
+                        laneOp(dst, m, [&](unsigned l) { return rs[l] + imm; });
+                    else if (is_sub)
+                        laneOp(dst, m, [&](unsigned l) { return rs[l] - rt[l]; });
+                    else
+                        laneOp(dst, m, [&](unsigned l) { return rs[l] + rt[l]; });
+                    break;
+                }
+                case Opcode::Addu:
+                    laneOp(rd_row, m, [&](unsigned l) { return rs[l] + rt[l]; });
+                    break;
+                case Opcode::Subu:
+                    laneOp(rd_row, m, [&](unsigned l) { return rs[l] - rt[l]; });
+                    break;
+                case Opcode::Addiu:
+                    laneOp(rt_row, m, [&](unsigned l) { return rs[l] + imm; });
+                    break;
+                case Opcode::And:
+                    laneOp(rd_row, m, [&](unsigned l) { return rs[l] & rt[l]; });
+                    break;
+                case Opcode::Or:
+                    laneOp(rd_row, m, [&](unsigned l) { return rs[l] | rt[l]; });
+                    break;
+                case Opcode::Nor:
+                    laneOp(rd_row, m, [&](unsigned l) { return ~(rs[l] | rt[l]); });
+                    break;
+                case Opcode::Xor:
+                    laneOp(rd_row, m, [&](unsigned l) { return rs[l] ^ rt[l]; });
+                    break;
+                case Opcode::Andi:
+                    laneOp(rt_row, m, [&](unsigned l) { return rs[l] & imm; });
+                    break;
+                case Opcode::Ori:
+                    laneOp(rt_row, m, [&](unsigned l) { return rs[l] | imm; });
+                    break;
+                case Opcode::Xori:
+                    laneOp(rt_row, m, [&](unsigned l) { return rs[l] ^ imm; });
+                    break;
+                case Opcode::Slt:
+                    laneOp(rd_row, m, [&](unsigned l)
+                           { return uint32_t(static_cast<int32_t>(rs[l]) < static_cast<int32_t>(rt[l])); });
+                    break;
+                case Opcode::Sltu:
+                    laneOp(rd_row, m, [&](unsigned l) { return uint32_t(rs[l] < rt[l]); });
+                    break;
+                case Opcode::Slti:
+                    laneOp(rt_row, m, [&](unsigned l)
+                           { return uint32_t(static_cast<int32_t>(rs[l]) < static_cast<int32_t>(imm)); });
+                    break;
+                case Opcode::Sltiu:
+                    laneOp(rt_row, m, [&](unsigned l) { return uint32_t(rs[l] < imm); });
+                    break;
+                case Opcode::Sll:
+                    laneOp(rd_row, m, [&](unsigned l) { return rt[l] << imm; });
+                    break;
+                case Opcode::Srl:
+                    laneOp(rd_row, m, [&](unsigned l) { return rt[l] >> imm; });
+                    break;
+                case Opcode::Sra:
+                    laneOp(rd_row, m, [&](unsigned l) { return uint32_t(static_cast<int32_t>(rt[l]) >> imm); });
+                    break;
+                case Opcode::Sllv:
+                    laneOp(rd_row, m, [&](unsigned l) { return rt[l] << (rs[l] & 0x1f); });
+                    break;
+                case Opcode::Srlv:
+                    laneOp(rd_row, m, [&](unsigned l) { return rt[l] >> (rs[l] & 0x1f); });
+                    break;
+                case Opcode::Srav:
+                    laneOp(rd_row, m, [&](unsigned l)
+                           { return uint32_t(static_cast<int32_t>(rt[l]) >> (rs[l] & 0x1f)); });
+                    break;
+                case Opcode::Lui:
+                case Opcode::Li:
+                case Opcode::La:
+                    laneOp(rt_row, m, [&](unsigned) { return imm; });
+                    break;
+                case Opcode::Move:
+                    laneOp(rd_row, m, [&](unsigned l) { return rs[l]; });
+                    break;
+                case Opcode::Mfhi:
+                {
+                    const uint32_t *hi = regs[RegIndex::Hi].v;
+
+                    laneOp(rd_row, m, [&](unsigned l) { return hi[l]; });
+                    break;
+                }
+                case Opcode::Mflo:
+                {
+                    const uint32_t *lo = regs[RegIndex::Lo].v;
+
+                    laneOp(rd_row, m, [&](unsigned l) { return lo[l]; });
+                    break;
+                }
+                case Opcode::Mthi:
+                    laneOp(regs[RegIndex::Hi].v, m, [&](unsigned l) { return rs[l]; });
+                    break;
+                case Opcode::Mtlo:
+                    laneOp(regs[RegIndex::Lo].v, m, [&](unsigned l) { return rs[l]; });
+                    break;
+                case Opcode::Mult:
+                case Opcode::Multu:
+                case Opcode::Div:
+                case Opcode::Divu:
+                {
+                    uint32_t *lo = regs[RegIndex::Lo].v;
+                    uint32_t *hi = regs[RegIndex::Hi].v;
+
+                    for (unsigned l = 0; l < MaxLanes; l++)
+                    {
+                        if (!m[l])
+                            continue;
+
+                        if (di.opc == Opcode::Mult)
+                        {
+                            int64_t p = extend_cast<int32_t, int64_t>(rs[l])
+                                        * extend_cast<int32_t, int64_t>(rt[l]);
+
+                            lo[l] = p & 0xffffffff;
+                            hi[l] = (p >> 32) & 0xffffffff;
+                        }
+                        else if (di.opc == Opcode::Multu)
+                        {
+                            uint64_t p = static_cast<uint64_t>(rs[l]) * static_cast<uint64_t>(rt[l]);
+
+                            lo[l] = p & 0xffffffff;
+                            hi[l] = p >> 32;
+                        }
+                        else if (rt[l] == 0)
+                        {
+                            continue;
+                        }
+                        else if (di.opc == Opcode::Div)
+                        {
+                            int32_t dividend = static_cast<int32_t>(rs[l]);
+                            int32_t divisor = static_cast<int32_t>(rt[l]);
+
+                            if (dividend == INT32_MIN && divisor == -1)
+                            {
+                                lo[l] = static_cast<uint32_t>(INT32_MIN);
+                                hi[l] = 0;
+                            }
+                            else
+                            {
+                                lo[l] = dividend / divisor;
+                                hi[l] = dividend % divisor;
+                            }
+                        }
+                        else
+                        {
+                            lo[l] = rs[l] / rt[l];
+                            hi[l] = rs[l] % rt[l];
+                        }
+                    }
+                    break;
+                }
+                case Opcode::Beq:
+                    laneOp(pc_row, m, [&](unsigned l) { return (rs[l] == rt[l])? imm : next_pc; });
+                    break;
+                case Opcode::Bne:
+                    laneOp(pc_row, m, [&](unsigned l) { return (rs[l] != rt[l])? imm : next_pc; });
+                    break;
+                case Opcode::Beqz:
+                    laneOp(pc_row, m, [&](unsigned l) { return (rs[l] == 0)? imm : next_pc; });
+                    break;
+                case Opcode::Bnez:
+                    laneOp(pc_row, m, [&](unsigned l) { return (rs[l] != 0)? imm : next_pc; });
+                    break;
+                case Opcode::Bltz:
+                    laneOp(pc_row, m, [&](unsigned l) { return (static_cast<int32_t>(rs[l]) < 0)? imm : next_pc; });
+                    break;
+                case Opcode::Bgez:
+                    laneOp(pc_row, m, [&](unsigned l) { return (static_cast<int32_t>(rs[l]) >= 0)? imm : next_pc; });
+                    break;
+                case Opcode::Blez:
+                    laneOp(pc_row, m, [&](unsigned l) { return (static_cast<int32_t>(rs[l]) <= 0)? imm : next_pc; });
+                    break;
+                case Opcode::Bgtz:
+                    laneOp(pc_row, m, [&](unsigned l) { return (static_cast<int32_t>(rs[l]) > 0)? imm : next_pc; });
+                    break;
+                case Opcode::J:
+                    laneOp(pc_row, m, [&](unsigned) { return imm; });
+                    break;
+                case Opcode::Jal:
+                    laneOp(regs[RegIndex::Ra].v, m, [&](unsigned) { return next_pc; });
+                    laneOp(pc_row, m, [&](unsigned) { return imm; });
+                    break;
+                case Opcode::Jr:
+                    laneOp(pc_row, m, [&](unsigned l) { return rs[l]; });
+                    break;
+                case Opcode::Jalr:
+                    // The target is read before $ra is written, as in jalr $ra
+                    laneOp(pc_row, m, [&](unsigned l) { return rs[l]; });
+                    laneOp(regs[RegIndex::Ra].v, m, [&](unsigned) { return next_pc; });
+                    break;
+                case Opcode::Lw: case Opcode::Lh: case Opcode::Lhu: case Opcode::Lb: case Opcode::Lbu:
+                case Opcode::Sw: case Opcode::Sh: case Opcode::Sb:
+                {
+                    // Every lane has its own memory, so these are done one lane
+                    // at a time. Faulting lanes run the task to get the error.
+                    for (unsigned l = 0; l < MaxLanes; l++)
+                    {
+                        if (!m[l])
+                            continue;
+
+                        MemoryManager *mm = lane_ctx[l]->mm;
+                        VirtualAddr vaddr = rs[l] + imm;
+                        bool ok;
+
+                        switch (di.opc)
+                        {
+                            case Opcode::Lw:
+                                ok = laneLoad<uint32_t>(mm, vaddr, rt_row[l]);
+                                break;
+                            case Opcode::Lh:
+                                ok = laneLoad<int16_t>(mm, vaddr, rt_row[l]);
+                                break;
+                            case Opcode::Lhu:
+                                ok = laneLoad<uint16_t>(mm, vaddr, rt_row[l]);
+                                break;
+                            case Opcode::Lb:
+                                ok = laneLoad<int8_t>(mm, vaddr, rt_row[l]);
+                                break;
+                            case Opcode::Lbu:
+                                ok = laneLoad<uint8_t>(mm, vaddr, rt_row[l]);
+                                break;
+                            case Opcode::Sw:
+                                ok = laneStore<uint32_t>(mm, vaddr, rt[l]);
+                                break;
+                            case Opcode::Sh:
+                                ok = laneStore<uint16_t>(mm, vaddr, rt[l]);
+                                break;
+                            default:
+                                ok = laneStore<uint8_t>(mm, vaddr, rt[l]);
+                        }
+
+                        if (!ok)
+                            runTask(l, idx);
+                    }
+                    break;
+                }
+                case Opcode::Nop:
+                    break;
+                default:
+                    // Syscalls, breaks and commands. The task leaves the PC
+                    // of every lane in its row.
+                    for (unsigned l = 0; l < MaxLanes; l++)
+                    {
+                        if (m[l])
+                            runTask(l, idx);
+                    }
+                    return;
+            }
+
+            regs[RegIndex::Zero] = LaneVector{};
+
+            if (block_end)
+                return;
+
+            idx++;
+            if (idx == code_v.size() || is_leader[idx])
+            {
+                laneOp(pc_row, m, [&](unsigned) { return next_pc; });
+                return;
+            }
+        }
+    }
+
+    void SimtEngine::run(const std::vector<RuntimeContext *>& ctx_v)
+    {
+        const VirtualAddr last_pc = 0x400000 + code_v.size() * 4;
+        unsigned lane_count = std::min<size_t>(ctx_v.size(), MaxLanes);
+
+        lane_ctx = ctx_v;
+
+        for (auto& row : regs)
+            row = LaneVector{};
+        mask = LaneVector{};
+        running = LaneVector{};
+
+        for (unsigned l = 0; l < MaxLanes; l++)
+        {
+            lane_ecode[l] = ErrorCode::Ok;
+            fault_idx[l] = 0;
+            inst_count[l] = 0;
+
+            if (l >= lane_count)
+                continue;
+
+            const uint32_t *lregs = lane_ctx[l]->reg_file.getRegArray();
+
+            for (unsigned r = 0; r <= RegIndex::Pc; r++)
+                regs[r].v[l] = lregs[r];
+
+            running.v[l] = ~0u;
+        }
+
+        while (true)
+        {
+            const uint32_t *pc_row = regs[RegIndex::Pc].v;
+            VirtualAddr pc = UINT32_MAX;
+
+            // Lanes that jumped past the end of the program are done. The
+            // rest of them run in groups starting with the lowest PC.
+            for (unsigned l = 0; l < lane_count; l++)
+            {
+                if (!running.v[l])
+                    continue;
+
+                if (pc_row[l] >= last_pc)
+                    running.v[l] = 0;
+                else if (pc_row[l] < pc)
+                    pc = pc_row[l];
+            }
+
+            if (pc == UINT32_MAX)
+                break;
+
+            runGroup(pc);
+        }
+
+        for (unsigned l = 0; l < lane_count; l++)
+        {
+            uint32_t *lregs = lane_ctx[l]->reg_file.getRegArray();
+
+            for (unsigned r = 0; r <= RegIndex::Pc; r++)
+                lregs[r] = regs[r].v[l];
+        }
+    }
+
+} // namespace Mips32
@@ -1,5 +1,16 @@
+#include <atomic>
 #include <chrono>
+#include <exception>
+#include <sstream>
+#include <thread>
 #include "mips32_vm.h"
+#include "mips32_interp.h"
+#include "mips32_jit.h"
+#include "mips32_simt.h"
+#include "mips32_cgen.h"
+#include "mips32_encoding.h"
+#include "mips32_elf.h"
+#include "mips32_prgcache.h"
 #include "mips32_lexer.h"
 #include "mips32_parser.h"
 #include "easm_error.h"
@@ -10,11 +21,91 @@ using sys_clk = std::chrono::system_clock;
 
 namespace Mips32
 {
+    // A file of the program after parsing. Each file has a node pool of its
+    // own, so the files can be parsed on different threads.
+    struct ParsedSource
+    {
+        std::unique_ptr<Ast::NodePool> node_pool;
+        Ast::AsmProgram *prg = nullptr;
+        std::exception_ptr error;
+    };
+
+    using ParsedSourceVector = std::vector<ParsedSource>;
+
+    static void parseSource(const SourceFile& src, ParsedSource& res)
+    {
+        res.node_pool = std::make_unique<Ast::NodePool>(src.name.c_str(), 1);
+
+        Lexer lexer(*src.text);
+        Parser parser(lexer, *res.node_pool);
+
+        try
+        {
+            res.prg = parser.parse();
+        }
+        catch (...)
+        {
+            res.error = std::current_exception();
+        }
+    }
+
+    // The errors are kept with their file, the caller goes through the files
+    // in order and reports the first one as if they were parsed one by one
+    static ParsedSourceVector parseSources(const SourceFileVector& sources, unsigned thread_count)
+    {
+        ParsedSourceVector parsed(sources.size());
+
+        if (thread_count == 0)
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+        thread_count = std::min<size_t>(thread_count, std::max<size_t>(sources.size(), 1));
+
+        std::atomic<size_t> next_src(0);
+
+        auto work = [&]()
+        {
+            for (size_t idx = next_src++; idx < sources.size(); idx = next_src++)
+                parseSource(sources[idx], parsed[idx]);
+        };
+
+        std::vector<std::thread> threads;
+
+        for (unsigned i = 1; i < thread_count; i++)
+            threads.emplace_back(work);
+
+        work();
+
+        for (auto& th : threads)
+            th.join();
+
+        return parsed;
+    }
+
     void VirtualMachine::init()
     {
-        mem_mgr = std::make_unique<MemoryManager>(mem_map);
-        rt_ctx = std::make_unique<RuntimeContext>(mem_mgr.get(), out);
+        // The memory is only allocated once, a reset goes back to the image
+        // taken then and only costs the pages written since
+        if (mem_mgr == nullptr)
+        {
+            mem_mgr = std::make_unique<MemoryManager>(mem_map);
+            reset_snap = mem_mgr->snapshot();
+        }
+        else
+            mem_mgr->restore(*reset_snap);
+
+        rt_ctx = std::make_unique<RuntimeContext>(mem_mgr.get(), in, out);
         rt_ctx->ext_syscall_handler = ext_sc_handler;
+
+        if (history)
+            history->clear();
+    }
+
+    void VirtualMachine::setHistorySize(size_t size)
+    {
+        if (size == 0)
+            history.reset();
+        else
+            history = std::make_unique<ExecHistory>(size);
     }
 
     int VirtualMachine::processCliInput(const std::string& input)
@@ -44,7 +135,7 @@ namespace Mips32
             if (n_entry->isA(Ast::ExecCmd_kind))
             {
                 Ast::ExecCmd *n_cmd = Ast::node_cast<Ast::ExecCmd>(n_entry);
-                std::string filename = Ast::node_cast<Ast::String>(n_cmd->n_str)->s_val;
+                std::string filename(Ast::node_cast<Ast::String>(n_cmd->n_str)->s_val);
 
                 return exec({filename}, "");    
             }
@@ -52,6 +143,16 @@ namespace Mips32
             {
                 init();
             }
+            else if (n_entry->isA(Ast::CheckpointCmd_kind))
+            {
+                Ast::CheckpointCmd *n_cmd = Ast::node_cast<Ast::CheckpointCmd>(n_entry);
+
+                return checkpoint(std::string(Ast::node_cast<Ast::StrLiteral>(n_cmd->n_str)->s_val));
+            }
+            else if (n_entry->isA(Ast::HistoryCmd_kind))
+            {
+                return historyCmd(Ast::node_cast<Ast::HistoryCmd>(n_entry), n_prg);
+            }
             else if (n_entry->isA(Ast::Inst_kind)
                      || n_entry->isA(Ast::Cmd_kind))
             {
@@ -59,7 +160,16 @@ namespace Mips32
                 VmOperationVector action_v;
                 n_prg->compile(cst, action_v);
 
-                return exec(action_v, 0x400000, 0);
+                if (n_entry->isA(Ast::Inst_kind) || history == nullptr)
+                    return exec(action_v, cst.dbg_table, 0x400000, 0);
+
+                // A command at the prompt isn't a step of the program, it
+                // would get in the way of #undo
+                std::unique_ptr<ExecHistory> saved_history = std::move(history);
+                int res = exec(action_v, cst.dbg_table, 0x400000, 0);
+
+                history = std::move(saved_history);
+                return res;
             }
             else
             {
@@ -77,34 +187,485 @@ namespace Mips32
         return 0;
     }
 
+    int VirtualMachine::historyCmd(Ast::HistoryCmd *n_cmd, Ast::AsmProgram *n_prg)
+    {
+        if (history == nullptr)
+        {
+            last_error = EAsm::Error(cboldText(fcolor::blue, n_cmd->toString()),
+                                     " needs the execution history, turn it on with ",
+                                     boldText("--history-size"), '\n');
+            return 1;
+        }
+        if (!n_cmd->n_arg->isA(Ast::Const_kind))
+        {
+            last_error = EAsm::Error(colorText(fcolor::red, n_cmd->n_arg->toString()),
+                                     " is not a constant\n");
+            return 1;
+        }
+
+        Ast::CompileState cst(0x400000, 0x10000000);
+        uint32_t val = Ast::node_cast<Ast::Immediate>(n_cmd->n_arg)->getImmValue(n_prg, cst);
+
+        switch (n_cmd->op)
+        {
+            case Ast::Hist_Undo:
+                if (val > 0 && history->undo(*rt_ctx, val) == 0)
+                {
+                    last_error = EAsm::Error("There is nothing to undo\n");
+                    return 1;
+                }
+                break;
+
+            case Ast::Hist_Redo:
+                if (val > 0 && history->redo(*rt_ctx, val) == 0)
+                {
+                    last_error = EAsm::Error("There is nothing to redo\n");
+                    return 1;
+                }
+                break;
+
+            default:
+                if (!history->rewind(*rt_ctx, val))
+                {
+                    last_error = EAsm::Error("The instruction at ",
+                                             cboldText(fcolor::red, Cvt::hexVal(val)),
+                                             " hasn't run since the oldest logged one\n");
+                    return 1;
+                }
+                break;
+        }
+
+        out << "pc = " << Cvt::hexVal(rt_ctx->getPC()) << '\n';
+
+        return 0;
+    }
+
     int VirtualMachine::exec(const std::vector<std::string>& input_files,
                              const std::string& entry_label)
     {
-        Ast::NodePool node_pool;
-        std::vector<Ast::AsmProgram *> prg_v;
-        Ast::CompileState cst(0x400000, 0x10000000);
+        if (input_files.size() == 1 && ElfImage::isElf(input_files[0]))
+            return execElf(input_files[0], entry_label);
+
+        return loadProgram(input_files, entry_label,
+            [this](const VmOperationVector& action_v, const DebugTable& dbg_table,
+                   VirtualAddr entry_addr)
+            {
+                // Undoing goes back to the loaded program at most
+                if (history)
+                    history->clear();
+
+                auto time1 = sys_clk::now();
+                int res = exec(action_v, dbg_table, entry_addr, 0);
+                auto time2 = sys_clk::now();
+
+                auto d = std::chrono::duration_cast<std::chrono::microseconds>(time2 - time1);
+                exec_time_us = static_cast<size_t>(d.count());
+
+                return res;
+            });
+    }
+
+    int VirtualMachine::execElf(const std::string& file, const std::string& entry_label)
+    {
+        std::optional<ElfImage> image;
+
+        try
+        {
+            image = ElfImage::load(file);
+        }
+        catch (EAsm::Error& err)
+        {
+            last_error = EAsm::Error(std::move(err));
+            return 1;
+        }
+
+        VirtualAddr entry_addr = image->entry;
+
+        if (!entry_label.empty())
+        {
+            auto it = image->symbols.find(entry_label);
+
+            if (it == image->symbols.end())
+            {
+                last_error = EAsm::Error("Entry point ", cboldText(fcolor::red, entry_label),
+                                         " isn't a symbol of ", colorText(fcolor::green, file), '\n');
+                return 2;
+            }
+            entry_addr = it->second;
+        }
+
+        std::vector<uint32_t> text = image->text();
+        uint64_t text_end = 0x400000 + text.size() * 4;
+        uint64_t gbl_start = UINT64_MAX;
+        uint64_t gbl_end = 0;
+
+        // The global memory starts at the page of the first data segment,
+        // which can be anywhere between the text and the heap, and grows to
+        // take all of them
+        for (const auto& seg : image->segments)
+        {
+            if (!seg.exec)
+            {
+                gbl_start = std::min<uint64_t>(gbl_start, seg.vaddr & ~(MemoryMap::PageSize - 1));
+                gbl_end = std::max<uint64_t>(gbl_end, uint64_t(seg.vaddr) + seg.mem_size);
+            }
+        }
+
+        if (gbl_start == UINT64_MAX)
+            gbl_start = mem_map.gblStartAddr();
+
+        gbl_end = std::max<uint64_t>(gbl_end, gbl_start + mem_map.gblSize());
+
+        uint64_t heap_end = ((gbl_end + MemoryMap::PageSize - 1) & ~(MemoryMap::PageSize - 1))
+                            + mem_map.heapLimit();
+
+        if (gbl_start < ((text_end + MemoryMap::PageSize - 1) & ~(MemoryMap::PageSize - 1))
+            || heap_end > mem_map.stkStartAddr())
+        {
+            last_error = EAsm::Error("The data segments of ", cboldText(fcolor::red, file),
+                                     " don't fit between the code and the stack\n");
+            return 2;
+        }
+
+        // The executable runs with its own layout, the machine goes back to
+        // the configured one when it's done
+        std::optional<MemoryMap> user_map;
+
+        if (gbl_start != mem_map.gblStartAddr() || gbl_end != mem_map.gblEndAddr())
+        {
+            user_map = mem_map;
+            mem_map = MemoryMap(gbl_start, mem_map.stkStartAddr(), gbl_end - gbl_start,
+                                mem_map.stkSize(), mem_map.heapLimit());
+            mem_mgr.reset();
+            init();
+        }
+
+        for (const auto& seg : image->segments)
+        {
+            if (!seg.exec && !seg.bytes.empty())
+                mem_mgr->writeBytes(seg.vaddr, seg.bytes.data(), seg.bytes.size());
+        }
+
+        auto gp = image->symbols.find("_gp");
+
+        if (gp != image->symbols.end())
+            rt_ctx->reg_file.setReg(RegIndex::Gp, gp->second);
+
+        VmOperationVector action_v = compileText(text, entry_addr);
+        DebugTable dbg_table;
+
+        for (size_t i = 0; i < action_v.size(); i++)
+            dbg_table.add(file.c_str(), 0);
+
+        if (history)
+            history->clear();
+
+        prg_text = std::move(text);
+
+        auto time1 = sys_clk::now();
+        int res = exec(action_v, dbg_table, entry_addr, 0);
+        auto time2 = sys_clk::now();
+
+        auto d = std::chrono::duration_cast<std::chrono::microseconds>(time2 - time1);
+        exec_time_us = static_cast<size_t>(d.count());
+
+        prg_text.clear();
+
+        if (user_map)
+        {
+            mem_map = *user_map;
+            mem_mgr.reset();
+            init();
+        }
+
+        return res;
+    }
+
+    int VirtualMachine::checkpoint(const std::string& file)
+    {
+        Checkpoint ckpt(mem_mgr->memMap());
+
+        ckpt.heap_brk = mem_mgr->heapBreak();
+        std::copy_n(rt_ctx->reg_file.getRegArray(), std::size(ckpt.regs), ckpt.regs);
+        ckpt.inst_count = inst_count;
+        ckpt.entry_label = prg_entry;
+        ckpt.sources = prg_sources;
+
+        try
+        {
+            ckpt.save(file, *mem_mgr);
+        }
+        catch (EAsm::Error& err)
+        {
+            last_error = EAsm::Error(std::move(err));
+            return 1;
+        }
+
+        return 0;
+    }
+
+    int VirtualMachine::resume(const std::string& file)
+    {
+        std::optional<Checkpoint> ckpt;
+
+        try
+        {
+            ckpt = Checkpoint::load(file);
+        }
+        catch (EAsm::Error& err)
+        {
+            last_error = EAsm::Error(std::move(err));
+            return 1;
+        }
+
+        // The memory map comes with the checkpoint
+        mem_map = MemoryMap(ckpt->mem_map.gblStartAddr(), ckpt->mem_map.stkStartAddr(),
+                            ckpt->mem_map.gblSize(), ckpt->mem_map.stkSize(),
+                            ckpt->mem_map.heapLimit());
+        mem_mgr.reset();
+        init();
+
+        auto restore_state = [this, &ckpt, &file]()
+        {
+            if (ckpt->image_size != mem_mgr->imageSize()
+                || !mem_mgr->loadImage(file, ckpt->image_ofs, ckpt->mem_map.heapSize(),
+                                       ckpt->heap_brk))
+            {
+                last_error = EAsm::Error("Cannot read the memory image of checkpoint file ",
+                                         cboldText(fcolor::red, file), '\n');
+                return false;
+            }
+
+            std::copy_n(ckpt->regs, std::size(ckpt->regs), rt_ctx->reg_file.getRegArray());
+            inst_count = ckpt->inst_count;
+
+            if (history)
+                history->clear();
+
+            return true;
+        };
+
+        if (ckpt->sources.empty())
+            return restore_state()? 0 : 1;
+
+        // The program is compiled again, its global data is then replaced by
+        // the saved memory
+        return loadProgram(std::move(ckpt->sources), ckpt->entry_label,
+            [this, &restore_state](const VmOperationVector& action_v, const DebugTable& dbg_table,
+                                   VirtualAddr)
+            {
+                if (!restore_state())
+                    return 1;
+
+                auto time1 = sys_clk::now();
+                int res = run(action_v, dbg_table);
+                auto time2 = sys_clk::now();
+
+                auto d = std::chrono::duration_cast<std::chrono::microseconds>(time2 - time1);
+                exec_time_us = static_cast<size_t>(d.count());
+
+                return res;
+            });
+    }
+
+    int VirtualMachine::emitC(const std::vector<std::string>& input_files,
+                              const std::string& entry_label,
+                              std::ostream& c_out)
+    {
+        return loadProgram(input_files, entry_label,
+            [this, &c_out](const VmOperationVector& action_v, const DebugTable& dbg_table,
+                           VirtualAddr entry_addr)
+            {
+                CEmitter cemitter(action_v, dbg_table, *mem_mgr);
+
+                try
+                {
+                    cemitter.emit(c_out, entry_addr);
+                }
+                catch (EAsm::Error& err)
+                {
+                    last_error = EAsm::Error(std::move(err));
+                    return 2;
+                }
+
+                return 0;
+            });
+    }
+
+    int VirtualMachine::disassemble(const std::vector<std::string>& input_files,
+                                    const std::string& entry_label,
+                                    std::ostream& d_out)
+    {
+        return loadProgram(input_files, entry_label,
+            [&d_out](const VmOperationVector& action_v, const DebugTable& dbg_table,
+                     VirtualAddr)
+            {
+                std::vector<uint32_t> text = encodeProgram(action_v);
+
+                for (size_t i = 0; i < text.size(); i++)
+                {
+                    VirtualAddr addr = 0x400000 + i * 4;
+                    EAsm::SrcInfo src_info = dbg_table.srcInfo(i);
+                    std::string inst = Mips32::disassemble(text[i], addr);
+
+                    inst.resize(std::max<size_t>(inst.size(), 28), ' ');
+                    d_out << Cvt::hexVal(addr) << "  " << Cvt::hexVal(text[i]) << "  " << inst
+                          << "; " << src_info.fileName() << ':' << src_info.lineNum() << '\n';
+                }
+
+                return 0;
+            });
+    }
+
+    int VirtualMachine::execLanes(const std::vector<std::string>& input_files,
+                                  const std::string& entry_label,
+                                  const std::vector<std::string>& lane_inputs,
+                                  std::vector<LaneResult>& results)
+    {
+        // Everything a single run owns
+        struct Lane
+        {
+            Lane(const MemoryMap& mmap, const std::string& input)
+            : mm(mmap), in(input), ctx(&mm, in, out)
+            {}
+
+            MemoryManager mm;
+            std::istringstream in;
+            std::ostringstream out;
+            RuntimeContext ctx;
+        };
+
+        return loadProgram(input_files, entry_label,
+            [this, &lane_inputs, &results](const VmOperationVector& action_v,
+                                           const DebugTable& dbg_table,
+                                           VirtualAddr entry_addr)
+            {
+                SimtEngine simt(action_v);
+
+                // Every lane starts from the loaded image and only pays for
+                // the pages it writes
+                mem_mgr->setText(encodeProgram(action_v));
+                auto load_snap = mem_mgr->snapshot();
+
+                results.clear();
+                results.resize(lane_inputs.size());
+                inst_count = 0;
+
+                auto time1 = sys_clk::now();
+
+                for (size_t first = 0; first < lane_inputs.size(); first += SimtEngine::MaxLanes)
+                {
+                    size_t count = std::min<size_t>(lane_inputs.size() - first, SimtEngine::MaxLanes);
+                    std::vector<std::unique_ptr<Lane>> lane_v;
+                    std::vector<RuntimeContext *> ctx_v;
+
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        auto lane = std::make_unique<Lane>(mem_map, lane_inputs[first + i]);
+
+                        lane->mm.restore(*load_snap);
+                        lane->ctx.ext_syscall_handler = ext_sc_handler;
+                        lane->ctx.setPC(entry_addr);
+                        lane->ctx.reg_file.setReg(RegIndex::Ra, 0);
+
+                        ctx_v.push_back(&lane->ctx);
+                        lane_v.push_back(std::move(lane));
+                    }
+
+                    simt.run(ctx_v);
+
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        LaneResult& res = results[first + i];
+
+                        res.inst_count = simt.instCount(i);
+                        res.output = lane_v[i]->out.str();
+                        res.status = engineResult(lane_v[i]->ctx, simt.laneResult(i),
+                                                  simt.faultIndex(i), action_v,
+                                                  dbg_table, res.error);
+                        inst_count += res.inst_count;
+                    }
+                }
+
+                auto time2 = sys_clk::now();
+                auto d = std::chrono::duration_cast<std::chrono::microseconds>(time2 - time1);
+                exec_time_us = static_cast<size_t>(d.count());
+
+                return 0;
+            });
+    }
+
+    int VirtualMachine::loadProgram(const std::vector<std::string>& input_files,
+                                    const std::string& entry_label,
+                                    const ProgramHandler& handler)
+    {
+        SourceFileVector sources;
 
         for (const auto& file : input_files)
         {
-            std::ifstream in(file, std::ios::in);
-            if (!in.is_open())
+            SourceTextPtr text = SourceText::mapFile(file);
+            if (!text)
             {
                 last_error = EAsm::Error("Cannot open file ", cboldText(fcolor::red, file), '\n');
                 return 1;
             }
 
-            node_pool.setCurrFilename(file.c_str());
-            node_pool.setCurrLinenum(1);
+            sources.push_back({file, std::move(text)});
+        }
+
+        return loadProgram(std::move(sources), entry_label, handler);
+    }
+
+    int VirtualMachine::loadProgram(SourceFileVector&& sources,
+                                    const std::string& entry_label,
+                                    const ProgramHandler& handler)
+    {
+        // Only kept while the program runs, so a checkpoint can save them
+        prg_sources = std::move(sources);
+        prg_entry = entry_label;
+
+        int res = compileProgram(handler);
 
-            Lexer lexer(in);
-            Parser parser(lexer, node_pool);
-            
+        prg_sources.clear();
+        prg_entry.clear();
+
+        return res;
+    }
+
+    int VirtualMachine::compileProgram(const ProgramHandler& handler)
+    {
+        ParsedSourceVector parsed;
+        std::vector<Ast::AsmProgram *> prg_v;
+        Ast::CompileState cst(0x400000, 0x10000000);
+        const std::string& entry_label = prg_entry;
+        uint64_t cache_key = 0;
+
+        if (!cache_dir.empty())
+        {
+            ProgramCache cache(cache_dir);
+            VmOperationVector action_v;
+            DebugTable dbg_table;
+            VirtualAddr entry_addr;
+
+            cache_key = ProgramCache::programKey(prg_sources, entry_label, mem_map);
+            if (cache.load(cache_key, *mem_mgr, action_v, dbg_table, entry_addr))
+                return handler(action_v, dbg_table, entry_addr);
+        }
+
+        // The files are parsed at the same time, the addresses and the labels
+        // depend on the files before, so they are resolved in order
+        parsed = parseSources(prg_sources, parse_threads);
+
+        for (auto& src : parsed)
+        {
             try
             {
+                if (src.error)
+                    std::rethrow_exception(src.error);
+
                 cst.vd_addr = ((cst.vd_addr + 3) / 4) * 4;
-                Ast::AsmProgram *prg = parser.parse();
-                prg->resolveLabels(cst);
-                prg_v.push_back(prg);
+                src.prg->resolveLabels(cst);
+                prg_v.push_back(src.prg);
             }
             catch (EAsm::Error& err)
             {
@@ -128,6 +689,7 @@ namespace Mips32
 
         VmOperationVector action_v;
         Ast::AsmEntryVector asm_entry_v;
+        DataBlockVector data_v;
 
         for (const auto prg : prg_v)
         {
@@ -142,9 +704,20 @@ namespace Mips32
             {
                 prg->compile(cst, action_v);
 
-                auto it = mem_mgr->memIter<uint8_t>(prg->virtual_addr);
-                for (auto b : prg->gdata.getData())
-                    *it++ = b;
+                const auto& data = prg->gdata.getData();
+
+                if (data.empty())
+                    continue;
+
+                if (!mem_mgr->isValidAddrRange(prg->virtual_addr, prg->virtual_addr + (data.size() - 1)))
+                {
+                    last_error = EAsm::Error("Global data doesn't fit in the data segment\n");
+                    return 2;
+                }
+                mem_mgr->writeBytes(prg->virtual_addr, data.data(), data.size());
+
+                if (!cache_dir.empty())
+                    data_v.push_back({prg->virtual_addr, data});
             }
             catch (EAsm::Error &err)
             {
@@ -196,26 +769,49 @@ namespace Mips32
 
         VirtualAddr entry_addr = entry_point ? entry_point->virtual_addr : 0x400000;
 
-        auto time1 = sys_clk::now();
-        int res = exec(action_v, entry_addr, 0);
-        auto time2 = sys_clk::now();
-
-        auto d = std::chrono::duration_cast<std::chrono::microseconds>(time2 - time1);
-        exec_time_us = static_cast<size_t>(d.count());
+        if (!cache_dir.empty())
+            ProgramCache(cache_dir).store(cache_key, action_v, cst.dbg_table, data_v, entry_addr);
 
-        return res;
+        return handler(action_v, cst.dbg_table, entry_addr);
     }
 
     int VirtualMachine::exec(const VmOperationVector &action_v,
+                             const DebugTable& dbg_table,
                              VirtualAddr entry_point,
                              VirtualAddr initial_ra)
     {
         rt_ctx->setPC(entry_point);
         rt_ctx->reg_file.setReg(RegIndex::Ra, initial_ra);
 
-        VirtualAddr last_pc = 0x400000 + action_v.size() * 4;
         inst_count = 0;
 
+        return run(action_v, dbg_table);
+    }
+
+    int VirtualMachine::run(const VmOperationVector &action_v, const DebugTable& dbg_table)
+    {
+        // Memory at 0x400000 holds the machine code of the program
+        mem_mgr->setText(prg_text.empty()? encodeProgram(action_v) : prg_text);
+
+        // Only the closure loop logs the instructions it runs
+        if (history)
+            return execClosures(action_v, dbg_table);
+
+        switch (engine)
+        {
+            case ExecEngine::Closure:
+                return execClosures(action_v, dbg_table);
+            case ExecEngine::Jit:
+                return execJit(action_v, dbg_table);
+            default:
+                return execDecoded(action_v, dbg_table);
+        }
+    }
+
+    int VirtualMachine::execClosures(const VmOperationVector &action_v, const DebugTable& dbg_table)
+    {
+        VirtualAddr last_pc = 0x400000 + action_v.size() * 4;
+
         do
         {
             unsigned idx = (rt_ctx->getPC() - 0x400000) / 4;
@@ -228,28 +824,34 @@ namespace Mips32
 
                 return 1;
             }
-            VmOperation act = action_v[idx];
-            rt_ctx->setPC(rt_ctx->getPC() + 4);
+            const TaskFunction& task = action_v[idx].task;
 
-            if (act.task == nullptr)
+            if (task == nullptr)
             {
-                last_error = EAsm::Error(act.src_info, "BUG in the machine, action is null :-(\n");
+                last_error = EAsm::Error(dbg_table.srcInfo(idx), "BUG in the machine, action is null :-(\n");
                 return 3;
             }
 
-            ErrorCode ecode = act.task(*rt_ctx);
+            if (history)
+                history->beginStep(*rt_ctx, action_v[idx]);
+
+            rt_ctx->setPC(rt_ctx->getPC() + 4);
+
+            ErrorCode ecode = task(*rt_ctx);
             inst_count++;
 
+            if (history)
+                history->endStep(*rt_ctx);
+
             if (ecode == ErrorCode::Stop)
                 break;
 
+            if (takeCheckpoint(ecode))
+                continue;
+
             if (ecode != ErrorCode::Ok)
             {
-                if (rt_ctx->last_error.empty())
-                    last_error = EAsm::errorCodeDesc(act.src_info, ecode);
-                else
-                    last_error = std::move(rt_ctx->last_error);
-
+                runtimeError(*rt_ctx, dbg_table.srcInfo(idx), ecode, last_error);
                 return 2;
             }
         } while (rt_ctx->getPC() < last_pc);
@@ -257,4 +859,110 @@ namespace Mips32
         return 0;
     }
 
+    int VirtualMachine::execDecoded(const VmOperationVector &action_v, const DebugTable& dbg_table)
+    {
+        Interpreter interp(action_v);
+        ErrorCode ecode;
+
+        // The only engine that runs the code the program writes, the others
+        // keep the text read only. The text of an executable has its delay
+        // slots, it can't be decoded again.
+        if (prg_text.empty())
+        {
+            interp.loadText(*mem_mgr);
+            mem_mgr->setTextWritable(true);
+        }
+
+        do
+            ecode = interp.run(*rt_ctx, inst_count);
+        while (takeCheckpoint(ecode));
+
+        mem_mgr->setTextWritable(false);
+
+        return engineResult(*rt_ctx, ecode, interp.faultIndex(), action_v, dbg_table, last_error);
+    }
+
+    int VirtualMachine::execJit(const VmOperationVector &action_v, const DebugTable& dbg_table)
+    {
+        JitEngine jit(action_v, mem_map);
+
+        // No native code generation on this host
+        if (!jit.isAvailable())
+            return execDecoded(action_v, dbg_table);
+
+        ErrorCode ecode;
+
+        do
+            ecode = jit.run(*rt_ctx, inst_count);
+        while (takeCheckpoint(ecode));
+
+        // The code of a new block couldn't be made executable, the decoded
+        // engine goes on from where the JIT stopped
+        if (jit.needsFallback())
+            return execDecoded(action_v, dbg_table);
+
+        return engineResult(*rt_ctx, ecode, jit.faultIndex(), action_v, dbg_table, last_error);
+    }
+
+    // The engines stop at a #checkpoint with the PC at the next instruction,
+    // so they can go on from there once it's saved
+    bool VirtualMachine::takeCheckpoint(ErrorCode ecode)
+    {
+        if (ecode != ErrorCode::Checkpoint)
+            return false;
+
+        if (checkpoint(rt_ctx->checkpoint_file) != 0)
+        {
+            rt_ctx->last_error = std::move(last_error);
+            return false;
+        }
+
+        return true;
+    }
+
+    int VirtualMachine::engineResult(RuntimeContext& ctx, ErrorCode ecode, size_t fault_idx,
+                                     const VmOperationVector &action_v,
+                                     const DebugTable& dbg_table, EAsm::Error& error)
+    {
+        switch (ecode)
+        {
+            case ErrorCode::Ok:
+            case ErrorCode::Stop:
+                return 0;
+
+            case ErrorCode::InstAddrOutOfRange:
+                error = EAsm::Error("Runtime error: Invalid instruction address ",
+                                    cboldText(fcolor::red, Cvt::hexVal(ctx.getPC())),
+                                    '\n');
+                return 1;
+
+            case ErrorCode::Bug:
+                if (action_v[fault_idx].task == nullptr)
+                {
+                    error = EAsm::Error(dbg_table.srcInfo(fault_idx),
+                                        "BUG in the machine, action is null :-(\n");
+                    return 3;
+                }
+                [[fallthrough]];
+
+            default:
+                runtimeError(ctx, dbg_table.srcInfo(fault_idx), ecode, error);
+                return 2;
+        }
+    }
+
+    void VirtualMachine::runtimeError(RuntimeContext& ctx, const EAsm::SrcInfo& src_info,
+                                      ErrorCode ecode, EAsm::Error& error)
+    {
+        if (ctx.last_error.empty())
+        {
+            error = EAsm::errorCodeDesc(src_info, ecode);
+        }
+        else
+        {
+            error = std::move(ctx.last_error);
+            error.setSrcInfo(src_info);
+        }
+    }
+
 } // namespace Mips32
\ No newline at end of file
@@ -0,0 +1,244 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+
+#include <cstdint>
+#include <vector>
+#include "doctest.h"
+#include "mem_iterator.h"
+#include "mips32_runtime.h"
+
+const VirtualAddr gbl_start = 0x10000000;
+const VirtualAddr stk_end = 0x7fffeffc;
+const size_t gbl_size = 8192;
+const size_t stk_size = 1024;
+const VirtualAddr stk_start = stk_end - stk_size;
+
+const Mips32::MemoryMap mmap(gbl_start, stk_start, gbl_size, stk_size);
+
+TEST_CASE("Memory iterator big endian view")
+{
+    alignas(4) uint8_t mem[8];
+
+    *MemIterator<uint32_t>(mem, ByteOrder::BigEndian, 0) = 0x11223344;
+    *MemIterator<uint32_t>(mem, ByteOrder::BigEndian, 4) = 0xaabbccdd;
+
+    SUBCASE("Bytes")
+    {
+        MemIterator<uint8_t> it(mem, ByteOrder::BigEndian);
+        std::vector<uint8_t> bytes;
+
+        for (int i = 0; i < 8; i++)
+            bytes.push_back(*it++);
+
+        CHECK(bytes == std::vector<uint8_t>{0x11, 0x22, 0x33, 0x44, 0xaa, 0xbb, 0xcc, 0xdd});
+    }
+
+    SUBCASE("Half words")
+    {
+        MemIterator<uint16_t> it(mem, ByteOrder::BigEndian);
+        std::vector<uint16_t> hwords;
+
+        for (int i = 0; i < 4; i++)
+            hwords.push_back(*it++);
+
+        CHECK(hwords == std::vector<uint16_t>{0x1122, 0x3344, 0xaabb, 0xccdd});
+    }
+
+    SUBCASE("Words")
+    {
+        MemIterator<uint32_t> it(mem, ByteOrder::BigEndian);
+
+        CHECK(*it++ == 0x11223344);
+        CHECK(*it == 0xaabbccdd);
+    }
+
+    SUBCASE("Store")
+    {
+        MemIterator<uint8_t> it(mem, ByteOrder::BigEndian, 4);
+
+        *it++ = 0x01;
+        *it++ = 0x02;
+        CHECK(*MemIterator<uint32_t>(mem, ByteOrder::BigEndian, 4) == 0x0102ccdd);
+    }
+}
+
+TEST_CASE("Memory iterator little endian view")
+{
+    alignas(4) uint8_t mem[4];
+
+    *MemIterator<uint32_t>(mem, ByteOrder::LittleEndian) = 0x11223344;
+
+    MemIterator<uint8_t> it(mem, ByteOrder::LittleEndian);
+    std::vector<uint8_t> bytes;
+
+    for (int i = 0; i < 4; i++)
+        bytes.push_back(*it++);
+
+    CHECK(bytes == std::vector<uint8_t>{0x44, 0x33, 0x22, 0x11});
+}
+
+TEST_CASE("Memory manager host pointers match the memory iterator")
+{
+    Mips32::MemoryManager mm(mmap);
+
+    for (VirtualAddr start : {gbl_start, stk_start})
+    {
+        for (uint32_t i = 0; i < 64; i++)
+            *mm.memIter<uint8_t>(start + i) = static_cast<uint8_t>(i * 7 + 1);
+
+        for (VirtualAddr vaddr = start; vaddr < start + 64; vaddr++)
+        {
+            CHECK(mm.hostPtr<uint8_t>(vaddr) == &*mm.memIter<uint8_t>(vaddr));
+            CHECK(mm.hostPtr<uint16_t>(vaddr) == &*mm.memIter<uint16_t>(vaddr));
+            if ((vaddr % 4) == 0)
+                CHECK(mm.hostPtr<uint32_t, Mips32::MemAccess::Write>(vaddr) == &*mm.memIter<uint32_t>(vaddr));
+        }
+    }
+
+    // Accesses across the end of a region are rejected
+    CHECK(mm.hostPtr<uint32_t>(gbl_start + gbl_size) == nullptr);
+    CHECK(mm.hostPtr<uint16_t>(gbl_start + gbl_size - 1) == nullptr);
+    CHECK(mm.hostPtr<uint8_t>(stk_start - 1) == nullptr);
+    CHECK(mm.hostPtr<uint8_t>(stk_end - 1) != nullptr);
+    CHECK(mm.hostPtr<uint8_t>(stk_end) == nullptr);
+    CHECK_FALSE(mm.isValidAddrRange(gbl_start + gbl_size - 4, stk_start));
+}
+
+TEST_CASE("Memory manager bulk copies")
+{
+    Mips32::MemoryManager mm(mmap);
+    std::vector<uint8_t> src(100);
+
+    for (size_t i = 0; i < src.size(); i++)
+        src[i] = static_cast<uint8_t>(i + 1);
+
+    // Every alignment of the start and the end, and one copy crossing a page
+    for (VirtualAddr vaddr : {gbl_start, gbl_start + 1, gbl_start + 2, gbl_start + 3,
+                              gbl_start + 4090, stk_start + 5})
+    {
+        for (size_t n : {0, 1, 3, 4, 7, 16, 33, 100})
+        {
+            mm.writeBytes(vaddr, src.data(), n);
+
+            auto it = mm.memIter<uint8_t>(vaddr);
+            bool same = true;
+
+            for (size_t i = 0; i < n; i++)
+                same = same && (*it++ == src[i]);
+
+            CHECK(same);
+
+            std::vector<uint8_t> dst(n);
+
+            mm.readBytes(vaddr, dst.data(), n);
+            CHECK(dst == std::vector<uint8_t>(src.begin(), src.begin() + n));
+        }
+    }
+
+    // Bytes next to the copied range are left untouched
+    mm.writeBytes(gbl_start, std::vector<uint8_t>(12, 0).data(), 12);
+    mm.writeBytes(gbl_start + 1, src.data(), 6);
+    CHECK(*mm.memIter<uint8_t>(gbl_start) == 0);
+    CHECK(*mm.memIter<uint8_t>(gbl_start + 7) == 0);
+    CHECK(*mm.memIter<uint32_t>(gbl_start) == 0x00010203);
+    CHECK(*mm.memIter<uint32_t>(gbl_start + 4) == 0x04050600);
+}
+
+TEST_CASE("Memory manager copy")
+{
+    Mips32::MemoryManager mm1(mmap);
+    Mips32::MemoryManager mm2(mmap);
+
+    *mm1.hostPtr<uint32_t, Mips32::MemAccess::Write>(gbl_start + 4) = 0x12345678;
+    *mm1.hostPtr<uint8_t, Mips32::MemAccess::Write>(gbl_start + 5000) = 0x9a;
+    *mm1.hostPtr<uint16_t, Mips32::MemAccess::Write>(stk_end - 2) = 0xbcde;
+
+    mm2.copyFrom(mm1);
+    CHECK(*mm2.hostPtr<uint32_t>(gbl_start + 4) == 0x12345678);
+    CHECK(*mm2.hostPtr<uint8_t>(gbl_start + 5000) == 0x9a);
+    CHECK(*mm2.hostPtr<uint16_t>(stk_end - 2) == 0xbcde);
+    CHECK(*mm2.hostPtr<uint32_t>(gbl_start + 4096) == 0);
+}
+
+TEST_CASE("Memory manager snapshot")
+{
+    const Mips32::MemoryMap heap_mmap(gbl_start, stk_start, gbl_size, stk_size, 16384);
+    Mips32::MemoryManager mm1(heap_mmap);
+    VirtualAddr brk;
+
+    *mm1.hostPtr<uint32_t, Mips32::MemAccess::Write>(gbl_start + 8) = 0xcafe0001;
+    *mm1.hostPtr<uint8_t, Mips32::MemAccess::Write>(stk_end - 1) = 0x42;
+    REQUIRE(mm1.sbrk(100, brk));
+
+    auto snap = mm1.snapshot();
+
+    // The memory is still the same after taking it
+    CHECK(*mm1.hostPtr<uint32_t>(gbl_start + 8) == 0xcafe0001);
+
+    *mm1.hostPtr<uint32_t, Mips32::MemAccess::Write>(gbl_start + 8) = 0;
+    *mm1.hostPtr<uint32_t, Mips32::MemAccess::Write>(gbl_start + 4096) = 0x77;
+    REQUIRE(mm1.sbrk(8000, brk));
+    *mm1.hostPtr<uint32_t, Mips32::MemAccess::Write>(heap_mmap.heapStartAddr() + 8000) = 0x99;
+
+    for (int i = 0; i < 2; i++)
+    {
+        mm1.restore(*snap);
+        CHECK(*mm1.hostPtr<uint32_t>(gbl_start + 8) == 0xcafe0001);
+        CHECK(*mm1.hostPtr<uint8_t>(stk_end - 1) == 0x42);
+        CHECK(*mm1.hostPtr<uint32_t>(gbl_start + 4096) == 0);
+        CHECK(mm1.hostPtr<uint32_t>(heap_mmap.heapStartAddr() + 8000) == nullptr);
+        REQUIRE(mm1.sbrk(4, brk));
+        CHECK(brk == heap_mmap.heapStartAddr() + 100);
+        *mm1.hostPtr<uint32_t, Mips32::MemAccess::Write>(gbl_start + 8) = 1;
+    }
+
+    // Another memory manager with the same memory map
+    Mips32::MemoryManager mm2(heap_mmap);
+
+    *mm2.hostPtr<uint32_t, Mips32::MemAccess::Write>(gbl_start + 12) = 5;
+    mm2.restore(*snap);
+    CHECK(*mm2.hostPtr<uint32_t>(gbl_start + 8) == 0xcafe0001);
+    CHECK(*mm2.hostPtr<uint32_t>(gbl_start + 12) == 0);
+    CHECK(*mm1.hostPtr<uint32_t>(gbl_start + 8) == 1);
+
+    // An empty image clears the memory
+    Mips32::MemoryManager mm3(heap_mmap);
+    auto empty_snap = mm3.snapshot();
+
+    mm1.restore(*empty_snap);
+    CHECK(*mm1.hostPtr<uint32_t>(gbl_start + 8) == 0);
+    CHECK(*mm1.hostPtr<uint8_t>(stk_end - 1) == 0);
+    CHECK(heap_mmap.heapStartAddr() == mm1.memMap().heapEndAddr());
+}
+
+TEST_CASE("Memory manager text")
+{
+    Mips32::MemoryManager mm(mmap);
+
+    mm.setText({0x24080005, 0x0000000c});
+
+    CHECK(*mm.hostPtr<uint32_t>(0x400000) == 0x24080005);
+    CHECK(*mm.hostPtr<uint8_t>(0x400000) == 0x24);
+    CHECK(*mm.hostPtr<uint16_t>(0x400006) == 0x000c);
+    CHECK(mm.hostPtr<uint32_t>(0x400008) == nullptr);
+    CHECK(mm.hostPtr<uint32_t>(0x400002) == nullptr);
+    CHECK_FALSE(mm.isValidAddr(0x400000));
+
+    // Read only until it's allowed, every write is recorded
+    CHECK(mm.hostPtr<uint32_t, Mips32::MemAccess::Write>(0x400004) == nullptr);
+    CHECK_FALSE(mm.textDirty());
+
+    mm.setTextWritable(true);
+    *mm.hostPtr<uint8_t, Mips32::MemAccess::Write>(0x400007) = 0x0d;
+    CHECK(mm.textDirty());
+    CHECK(mm.takeTextDirty() == std::vector<uint32_t>{1});
+    CHECK_FALSE(mm.textDirty());
+    CHECK(*mm.hostPtr<uint32_t>(0x400004) == 0x0000000d);
+
+    // Snapshots carry the text
+    auto snap = mm.snapshot();
+
+    mm.setText({});
+    CHECK(mm.hostPtr<uint32_t>(0x400000) == nullptr);
+    mm.restore(*snap);
+    CHECK(mm.textWords() == std::vector<uint32_t>{0x24080005, 0x0000000d});
+}
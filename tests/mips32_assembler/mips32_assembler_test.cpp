@@ -9,6 +9,8 @@
 #include "easm_error.h"
 #include "mips32_ast.h"
 #include "mips32_assembler.h"
+#include "mips32_encoding.h"
+#include "mips32_names.h"
 
 #define _AsmPrg node_pool.AsmProgramCreate
 #define _Global(lbl) node_pool.GlobalDirCreate(lbl)
@@ -266,7 +268,7 @@ TEST_CASE("Resolve labels in code")
 
     CHECK( it4->second->virtual_addr == 0x400014 );
 
-    const Ast::AsmEntryVector& asm_entries = prg->asm_entries;
+    const Ast::AsmEntryArray& asm_entries = prg->asm_entries;
     for (int i = 0; i < asm_entries.size(); i++)
     {
         INFO("Stmt: " << asm_entries[i]->toString());
@@ -362,6 +364,28 @@ TEST_CASE("Mips32 ISA API")
     const Mips32::InstInfo *ii = Asm::getInstInfo("lw");
     REQUIRE(ii);
     CHECK(ii->sig.arg_count == 2);
+
+    // Both names of every register, and names that only look like one
+    for (int i = 0; i < int(Mips32::Names::RegCount); i++)
+    {
+        CHECK(Asm::getRegIndex(Mips32::Names::reg_names[i].name) == i);
+        CHECK(Asm::getRegIndex(Mips32::Names::reg_names[i].num_name) == i);
+    }
+    CHECK(Asm::getRegIndex("$r35") == -1);
+    CHECK(Asm::getRegIndex("$t") == -1);
+    CHECK(Asm::getRegIndex("") == -1);
+
+    // The key doesn't have to be a whole string
+    std::string line = "lwc1 swc1";
+    CHECK(Asm::getInstInfo(std::string_view(line).substr(0, 2)) == ii);
+    CHECK(Asm::getInstInfo(std::string_view(line).substr(0, 3)) == nullptr);
+
+    for (const auto& entry : Mips32::Names::mnemonics)
+    {
+        const Mips32::InstInfo *info = Asm::getInstInfo(entry.name);
+        REQUIRE(info);
+        CHECK(entry.name == info->name);
+    }
 }
 
 void testInst(Mips32::RuntimeContext& ctx, Mips32::Opcode opc,
@@ -369,7 +393,7 @@ void testInst(Mips32::RuntimeContext& ctx, Mips32::Opcode opc,
 {
     Mips32::VmOperation act;
 
-    Mips32::TaskFunction task = Asm::compileInst(opc, args, EAsm::SrcInfo("Test case", 0));
+    Mips32::TaskFunction task = Asm::compileInst(opc, args);
     
     REQUIRE(task != nullptr); 
     ErrorCode err = task(ctx);
@@ -2237,4 +2261,91 @@ TEST_CASE("Data Definition 2")
     }
 
     CHECK( success );
-}
\ No newline at end of file
+}
+TEST_CASE("Mips32 assembler: machine code")
+{
+    struct EncodingTest
+    {
+        opc opcode;
+        std::vector<uint32_t> argv;
+        uint32_t word;
+        const char *text;
+    };
+
+    const VirtualAddr pc = 0x400010;
+    const EncodingTest tests[] = {
+        {opc::Addu, {Reg::t0, Reg::t1, Reg::t2}, 0x012a4021, "addu $t0, $t1, $t2"},
+        {opc::Sll, {Reg::t0, Reg::t1, 4}, 0x00094100, "sll $t0, $t1, 4"},
+        {opc::Srav, {Reg::t0, Reg::t1, Reg::t2}, 0x01494007, "srav $t0, $t1, $t2"},
+        {opc::Addiu, {Reg::Sp, Reg::Sp, 0xfff8}, 0x27bdfff8, "addiu $sp, $sp, -8"},
+        {opc::Ori, {Reg::t0, Reg::Zero, 0xff00}, 0x3408ff00, "ori $t0, $zero, 0xff00"},
+        {opc::Lui, {Reg::At, 0x1000}, 0x3c011000, "lui $at, 0x1000"},
+        {opc::Lw, {Reg::Ra, 4, Reg::Sp}, 0x8fbf0004, "lw $ra, 4($sp)"},
+        {opc::Sb, {Reg::t0, 0xffff, Reg::s0}, 0xa208ffff, "sb $t0, -1($s0)"},
+        {opc::Mult, {Reg::s0, Reg::v0}, 0x02020018, "mult $s0, $v0"},
+        {opc::Mflo, {Reg::v0}, 0x00001012, "mflo $v0"},
+        {opc::Jr, {Reg::Ra}, 0x03e00008, "jr $ra"},
+        {opc::Jalr, {Reg::t1}, 0x0120f809, "jalr $t1"},
+        {opc::Beq, {Reg::t0, Reg::t1, 0x400000}, 0x1109fffb, "beq $t0, $t1, 0x00400000"},
+        {opc::Bnez, {Reg::t0, 0x400038}, 0x15000009, "bnez $t0, 0x00400038"},
+        {opc::Bgez, {Reg::t0, 0x400020}, 0x05010003, "bgez $t0, 0x00400020"},
+        {opc::J, {0x400000}, 0x08100000, "j 0x00400000"},
+        {opc::Jal, {0x40004c}, 0x0c100013, "jal 0x0040004c"},
+        {opc::Move, {Reg::s0, Reg::a0}, 0x00808021, "move $s0, $a0"},
+        {opc::Break, {5}, 0x0000014d, "break 5"},
+        {opc::Syscall, {}, 0x0000000c, "syscall"},
+        {opc::Nop, {}, 0x00000000, "nop"},
+    };
+
+    for (const auto& test : tests)
+    {
+        INFO(test.text);
+
+        auto di = Asm::decodeInst(test.opcode, test.argv);
+        REQUIRE( di.has_value() );
+        CHECK( Mips32::encodeInst(*di, pc) == test.word );
+
+        auto ddi = Mips32::decodeWord(test.word, pc);
+        REQUIRE( ddi.has_value() );
+        CHECK( ddi->opc == test.opcode );
+        CHECK( ddi->imm == di->imm );
+
+        // The arguments compile to the same instruction
+        auto adi = Asm::decodeInst(ddi->opc, Asm::instArgs(*ddi));
+        REQUIRE( adi.has_value() );
+        CHECK( Mips32::encodeInst(*adi, pc) == test.word );
+        CHECK( Mips32::disassemble(test.word, pc) == test.text );
+    }
+
+    SUBCASE("Pseudo instructions")
+    {
+        auto li = [pc](uint32_t val)
+        { return Mips32::encodeInst(*Asm::decodeInst(opc::Li, {Reg::t0, val}), pc); };
+
+        CHECK( li(0xfffffffb) == 0x2408fffb );
+        CHECK( li(0xffff) == 0x3408ffff );
+        CHECK( li(0x10010000) == 0x3c081001 );
+        CHECK_FALSE( li(0x10010004).has_value() );
+    }
+
+    SUBCASE("Out of reach")
+    {
+        auto far_beq = Asm::decodeInst(opc::Beq, {Reg::t0, Reg::t1, pc + 0x40000});
+        auto far_j = Asm::decodeInst(opc::J, {0x10000000});
+
+        CHECK_FALSE( Mips32::encodeInst(*far_beq, pc).has_value() );
+        CHECK_FALSE( Mips32::encodeInst(*far_j, pc).has_value() );
+    }
+
+    SUBCASE("Words that aren't instructions")
+    {
+        CHECK_FALSE( Mips32::decodeWord(Mips32::pseudoWord(7), pc).has_value() );
+        CHECK_FALSE( Mips32::decodeWord(0xffffffff, pc).has_value() );
+
+        // A syscall with a shift amount
+        CHECK_FALSE( Mips32::decodeWord(0x0000004c, pc).has_value() );
+
+        CHECK( Mips32::disassemble(Mips32::pseudoWord(7), pc) == "<operation 7>" );
+        CHECK( Mips32::disassemble(0xffffffff, pc) == ".word 0xffffffff" );
+    }
+}
@@ -1,5 +1,7 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 
+#include <filesystem>
+#include <fstream>
 #include <sstream>
 #include <string>
 #include "doctest.h"
@@ -22,6 +24,10 @@ using Token = Mips32::Token;
 #define KW_STOP { Token::KwStop, "#stop" }
 #define KW_DEBUG { Token::KwDebug, "#debug" }
 #define KW_RESET { Token::KwReset, "#reset" }
+#define KW_CHECKPOINT { Token::KwCheckpoint, "#checkpoint" }
+#define KW_UNDO { Token::KwUndo, "#undo" }
+#define KW_REDO { Token::KwRedo, "#redo" }
+#define KW_REWIND { Token::KwRewind, "#rewind" }
 #define KW_SEP { Token::KwSep, "sep" }
 #define KW_BYTE { Token::KwByte, "byte" }
 #define KW_HWORD { Token::KwHword, "hword" }
@@ -140,6 +146,10 @@ const char *test1 = ".global "
                     "#stop "
                     "#debug "
                     "#reset "
+                    "#checkpoint "
+                    "#undo "
+                    "#redo "
+                    "#rewind "
                     "sep "
                     "byte "
                     "hword "
@@ -185,6 +195,10 @@ TokenInfo test1Exp[] = {
     KW_STOP,
     KW_DEBUG,
     KW_RESET,
+    KW_CHECKPOINT,
+    KW_UNDO,
+    KW_REDO,
+    KW_REWIND,
     IDENT("sep"),
     KW_BYTE,
     KW_HWORD,
@@ -309,3 +323,83 @@ TEST_CASE("MIPS32 lexer test 4: Set keywords") {
         tk = lexer.getNextToken();
     }
 }
+
+TEST_CASE("MIPS32 lexer test 5: Tokens point into the source") {
+    std::string long_str(3 * LEX_BUFF_SIZE, 'a');
+    std::istringstream in(".byte \"" + long_str + "\"\nmain: addi $t0, $t0, -1\n");
+    Mips32::Lexer lexer(in);
+    std::vector<Token> tokens;
+
+    for (Token tk = lexer.getNextToken(); tk.token_id != Token::Eof; tk = lexer.getNextToken())
+        tokens.push_back(tk);
+
+    // The text of every token is still there after the whole input is read
+    REQUIRE( tokens.size() == 11 );
+    CHECK( tokens[0] == TokenInfo KW_DOTBYTE );
+    CHECK( tokens[1] == TokenInfo STRLITERAL(long_str.c_str()) );
+    CHECK( tokens[3] == TokenInfo LABEL("main:") );
+    CHECK( tokens[5] == TokenInfo REGNAME("$t0") );
+    CHECK( tokens[9] == TokenInfo DEC_CONST("-1") );
+    CHECK( tokens[10] == TokenInfo EOL );
+    CHECK( lexer.getNextToken() == TokenInfo TK_EOF );
+}
+
+TEST_CASE("MIPS32 lexer test 6: Mapped source file") {
+    namespace fs = std::filesystem;
+
+    // The file ends with a token right at a page boundary, what comes
+    // after it must read as the end of the input
+    std::string text;
+    while (text.size() < 4096 - 32)
+        text += "loop: addi $t0, $t0, -1\n";
+    text += std::string(4096 - text.size() - 4, ' ') + "main";
+
+    fs::path src_file(fs::temp_directory_path() / "easymips-test-lexer.asm");
+    {
+        std::ofstream out(src_file, std::ios::out | std::ios::binary);
+        out << text;
+    }
+
+    Mips32::SourceTextPtr src = Mips32::SourceText::mapFile(src_file.string());
+    REQUIRE( src != nullptr );
+    CHECK( src->text() == text );
+
+    std::istringstream in(text);
+    Mips32::Lexer lexer(*src);
+    Mips32::Lexer in_lexer(in);
+    size_t count = 0;
+
+    for (;;) {
+        Token tk = lexer.getNextToken();
+        Token in_tk = in_lexer.getNextToken();
+
+        INFO("Token: " << count);
+        REQUIRE( tk.token_id == in_tk.token_id );
+        REQUIRE( tk.text == in_tk.text );
+        REQUIRE( tk.line_num == in_tk.line_num );
+        if (tk.token_id == Token::Eof)
+            break;
+        count++;
+    }
+    CHECK( count > 0 );
+
+    // The copy of a string lexes the same way, an empty one is just the end
+    Mips32::SourceText copy("main");
+    Mips32::Lexer copy_lexer(copy);
+    CHECK( copy_lexer.getNextToken() == TokenInfo IDENT("main") );
+    CHECK( copy_lexer.getNextToken() == TokenInfo TK_EOF );
+
+    Mips32::SourceText empty("");
+    Mips32::Lexer empty_lexer(empty);
+    CHECK( empty_lexer.getNextToken() == TokenInfo TK_EOF );
+
+    // An empty file has nothing to map, only the padding
+    std::ofstream(src_file, std::ios::out | std::ios::trunc).close();
+    src = Mips32::SourceText::mapFile(src_file.string());
+    REQUIRE( src != nullptr );
+    Mips32::Lexer empty_file_lexer(*src);
+    CHECK( empty_file_lexer.getNextToken() == TokenInfo TK_EOF );
+
+    fs::remove(src_file);
+    CHECK( Mips32::SourceText::mapFile(src_file.string()) == nullptr );
+}
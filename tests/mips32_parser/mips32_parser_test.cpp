@@ -145,7 +145,7 @@ TEST_CASE("Parser + AST")
             Ast::AsmProgram *prg = parser.parse();
             REQUIRE( prg );
             
-            const Ast::AsmEntryVector& asm_entries = prg->asm_entries;
+            const Ast::AsmEntryArray& asm_entries = prg->asm_entries;
 
             int lines[] = {3, 4, 6, 8, 9, 10, 10, 10, 12, 14, 16};
             REQUIRE( asm_entries.size() == sizeof(lines)/sizeof(lines[0]) );
@@ -0,0 +1,33 @@
+; Program without debugger commands, it can be translated with --emit-c
+.data
+values: .word 7, -3, 12, 25
+msg: .byte "Sum = ", 0
+
+.text
+main:
+    la $t0, values
+    li $t1, 4
+    li $a0, 0
+loop:
+    lw $t2, 0($t0)
+    addu $a0, $a0, $t2
+    addiu $t0, $t0, 4
+    addiu $t1, $t1, -1
+    bne $t1, $zero, loop
+
+    move $s0, $a0
+    la $a0, msg
+    li $v0, 4
+    syscall
+    move $a0, $s0
+    jal print_int
+    li $v0, 10
+    syscall
+
+print_int:
+    li $v0, 1
+    syscall
+    li $a0, 10
+    li $v0, 11
+    syscall
+    jr $ra
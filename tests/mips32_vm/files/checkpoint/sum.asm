@@ -0,0 +1,37 @@
+; Sums 1..10 printing the partial sums, saves a checkpoint after the 5th
+; and writes the running total to the heap
+.data
+total: .word 0
+.text
+main:
+    li $a0, 64
+    li $v0, 9
+    syscall
+    move $s1, $v0
+    li $t0, 1
+    li $s0, 0
+loop:
+    addu $s0, $s0, $t0
+    la $t2, total
+    sw $s0, 0($t2)
+    sw $s0, 0($s1)
+    move $a0, $s0
+    li $v0, 1
+    syscall
+    li $a0, 32
+    li $v0, 11
+    syscall
+    li $t1, 5
+    bne $t0, $t1, next
+#checkpoint "sum.ckpt"
+next:
+    addiu $t0, $t0, 1
+    li $t1, 11
+    bne $t0, $t1, loop
+    la $t2, total
+    lw $a0, 0($t2)
+    li $v0, 1
+    syscall
+    li $a0, 10
+    li $v0, 11
+    syscall
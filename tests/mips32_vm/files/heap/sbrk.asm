@@ -0,0 +1,54 @@
+; Allocates two blocks with sbrk, the second one across a page boundary,
+; and prints their distance, the sum of a word array written to the second
+; one and a byte written to the first one. Then asks for more than the
+; heap limit.
+.text
+main:
+    li $a0, 10
+    li $v0, 9
+    syscall
+    move $s0, $v0
+    li $a0, 8000
+    li $v0, 9
+    syscall
+    move $s1, $v0
+    li $t0, 0
+    li $t1, 2000
+fill:
+    sll $t2, $t0, 2
+    addu $t2, $t2, $s1
+    sw $t0, 0($t2)
+    addiu $t0, $t0, 1
+    bne $t0, $t1, fill
+    li $t0, 0
+    li $v1, 0
+sum:
+    sll $t2, $t0, 2
+    addu $t2, $t2, $s1
+    lw $t3, 0($t2)
+    addu $v1, $v1, $t3
+    addiu $t0, $t0, 1
+    bne $t0, $t1, sum
+    sb $t1, 3($s0)
+    lbu $t4, 3($s0)
+    subu $a0, $s1, $s0
+    li $v0, 1
+    syscall
+    li $a0, 32
+    li $v0, 11
+    syscall
+    move $a0, $v1
+    li $v0, 1
+    syscall
+    li $a0, 32
+    li $v0, 11
+    syscall
+    move $a0, $t4
+    li $v0, 1
+    syscall
+    li $a0, 10
+    li $v0, 11
+    syscall
+    li $a0, 65536
+    li $v0, 9
+    syscall
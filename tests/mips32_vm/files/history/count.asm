@@ -0,0 +1,18 @@
+; Counts to 10 storing the count to a global word and to the first byte
+; of a block taken from the heap
+.data
+count: .word 0
+.text
+main:
+    li $a0, 16
+    li $v0, 9
+    syscall
+    move $s1, $v0
+    li $t0, 0
+loop:
+    addiu $t0, $t0, 1
+    sb $t0, 0($s1)
+    la $t2, count
+    sw $t0, 0($t2)
+    li $t1, 10
+    bne $t0, $t1, loop
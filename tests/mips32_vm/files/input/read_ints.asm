@@ -0,0 +1,42 @@
+; Reads a count and then that many numbers with a single syscall 60. Prints
+; their sum, how many were read and the number on the line that follows.
+.data
+nums: .word 0, 0, 0, 0, 0, 0, 0, 0
+
+.text
+main:
+    li $v0, 5
+    syscall
+    move $a1, $v0
+    la $a0, nums
+    li $v0, 60
+    syscall
+    move $t0, $v0
+    move $t1, $zero
+    la $t2, nums
+    move $t3, $t0
+    beqz $t3, print
+sum:
+    lw $t4, 0($t2)
+    addu $t1, $t1, $t4
+    addiu $t2, $t2, 4
+    addiu $t3, $t3, -1
+    bnez $t3, sum
+print:
+    move $a0, $t1
+    jal print_int
+    move $a0, $t0
+    jal print_int
+    li $v0, 5
+    syscall
+    move $a0, $v0
+    jal print_int
+    li $v0, 10
+    syscall
+print_int:
+    li $v0, 1
+    syscall
+    li $a0, 10
+    li $v0, 11
+    syscall
+    jr $ra
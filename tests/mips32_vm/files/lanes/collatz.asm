@@ -0,0 +1,45 @@
+; Prints the number of Collatz steps of the integer read from the input.
+; Non positive numbers end with an arithmetic overflow.
+.data
+msg: .byte "steps=", 0
+
+.text
+main:
+    li $v0, 5
+    syscall
+    move $t0, $v0
+    li $t1, 0
+    blez $t0, bad
+loop:
+    li $t2, 1
+    beq $t0, $t2, done
+    andi $t3, $t0, 1
+    beqz $t3, even
+    sll $t4, $t0, 1
+    addu $t0, $t0, $t4
+    addiu $t0, $t0, 1
+    j next
+even:
+    sra $t0, $t0, 1
+next:
+    addiu $t1, $t1, 1
+    addiu $sp, $sp, -4
+    sw $t1, 0($sp)
+    lw $s0, 0($sp)
+    addiu $sp, $sp, 4
+    j loop
+done:
+    la $a0, msg
+    li $v0, 4
+    syscall
+    move $a0, $s0
+    li $v0, 1
+    syscall
+    li $a0, 10
+    li $v0, 11
+    syscall
+    li $v0, 10
+    syscall
+bad:
+    li $t0, 0x7fffffff
+    addi $t0, $t0, 1
@@ -0,0 +1,10 @@
+; Overwrites the next block with a word that isn't an instruction
+.text
+main:
+    la $s0, bad
+    li $t0, -1
+    sw $t0, 0($s0)
+    j bad
+bad:
+    li $v0, 10
+    syscall
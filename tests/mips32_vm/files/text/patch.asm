@@ -0,0 +1,19 @@
+; Adds 1, 2, 3 and 4 to $t0 with a single addiu, the program bumps its
+; immediate after every pass
+.text
+main:
+    la $s0, step
+    li $t0, 0
+    li $t1, 0
+loop:
+step:
+    addiu $t0, $t0, 1
+    lw $t2, 0($s0)
+    addiu $t2, $t2, 1
+    sw $t2, 0($s0)
+    addiu $t1, $t1, 1
+    li $t3, 4
+    bne $t1, $t3, loop
+    move $a0, $t0
+    li $v0, 1
+    syscall
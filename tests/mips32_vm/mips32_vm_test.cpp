@@ -5,14 +5,22 @@
 #include <fstream>
 #include <vector>
 #include <filesystem>
+#include <cstdio>
+#include <cstdlib>
 #include "doctest.h"
 #include "easm_error.h"
 #include "mips32_parser.h"
 #include "mips32_ast.h"
 #include "mips32_assembler.h"
 #include "mips32_vm.h"
+#include "mips32_batch.h"
+#include "easm_outsink.h"
 #include "rang.hpp"
 
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sys/wait.h>
+#endif
+
 namespace Ast = Mips32::Ast;
 namespace Asm = Mips32::Assembler;
 
@@ -48,7 +56,8 @@ std::string readAllFile(const std::string& file_path)
     return std::string(file_data.data(), file_data.size());
 }
 
-void testFile(const std::string& src_file, const std::string& exp_file)
+void testFile(const std::string& src_file, const std::string& exp_file,
+              Mips32::ExecEngine engine = Mips32::ExecEngine::Decoded)
 {
     std::string file_content;
     try
@@ -64,6 +73,7 @@ void testFile(const std::string& src_file, const std::string& exp_file)
     std::ostringstream oss;
     Mips32::VirtualMachine vm(mmap, oss);
 
+    vm.setExecEngine(engine);
     rang::setControlMode(rang::control::Off);
     int res = vm.exec({src_file});
     rang::setControlMode(rang::control::Auto);
@@ -77,7 +87,8 @@ void testFile(const std::string& src_file, const std::string& exp_file)
     CHECK(oss.str() == file_content);
 }
 
-void checkOverflow(const std::string& src_file)
+void checkOverflow(const std::string& src_file,
+                   Mips32::ExecEngine engine = Mips32::ExecEngine::Decoded)
 {
     std::ostringstream oss;
 
@@ -85,6 +96,8 @@ void checkOverflow(const std::string& src_file)
     {
         Mips32::VirtualMachine vm(mmap);
 
+        vm.setExecEngine(engine);
+
         int res = vm.exec({src_file});
         REQUIRE( res != 0 );
         REQUIRE( !vm.lastError().empty() );
@@ -99,7 +112,7 @@ void checkOverflow(const std::string& src_file)
     }
 }
 
-TEST_CASE("MIPS32 virtual machine single file test")
+void testFolder(Mips32::ExecEngine engine)
 {
     fs::path srcfolder_path(inc_folder);
     fs::path expfolder_path(inc_folder);
@@ -121,7 +134,7 @@ TEST_CASE("MIPS32 virtual machine single file test")
         if (src_filename.compare(0, 3, "ovf") == 0)
         {
             std::cout << "Testing overflow: " << colorText(fcolor::yellow, sfilepath.string()) << '\n';
-            checkOverflow(sfilepath.string());
+            checkOverflow(sfilepath.string(), engine);
             continue;
         }
 
@@ -134,11 +147,425 @@ TEST_CASE("MIPS32 virtual machine single file test")
             fs::path efilepath(expfolder_path / efile);
 
             std::cout << "Testing file " << cboldText(rang::fg::magenta, sfilepath.string()) << '\n';
-            testFile(sfilepath.string(), efilepath.string());
+            testFile(sfilepath.string(), efilepath.string(), engine);
         }
     }
 }
 
+TEST_CASE("MIPS32 virtual machine single file test")
+{
+    testFolder(Mips32::ExecEngine::Decoded);
+}
+
+TEST_CASE("MIPS32 virtual machine single file test (closure engine)")
+{
+    testFolder(Mips32::ExecEngine::Closure);
+}
+
+TEST_CASE("MIPS32 virtual machine single file test (jit engine)")
+{
+    testFolder(Mips32::ExecEngine::Jit);
+}
+
+TEST_CASE("MIPS32 virtual machine instruction count")
+{
+    fs::path srcfolder_path(inc_folder);
+
+    srcfolder_path /= "asm";
+    REQUIRE(fs::is_directory(srcfolder_path));
+
+    for (const auto& entry : fs::directory_iterator(srcfolder_path))
+    {
+        if (!fs::is_regular_file(entry.status()))
+            continue;
+
+        std::string src_file = entry.path().string();
+        std::ostringstream oss1, oss2, oss3;
+        Mips32::VirtualMachine vm1(mmap, oss1);
+        Mips32::VirtualMachine vm2(mmap, oss2);
+        Mips32::VirtualMachine vm3(mmap, oss3);
+
+        INFO(src_file);
+        vm1.setExecEngine(Mips32::ExecEngine::Closure);
+        vm2.setExecEngine(Mips32::ExecEngine::Decoded);
+        vm3.setExecEngine(Mips32::ExecEngine::Jit);
+
+        int res1 = vm1.exec({src_file});
+        int res2 = vm2.exec({src_file});
+        int res3 = vm3.exec({src_file});
+
+        CHECK( res1 == res2 );
+        CHECK( res1 == res3 );
+        CHECK( vm1.getInstCount() == vm2.getInstCount() );
+        CHECK( vm1.getInstCount() == vm3.getInstCount() );
+        CHECK( oss1.str() == oss2.str() );
+        CHECK( oss1.str() == oss3.str() );
+    }
+}
+
+TEST_CASE("MIPS32 virtual machine C translation")
+{
+    fs::path srcfolder_path(fs::path(inc_folder) / "asm");
+    std::ostringstream c_out;
+    Mips32::VirtualMachine vm(mmap);
+
+    int res = vm.emitC({(srcfolder_path / "no_commands.asm").string()}, "", c_out);
+    if (res != 0)
+        std::cerr << vm.lastError();
+
+    REQUIRE( res == 0 );
+    CHECK( c_out.str().find("int main(void)") != std::string::npos );
+    CHECK( c_out.str().find("sys_call(") != std::string::npos );
+
+    // Debugger commands are only supported by the VM
+    std::ostringstream c_out2;
+
+    res = vm.emitC({(srcfolder_path / "syscall.asm").string()}, "", c_out2);
+    CHECK( res != 0 );
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+// C compiler of the host, CC if it's set, empty if there's none
+static std::string hostCompiler()
+{
+    std::vector<std::string> compilers = {"cc", "gcc", "clang"};
+
+    if (const char *cc = std::getenv("CC"))
+        compilers.insert(compilers.begin(), cc);
+
+    for (const auto& cc : compilers)
+    {
+        if (std::system((cc + " --version > /dev/null 2>&1").c_str()) == 0)
+            return cc;
+    }
+    return "";
+}
+
+TEST_CASE("MIPS32 virtual machine C translation: same behavior as the VM")
+{
+    std::string cc = hostCompiler();
+
+    if (cc.empty())
+    {
+        MESSAGE("No C compiler found, the translated programs aren't run");
+        return;
+    }
+
+    fs::path work_dir(fs::temp_directory_path() / "easymips-test-cgen");
+    const Mips32::MemoryMap heap_mmap(gbl_start, stk_start, gbl_size, stk_size, 16384);
+    std::vector<fs::path> programs;
+
+    fs::create_directories(work_dir);
+
+    for (const auto& entry : fs::directory_iterator(fs::path(inc_folder) / "asm"))
+    {
+        if (fs::is_regular_file(entry.status()))
+            programs.push_back(entry.path());
+    }
+    programs.push_back(fs::path(inc_folder) / "heap" / "sbrk.asm");
+
+    // Runtime errors and a jump out of the program, how they end is where
+    // the translation can drift from the VM
+    const std::vector<std::pair<std::string, std::string>> error_programs = {
+        {"overflow.asm", ".text\nmain:\nli $a0, 5\nli $v0, 1\nsyscall\n"
+                         "li $t1, 0x70000000\nadd $t0, $t1, $t1\nli $a0, 6\nsyscall\n"},
+        {"bad_load.asm", ".text\nmain:\nli $a0, 5\nli $v0, 1\nsyscall\n"
+                         "li $t0, 0x20000000\nlw $a0, 0($t0)\nsyscall\n"},
+        {"bad_store.asm", ".text\nmain:\nli $t0, 0x10000400\nsw $t0, 0($t0)\n"},
+        {"unaligned.asm", ".data\nw: .word 1, 2\n.text\nmain:\nla $t0, w\nlw $a0, 2($t0)\n"},
+        {"jump_past_end.asm", ".text\nmain:\nli $t0, 0x500000\njr $t0\n"},
+        {"read_ints_wrap.asm", ".text\nmain:\nli $a0, 0x10000000\nli $a1, 0x40000002\nli $v0, 60\nsyscall\n"},
+        {"read_ints_span.asm", ".text\nmain:\nli $a0, 0x10000000\nli $a1, 0x1bfffb00\nli $v0, 60\nsyscall\n"},
+    };
+
+    for (const auto& prg : error_programs)
+    {
+        programs.push_back(work_dir / prg.first);
+        std::ofstream(programs.back()) << prg.second;
+    }
+
+    size_t translated = 0;
+
+    for (const auto& src_file : programs)
+    {
+        INFO(src_file.string());
+
+        std::ostringstream c_out;
+        Mips32::VirtualMachine cvm(heap_mmap);
+
+        // Programs with debugger commands only run on the VM
+        if (cvm.emitC({src_file.string()}, "", c_out) != 0)
+            continue;
+
+        fs::path c_file(work_dir / src_file.filename().replace_extension(".c"));
+        fs::path exe_file(work_dir / src_file.filename().replace_extension(""));
+        fs::path out_file(work_dir / src_file.filename().replace_extension(".out"));
+
+        std::ofstream(c_file) << c_out.str();
+
+        std::string build = cc + " -O1 -o " + exe_file.string() + " " + c_file.string();
+        REQUIRE( std::system(build.c_str()) == 0 );
+
+        std::string run = exe_file.string() + " < /dev/null > " + out_file.string() + " 2> /dev/null";
+        int status = std::system(run.c_str());
+        REQUIRE( WIFEXITED(status) );
+
+        std::istringstream in;
+        std::ostringstream vm_out;
+        Mips32::VirtualMachine vm(heap_mmap, nullptr, in, vm_out);
+        int res = vm.exec({src_file.string()});
+
+        CHECK( WEXITSTATUS(status) == res );
+        CHECK( readAllFile(out_file.string()) == vm_out.str() );
+        translated++;
+    }
+
+    // Everything but the programs with commands
+    CHECK( translated >= error_programs.size() + 1 );
+
+    fs::remove_all(work_dir);
+}
+#endif
+
+static int collatzSteps(int n)
+{
+    int steps = 0;
+
+    for (; n != 1; steps++)
+        n = (n % 2 == 0)? n / 2 : 3 * n + 1;
+
+    return steps;
+}
+
+TEST_CASE("MIPS32 virtual machine lockstep lanes")
+{
+    fs::path src_file(fs::path(inc_folder) / "lanes" / "collatz.asm");
+    std::vector<std::string> inputs;
+    std::vector<Mips32::LaneResult> results;
+    Mips32::VirtualMachine vm(mmap);
+
+    // More inputs than lanes, so they run in two groups
+    for (int i = 1; i <= 20; i++)
+        inputs.push_back(std::to_string(i * 7) + "\n");
+    inputs.push_back("-5\n");
+
+    int res = vm.execLanes({src_file.string()}, "", inputs, results);
+    if (res != 0)
+        std::cerr << vm.lastError();
+
+    REQUIRE( res == 0 );
+    REQUIRE( results.size() == inputs.size() );
+
+    for (int i = 1; i <= 20; i++)
+    {
+        const Mips32::LaneResult& lres = results[i - 1];
+        std::vector<Mips32::LaneResult> single;
+
+        INFO(inputs[i - 1]);
+        CHECK( lres.status == 0 );
+        CHECK( lres.output == "steps=" + std::to_string(collatzSteps(i * 7)) + "\n" );
+
+        // Running alone must take the same path
+        REQUIRE( vm.execLanes({src_file.string()}, "", {inputs[i - 1]}, single) == 0 );
+        CHECK( lres.inst_count == single[0].inst_count );
+    }
+
+    CHECK( results.back().status == 2 );
+    CHECK( results.back().output.empty() );
+}
+
+TEST_CASE("MIPS32 virtual machine heap")
+{
+    fs::path src_file(fs::path(inc_folder) / "heap" / "sbrk.asm");
+    const Mips32::MemoryMap heap_mmap(gbl_start, stk_start, gbl_size, stk_size, 16384);
+
+    for (auto engine : {Mips32::ExecEngine::Closure, Mips32::ExecEngine::Decoded,
+                        Mips32::ExecEngine::Jit})
+    {
+        std::ostringstream oss, err;
+        Mips32::VirtualMachine vm(heap_mmap, oss);
+
+        vm.setExecEngine(engine);
+        rang::setControlMode(rang::control::Off);
+        int res = vm.exec({src_file.string()});
+        err << vm.lastError();
+        rang::setControlMode(rang::control::Auto);
+
+        CHECK( res == 2 );
+        CHECK( oss.str() == "12 1999000 208\n" );
+        CHECK( err.str().find("heap limit is 16384 bytes") != std::string::npos );
+    }
+}
+
+TEST_CASE("MIPS32 virtual machine reset")
+{
+    fs::path src_file(fs::path(inc_folder) / "heap" / "sbrk.asm");
+    const Mips32::MemoryMap heap_mmap(gbl_start, stk_start, gbl_size, stk_size, 12288);
+    std::ostringstream oss;
+    Mips32::VirtualMachine vm(heap_mmap, oss);
+
+    // A second run only fits in the heap after a reset
+    for (int i = 0; i < 2; i++)
+    {
+        CHECK( vm.exec({src_file.string()}) == 2 );
+        CHECK( oss.str() == "12 1999000 208\n" );
+        oss.str("");
+
+        CHECK( vm.processCliInput("#reset") == 0 );
+    }
+}
+
+TEST_CASE("MIPS32 virtual machine checkpoint")
+{
+    fs::path src_file(fs::path(inc_folder) / "checkpoint" / "sum.asm");
+    const Mips32::MemoryMap heap_mmap(gbl_start, stk_start, gbl_size, stk_size, 16384);
+
+    for (auto engine : {Mips32::ExecEngine::Closure, Mips32::ExecEngine::Decoded,
+                        Mips32::ExecEngine::Jit})
+    {
+        std::ostringstream oss1, oss2;
+        Mips32::VirtualMachine vm1(heap_mmap, oss1);
+
+        vm1.setExecEngine(engine);
+        REQUIRE( vm1.exec({src_file.string()}) == 0 );
+        CHECK( oss1.str() == "1 3 6 10 15 21 28 36 45 55 55\n" );
+
+        // The checkpoint brings its own memory map
+        Mips32::VirtualMachine vm2(mmap, oss2);
+
+        vm2.setExecEngine(engine);
+        REQUIRE( vm2.resume("sum.ckpt") == 0 );
+        CHECK( oss2.str() == "21 28 36 45 55 55\n" );
+        CHECK( vm2.getInstCount() == vm1.getInstCount() );
+        CHECK( vm2.memoryMap().heapLimit() == 16384 );
+    }
+
+    // Heap size past its limit, heap break outside of the heap
+    std::string image = readAllFile("sum.ckpt");
+
+    for (auto [offset, val] : {std::pair<size_t, uint64_t>(56, 0x40000000), {64, 0x30001000}})
+    {
+        std::string bad_image = image;
+        std::ostringstream err;
+        Mips32::VirtualMachine vm(mmap);
+
+        bad_image.replace(offset, sizeof(val), reinterpret_cast<const char *>(&val), sizeof(val));
+        std::ofstream("bad.ckpt", std::ios::out | std::ios::binary) << bad_image;
+
+        rang::setControlMode(rang::control::Off);
+        CHECK( vm.resume("bad.ckpt") == 1 );
+        err << vm.lastError();
+        rang::setControlMode(rang::control::Auto);
+        CHECK( err.str() == "bad.ckpt is not a valid checkpoint file\n" );
+    }
+    fs::remove("bad.ckpt");
+    fs::remove("sum.ckpt");
+}
+
+TEST_CASE("MIPS32 virtual machine interactive checkpoint")
+{
+    std::ostringstream oss;
+    Mips32::VirtualMachine vm1(mmap);
+    Mips32::VirtualMachine vm2(mmap, oss);
+
+    REQUIRE( vm1.processCliInput("#set $t3 = 1234") == 0 );
+    REQUIRE( vm1.processCliInput("#set word 16($gp) = 0xcafe") == 0 );
+    REQUIRE( vm1.processCliInput("#checkpoint \"repl.ckpt\"") == 0 );
+
+    REQUIRE( vm2.resume("repl.ckpt") == 0 );
+
+    rang::setControlMode(rang::control::Off);
+    REQUIRE( vm2.processCliInput("#show $t3") == 0 );
+    REQUIRE( vm2.processCliInput("#show word 16($gp) hex") == 0 );
+    rang::setControlMode(rang::control::Auto);
+
+    CHECK( oss.str() == "$t3 = 1234\nword(0x10000010) = 0x0000cafe\n" );
+    fs::remove("repl.ckpt");
+
+    CHECK( vm2.resume("repl.ckpt") == 1 );
+}
+
+TEST_CASE("MIPS32 virtual machine history")
+{
+    std::string src_file = (fs::path(inc_folder) / "history" / "count.asm").string();
+    const Mips32::MemoryMap heap_mmap(gbl_start, stk_start, gbl_size, stk_size, 16384);
+    std::ostringstream oss;
+    Mips32::VirtualMachine vm(heap_mmap, oss);
+
+    auto cli = [&vm, &oss](const std::string& input)
+    {
+        oss.str("");
+        rang::setControlMode(rang::control::Off);
+        int res = vm.processCliInput(input);
+        rang::setControlMode(rang::control::Auto);
+
+        return res;
+    };
+
+    CHECK( cli("#undo") == 1 );
+
+    vm.setHistorySize(1 << 20);
+    REQUIRE( cli("#exec \"" + src_file + "\"") == 0 );
+
+    SUBCASE("Undo and redo")
+    {
+        // bne, li and sw of the last iteration
+        REQUIRE( cli("#undo 3") == 0 );
+        CHECK( oss.str() == "pc = 0x00400020\n" );
+        REQUIRE( cli("#show word 0($gp)") == 0 );
+        CHECK( oss.str() == "word(0x10000000) = 9\n" );
+
+        REQUIRE( cli("#redo 5") == 0 );
+        REQUIRE( cli("#show word 0($gp)") == 0 );
+        CHECK( oss.str() == "word(0x10000000) = 10\n" );
+        CHECK( cli("#redo") == 1 );
+    }
+
+    SUBCASE("Rewind")
+    {
+        // Right before the sb of the last iteration
+        REQUIRE( cli("#rewind 0x400018") == 0 );
+        CHECK( oss.str() == "pc = 0x00400018\n" );
+        REQUIRE( cli("#show $t0") == 0 );
+        CHECK( oss.str() == "$t0 = 10\n" );
+        REQUIRE( cli("#show byte 0($s1) hex") == 0 );
+        CHECK( oss.str() == "byte(0x10001000) = 0x09\n" );
+
+        CHECK( cli("#rewind 0x400100") == 1 );
+    }
+
+    SUBCASE("Back to the start")
+    {
+        REQUIRE( cli("#undo 1000") == 0 );
+        CHECK( oss.str() == "pc = 0x00400000\n" );
+
+        // The heap is gone with the sbrk
+        CHECK( cli("#show byte 0x10001000") == 1 );
+
+        REQUIRE( cli("#redo 3") == 0 );
+        REQUIRE( cli("#show $v0") == 0 );
+        CHECK( oss.str() == "$v0 = 268439552\n" );
+
+        // A new instruction drops what was undone
+        REQUIRE( cli("addiu $t5, $zero, 9") == 0 );
+        CHECK( cli("#redo") == 1 );
+        REQUIRE( cli("#undo") == 0 );
+        REQUIRE( cli("#show $t5") == 0 );
+        CHECK( oss.str() == "$t5 = 0\n" );
+    }
+
+    SUBCASE("Oldest instructions dropped")
+    {
+        vm.setHistorySize(1);
+        REQUIRE( cli("#reset") == 0 );
+        REQUIRE( cli("#exec \"" + src_file + "\"") == 0 );
+
+        REQUIRE( cli("#undo 1000") == 0 );
+        CHECK( oss.str() != "pc = 0x00400000\n" );
+        CHECK( cli("#undo") == 1 );
+    }
+}
+
 std::string vmRun(const std::vector<std::string>& files)
 {
     std::ostringstream oss;
@@ -155,6 +582,479 @@ std::string vmRun(const std::vector<std::string>& files)
     return oss.str();
 }
 
+TEST_CASE("MIPS32 virtual machine self-modifying code")
+{
+    fs::path text_folder(fs::path(inc_folder) / "text");
+
+    auto run = [](const fs::path& src_file, Mips32::ExecEngine engine,
+                  std::string& output, std::string& error)
+    {
+        std::ostringstream oss, err;
+        Mips32::VirtualMachine vm(mmap, oss);
+
+        vm.setExecEngine(engine);
+        rang::setControlMode(rang::control::Off);
+        int res = vm.exec({src_file.string()});
+        err << vm.lastError();
+        rang::setControlMode(rang::control::Auto);
+
+        output = oss.str();
+        error = err.str();
+        return res;
+    };
+
+    std::string output, error;
+
+    SUBCASE("Patched immediate")
+    {
+        CHECK( run(text_folder / "patch.asm", Mips32::ExecEngine::Decoded, output, error) == 0 );
+        CHECK( output == "10" );
+
+        // The other engines keep the text read only
+        for (auto engine : {Mips32::ExecEngine::Closure, Mips32::ExecEngine::Jit})
+        {
+            CHECK( run(text_folder / "patch.asm", engine, output, error) == 2 );
+            CHECK( error.find("Invalid virtual address 0x0040000c in instruction sw")
+                   != std::string::npos );
+        }
+    }
+
+    SUBCASE("Invalid word")
+    {
+        CHECK( run(text_folder / "bad_word.asm", Mips32::ExecEngine::Decoded, output, error) == 2 );
+        CHECK( error.find("bad_word.asm:9:") != std::string::npos );
+        CHECK( error.find("Invalid instruction word 0xffffffff") != std::string::npos );
+    }
+}
+
+TEST_CASE("MIPS32 virtual machine program cache")
+{
+    fs::path cache_dir(fs::temp_directory_path() / "easymips-test-cache");
+    std::string src_file = (fs::path(inc_folder) / "asm" / "no_commands.asm").string();
+
+    fs::remove_all(cache_dir);
+
+    auto run = [&cache_dir](const std::string& src_file, Mips32::ExecEngine engine)
+    {
+        std::ostringstream oss;
+        Mips32::VirtualMachine vm(mmap, oss);
+
+        vm.setExecEngine(engine);
+        vm.setCacheDir(cache_dir.string());
+        rang::setControlMode(rang::control::Off);
+        int res = vm.exec({src_file});
+        rang::setControlMode(rang::control::Auto);
+
+        if (res != 0)
+            std::cerr << vm.lastError();
+
+        REQUIRE( res == 0 );
+        return oss.str();
+    };
+
+    std::string output = run(src_file, Mips32::ExecEngine::Decoded);
+    std::vector<fs::path> files;
+
+    for (const auto& ent : fs::directory_iterator(cache_dir))
+        files.push_back(ent.path());
+
+    REQUIRE( files.size() == 1 );
+    CHECK( files[0].extension() == ".prg" );
+
+    // A hit gives the same program to every engine
+    for (auto engine : {Mips32::ExecEngine::Closure, Mips32::ExecEngine::Decoded,
+                        Mips32::ExecEngine::Jit})
+        CHECK( run(src_file, engine) == output );
+
+    // The global data comes from the file on a hit
+    std::string image = readAllFile(files[0].string());
+    size_t pos = image.find("Sum = ");
+
+    REQUIRE( pos != std::string::npos );
+    image.replace(pos, 3, "SUM");
+    std::ofstream(files[0], std::ios::out | std::ios::binary) << image;
+
+    CHECK( run(src_file, Mips32::ExecEngine::Decoded) == "SUM = 41\n" );
+
+    // A damaged file is a miss and gets written again
+    std::ofstream(files[0], std::ios::out | std::ios::binary) << "EMIPSPRG";
+    CHECK( run(src_file, Mips32::ExecEngine::Decoded) == output );
+    CHECK( run(src_file, Mips32::ExecEngine::Decoded) == output );
+    CHECK( fs::file_size(files[0]) > 8 );
+
+    // Programs with debugger commands are never kept
+    run((fs::path(inc_folder) / "hi_lo_hw.asm").string(), Mips32::ExecEngine::Decoded);
+    CHECK( std::distance(fs::directory_iterator(cache_dir), fs::directory_iterator()) == 1 );
+
+    fs::remove_all(cache_dir);
+}
+
+// Big-endian ELF32 MIPS executable with a code segment at 0x400000, a data
+// segment at 0x10000000 and a symbol table
+static std::string elfExecutable(const std::vector<uint32_t>& code, uint32_t entry,
+                                 const std::vector<uint8_t>& data, uint32_t bss_size,
+                                 const std::vector<std::pair<std::string, uint32_t>>& symbols)
+{
+    std::string buf;
+
+    auto put16 = [&buf](uint32_t val)
+    { buf += char(val >> 8); buf += char(val); };
+    auto put32 = [&buf](uint32_t val)
+    { for (int s = 24; s >= 0; s -= 8) buf += char(val >> s); };
+
+    std::string strtab(1, '\0');
+    for (const auto& sym : symbols)
+        strtab += sym.first + '\0';
+
+    const uint32_t text_ofs = 52 + 2 * 32;
+    const uint32_t data_ofs = text_ofs + code.size() * 4;
+    const uint32_t symtab_ofs = data_ofs + ((data.size() + 3) & ~size_t(3));
+    const uint32_t strtab_ofs = symtab_ofs + (symbols.size() + 1) * 16;
+    const uint32_t shdr_ofs = (strtab_ofs + strtab.size() + 3) & ~3u;
+
+    buf.append("\x7f" "ELF\x01\x02\x01", 7);
+    buf.append(9, '\0');
+    put16(2); put16(8); put32(1);               // ET_EXEC, EM_MIPS
+    put32(entry); put32(52); put32(shdr_ofs);
+    put32(0x50001000);                          // MIPS32, O32
+    put16(52); put16(32); put16(2); put16(40); put16(3); put16(0);
+
+    // PT_LOAD segments
+    for (uint32_t val : {1u, text_ofs, 0x400000u, 0x400000u, uint32_t(code.size() * 4),
+                         uint32_t(code.size() * 4), 5u, 4u})
+        put32(val);
+    for (uint32_t val : {1u, data_ofs, 0x10000000u, 0x10000000u, uint32_t(data.size()),
+                         uint32_t(data.size() + bss_size), 6u, 4u})
+        put32(val);
+
+    for (uint32_t word : code)
+        put32(word);
+    buf.append(data.begin(), data.end());
+    buf.resize(symtab_ofs, '\0');
+
+    buf.append(16, '\0');
+    for (size_t i = 0, name = 1; i < symbols.size(); name += symbols[i].first.size() + 1, i++)
+    {
+        put32(name); put32(symbols[i].second); put32(0);
+        buf += char(0x10); buf += '\0'; put16(1); // STB_GLOBAL, first section
+    }
+    buf += strtab;
+    buf.resize(shdr_ofs, '\0');
+
+    // Null section, .symtab and .strtab
+    buf.append(40, '\0');
+    for (uint32_t val : {0u, 2u, 0u, 0u, symtab_ofs, uint32_t((symbols.size() + 1) * 16), 2u, 1u, 4u, 16u})
+        put32(val);
+    for (uint32_t val : {0u, 3u, 0u, 0u, strtab_ofs, uint32_t(strtab.size()), 0u, 0u, 1u, 0u})
+        put32(val);
+
+    return buf;
+}
+
+TEST_CASE("MIPS32 virtual machine ELF executable")
+{
+    // Words a toolchain would emit, with the delay slots filled
+    const std::vector<uint32_t> code = {
+        0x4869210a, 0x00000000, 0x00000000, 0x00000000, // "Hi!\n"
+        0x3c040040, // main: lui $a0, 0x40
+        0x24020004, //       addiu $v0, $zero, 4
+        0x0000000c, //       syscall
+        0x24090003, //       addiu $t1, $zero, 3
+        0x24040000, //       addiu $a0, $zero, 0
+        0x00892021, // loop: addu $a0, $a0, $t1
+        0x2529ffff, //       addiu $t1, $t1, -1
+        0x1520fffd, //       bne $t1, $zero, loop
+        0x254a0001, //       addiu $t2, $t2, 1
+        0x15200009, //       bne $t1, $zero, exit
+        0x24090007, //       addiu $t1, $zero, 7
+        0x0c100019, //       jal print
+        0x24020001, //       addiu $v0, $zero, 1
+        0x0c100019, //       jal print
+        0x01402021, //       move $a0, $t2
+        0x0c100019, //       jal print
+        0x01202021, //       move $a0, $t1
+        0x0c100019, //       jal print
+        0x8f84fffc, //       lw $a0, -4($gp)
+        0x2402000a, // exit: addiu $v0, $zero, 10
+        0x0000000c, //       syscall
+        0x24020001, // print: addiu $v0, $zero, 1
+        0x0000000c, //       syscall
+        0x2404000a, //       addiu $a0, $zero, 10
+        0x2402000b, //       addiu $v0, $zero, 11
+        0x0000000c, //       syscall
+        0x03e00008, //       jr $ra
+        0x00000000, //       nop
+    };
+    const std::vector<uint8_t> data = {0x11, 0x22, 0x33, 0x44};
+    fs::path elf_file(fs::temp_directory_path() / "easymips-test.elf");
+
+    std::ofstream(elf_file, std::ios::out | std::ios::binary)
+        << elfExecutable(code, 0x400010, data, 12, {{"main", 0x400010}, {"_gp", 0x10000004}});
+
+    for (auto engine : {Mips32::ExecEngine::Closure, Mips32::ExecEngine::Decoded,
+                        Mips32::ExecEngine::Jit})
+    {
+        std::ostringstream oss;
+        Mips32::VirtualMachine vm(mmap, oss);
+
+        vm.setExecEngine(engine);
+        int res = vm.exec({elf_file.string()});
+        if (res != 0)
+            std::cerr << vm.lastError();
+
+        CHECK( res == 0 );
+        CHECK( oss.str() == "Hi!\n6\n3\n7\n287454020\n" );
+    }
+
+    // A bss bigger than the global memory moves its end for the run only,
+    // the programs run after it get the configured layout back
+    {
+        fs::path big_elf(fs::temp_directory_path() / "easymips-test-big.elf");
+        fs::path src_file(fs::temp_directory_path() / "easymips-test-after-elf.asm");
+        std::ostringstream oss;
+        Mips32::VirtualMachine vm(mmap, oss);
+
+        std::ofstream(big_elf, std::ios::out | std::ios::binary)
+            << elfExecutable(code, 0x400010, data, 4096, {{"main", 0x400010}, {"_gp", 0x10000004}});
+        std::ofstream(src_file) << ".text\nmain:\nli $t0, 0x10000800\nlw $a0, 0($t0)\n";
+
+        REQUIRE( vm.exec({big_elf.string()}) == 0 );
+        CHECK( oss.str() == "Hi!\n6\n3\n7\n287454020\n" );
+        CHECK( vm.memoryMap().gblStartAddr() == mmap.gblStartAddr() );
+        CHECK( vm.memoryMap().gblSize() == mmap.gblSize() );
+
+        // Past the end of the configured global memory
+        CHECK( vm.exec({src_file.string()}, "main") == 2 );
+
+        fs::remove(big_elf);
+        fs::remove(src_file);
+    }
+
+    std::ostringstream err;
+    Mips32::VirtualMachine vm(mmap);
+
+    rang::setControlMode(rang::control::Off);
+    CHECK( vm.exec({elf_file.string()}, "start") == 2 );
+    err << vm.lastError();
+    CHECK( err.str().find("Entry point start isn't a symbol of") != std::string::npos );
+
+    // A code segment whose end wraps around the address space
+    std::string image = readAllFile(elf_file.string());
+    std::string wrapped = image;
+
+    wrapped.replace(60, 4, "\xff\xff\xf0\x00", 4);    // p_vaddr
+    wrapped.replace(72, 4, "\x00\x00\x10\x00", 4);    // p_memsz
+    std::ofstream(elf_file, std::ios::out | std::ios::binary) << wrapped;
+    err.str("");
+    CHECK( vm.exec({elf_file.string()}) == 1 );
+    err << vm.lastError();
+    CHECK( err.str().find("must be between 0x00400000 and 0x10000000") != std::string::npos );
+
+    // Executables from other architectures are rejected
+    image[5] = 1;
+    std::ofstream(elf_file, std::ios::out | std::ios::binary) << image;
+    err.str("");
+    CHECK( vm.exec({elf_file.string()}) == 1 );
+    err << vm.lastError();
+    CHECK( err.str().find("is not a big-endian MIPS32 ELF file") != std::string::npos );
+    rang::setControlMode(rang::control::Auto);
+
+    fs::remove(elf_file);
+}
+
+TEST_CASE("MIPS32 virtual machine batch")
+{
+    fs::path batch_dir(fs::temp_directory_path() / "easymips-test-batch");
+    fs::path asm_dir(inc_folder);
+
+    fs::remove_all(batch_dir);
+    fs::create_directories(batch_dir);
+
+    std::ofstream(batch_dir / "sum.out") << "Sum = 41\n";
+    std::ofstream(batch_dir / "seven.in") << "7\n";
+    std::ofstream(batch_dir / "seven.out") << "steps=" << collatzSteps(7) << "\n";
+    std::ofstream(batch_dir / "wrong.out") << "steps=0\n";
+    std::ofstream(batch_dir / "jobs.txt")
+        << "# Sum of an array\n"
+        << "run=" << (asm_dir / "asm" / "no_commands.asm").string() << " expect=sum.out\n"
+        << "\n"
+        << "run=" << (asm_dir / "lanes" / "collatz.asm").string() << " stdin=seven.in expect=seven.out\n"
+        << "run=" << (asm_dir / "lanes" / "collatz.asm").string() << " stdin=seven.in expect=wrong.out\n"
+        << "run=missing.asm  # Doesn't exist\n"
+        << "run=" << (asm_dir / "asm" / "no_commands.asm").string() << "\n";
+
+    Mips32::BatchJobVector jobs = Mips32::parseManifest((batch_dir / "jobs.txt").string());
+
+    REQUIRE( jobs.size() == 5 );
+    CHECK( jobs[1].line == 4 );
+    CHECK( jobs[1].stdin_file == (batch_dir / "seven.in").string() );
+    CHECK( jobs[3].input_files[0] == (batch_dir / "missing.asm").string() );
+
+    Mips32::BatchOptions opts;
+    std::ostringstream oss;
+
+    opts.threads = 3;
+    rang::setControlMode(rang::control::Off);
+    size_t failed = Mips32::runBatch(jobs, mmap, opts, oss);
+    rang::setControlMode(rang::control::Auto);
+
+    CHECK( failed == 2 );
+
+    std::istringstream iss(oss.str());
+    std::vector<std::string> lines;
+
+    for (std::string line; std::getline(iss, line); )
+        lines.push_back(line);
+
+    REQUIRE( lines.size() == 5 );
+    for (size_t i = 0; i < lines.size(); i++)
+        CHECK( lines[i].find("{\"job\":" + std::to_string(i + 1) + ",") == 0 );
+
+    CHECK( lines[0].find("\"line\":2,\"status\":0,\"passed\":true,\"inst_count\":") != std::string::npos );
+    CHECK( lines[0].find("\"output\"") == std::string::npos );
+    CHECK( lines[1].find("\"passed\":true") != std::string::npos );
+    CHECK( lines[2].find("\"passed\":false") != std::string::npos );
+    CHECK( lines[2].find("\"output\":\"steps=16\\n\"") != std::string::npos );
+    CHECK( lines[3].find("\"status\":1,\"passed\":false") != std::string::npos );
+    CHECK( lines[3].find("\"error\":") != std::string::npos );
+    CHECK( lines[4].find("\"passed\":null") != std::string::npos );
+    CHECK( lines[4].find("\"output\":\"Sum = 41\\n\"") != std::string::npos );
+
+    // Wrong manifests are rejected with their line
+    std::ofstream(batch_dir / "bad.txt") << "run=a.asm\nrun=b.asm input=x\n";
+    CHECK_THROWS_AS( Mips32::parseManifest((batch_dir / "bad.txt").string()), EAsm::Error );
+
+    fs::remove_all(batch_dir);
+}
+
+TEST_CASE("MIPS32 virtual machine output sink")
+{
+    fs::path out_file(fs::temp_directory_path() / "easymips-test-sink.txt");
+    std::FILE *f = std::fopen(out_file.string().c_str(), "wb");
+
+    REQUIRE( f != nullptr );
+
+    auto written = [&out_file]() { return readAllFile(out_file.string()); };
+
+    {
+        // The whole output is kept until the end, past the initial size
+        EAsm::OutputSink sink(fileno(f), EAsm::FlushPolicy::Exit, 4);
+        std::ostream os(&sink);
+        Mips32::VirtualMachine vm(mmap, os);
+
+        CHECK_FALSE( sink.isTerminal() );
+        REQUIRE( vm.exec({(fs::path(inc_folder) / "asm" / "no_commands.asm").string()}) == 0 );
+        os.flush();
+        CHECK( written() == "" );
+        CHECK( sink.flush() );
+        CHECK( written() == "Sum = 41\n" );
+
+        sink.setFlushPolicy(EAsm::FlushPolicy::Line);
+        os << "Line" << ' ' << 1;
+        CHECK( written() == "Sum = 41\n" );
+        os.put('\n');
+        CHECK( written() == "Sum = 41\nLine 1\n" );
+    }
+
+    {
+        EAsm::OutputSink sink(fileno(f), EAsm::FlushPolicy::Size, 4);
+        std::ostream os(&sink);
+
+        os << "ab";
+        os.put('c');
+        CHECK( written() == "Sum = 41\nLine 1\n" );
+        os << "def";
+        CHECK( written() == "Sum = 41\nLine 1\nabc" );
+        os << "ghijk";
+        CHECK( written() == "Sum = 41\nLine 1\nabcdefghijk" );
+        os << '\n';
+    }
+    CHECK( written() == "Sum = 41\nLine 1\nabcdefghijk\n" );
+
+    // An attached stream gets its own buffer back
+    std::ostringstream oss;
+
+    {
+        EAsm::OutputSink sink(fileno(f), EAsm::FlushPolicy::Size);
+
+        oss << "before ";
+        sink.attach(oss);
+        oss << "sink\n";
+    }
+    oss << "after";
+    CHECK( oss.str() == "before after" );
+    CHECK( written() == "Sum = 41\nLine 1\nabcdefghijk\nsink\n" );
+
+    std::fclose(f);
+    fs::remove(out_file);
+}
+
+TEST_CASE("MIPS32 virtual machine input")
+{
+    // Lines and numbers are read like std::getline and std::stol did
+    std::istringstream iss("  +12abc\n+-5\n99999999999999999999999\n\n" + std::string(100000, 'x')
+                           + "\n-7\nlast");
+    Mips32::InputReader reader(iss);
+
+    CHECK( reader.readInt() == 12 );
+    CHECK( reader.readInt() == 0 );
+    CHECK( reader.readInt() == 0 );
+    CHECK( reader.readLine() == "" );
+    CHECK( reader.readLine().size() == 100000 );
+    CHECK( reader.readInt() == -7 );
+    CHECK( reader.readLine() == "last" );
+    CHECK( reader.readLine() == "" );
+
+    std::string src_file = (fs::path(inc_folder) / "input" / "read_ints.asm").string();
+    auto run = [&src_file](const std::string& input, Mips32::ExecEngine engine)
+    {
+        std::istringstream in(input);
+        std::ostringstream out;
+        Mips32::VirtualMachine vm(mmap, nullptr, in, out);
+
+        vm.setExecEngine(engine);
+        int res = vm.exec({src_file});
+        if (res != 0)
+            std::cerr << vm.lastError();
+
+        CHECK( res == 0 );
+        return out.str();
+    };
+
+    for (auto engine : {Mips32::ExecEngine::Closure, Mips32::ExecEngine::Decoded,
+                        Mips32::ExecEngine::Jit})
+    {
+        CHECK( run("5\n1 2\n\n  3 -4\t+5  \n42\n", engine) == "7\n5\n42\n" );
+        CHECK( run("4\n10 20 x 30\n7\n", engine) == "30\n2\n0\n" );
+        CHECK( run("4\n10 20 3x 30\n7\n", engine) == "30\n2\n30\n" );
+        CHECK( run("3\n1 2", engine) == "3\n2\n0\n" );
+    }
+
+    // The array must be in memory and aligned
+    std::istringstream in("1 2 3\n");
+    std::ostringstream out;
+    Mips32::VirtualMachine vm(mmap, nullptr, in, out);
+
+    REQUIRE( vm.exec({src_file}) == 0 );
+    rang::setControlMode(rang::control::Off);
+    CHECK( vm.processCliInput("li $a0, 0x10000002") == 0 );
+    CHECK( vm.processCliInput("li $a1, 1") == 0 );
+    CHECK( vm.processCliInput("li $v0, 60") == 0 );
+    CHECK( vm.processCliInput("syscall") != 0 );
+
+    // A count whose byte size wraps around the address space
+    vm.setHistorySize(1 << 16);
+    CHECK( vm.processCliInput("li $a0, 0x10000000") == 0 );
+    CHECK( vm.processCliInput("li $a1, 0x40000002") == 0 );
+    CHECK( vm.processCliInput("syscall") != 0 );
+
+    std::ostringstream err;
+
+    err << vm.lastError();
+    CHECK( err.str().find("Invalid virtual address range 0x10000000:0x110000007\n") != std::string::npos );
+    rang::setControlMode(rang::control::Auto);
+}
+
 TEST_CASE("MIPS32 virtual machine multiple file: test 1")
 {
     fs::path ifolder_path(inc_folder);
@@ -227,6 +1127,78 @@ TEST_CASE("MIPS32 virtual machine multiple file: test 2")
     CHECK(output == file_content);
 }
 
+TEST_CASE("MIPS32 virtual machine multiple file: parse threads")
+{
+    fs::path src_dir(fs::temp_directory_path() / "easymips-test-multiple");
+
+    fs::remove_all(src_dir);
+    fs::create_directories(src_dir);
+
+    // The code of a file goes on in the next one, every file has its own
+    // label 'here'
+    std::vector<std::string> files;
+
+    for (int i = 0; i < 20; i++)
+    {
+        fs::path file = src_dir / ("part" + std::to_string(i) + ".asm");
+        std::ofstream out(file);
+
+        if (i == 0)
+            out << ".text\n    li $a0, 0\n";
+        else if (i == 19)
+            out << ".text\n    li $v0, 1\n    syscall\n    li $v0, 10\n    syscall\n";
+        else
+            out << ".text\nhere:\n    addi $a0, $a0, " << i << "\n";
+
+        files.push_back(file.string());
+    }
+
+    auto run = [&files](unsigned threads, std::string& error)
+    {
+        std::ostringstream out, err;
+        Mips32::VirtualMachine vm(mmap, out);
+
+        vm.setParseThreads(threads);
+        rang::setControlMode(rang::control::Off);
+        int res = vm.exec(files);
+        err << vm.lastError();
+        rang::setControlMode(rang::control::Auto);
+
+        error = (res == 0)? "" : err.str();
+        return out.str();
+    };
+
+    std::string error;
+
+    for (unsigned threads : {1, 4, 0})
+    {
+        CHECK( run(threads, error) == "171" );
+        CHECK( error.empty() );
+    }
+
+    // The error of the first wrong file is the one reported, whatever the
+    // thread that parsed it
+    std::ofstream(files[5]) << ".global nowhere\n.text\n    addi $a0, $a0, 5\n";
+    std::ofstream(files[12]) << ".text\n    addi $a0, , 12\n";
+
+    for (unsigned threads : {1, 4, 0})
+    {
+        run(threads, error);
+        CHECK( error.find("part5.asm") != std::string::npos );
+        CHECK( error.find("nowhere") != std::string::npos );
+    }
+
+    std::ofstream(files[5]) << ".text\n    addi $a0, $a0, 5\n";
+
+    for (unsigned threads : {1, 4, 0})
+    {
+        run(threads, error);
+        CHECK( error.find("part12.asm") != std::string::npos );
+    }
+
+    fs::remove_all(src_dir);
+}
+
 int main(int argc, char **argv)
 {
     doctest::Context context;